@@ -117,6 +117,11 @@ if(DEFINED DEBUG_NO_REBOOT)
     set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -DDEBUG_NO_REBOOT=1")
 endif()
 
+# Access files on local disk through mmap, -DNO_FILE_MMAP=1 to use stdio instead
+if(NOT DEFINED NO_FILE_MMAP AND NOT CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DFNIO_MMAP")
+endif()
+
 set(INCLUDE_DIRS include
     lib/compat lib/config lib/utils lib/hardware lib/clock
     lib/FileSystem
@@ -177,6 +182,7 @@ set(SOURCES src/main.cpp
     lib/FileSystem/fnFileTNFS.h lib/FileSystem/fnFileTNFS.cpp
     lib/FileSystem/fnFileSMB.h lib/FileSystem/fnFileSMB.cpp
     lib/FileSystem/fnFileMem.h lib/FileSystem/fnFileMem.cpp
+    lib/FileSystem/fnFileMap.h lib/FileSystem/fnFileMap.cpp
     lib/FileSystem/fnio.h lib/FileSystem/fnio.cpp
     lib/tcpip/fnDNS.h lib/tcpip/fnDNS.cpp
     lib/tcpip/fnUDP.h lib/tcpip/fnUDP.cpp
@@ -188,6 +194,7 @@ set(SOURCES src/main.cpp
     lib/TNFSlib/tnfslib_udp.h lib/TNFSlib/tnfslib_udp_testing.cpp
     lib/telnet/libtelnet.h lib/telnet/libtelnet.c
     lib/fnjson/fnjson.h lib/fnjson/fnjson.cpp
+    lib/fnjson/fnjsonstream.h lib/fnjson/fnjsonstream.cpp
     components_pc/mongoose/mongoose.h components_pc/mongoose/mongoose.c
     lib/webdav/WebDAV.h lib/webdav/WebDAV.cpp
     lib/http/httpService.h lib/http/mgHttpService.cpp
@@ -212,6 +219,7 @@ set(SOURCES src/main.cpp
     lib/printer-emulator/html_printer.h lib/printer-emulator/html_printer.cpp
     lib/printer-emulator/okimate_10.h lib/printer-emulator/okimate_10.cpp
     lib/printer-emulator/pdf_printer.h lib/printer-emulator/pdf_printer.cpp
+    lib/printer-emulator/zlib_stream.h lib/printer-emulator/zlib_stream.cpp
     lib/printer-emulator/png_printer.h lib/printer-emulator/png_printer.cpp
     lib/printer-emulator/printer_emulator.h lib/printer-emulator/printer_emulator.cpp
     lib/printer-emulator/svg_plotter.h lib/printer-emulator/svg_plotter.cpp
@@ -474,6 +482,175 @@ add_custom_target(build_version DEPENDS "${CMAKE_BINARY_DIR}/include/build_versi
 add_dependencies(fujinet build_version)
 target_include_directories(fujinet PRIVATE "${CMAKE_BINARY_DIR}/include")
 
+# Firmware without main(), for the tools below that need the rest of FujiNet
+# "fujinet_tool_core" library, not part of the default build
+set(TOOL_CORE_SOURCES ${SOURCES})
+list(REMOVE_ITEM TOOL_CORE_SOURCES src/main.cpp)
+add_library(fujinet_tool_core STATIC EXCLUDE_FROM_ALL ${TOOL_CORE_SOURCES})
+target_include_directories(fujinet_tool_core PUBLIC ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR} "${CMAKE_BINARY_DIR}/include")
+target_link_libraries(fujinet_tool_core PUBLIC pthread expat cjson cjson_utils smb2 ssh ${CRYPTO_LIBS})
+if(DEFINED USE_LIBSERIAL)
+    target_include_directories(fujinet_tool_core PUBLIC ${LIBSERIALPORT_INCLUDE_DIRS})
+    target_link_libraries(fujinet_tool_core PUBLIC ${LIBSERIALPORT_LIBRARIES})
+    target_compile_options(fujinet_tool_core PUBLIC ${LIBSERIALPORT_CFLAGS_OTHER})
+endif()
+if(CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    target_link_libraries(fujinet_tool_core PUBLIC ws2_32 bcrypt crypt32)
+endif()
+add_dependencies(fujinet_tool_core build_version)
+
+# Printer emulator replay benchmark
+# "printer_replay" target, not part of the default build
+find_package(ZLIB)
+add_executable(printer_replay EXCLUDE_FROM_ALL tools/printer_replay.cpp
+    lib/printer-emulator/atari_1020.cpp
+    lib/printer-emulator/atari_1025.cpp
+    lib/printer-emulator/atari_1027.cpp
+    lib/printer-emulator/atari_1029.cpp
+    lib/printer-emulator/atari_820.cpp
+    lib/printer-emulator/atari_822.cpp
+    lib/printer-emulator/atari_825.cpp
+    lib/printer-emulator/atari_xdm121.cpp
+    lib/printer-emulator/atari_xmm801.cpp
+    lib/printer-emulator/coleco_printer.cpp
+    lib/printer-emulator/commodoremps803.cpp
+    lib/printer-emulator/epson_80.cpp
+    lib/printer-emulator/file_printer.cpp
+    lib/printer-emulator/html_printer.cpp
+    lib/printer-emulator/okimate_10.cpp
+    lib/printer-emulator/pdf_printer.cpp
+    lib/printer-emulator/zlib_stream.cpp
+    lib/printer-emulator/png_printer.cpp
+    lib/printer-emulator/printer_emulator.cpp
+    lib/printer-emulator/svg_plotter.cpp
+    lib/FileSystem/fnFS.cpp
+    lib/FileSystem/fnFsSD.cpp
+    lib/FileSystem/fnFsSPIFFS.cpp
+    lib/FileSystem/fnDirCache.cpp
+    lib/FileSystem/fnFile.cpp
+    lib/FileSystem/fnFileLocal.cpp
+    lib/FileSystem/fnFileMap.cpp
+    lib/FileSystem/fnio.cpp
+    lib/utils/utils.cpp
+    lib/utils/string_utils.cpp
+    lib/utils/U8Char.cpp
+    lib/utils/punycode.cpp
+    lib/compat/compat_gettimeofday.c
+)
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Darwin")
+    target_sources(printer_replay PRIVATE lib/compat/strlcat.c lib/compat/strlcpy.c)
+endif()
+target_include_directories(printer_replay PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR} "${CMAKE_BINARY_DIR}/include")
+target_link_libraries(printer_replay ${CRYPTO_LIBS})
+if(ZLIB_FOUND)
+    # check the structure of the PDF and PNG output, their streams are inflated with the host zlib
+    target_compile_definitions(printer_replay PRIVATE REPLAY_CHECK_ZLIB)
+    target_link_libraries(printer_replay ZLIB::ZLIB)
+endif()
+add_dependencies(printer_replay build_version)
+
+# zlibStream round trip check and benchmark, inflates with the host zlib
+# "zlib_bench" target, not part of the default build
+if(ZLIB_FOUND)
+    add_executable(zlib_bench EXCLUDE_FROM_ALL tools/zlib_bench.cpp lib/printer-emulator/zlib_stream.cpp)
+    target_include_directories(zlib_bench PRIVATE lib/printer-emulator)
+    target_link_libraries(zlib_bench ZLIB::ZLIB)
+endif()
+
+# Printer emulator output check against the committed hashes of the built-in jobs
+# "printer_replay_check" target, not part of the default build
+set(PRINTER_REPLAY_GOLDEN ${CMAKE_SOURCE_DIR}/tools/printer_replay_${FUJINET_TARGET}.golden)
+if(EXISTS ${PRINTER_REPLAY_GOLDEN})
+    add_custom_target(printer_replay_check
+        COMMENT "Checking printer emulator output"
+        COMMAND ${CMAKE_COMMAND} -E copy_directory ${CMAKE_SOURCE_DIR}/data/webui/common/f data/f
+        COMMAND $<TARGET_FILE:printer_replay> --golden ${PRINTER_REPLAY_GOLDEN}
+        WORKING_DIRECTORY ${CMAKE_BINARY_DIR}
+    )
+    add_dependencies(printer_replay_check printer_replay)
+endif()
+
+# Meatloaf disk image benchmark
+# "meatloaf_bench" target, not part of the default build (meatloaf is not in FujiNet-PC)
+add_executable(meatloaf_bench EXCLUDE_FROM_ALL tools/meatloaf_bench.cpp
+    lib/meatloaf/meat_media.cpp
+    lib/meatloaf/disk/d64.cpp
+    lib/meatloaf/network/http_cache.cpp
+)
+target_include_directories(meatloaf_bench PRIVATE lib/meatloaf)
+# drop the MFile side of the disk formats, it needs the whole meatloaf tree
+target_compile_options(meatloaf_bench PRIVATE -ffunction-sections -fdata-sections)
+if(APPLE)
+    target_link_options(meatloaf_bench PRIVATE -Wl,-dead_strip)
+else()
+    target_link_options(meatloaf_bench PRIVATE -Wl,--gc-sections)
+endif()
+target_link_libraries(meatloaf_bench fujinet_tool_core)
+
+# SmartPort packet codec check and benchmark
+# "smartport_bench" target, not part of the default build (FujiNet-PC talks SLIP, not SmartPort packets)
+add_executable(smartport_bench EXCLUDE_FROM_ALL tools/smartport_bench.cpp lib/bus/iwm/iwm_sp_codec.cpp)
+target_include_directories(smartport_bench PRIVATE lib/bus/iwm)
+target_compile_definitions(smartport_bench PRIVATE BUILD_APPLE)
+
+# devrelay request pipelining benchmark
+# "devrelay_bench" target, not part of the default build
+add_executable(devrelay_bench EXCLUDE_FROM_ALL tools/devrelay_bench.cpp
+    lib/devrelay/service/Connection.cpp
+    lib/devrelay/service/Requestor.cpp
+    lib/devrelay/types/Request.cpp
+    lib/devrelay/types/Response.cpp
+    lib/devrelay/util.cpp
+    lib/devrelay/commands/Close.cpp
+    lib/devrelay/commands/Control.cpp
+    lib/devrelay/commands/Format.cpp
+    lib/devrelay/commands/Init.cpp
+    lib/devrelay/commands/Open.cpp
+    lib/devrelay/commands/Read.cpp
+    lib/devrelay/commands/ReadBlock.cpp
+    lib/devrelay/commands/Reset.cpp
+    lib/devrelay/commands/Status.cpp
+    lib/devrelay/commands/Write.cpp
+    lib/devrelay/commands/WriteBlock.cpp
+)
+target_include_directories(devrelay_bench PRIVATE lib/devrelay lib/devrelay/service)
+target_link_libraries(devrelay_bench pthread)
+
+# SLIP framing fuzz check and benchmark
+# "slip_bench" target, not part of the default build
+add_executable(slip_bench EXCLUDE_FROM_ALL tools/slip_bench.cpp lib/devrelay/slip/SLIP.cpp)
+target_include_directories(slip_bench PRIVATE lib/devrelay/slip)
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    # send_data() of TCPConnection on loopback
+    target_sources(slip_bench PRIVATE lib/devrelay/service/TCPConnection.cpp lib/devrelay/service/Connection.cpp)
+    target_include_directories(slip_bench PRIVATE include lib/devrelay/service)
+    target_compile_definitions(slip_bench PRIVATE DEV_RELAY_SLIP SLIP_PROTOCOL_NET)
+    target_link_libraries(slip_bench pthread)
+endif()
+
+# UARTManager::poll() latency benchmark on a pty pair
+# "uart_poll_bench" target, not part of the default build
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    add_executable(uart_poll_bench EXCLUDE_FROM_ALL tools/uart_poll_bench.cpp)
+    target_link_libraries(uart_poll_bench fujinet_tool_core)
+endif()
+
+# SAM streaming renderer and phrase cache check against the old renderer
+# "sam_bench" target, not part of the default build (SAM is not in FujiNet-PC)
+add_executable(sam_bench EXCLUDE_FROM_ALL tools/sam_bench.cpp
+    lib/sam/sam.c
+    lib/sam/render.c
+    lib/sam/reciter.c
+    lib/sam/samdebug.c
+    lib/sam/samcache.cpp
+)
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Darwin")
+    target_sources(sam_bench PRIVATE lib/compat/strlcat.c)
+endif()
+target_include_directories(sam_bench PRIVATE lib/sam lib/compat)
+target_compile_definitions(sam_bench PRIVATE BUILD_ATARI)
+target_link_libraries(sam_bench pthread)
+
 # WebUI
 # "build_webui" target
 add_custom_command(
@@ -525,3 +702,50 @@ set_property(
 set_property(
     DIRECTORY APPEND PROPERTY ADDITIONAL_CLEAN_FILES "${CMAKE_BINARY_DIR}/include"
 )
+
+# TNFS client check and benchmark against a loopback server
+# "tnfs_bench" target, not part of the default build
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    add_executable(tnfs_bench EXCLUDE_FROM_ALL tools/tnfs_bench.cpp)
+    target_link_libraries(tnfs_bench fujinet_tool_core)
+endif()
+
+# DirCache heap and time benchmark against the old fsdir_entry cache
+# "dircache_bench" target, not part of the default build
+add_executable(dircache_bench EXCLUDE_FROM_ALL tools/dircache_bench.cpp)
+target_link_libraries(dircache_bench fujinet_tool_core)
+
+# NetworkBuffer check and allocation benchmark against the old std::string buffers
+# "netbuf_bench" target, not part of the default build
+add_executable(netbuf_bench EXCLUDE_FROM_ALL tools/netbuf_bench.cpp)
+target_include_directories(netbuf_bench PRIVATE lib/network-protocol)
+
+# Network line ending translation check and benchmark against the old replace passes
+# "translate_bench" target, not part of the default build
+add_executable(translate_bench EXCLUDE_FROM_ALL tools/translate_bench.cpp)
+target_include_directories(translate_bench PRIVATE lib/network-protocol test)
+target_link_libraries(translate_bench fujinet_tool_core)
+
+# Streaming JSON parser check against cJSON_Parse() and heap benchmark
+# "json_bench" target, not part of the default build
+add_executable(json_bench EXCLUDE_FROM_ALL tools/json_bench.cpp)
+target_link_libraries(json_bench fujinet_tool_core)
+
+# mmap file handler check and random sector benchmark against stdio
+# "filemap_bench" target, not part of the default build
+if(NOT DEFINED NO_FILE_MMAP AND NOT CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    add_executable(filemap_bench EXCLUDE_FROM_ALL tools/filemap_bench.cpp)
+    target_link_libraries(filemap_bench fujinet_tool_core)
+endif()
+
+# HTTP client check and benchmark against a loopback server
+# "http_bench" target, not part of the default build
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    add_executable(http_bench EXCLUDE_FROM_ALL tools/http_bench.cpp)
+    target_link_libraries(http_bench fujinet_tool_core)
+endif()
+
+# WebDAV directory listing parser check and benchmark
+# "webdav_bench" target, not part of the default build
+add_executable(webdav_bench EXCLUDE_FROM_ALL tools/webdav_bench.cpp)
+target_link_libraries(webdav_bench fujinet_tool_core)
@@ -8,52 +8,24 @@
 #include "utils.h"
 
 
-bool _fsdir_sort_name_ascend(fsdir_entry &left, fsdir_entry &right)
-{
-    if (left.isDir == right.isDir)
-        return strcasecmp(left.filename, right.filename) < 0;
-    else
-        return left.isDir;
-}
-
-bool _fsdir_sort_name_descend(fsdir_entry &left, fsdir_entry &right)
-{
-    if (left.isDir == right.isDir)
-        return strcasecmp(left.filename, right.filename) > 0;
-    else
-        return left.isDir;
-}
-
-bool _fsdir_sort_time_ascend(fsdir_entry &left, fsdir_entry &right)
-{
-    if (left.isDir == right.isDir)
-        return left.modified_time > right.modified_time;
-    else
-        return left.isDir;
-}
-
-bool _fsdir_sort_time_descend(fsdir_entry &left, fsdir_entry &right)
-{
-    if (left.isDir == right.isDir)
-        return left.modified_time < right.modified_time;
-    else
-        return left.isDir;
-}
-
-typedef bool (*sort_fn_t)(fsdir_entry &left, fsdir_entry &right);
-
-
 void DirCache::clear()
 {
-    _entries.clear();
-    _entries_filtered.clear();
+    // release the memory too, a large listing should not stay resident after the cache moves on
+    std::vector<dircache_entry>().swap(_entries);
+    std::vector<char>().swap(_names);
+    std::vector<uint32_t>().swap(_entries_filtered);
     _current = 0;
 }
 
-fsdir_entry &DirCache::new_entry()
+void DirCache::add_entry(const char *name, bool isDir, uint32_t size, time_t modified_time)
 {
-    _entries.push_back(fsdir_entry());
-    return _entries.back();
+    dircache_entry entry;
+    entry.name_offset = _names.size();
+    entry.size = size;
+    entry.modified_time = modified_time;
+    entry.isDir = isDir;
+    _names.insert(_names.end(), name, name + strlen(name) + 1);
+    _entries.push_back(entry);
 }
 
 void DirCache::apply_filter(const char *pattern, uint16_t diropts)
@@ -67,45 +39,59 @@ void DirCache::apply_filter(const char *pattern, uint16_t diropts)
 		realpat[strlen(realpat)-1] = '\0';
 	}
 	//thepat = filter_dirs ? realpat : (char *)pattern;
-    fsdir_entry entry;
 
     // Filter directory entries
     _entries_filtered.clear();
-    for (unsigned i=0; i<_entries.size(); ++i)
+    for (uint32_t i=0; i<_entries.size(); ++i)
     {
-        entry = _entries[i];
+        const dircache_entry &entry = _entries[i];
         // Skip this entry if we have a search filter and it doesn't match it
 		// HCGIII: Include directory filtering if specified
         if(have_pattern && (
 			!entry.isDir || (entry.isDir && filter_dirs)
-		) && util_wildcard_match(entry.filename, pattern) == false)
+		) && util_wildcard_match(_name(entry), pattern) == false)
             continue;
-        _entries_filtered.push_back(entry);
+        _entries_filtered.push_back(i);
     }
 
-    // Choose the appropriate sorting function
-    sort_fn_t sortfn;
+    // Sort directory entries, directories first
+    bool descending = diropts & DIR_OPTION_DESCENDING;
     if (diropts & DIR_OPTION_FILEDATE)
     {
-        sortfn = (diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_time_descend : _fsdir_sort_time_ascend;
+        std::sort(_entries_filtered.begin(), _entries_filtered.end(), [this, descending](uint32_t l, uint32_t r) {
+            const dircache_entry &left = _entries[l];
+            const dircache_entry &right = _entries[r];
+            if (left.isDir != right.isDir)
+                return left.isDir;
+            return descending ? left.modified_time < right.modified_time : left.modified_time > right.modified_time;
+        });
     }
     else
     {
-        sortfn = (diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_name_descend : _fsdir_sort_name_ascend;
+        std::sort(_entries_filtered.begin(), _entries_filtered.end(), [this, descending](uint32_t l, uint32_t r) {
+            const dircache_entry &left = _entries[l];
+            const dircache_entry &right = _entries[r];
+            if (left.isDir != right.isDir)
+                return left.isDir;
+            int cmp = strcasecmp(_name(left), _name(right));
+            return descending ? cmp > 0 : cmp < 0;
+        });
     }
-
-    // Sort directory entries
-    std::sort(_entries_filtered.begin(), _entries_filtered.end(), sortfn);
     // rewind read cursor
     _current = 0;
 }
 
 fsdir_entry *DirCache::read()
 {
-    if(_current < _entries_filtered.size())
-        return &_entries_filtered[_current++];
-    else
+    if(_current >= _entries_filtered.size())
         return nullptr;
+
+    const dircache_entry &entry = _entries[_entries_filtered[_current++]];
+    strlcpy(_direntry.filename, _name(entry), sizeof(_direntry.filename));
+    _direntry.isDir = entry.isDir;
+    _direntry.size = entry.size;
+    _direntry.modified_time = entry.modified_time;
+    return &_direntry;
 }
 
 uint16_t DirCache::tell()
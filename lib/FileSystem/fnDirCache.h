@@ -5,26 +5,46 @@
 
 #include "fnFS.h"
 
+/*
+ Directory cache for file systems which have to list whole directories up front (SMB, FTP).
+ Entry names are packed into one contiguous string arena and referenced by offset from small
+ fixed-size records. Filtering and sorting only build an index permutation over those records,
+ the full fsdir_entry is materialized on read().
+*/
+struct dircache_entry
+{
+    uint32_t name_offset; // offset of NUL terminated name in _names
+    uint32_t size;
+    time_t modified_time;
+    bool isDir;
+};
+
 class DirCache
 {
 private:
-    std::vector<fsdir_entry> _entries;
-    std::vector<fsdir_entry> _entries_filtered;
+    std::vector<dircache_entry> _entries;
+    std::vector<char> _names;
+    std::vector<uint32_t> _entries_filtered; // indexes into _entries
     uint16_t _current = 0;
+    fsdir_entry _direntry;
+
+    const char *_name(const dircache_entry &entry) const { return _names.data() + entry.name_offset; }
 
 public:
     // DirCache();
     // ~DirCache();
 
     void clear();
-    fsdir_entry &new_entry();
+    void add_entry(const char *name, bool isDir, uint32_t size, time_t modified_time);
     void apply_filter(const char *pattern, uint16_t diropts);
 
     bool empty() {return _entries.empty();}
 
+    // Returns the next entry, or null after the last one. The entry is built in a buffer
+    // owned by the cache and is overwritten by the next read(), copy it to keep it longer.
     fsdir_entry *read();
     uint16_t tell();
     bool seek(uint16_t pos);
 };
 
-#endif // FN_DIRCACHE_H
\ No newline at end of file
+#endif // FN_DIRCACHE_H
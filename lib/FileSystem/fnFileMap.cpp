@@ -0,0 +1,236 @@
+#ifdef FNIO_MMAP
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fnFileMap.h"
+#include "../../include/debug.h"
+
+
+FileHandlerMap::FileHandlerMap(int fd, uint8_t *map, size_t size, bool writable)
+    : _fd(fd), _map(map), _size(size), _position(0), _writable(writable), _eof(false)
+{
+    // Debug_println("new FileHandlerMap");
+};
+
+
+FileHandler *FileHandlerMap::open(const char *path, const char *mode)
+{
+    // Only existing files opened for update are mapped, "w" truncates and "a" appends,
+    // and plain reads stay with stdio
+    if (mode == nullptr || mode[0] != 'r' || strchr(mode, '+') == nullptr)
+        return nullptr;
+
+    int fd = ::open(path, O_RDWR);
+    if (fd < 0)
+        return nullptr;
+
+    // Empty files can't be mapped
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        Debug_printf("FileHandlerMap::open - mmap failed: %d\n", errno);
+        ::close(fd);
+        return nullptr;
+    }
+
+    return new FileHandlerMap(fd, (uint8_t *)map, st.st_size, true);
+}
+
+
+FileHandlerMap::~FileHandlerMap()
+{
+    // Debug_println("delete FileHandlerMap");
+    if (_fd >= 0) close(false);
+}
+
+
+int FileHandlerMap::close(bool destroy)
+{
+    // Debug_println("FileHandlerMap::close");
+    int result = 0;
+    if (_map != nullptr)
+    {
+        munmap(_map, _size);
+        _map = nullptr;
+    }
+    if (_fd >= 0)
+    {
+        result = ::close(_fd);
+        _fd = -1;
+    }
+    if (destroy) delete this;
+    return result;
+}
+
+
+int FileHandlerMap::seek(long int off, int whence)
+{
+    // Debug_println("FileHandlerMap::seek");
+    long int new_pos;
+    switch (whence)
+    {
+        case SEEK_SET:
+            new_pos = off;
+            break;
+        case SEEK_END:
+            if (sync_size() < 0)
+                return -1;
+            new_pos = (long int)_size + off;
+            break;
+        case SEEK_CUR:
+            new_pos = (long int)_position + off;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    if (new_pos < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Like stdio, seeking past the end is fine, a write there extends the file
+    _position = new_pos;
+    _eof = false;
+    return 0;
+}
+
+
+long int FileHandlerMap::tell()
+{
+    // Debug_println("FileHandlerMap::tell");
+    return _position;
+}
+
+
+size_t FileHandlerMap::read(void *ptr, size_t size, size_t count)
+{
+    // Debug_println("FileHandlerMap::read");
+    if (sync_size() < 0)
+        return 0;
+
+    size_t requested = size * count;
+    size_t available = _position < _size ? _size - _position : 0;
+    size_t to_read = available > requested ? requested : available;
+
+    if (to_read)
+    {
+        memcpy(ptr, _map + _position, to_read);
+        _position += to_read;
+    }
+    if (to_read < requested)
+        _eof = true;
+
+    return size == 0 ? 0 : to_read / size;
+}
+
+
+size_t FileHandlerMap::write(const void *ptr, size_t size, size_t count)
+{
+    // Debug_println("FileHandlerMap::write");
+    if (!_writable)
+    {
+        errno = EBADF;
+        return 0;
+    }
+
+    if (sync_size() < 0)
+        return 0;
+
+    size_t requested = size * count;
+    if (_position + requested > _size && grow(_position + requested) < 0)
+        return 0;
+
+    memcpy(_map + _position, ptr, requested);
+    _position += requested;
+
+    return count;
+}
+
+
+int FileHandlerMap::flush()
+{
+    // Debug_println("FileHandlerMap::flush");
+    // Written data is in the page cache already, just start the write back
+    if (!_writable || _map == nullptr)
+        return 0;
+    return msync(_map, _size, MS_ASYNC);
+}
+
+
+int FileHandlerMap::eof()
+{
+    return _eof ? 1 : 0;
+}
+
+
+// extend the file and map the new size
+// return 0 on success, -1 on failure
+int FileHandlerMap::grow(size_t filesize)
+{
+    Debug_printf("FileHandlerMap::grow - file size: %lu\n", (unsigned long)filesize);
+    if (ftruncate(_fd, filesize) != 0)
+        return -1;
+
+    size_t old_size = _size;
+    if (remap(filesize) < 0)
+    {
+        ftruncate(_fd, old_size);
+        return -1;
+    }
+    return 0;
+}
+
+
+// map the file at the given size, nothing is mapped for an empty file
+// return 0 on success, -1 on failure (the old mapping is kept)
+int FileHandlerMap::remap(size_t filesize)
+{
+    uint8_t *map = nullptr;
+    if (filesize > 0)
+    {
+        void *m = mmap(nullptr, filesize, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, 0);
+        if (m == MAP_FAILED)
+        {
+            Debug_printf("FileHandlerMap::remap - mmap failed: %d\n", errno);
+            return -1;
+        }
+        map = (uint8_t *)m;
+    }
+
+    if (_map != nullptr)
+        munmap(_map, _size);
+    _map = map;
+    _size = filesize;
+    return 0;
+}
+
+
+// follow a size change made through another handle or by another program,
+// touching pages past the end of the file would raise SIGBUS
+// return 0 on success, -1 on failure
+int FileHandlerMap::sync_size()
+{
+    struct stat st;
+    if (fstat(_fd, &st) != 0)
+        return -1;
+    if ((size_t)st.st_size == _size)
+        return 0;
+    return remap(st.st_size);
+}
+
+#endif // FNIO_MMAP
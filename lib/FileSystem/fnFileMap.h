@@ -0,0 +1,51 @@
+#ifndef FN_FILEMAP_H
+#define FN_FILEMAP_H
+
+#ifdef FNIO_MMAP
+
+#include <stdint.h>
+#include <cstddef>
+
+#include "fnFile.h"
+
+/*
+ * FileHandlerMap - file on local disk accessed through a shared memory mapping
+ * Reads and writes are a memcpy, handles to the same file share the page cache.
+ * Only files opened for update are mapped, i.e. disk images mounted read/write.
+ * The size is checked with fstat before each access and the mapping follows it,
+ * so another program truncating or extending the image is seen like with stdio
+ * instead of faulting on pages past the end.
+ */
+class FileHandlerMap : public FileHandler
+{
+protected:
+    int _fd;
+    uint8_t *_map;
+    size_t _size;
+    size_t _position;
+    bool _writable;
+    bool _eof;
+
+    FileHandlerMap(int fd, uint8_t *map, size_t size, bool writable);
+    int grow(size_t filesize);
+    int remap(size_t filesize);
+    int sync_size();
+
+public:
+    // Returns nullptr if the file cannot be mapped, caller should fall back to stdio
+    static FileHandler *open(const char *path, const char *mode);
+
+    virtual ~FileHandlerMap() override;
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override;
+    virtual long int tell() override;
+    virtual size_t read(void *ptr, size_t size, size_t count) override;
+    virtual size_t write(const void *ptr, size_t size, size_t count) override;
+    virtual int flush() override;
+    virtual int eof() override;
+};
+
+#endif // FNIO_MMAP
+
+#endif // FN_FILEMAP_H
@@ -121,12 +121,16 @@ size_t FileHandlerTNFS::read(void *ptr, size_t size, size_t count)
 }
 
 
+// Writes go to the TNFS cache and reach the server when their block is evicted, on
+// flush() or on close(). A failure to write cached data back is reported by the call
+// that triggered it, which can be a later write(), a read(), flush() or close(); the
+// data stays cached until it can be written.
 size_t FileHandlerTNFS::write(const void *ptr, size_t size, size_t count)
 {
     Debug_println("FileHandlerTNFS::write");
     // return fwrite(ptr, size, n, _fh);
 
-    uint16_t bytes_requested = size * count;
+    size_t bytes_requested = size * count;
     if (bytes_requested == 0)
         return 0;
 
@@ -134,6 +138,7 @@ size_t FileHandlerTNFS::write(const void *ptr, size_t size, size_t count)
     uint16_t bytes_written;
     uint16_t write_size;
     int result;
+    bool recovered = false;
 
     while (total_bytes_written < bytes_requested)
     {
@@ -144,12 +149,19 @@ size_t FileHandlerTNFS::write(const void *ptr, size_t size, size_t count)
             write_size = (uint16_t)(bytes_requested - total_bytes_written);
 
         result = tnfs_write(_mountinfo, _handle, ((uint8_t *)ptr)+total_bytes_written, write_size, &bytes_written);
+        // bytes taken before a failure are in the cache
+        total_bytes_written += bytes_written;
+        if (result == TNFS_RESULT_BAD_FILENUM && !recovered && _bad_fd_recovery() == TNFS_RESULT_SUCCESS)
+        {
+            // retry the rest with the new handle
+            recovered = true;
+            continue;
+        }
         if (result != TNFS_RESULT_SUCCESS)
         {
             errno = tnfs_code_to_errno(result);
             break;
         }
-        total_bytes_written += bytes_written;
     }
     return (size_t)(bytes_requested == total_bytes_written ? count : total_bytes_written / size);
 }
@@ -158,13 +170,18 @@ size_t FileHandlerTNFS::write(const void *ptr, size_t size, size_t count)
 int FileHandlerTNFS::flush()
 {
     Debug_println("FileHandlerTNFS::flush");
-    // int ret = fflush(_fh);    // This doesn't seem to be connected to anything in ESP-IDF VF, so it may not do anything
-    // ret = fsync(fileno(_fh)); // Since we might get reset at any moment, go ahead and sync the file (not clear if fflush does this)
-    // return ret;
-    return -1;
+    // Send any writes still held in the TNFS cache to the server
+    int result = tnfs_flush(_mountinfo, _handle);
+    if (result != TNFS_RESULT_SUCCESS)
+    {
+        errno = tnfs_code_to_errno(result);
+        return -1;
+    }
+    errno = 0;
+    return 0;
 }
 
-// reopen the file and seek to last known position
+// reopen the file, write back what's still cached and seek to last known position
 uint8_t FileHandlerTNFS::_bad_fd_recovery()
 {
     Debug_println("FileHandlerTNFS - Invalid file ID");
@@ -177,20 +194,44 @@ uint8_t FileHandlerTNFS::_bad_fd_recovery()
 
     int16_t handle;
 
-    int result = tnfs_open(_mountinfo, pFileInf->filename, TNFS_OPENMODE_READ, 0, &handle);
+    // same mode, without creating or truncating the file again
+    uint16_t open_mode = pFileInf->open_mode & ~(TNFS_OPENMODE_WRITE_TRUNCATE | TNFS_OPENMODE_CREATE_EXCLUSIVE);
+    if (open_mode == 0)
+        open_mode = TNFS_OPENMODE_READ;
+
+    int result = tnfs_open(_mountinfo, pFileInf->filename, open_mode, 0, &handle);
     if(result != TNFS_RESULT_SUCCESS)
         return result;
 
-    // last known position
+    // the cache, written data included, moves to the new handle
+    decltype(pFileInf->cache) cache;
+    cache.swap(pFileInf->cache);
     uint32_t pos = pFileInf->cached_pos;
-    uint32_t new_pos;
+    uint32_t file_size = pFileInf->file_size;
+    bool modified = pFileInf->modified;
+    uint32_t cache_tick = pFileInf->cache_tick;
+
+    // delete bad fd filehandleinfo, the server may have handed out the same id again
+    _mountinfo->delete_filehandleinfo(pFileInf);
 
     // update file handle / fd
     _handle = handle;
-    // delete bad fd filehandleinfo
-    _mountinfo->delete_filehandleinfo(pFileInf);
+    pFileInf = _mountinfo->get_filehandleinfo(_handle);
+    if (pFileInf == nullptr)
+        return TNFS_RESULT_BAD_FILENUM;
+    pFileInf->cache.swap(cache);
+    pFileInf->cache_tick = cache_tick;
+    pFileInf->modified = modified;
+    // unwritten data can make the file longer than the server knows
+    if (file_size > pFileInf->file_size)
+        pFileInf->file_size = file_size;
+
+    result = tnfs_flush(_mountinfo, _handle);
+    if (result != TNFS_RESULT_SUCCESS)
+        return result;
 
     // seek to last known position
+    uint32_t new_pos;
     return tnfs_lseek(_mountinfo, _handle, pos, SEEK_SET, &new_pos);
 }
 
@@ -293,7 +293,6 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
         string filename;
         long filesz;
         bool is_dir;
-        fsdir_entry *fs_de;
 
         // get first directory entry
         res = _ftp->read_directory(filename, filesz, is_dir);
@@ -304,13 +303,7 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
                 continue;
 
             // new dir entry
-            fs_de = &_dircache.new_entry();
-
-            // set entry members
-            strlcpy(fs_de->filename, filename.c_str(), sizeof(fs_de->filename));
-            fs_de->isDir = is_dir;
-            fs_de->size = (uint32_t)filesz;
-            fs_de->modified_time = 0; // TODO
+            _dircache.add_entry(filename.c_str(), is_dir, (uint32_t)filesz, 0); // TODO modified time
 
             // get next
             res = _ftp->read_directory(filename, filesz, is_dir);
@@ -5,6 +5,7 @@
 
 #include "fnFsSD.h"
 #include "fnFileLocal.h"
+#include "fnFileMap.h"
 
 #ifdef ESP_PLATFORM
 #include <esp_vfs.h>
@@ -398,6 +399,14 @@ FILE * FileSystemSDFAT::file_open(const char* path, const char* mode)
 FileHandler * FileSystemSDFAT::filehandler_open(const char* path, const char* mode)
 {
     Debug_printf("FileSystemSDFAT::filehandler_open %s %s\r\n", path, mode);
+#ifdef FNIO_MMAP
+    // Map images opened for update, disk image sector access becomes a memcpy
+    char * fpath = _make_fullpath(path);
+    FileHandler * fm = FileHandlerMap::open(fpath, mode);
+    free(fpath);
+    if (fm != nullptr)
+        return fm;
+#endif
     FILE * fh = file_open(path, mode);
     return (fh == nullptr) ? nullptr : new FileHandlerLocal(fh);
 }
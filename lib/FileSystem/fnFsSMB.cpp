@@ -221,7 +221,7 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
 
         // Populate directory cache with entries
         smb2dirent *smb_de;
-        fsdir_entry *fs_de;
+        bool is_dir;
 
         while ((smb_de = smb2_readdir(_smb, smb_dir)) != nullptr)
         {
@@ -234,18 +234,13 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
                 continue;
 
             // new dir entry
-            fs_de = &_dircache.new_entry();
+            is_dir = smb_de->st.smb2_type == SMB2_TYPE_DIRECTORY;
+            _dircache.add_entry(smb_de->name, is_dir, (uint32_t)smb_de->st.smb2_size, (time_t)smb_de->st.smb2_mtime);
 
-            // set entry members
-            strlcpy(fs_de->filename, smb_de->name, sizeof(fs_de->filename));
-            fs_de->isDir = smb_de->st.smb2_type == SMB2_TYPE_DIRECTORY;
-            fs_de->size = (uint32_t)smb_de->st.smb2_size;
-            fs_de->modified_time = (time_t)smb_de->st.smb2_mtime;
-
-            if (fs_de->isDir)
-                Debug_printf(" add entry: \"%s\"\tDIR\n", fs_de->filename);
+            if (is_dir)
+                Debug_printf(" add entry: \"%s\"\tDIR\n", smb_de->name);
             else
-                Debug_printf(" add entry: \"%s\"\t%lu\n", fs_de->filename, fs_de->size);
+                Debug_printf(" add entry: \"%s\"\t%lu\n", smb_de->name, (unsigned long)smb_de->st.smb2_size);
         }
         smb2_closedir(_smb, smb_dir);
     }
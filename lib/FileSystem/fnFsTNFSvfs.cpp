@@ -228,11 +228,33 @@ int vfs_tnfs_stat(void* ctx, const char * path, struct stat * st)
     return 0;
 }
 
+int vfs_tnfs_fsync(void* ctx, int fd)
+{
+    tnfsMountInfo *mi = (tnfsMountInfo *)ctx;
+
+    int result = tnfs_flush(mi, fd);
+    if(result != TNFS_RESULT_SUCCESS)
+    {
+        errno = tnfs_code_to_errno(result);
+        return -1;
+    }
+    errno = 0;
+    return 0;
+}
+
 int vfs_tnfs_fstat(void* ctx, int fd, struct stat * st)
 {
     //Debug_printf("vfs_tnfs_fstat: %d\r\n", fd);    
     tnfsMountInfo *mi = (tnfsMountInfo *)ctx;
 
+    // The server only knows the right size once cached writes are sent
+    int result = tnfs_flush(mi, fd);
+    if(result != TNFS_RESULT_SUCCESS)
+    {
+        errno = tnfs_code_to_errno(result);
+        return -1;
+    }
+
     const char *path = tnfs_filepath(mi, fd);
     return vfs_tnfs_stat(mi, path, st);
 }
@@ -254,6 +276,7 @@ esp_err_t vfs_tnfs_register(tnfsMountInfo &m_info, char *basepath, int basepathl
     vfs.stat_p = &vfs_tnfs_stat;
     vfs.fstat_p = &vfs_tnfs_fstat;
     vfs.lseek_p = &vfs_tnfs_lseek;
+    vfs.fsync_p = &vfs_tnfs_fsync;
     vfs.unlink_p = &vfs_tnfs_unlink;
     vfs.rename_p = &vfs_tnfs_rename;
 
@@ -55,6 +55,9 @@ _tnfs_recv_result _tnfs_recv_and_validate(fnUDP &udp, tnfsMountInfo *m_info, tnf
 uint8_t _tnfs_session_recovery(tnfsMountInfo *m_info, uint8_t command);
 
 int _tnfs_adjust_with_full_path(tnfsMountInfo *m_info, char *buffer, const char *source, int bufflen);
+int _tnfs_cache_flush(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI);
+bool _tnfs_dirlisting_current(tnfsDirListing *pListing);
+void _tnfs_dirlisting_detach(tnfsMountInfo *m_info);
 
 void _tnfs_debug_packet(const tnfsPacket &pkt, unsigned short len, bool isResponse = false);
 
@@ -168,6 +171,10 @@ int tnfs_open(tnfsMountInfo *m_info, const char *filepath, uint16_t open_mode, u
 
     *file_handle = TNFS_INVALID_HANDLE;
 
+    // New files and size changes show up in directory listings
+    if (open_mode & TNFS_OPENMODE_WRITE)
+        m_info->invalidate_dirlistings();
+
     // Find a free slot in our table of file handles
     tnfsFileHandleInfo *pFileInf = m_info->new_filehandleinfo();
     if (pFileInf == nullptr)
@@ -221,6 +228,7 @@ int tnfs_open(tnfsMountInfo *m_info, const char *filepath, uint16_t open_mode, u
         {
             // Since everything went okay, save our file info
             pFileInf->handle_id = packet.payload[1];
+            pFileInf->open_mode = open_mode;
             pFileInf->file_position = pFileInf->cached_pos = 0;
 
             *file_handle = pFileInf->handle_id;
@@ -260,6 +268,14 @@ int tnfs_close(tnfsMountInfo *m_info, int16_t file_handle)
     if (pFileInf == nullptr)
         return TNFS_RESULT_BAD_FILE_DESCRIPTOR;
 
+    // Get any data still sitting in the cache to the server first
+    int flush_result = _tnfs_cache_flush(m_info, pFileInf);
+    if (pFileInf->modified)
+        m_info->invalidate_dirlistings();
+
+    Debug_printf("TNFS cache \"%s\": %u hits, %u misses, %u evictions\r\n", pFileInf->filename,
+                 pFileInf->cache_hits, pFileInf->cache_misses, pFileInf->cache_evictions);
+
     tnfsPacket packet;
     packet.command = TNFS_CMD_CLOSE;
     packet.payload[0] = file_handle;
@@ -268,7 +284,7 @@ int tnfs_close(tnfsMountInfo *m_info, int16_t file_handle)
     {
         // We're going to go ahead and delete our info even though the server could reject it
         m_info->delete_filehandleinfo(pFileInf);
-        return packet.payload[0];
+        return flush_result != 0 ? flush_result : packet.payload[0];
     }
 
     return -1;
@@ -289,180 +305,489 @@ void _tnfs_cache_dump(const char *title, uint8_t *cache, uint32_t cache_size)
 }
 
 /*
- Fills destination buffer with data available in internal cache, if any
- Returns 0: success; TNFS_RESULT_END_OF_FILE: EOF; -1: if not all bytes requested could be fulfilled by cache
+ Moves the server's file position without touching the position we report to the client
+ Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
 */
-int _tnfs_read_from_cache(tnfsFileHandleInfo *pFHI, uint8_t *dest, uint16_t dest_size, uint16_t *dest_used)
+int _tnfs_server_seek(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint32_t position)
 {
-    #ifdef VERBOSE_TNFS
-    Debug_printf("_tnfs_read_from_cache: buffpos=%d, cache_start=%d, cache_avail=%d, dest_size=%d, dest_used=%d\r\n",
-                 pFHI->cached_pos, pFHI->cache_start, pFHI->cache_available, dest_size, *dest_used);
-    #endif
+    tnfsPacket packet;
+    packet.command = TNFS_CMD_LSEEK;
+    packet.payload[0] = pFHI->handle_id;
+    packet.payload[1] = SEEK_SET;
+    TNFS_UINT32_TO_LOHI_BYTEPTR(position, packet.payload + 2);
 
-    // Report if we've reached the end of the file
-    if (pFHI->cached_pos >= pFHI->file_size)
+    if (_tnfs_transaction(m_info, packet, 6))
     {
-        #ifdef VERBOSE_TNFS
-        Debug_print("_tnfs_read_from_cache - attempting to read past EOF\r\n");
-        #endif
-        return TNFS_RESULT_END_OF_FILE;
+        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+            pFHI->file_position = position;
+        return packet.payload[0];
     }
-    // Reject if we have nothing in the cache
-    if (pFHI->cache_available == 0)
+    return -1;
+}
+
+/*
+ Returns the cache block starting at block_start or null if it isn't cached
+*/
+tnfsCacheBlock *_tnfs_cache_find(tnfsFileHandleInfo *pFHI, uint32_t block_start)
+{
+    for (auto &block : pFHI->cache)
+        if (block.start == block_start)
+            return &block;
+    return nullptr;
+}
+
+void _tnfs_cache_release(tnfsCacheBlock *block)
+{
+    block->start = TNFS_CACHE_BLOCK_UNUSED;
+    block->length = 0;
+    block->dirty_start = block->dirty_end = 0;
+    block->loaded = false;
+}
+
+/*
+ Moves the end of the file forward to new_size after a write past it
+ Blocks read up to the old end of the file get the gap zero-filled, the way the
+ server fills it once the written data gets there, so reads don't stop short
+*/
+void _tnfs_cache_grow(tnfsFileHandleInfo *pFHI, uint32_t new_size)
+{
+    for (auto &block : pFHI->cache)
     {
-        #ifdef VERBOSE_TNFS
-        Debug_print("_tnfs_read_from_cache - nothing in cache\r\n");
-        #endif
-        return -1;
+        if (block.start == TNFS_CACHE_BLOCK_UNUSED || block.start >= new_size || !block.loaded)
+            continue;
+        uint32_t end = new_size - block.start;
+        if (end > TNFS_FILE_CACHE_BLOCK_SIZE)
+            end = TNFS_FILE_CACHE_BLOCK_SIZE;
+        if (end > block.length)
+        {
+            memset(block.data + block.length, 0, end - block.length);
+            block.length = end;
+        }
     }
+    pFHI->file_size = new_size;
+}
 
-    // See if the current file position is at or after the start of our cache
-    if (pFHI->cached_pos >= pFHI->cache_start)
+/*
+ Sends the dirty part of a cache block to the server
+ Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+*/
+int _tnfs_cache_flush_block(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, tnfsCacheBlock *block)
+{
+    while (block->dirty_start < block->dirty_end)
     {
-        // See if the current file position falls before the end of our cache
-        uint32_t cache_end = pFHI->cache_start + pFHI->cache_available;
-        if (pFHI->cached_pos < cache_end)
+        uint32_t position = block->start + block->dirty_start;
+        if (pFHI->file_position != position)
         {
-            // Our current file position is within the cached region
-            // Calculate how many bytes to provide:
-            // Either from the position to the end of the cache
-            // Or the bytes free at the destination if that's smaller
-            uint32_t bytes_available = cache_end - pFHI->cached_pos;
-            uint16_t dest_free = dest_size - *dest_used; // This accounts for an earlier partially-fulfilled request
-            uint16_t bytes_provided = dest_free > bytes_available ? bytes_available : dest_free;
+            int result = _tnfs_server_seek(m_info, pFHI, position);
+            if (result != 0)
+            {
+                Debug_print("TNFS seek failed during cache flush\r\n");
+                return result;
+            }
+        }
 
-            #ifdef VERBOSE_TNFS
-            Debug_printf("TNFS cache providing %u bytes\r\n", bytes_provided);
-            #endif
-            memcpy(dest + (*dest_used), pFHI->cache + (pFHI->cached_pos - pFHI->cache_start), bytes_provided);
+        uint16_t bytes_to_write = block->dirty_end - block->dirty_start;
 
-#ifdef DEBUG
-            //_tnfs_cache_dump("CACHE PROVIDED", dest + (*dest_used), bytes_provided);
-#endif
+        tnfsPacket packet;
+        packet.command = TNFS_CMD_WRITE;
+        packet.payload[0] = pFHI->handle_id;
+        packet.payload[1] = TNFS_LOBYTE_FROM_UINT16(bytes_to_write);
+        packet.payload[2] = TNFS_HIBYTE_FROM_UINT16(bytes_to_write);
+        memcpy(packet.payload + 3, block->data + block->dirty_start, bytes_to_write);
 
-            pFHI->cached_pos += bytes_provided;
-            *dest_used += bytes_provided;
+        if (!_tnfs_transaction(m_info, packet, bytes_to_write + 3))
+            return -1;
+        if (packet.payload[0] != TNFS_RESULT_SUCCESS)
+            return packet.payload[0];
 
-            /*
-            // Report if we've reached the end of the file
-            if (pFHI->cached_pos > pFHI->file_size)
-            {
-                Debug_print("_tnfs_read_from_cache - reached EOF\r\n");
-                return TNFS_RESULT_END_OF_FILE;
-            }
-            */
+        uint16_t bytes_written = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
+        if (bytes_written == 0 || bytes_written > bytes_to_write)
+            return TNFS_RESULT_IO_ERROR;
+
+        pFHI->file_position += bytes_written;
+        block->dirty_start += bytes_written;
+    }
+    block->dirty_start = block->dirty_end = 0;
+
+    // Without data read from the server, nothing in the block is valid anymore
+    if (!block->loaded)
+        _tnfs_cache_release(block);
+
+    return 0;
+}
+
+/*
+ Sends all dirty cache blocks to the server in file order, so that files opened
+ for appending get their data in the right sequence
+ Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+*/
+int _tnfs_cache_flush(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
+{
+    while (true)
+    {
+        tnfsCacheBlock *first_dirty = nullptr;
+        for (auto &block : pFHI->cache)
+            if (block.dirty_start < block.dirty_end && (first_dirty == nullptr || block.start < first_dirty->start))
+                first_dirty = &block;
+
+        if (first_dirty == nullptr)
+            return 0;
+
+        int result = _tnfs_cache_flush_block(m_info, pFHI, first_dirty);
+        if (result != 0)
+        {
+            Debug_printf("_tnfs_cache_flush failed (%d)\r\n", result);
+            return result;
         }
     }
+}
 
-    // Return value depends on whether we filled the destination buffer
-    if (dest_size - *dest_used)
-        return -1;
-    else
-        return 0;
+/*
+ Returns an unused cache block, or frees up the least recently used one
+ Dirty data is written back before a block gets reused
+ Returns null if that write-back failed, with the TNFS error in *error
+*/
+tnfsCacheBlock *_tnfs_cache_evict(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, int *error)
+{
+    tnfsCacheBlock *victim = nullptr;
+    for (auto &block : pFHI->cache)
+    {
+        if (block.start == TNFS_CACHE_BLOCK_UNUSED)
+        {
+            victim = &block;
+            break;
+        }
+        if (victim == nullptr || block.last_used < victim->last_used)
+            victim = &block;
+    }
+
+    if (victim->start != TNFS_CACHE_BLOCK_UNUSED)
+    {
+        if (victim->dirty_start < victim->dirty_end)
+        {
+            *error = _tnfs_cache_flush(m_info, pFHI);
+            if (*error != 0)
+                return nullptr;
+        }
+        pFHI->cache_evictions++;
+    }
+
+    _tnfs_cache_release(victim);
+    victim->last_used = ++pFHI->cache_tick;
+    return victim;
 }
 
 /*
- Executes as many READ calls as needed to populate our internal cache
- Returns: 0: success; -1: failed to deliver/receive packet; other: TNFS error result code
+ Loads up to count consecutive blocks, starting at the server's current file position,
+ with that many READ requests in flight at once, so the read-ahead costs about one
+ round trip instead of one per block.
+ The server reads from its current file position, so requests go out back-to-back
+ with consecutive sequence numbers and responses are only accepted in sequence
+ order as full blocks. Anything unexpected abandons the pipeline and re-synchronizes
+ the server's file position. Servers that misbehave TNFS_READ_WINDOW_MAX_FAILURES times
+ without TNFS_READ_WINDOW_GOOD_RUN good reads in between get read_window dropped to 1.
+ Only used over UDP: TCP responses aren't framed, so several replies may arrive
+ in a single read.
+ blocks_loaded is set to the number of leading blocks that were completely filled
+ Returns: 0: success (possibly partial); TNFS_RESULT_END_OF_FILE: server reported EOF;
+ -1: failed to deliver/receive packet; other: TNFS error result code
 */
-int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
+int _tnfs_read_pipelined(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, tnfsCacheBlock **blocks, int count, int *blocks_loaded)
 {
-    // Note that when we're filling the cache, we're dealing with the "real" file position,
-    // not the cached_position we also keep track of on behalf of the client
+    *blocks_loaded = 0;
+
+    std::lock_guard<std::recursive_mutex> lock(m_info->transaction_mutex);
+
+    // One socket for the whole window so every response comes back to us
+    fnUDP udp;
+
+    uint8_t first_sequence_num = m_info->current_sequence_num;
+    int sent = 0;
+    for (; sent < count; sent++)
+    {
+        tnfsPacket packet;
+        packet.session_idl = TNFS_LOBYTE_FROM_UINT16(m_info->session);
+        packet.session_idh = TNFS_HIBYTE_FROM_UINT16(m_info->session);
+        packet.sequence_num = m_info->current_sequence_num++;
+        packet.command = TNFS_CMD_READ;
+        packet.payload[0] = pFHI->handle_id;
+        packet.payload[1] = TNFS_LOBYTE_FROM_UINT16(TNFS_FILE_CACHE_BLOCK_SIZE);
+        packet.payload[2] = TNFS_HIBYTE_FROM_UINT16(TNFS_FILE_CACHE_BLOCK_SIZE);
+#ifdef DEBUG
+        _tnfs_debug_packet(packet, 3);
+#endif
+        if (!_tnfs_send(&udp, m_info, packet, 3))
+        {
+            Debug_println("_tnfs_read_pipelined failed to send packet");
+            break;
+        }
+    }
+
+    bool in_order = sent > 0;
+    bool eof = false;
+    int received = 0;
+#ifdef ESP_PLATFORM
+    unsigned long ms_last = fnSystem.millis();
+#else
+    uint64_t ms_start = fnSystem.millis();
+    uint64_t ms_last = ms_start;
+#endif
+    while (in_order && received < sent)
+    {
+        if (SYSTEM_BUS.getShuttingDown())
+        {
+            Debug_println("TNFS Breakout due to Shutdown");
+            in_order = false;
+            break;
+        }
+
+        tnfsPacket packet;
+        int l = _tnfs_recv(&udp, m_info, packet);
+        if (l < 0)
+        {
+            if ((fnSystem.millis() - ms_last) >= m_info->timeout_ms)
+            {
+                Debug_printf("_tnfs_read_pipelined timeout with %d of %d responses\r\n", received, sent);
+                in_order = false;
+                break;
+            }
+#ifdef ESP_PLATFORM
+            fnSystem.yield();
+#else
+            fnSystem.delay_microseconds(1000);
+#endif
+            continue;
+        }
+#ifdef DEBUG
+        _tnfs_debug_packet(packet, l, true);
+#endif
+
+        uint8_t expected_sequence_num = first_sequence_num + received;
+        if (packet.sequence_num != expected_sequence_num)
+        {
+            Debug_printf("_tnfs_read_pipelined out of order response! Rcvd: %x, Expected: %x\r\n", packet.sequence_num, expected_sequence_num);
+            in_order = false;
+            break;
+        }
+        received++;
+        ms_last = fnSystem.millis();
+
+        int tnfs_result = packet.payload[0];
+        if (tnfs_result == TNFS_RESULT_END_OF_FILE)
+        {
+            eof = true;
+            break;
+        }
+        // Leave TRY_AGAIN, session recovery and the like to the regular transaction code
+        if (tnfs_result != TNFS_RESULT_SUCCESS)
+        {
+            Debug_printf("_tnfs_read_pipelined unexpected result: %u\r\n", tnfs_result);
+            break;
+        }
+
+        uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
+        if (bytes_read > TNFS_FILE_CACHE_BLOCK_SIZE)
+        {
+            in_order = false;
+            break;
+        }
+        tnfsCacheBlock *block = blocks[*blocks_loaded];
+        memcpy(block->data, packet.payload + 3, bytes_read);
+        block->length = bytes_read;
+        block->loaded = true;
+        (*blocks_loaded)++;
+        pFHI->file_position += bytes_read;
+
+        // A short read means our idea of the file size is off, so stop here
+        if (bytes_read < TNFS_FILE_CACHE_BLOCK_SIZE)
+            break;
+    }
+
     #ifdef VERBOSE_TNFS
-    Debug_printf("_TNFS_FILL_CACHE fh=%d, file_position=%d\r\n", pFHI->handle_id, pFHI->file_position);
+    Debug_printf("_tnfs_read_pipelined %d blocks in %d/%d responses, %u ms\r\n",
+                 *blocks_loaded, received, sent, (unsigned)(fnSystem.millis() - ms_start));
     #endif
 
-    int error = 0;
+    // Only failures close together count against the server, an occasional lost
+    // packet shouldn't cost the mount its pipelining for good
+    if (in_order)
+    {
+        if (++m_info->read_window_good_run >= TNFS_READ_WINDOW_GOOD_RUN)
+        {
+            m_info->read_window_failures = 0;
+            m_info->read_window_good_run = 0;
+        }
+    }
+    else
+    {
+        m_info->read_window_good_run = 0;
+        if (++m_info->read_window_failures >= TNFS_READ_WINDOW_MAX_FAILURES && m_info->read_window > 1)
+        {
+            Debug_printf("TNFS server mishandles pipelined reads, falling back to stop-and-wait\r\n");
+            m_info->read_window = 1;
+        }
+    }
 
-    // Reset the current cache values so it's invalid if we fail below
-    pFHI->cache_available = 0;
-    pFHI->cache_start = pFHI->file_position;
+    // Outstanding requests may still move the server's file position
+    if (received < sent)
+    {
+        int result = _tnfs_server_seek(m_info, pFHI, pFHI->file_position);
+        if (result != 0)
+        {
+            Debug_printf("_tnfs_read_pipelined failed to resync file position (%d)\r\n", result);
+            return result;
+        }
+    }
 
-    // How many bytes until we finish loading the cache
-    uint32_t bytes_remaining_to_load = sizeof(pFHI->cache);
+    return eof ? TNFS_RESULT_END_OF_FILE : 0;
+}
+
+/*
+ Reads one block with as many stop-and-wait READ calls as it takes
+ Returns: 0: success; TNFS_RESULT_END_OF_FILE: EOF before any data;
+ -1: failed to deliver/receive packet; other: TNFS error result code
+*/
+int _tnfs_read_block(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, tnfsCacheBlock *block)
+{
+    block->length = 0;
 
     // Keep making TNFS READ calls as long as we still have bytes to read
-    while (bytes_remaining_to_load > 0)
+    while (block->length < TNFS_FILE_CACHE_BLOCK_SIZE)
     {
         tnfsPacket packet;
         packet.command = TNFS_CMD_READ;
         packet.payload[0] = pFHI->handle_id;
 
-        // How many bytes to read in this call
-        uint16_t bytes_to_read = bytes_remaining_to_load > TNFS_MAX_READWRITE_PAYLOAD ? TNFS_MAX_READWRITE_PAYLOAD : bytes_remaining_to_load;
-
+        uint16_t bytes_to_read = TNFS_FILE_CACHE_BLOCK_SIZE - block->length;
         packet.payload[1] = TNFS_LOBYTE_FROM_UINT16(bytes_to_read);
         packet.payload[2] = TNFS_HIBYTE_FROM_UINT16(bytes_to_read);
 
         #ifdef VERBOSE_TNFS
-        Debug_printf("_tnfs_fill_cache requesting %u bytes\r\n", bytes_to_read);
+        Debug_printf("_tnfs_read_block requesting %u bytes\r\n", bytes_to_read);
         #endif
 
-        if (_tnfs_transaction(m_info, packet, 3))
+        if (!_tnfs_transaction(m_info, packet, 3))
         {
-            int tnfs_result = packet.payload[0];
-            if (tnfs_result == TNFS_RESULT_SUCCESS)
-            {
-                // Copy the actual number of bytes returned to us into our cache
-                // (offset by how many bytes we've already put in the cache)
-                uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
-                memcpy(pFHI->cache + (sizeof(pFHI->cache) - bytes_remaining_to_load),
-                       packet.payload + 3, bytes_read);
-
-                // Keep track of our file position
-                pFHI->file_position = pFHI->file_position + bytes_read;
-                // Keep track of how many more bytes we have to go
-                bytes_remaining_to_load -= bytes_read;
-
-                #ifdef VERBOSE_TNFS
-                Debug_printf("_tnfs_fill_cache got %u bytes, %u more bytes needed\r\n", bytes_read, bytes_remaining_to_load);
-                #endif
-            }
-            else if(tnfs_result == TNFS_RESULT_END_OF_FILE)
-            {
-                // Stop if we got an EOF result
-                #ifdef VERBOSE_TNFS
-                Debug_print("_tnfs_fill_cache got EOF\r\n");
-                #endif
-#ifndef ESP_PLATFORM
-// TODO review EOF handling
-                error = TNFS_RESULT_END_OF_FILE; // push EOF up
-#endif
-                break;
-            }
-            else
-            {
-                Debug_printf("_tnfs_fill_cache unexepcted result: %u\r\n", tnfs_result);
-                error = tnfs_result;
-                break;
-            }
+            Debug_print("_tnfs_read_block received failure condition on TNFS read attempt\r\n");
+            return -1;
         }
-        else
+
+        int tnfs_result = packet.payload[0];
+        if (tnfs_result == TNFS_RESULT_END_OF_FILE)
         {
-            Debug_print("_tnfs_fill_cache received failure condition on TNFS read attempt\r\n");
-            error = -1;
+            #ifdef VERBOSE_TNFS
+            Debug_print("_tnfs_read_block got EOF\r\n");
+            #endif
             break;
         }
+        if (tnfs_result != TNFS_RESULT_SUCCESS)
+        {
+            Debug_printf("_tnfs_read_block unexepcted result: %u\r\n", tnfs_result);
+            return tnfs_result;
+        }
+
+        uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
+        if (bytes_read > bytes_to_read)
+            return TNFS_RESULT_IO_ERROR;
+        memcpy(block->data + block->length, packet.payload + 3, bytes_read);
+        block->length += bytes_read;
+        pFHI->file_position += bytes_read;
     }
 
-    // If we're successful, note the total number of valid bytes in our cache
-#ifdef ESP_PLATFORM
-    if (error == 0)
+    block->loaded = true;
+    return block->length > 0 ? 0 : TNFS_RESULT_END_OF_FILE;
+}
+
+/*
+ Loads the block starting at block_start into the cache and reads ahead as many of the
+ following blocks as the read window allows
+ The loaded block is returned in *pBlock
+ Returns: 0: success; TNFS_RESULT_END_OF_FILE: EOF; -1: failed to deliver/receive packet;
+ other: TNFS error result code
+*/
+int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint32_t block_start, tnfsCacheBlock **pBlock)
+{
+    // Note that when we're filling the cache, we're dealing with the "real" file position,
+    // not the cached_position we also keep track of on behalf of the client
+    #ifdef VERBOSE_TNFS
+    Debug_printf("_TNFS_FILL_CACHE fh=%d, block=%u, file_position=%u\r\n", pFHI->handle_id, block_start, pFHI->file_position);
+    #endif
+
+    pFHI->cache_misses++;
+    int error = 0;
+
+    // Read ahead following blocks that aren't cached yet and aren't past the end of the file
+    int window = m_info->protocol == TNFS_PROTOCOL_UDP ? m_info->read_window : 1;
+    if (window > TNFS_READ_WINDOW)
+        window = TNFS_READ_WINDOW;
+    if (window > (int)pFHI->cache.size())
+        window = pFHI->cache.size();
+    int count = 1;
+    while (count < window)
+    {
+        uint32_t next_start = block_start + count * TNFS_FILE_CACHE_BLOCK_SIZE;
+        if (next_start >= pFHI->file_size || _tnfs_cache_find(pFHI, next_start) != nullptr)
+            break;
+        count++;
+    }
+
+    // Data written at or past this block has to reach the server first, until it does the
+    // server's file may end in front of it. A block holding only written data is then read
+    // back in full.
+    for (auto &block : pFHI->cache)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
-#else
-// TODO review EOF handling
-    if (error == 0 || error == TNFS_RESULT_END_OF_FILE)
+        if (block.dirty_start < block.dirty_end && block.start >= block_start)
+        {
+            if ((error = _tnfs_cache_flush(m_info, pFHI)) != 0)
+                return error;
+            break;
+        }
+    }
+    tnfsCacheBlock *blocks[TNFS_READ_WINDOW];
+    blocks[0] = _tnfs_cache_find(pFHI, block_start);
+    if (blocks[0] != nullptr)
+        _tnfs_cache_release(blocks[0]);
+    else if ((blocks[0] = _tnfs_cache_evict(m_info, pFHI, &error)) == nullptr)
+        return error;
+    blocks[0]->start = block_start;
+    blocks[0]->last_used = ++pFHI->cache_tick;
+
+    for (int i = 1; i < count; i++)
+    {
+        if ((blocks[i] = _tnfs_cache_evict(m_info, pFHI, &error)) == nullptr)
+        {
+            count = i;
+            break;
+        }
+        blocks[i]->start = block_start + i * TNFS_FILE_CACHE_BLOCK_SIZE;
+    }
+    *pBlock = blocks[0];
+
+    if (pFHI->file_position != block_start)
+        error = _tnfs_server_seek(m_info, pFHI, block_start);
+
+    int loaded = 0;
+    if (error == 0 && count > 1)
+        error = _tnfs_read_pipelined(m_info, pFHI, blocks, count, &loaded);
+
+    // Stop-and-wait for the block we need if the pipeline couldn't deliver it
+    if (error == 0 && loaded == 0)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
-        if (pFHI->cache_available > 0) error = 0; // neutralize EOF
-#endif
-#ifdef DEBUG
-        //_tnfs_cache_dump("CACHE FILL RESULTS", pFHI->cache, pFHI->cache_available);
-#endif
+        error = _tnfs_read_block(m_info, pFHI, blocks[0]);
+        if (error == 0)
+            loaded = 1;
     }
 
+    // Don't keep read-ahead blocks we didn't get
+    for (int i = loaded; i < count; i++)
+        _tnfs_cache_release(blocks[i]);
+
+    if (loaded > 0)
+        return 0;
+
+    #ifdef VERBOSE_TNFS
+    Debug_printf("_tnfs_fill_cache failed (%d)\r\n", error);
+    #endif
     return error;
 }
 
@@ -490,22 +815,29 @@ int tnfs_read(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint1
     #endif
 
     int result = 0;
-    // Try to fulfill the request using our internal cache
-    while ((result = _tnfs_read_from_cache(pFileInf, buffer, bufflen, resultlen)) != 0 && result != TNFS_RESULT_END_OF_FILE)
+    while (*resultlen < bufflen)
     {
-        // Reload the cache if we couldn't fulfill the request
-        result = _tnfs_fill_cache(m_info, pFileInf);
-        if (result != 0)
+        // Report if we've reached the end of the file
+        if (pFileInf->cached_pos >= pFileInf->file_size)
+        {
+            result = TNFS_RESULT_END_OF_FILE;
+            break;
+        }
+
+        uint32_t block_start = pFileInf->cached_pos - pFileInf->cached_pos % TNFS_FILE_CACHE_BLOCK_SIZE;
+        tnfsCacheBlock *block = _tnfs_cache_find(pFileInf, block_start);
+        if (block != nullptr && block->loaded)
+        {
+            pFileInf->cache_hits++;
+            block->last_used = ++pFileInf->cache_tick;
+        }
+        else if ((result = _tnfs_fill_cache(m_info, pFileInf, block_start, &block)) != 0)
         {
 #ifndef ESP_PLATFORM
-// TODO review EOF handling
             if (result == TNFS_RESULT_END_OF_FILE)
             {
                 Debug_println("tnfs_read empty cache got EOF");
-                if (pFileInf->cached_pos < pFileInf->file_size)
-                {
-                    Debug_printf("tnfs_read premature end of file, got %u, expected %u\n", (unsigned)pFileInf->cached_pos, (unsigned)pFileInf->file_size);
-                }
+                Debug_printf("tnfs_read premature end of file, got %u, expected %u\n", (unsigned)pFileInf->cached_pos, (unsigned)pFileInf->file_size);
             }
             else
 #endif
@@ -514,6 +846,25 @@ int tnfs_read(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint1
             }
             break;
         }
+
+        uint16_t offset = pFileInf->cached_pos - block_start;
+        if (offset >= block->length)
+        {
+            // The server has less data than the file size we know about
+            result = TNFS_RESULT_END_OF_FILE;
+            break;
+        }
+
+        uint16_t bytes_provided = block->length - offset;
+        if (bytes_provided > bufflen - *resultlen)
+            bytes_provided = bufflen - *resultlen;
+
+        #ifdef VERBOSE_TNFS
+        Debug_printf("TNFS cache providing %u bytes\r\n", bytes_provided);
+        #endif
+        memcpy(buffer + *resultlen, block->data + offset, bytes_provided);
+        pFileInf->cached_pos += bytes_provided;
+        *resultlen += bytes_provided;
     }
 
     return result;
@@ -522,6 +873,8 @@ int tnfs_read(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint1
 
 /*
  Write to an open file.
+ Data is collected in the cache and sent to the server when its block is evicted,
+ on tnfs_flush() or on tnfs_close(), so server-side errors may only show up then.
  Max bufflen is TNFS_PAYLOAD_SIZE - 3; any larger size will return an error
  Bytes actually written will be placed in resultlen
  Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
@@ -539,82 +892,103 @@ int tnfs_write(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint
     if (pFileInf == nullptr)
         return TNFS_RESULT_BAD_FILE_DESCRIPTOR;
 
-    // For now, invalidate our cache and seek to the current position in the file before writing
-    pFileInf->cache_available = 0;
-    if(pFileInf->cached_pos != pFileInf->file_position)
+    while (*resultlen < bufflen)
     {
-        int result = tnfs_lseek(m_info, file_handle, pFileInf->cached_pos, SEEK_SET, nullptr, true);
-        if(result != 0)
+        uint32_t block_start = pFileInf->cached_pos - pFileInf->cached_pos % TNFS_FILE_CACHE_BLOCK_SIZE;
+        uint16_t offset = pFileInf->cached_pos - block_start;
+        uint16_t bytes_to_write = TNFS_FILE_CACHE_BLOCK_SIZE - offset;
+        if (bytes_to_write > bufflen - *resultlen)
+            bytes_to_write = bufflen - *resultlen;
+
+        tnfsCacheBlock *block = _tnfs_cache_find(pFileInf, block_start);
+        if (block != nullptr)
         {
-            Debug_print("TNFS seek failed during write\r\n");
-            return result;
+            pFileInf->cache_hits++;
         }
-    }
+        else
+        {
+            // No need to read the block first, only the bytes we write become valid
+            pFileInf->cache_misses++;
+            int result = 0;
+            if ((block = _tnfs_cache_evict(m_info, pFileInf, &result)) == nullptr)
+                return result;
+            block->start = block_start;
+            // Past the end of the file there's nothing on the server to read back
+            block->loaded = block_start >= pFileInf->file_size;
+        }
+        block->last_used = ++pFileInf->cache_tick;
 
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_WRITE;
-    packet.payload[0] = file_handle;
-    packet.payload[1] = TNFS_LOBYTE_FROM_UINT16(bufflen);
-    packet.payload[2] = TNFS_HIBYTE_FROM_UINT16(bufflen);
+        bool dirty = block->dirty_start < block->dirty_end;
+        uint16_t write_start = offset;
+        if (block->loaded)
+        {
+            // Writing past the end of the file leaves a zero-filled gap
+            if (offset > block->length)
+            {
+                memset(block->data + block->length, 0, offset - block->length);
+                write_start = block->length;
+            }
+        }
+        else if (dirty && (offset > block->dirty_end || offset + bytes_to_write < block->dirty_start))
+        {
+            // The dirty range of a block we haven't read has to stay contiguous
+            int result = _tnfs_cache_flush(m_info, pFileInf);
+            if (result != 0)
+                return result;
+            block->start = block_start;
+            dirty = false;
+        }
 
-    memcpy(packet.payload + 3, buffer, bufflen);
+        memcpy(block->data + offset, buffer + *resultlen, bytes_to_write);
 
-    if (_tnfs_transaction(m_info, packet, bufflen + 3))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+        uint16_t write_end = offset + bytes_to_write;
+        if (!dirty)
         {
-            *resultlen = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
-            // Keep track of our file position
-            uint32_t new_pos = pFileInf->file_position + *resultlen;
-            // Debug_printf("tnfs_write prev_pos: %u, read: %u, new_pos: %u\r\n", pFileInf->file_position, *resultlen, new_pos);
-            pFileInf->file_position = pFileInf->cached_pos = new_pos;
+            block->dirty_start = write_start;
+            block->dirty_end = write_end;
         }
-        return packet.payload[0];
+        else
+        {
+            if (write_start < block->dirty_start)
+                block->dirty_start = write_start;
+            if (write_end > block->dirty_end)
+                block->dirty_end = write_end;
+        }
+        if (block->loaded && write_end > block->length)
+            block->length = write_end;
+
+        pFileInf->modified = true;
+        pFileInf->cached_pos += bytes_to_write;
+        if (pFileInf->cached_pos > pFileInf->file_size)
+            _tnfs_cache_grow(pFileInf, pFileInf->cached_pos);
+        *resultlen += bytes_to_write;
     }
-    return -1;
+
+    return 0;
 }
 
 /*
-  Try to seek within our internal cache
-  Return 0 on success, -1 on failure
-*/
-int _tnfs_cache_seek(tnfsFileHandleInfo *pFHI, int32_t position, uint8_t type)
+ Sends any data cached by tnfs_write() to the server
+ Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+ */
+int tnfs_flush(tnfsMountInfo *m_info, int16_t file_handle)
 {
-    if (pFHI->cache_available == 0)
+    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(file_handle))
         return -1;
 
-    // Calculate where we're supposed to end up to see if it's within the cached region
-    uint32_t destination_pos;
-    if (type == SEEK_SET)
-        destination_pos = position;
-    else if (type == SEEK_CUR)
-        destination_pos = pFHI->cached_pos + position;
-    else
-        destination_pos = pFHI->file_size + position;
-
-    uint32_t cache_end = pFHI->cache_start + pFHI->cache_available;
-#ifdef TNFS_DEBUG
-    Debug_printf("_tnfs_cache_seek current=%u, destination=%u, cache_start=%u, cache_end=%u\r\n",
-                 pFHI->cached_pos, destination_pos, pFHI->cache_start, cache_end);
-#endif
+    // Find info on this handle
+    tnfsFileHandleInfo *pFileInf = m_info->get_filehandleinfo(file_handle);
+    if (pFileInf == nullptr)
+        return TNFS_RESULT_BAD_FILE_DESCRIPTOR;
 
-    // Just update our position if we're within the cached region
-    if (destination_pos >= pFHI->cache_start && destination_pos < cache_end)
-    {
-#ifdef TNFS_DEBUG
-        Debug_println("_tnfs_cache_seek within cached region");
-#endif
-        pFHI->cached_pos = destination_pos;
-        return 0;
-    }
-#ifdef TNFS_DEBUG
-    Debug_println("_tnfs_cache_seek outside cached region");
-#endif
-    return -1;
+    return _tnfs_cache_flush(m_info, pFileInf);
 }
 
 /*
  Seek to different position in open file
+ The cache is keyed by file position, so this normally only moves the position we report
+ to the client. The server catches up on the next cache fill or flush.
+ skip_cache forces an immediate TNFS LSEEK.
  Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
  */
 int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uint8_t type, uint32_t *new_position, bool skip_cache)
@@ -635,53 +1009,29 @@ int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uin
     Debug_printf("tnfs_lseek currpos=%d, pos=%d, typ=%d\r\n", pFileInf->cached_pos, position, type);
 #endif
 
-    // Try to fulfill the seek within our internal cache
-    if (skip_cache == false && _tnfs_cache_seek(pFileInf, position, type) == 0)
-    {
-        if(new_position != nullptr)
-            *new_position = pFileInf->cached_pos;
-        return 0;
-    }
-    // Cache seek failed - invalidate the internal cache
-    pFileInf->cache_available = 0;
+    int64_t destination_pos;
+    if (type == SEEK_SET)
+        destination_pos = position;
+    else if (type == SEEK_CUR)
+        destination_pos = (int64_t)pFileInf->cached_pos + position;
+    else
+        destination_pos = (int64_t)pFileInf->file_size + position;
 
-    // Go ahead and execute a new TNFS SEEK request
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_LSEEK;
-    packet.payload[0] = file_handle;
-    packet.payload[1] = type;
-    TNFS_UINT32_TO_LOHI_BYTEPTR(position, packet.payload + 2);
+    if (destination_pos < 0 || destination_pos > 0xFFFFFFFF)
+        return TNFS_RESULT_INVALID_ARGUMENT;
 
-    if (_tnfs_transaction(m_info, packet, 6))
+    if (skip_cache)
     {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            // Keep track of our file position
-            if (type == SEEK_SET)
-                pFileInf->file_position = position;
-            else if (type == SEEK_CUR)
-                pFileInf->file_position += position;
-            else
-                pFileInf->file_position = (pFileInf->file_size + position);
+        int result = _tnfs_server_seek(m_info, pFileInf, destination_pos);
+        if (result != 0)
+            return result;
+    }
 
-            pFileInf->cached_pos = pFileInf->file_position;
+    pFileInf->cached_pos = destination_pos;
+    if(new_position != nullptr)
+        *new_position = pFileInf->cached_pos;
 
-            if(new_position != nullptr)
-                *new_position = pFileInf->file_position;
-            uint32_t response_pos = TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + 1);
-#ifdef TNFS_DEBUG
-            Debug_printf("tnfs_lseek success, new pos=%u, response pos=%u\r\n", pFileInf->file_position, response_pos);
-#endif
-            // TODO: This is temporary while we confirm that the recently-changed TNFSD code matches what we've been doing prior
-            if(pFileInf->file_position != response_pos)
-            {
-                Debug_print("CALCULATED AND RESPONSE POS DON'T MATCH!\r\n");
-                fnSystem.delay(5000);
-            }
-        }
-        return packet.payload[0];
-    }
-    return -1;
+    return 0;
 }
 
 /*
@@ -707,6 +1057,7 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
 
     // Throw out any existing cached directory entries
     m_info->empty_dircache();
+    _tnfs_dirlisting_detach(m_info);
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_OPENDIRX;
@@ -732,6 +1083,28 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
     Debug_printf("TNFS open directory: sortopts=0x%02x diropts=0x%02x maxresults=0x%04x pattern=\"%s\" path=\"%s\"\r\n",
      sortopts, diropts, maxresults, (char *)(packet.payload + OFFSET_OPENDIRX_PATTERN), (char *)(packet.payload + pathoffset));
 
+    // Answer from a listing we fetched recently
+    char fullpath[TNFS_MAX_FILELEN];
+    strlcpy(fullpath, (char *)(packet.payload + pathoffset), sizeof(fullpath));
+    tnfsDirListing *pListing = m_info->find_dirlisting(fullpath, pattern, sortopts, diropts, maxresults);
+    if (pListing != nullptr && pListing->complete)
+    {
+        if (_tnfs_dirlisting_current(pListing))
+        {
+            m_info->dir_listing = pListing;
+            m_info->dir_from_listing = true;
+            m_info->dir_listing_pos = 0;
+            m_info->dir_entries = pListing->entries.size();
+            Debug_printf("Directory opened from kept listing, entries: %u\r\n", m_info->dir_entries);
+            return TNFS_RESULT_SUCCESS;
+        }
+        m_info->delete_dirlisting(pListing);
+    }
+    else if (pListing != nullptr)
+    {
+        m_info->delete_dirlisting(pListing);
+    }
+
     if (_tnfs_transaction(m_info, packet, pathoffset + pathlen + 1))
     {
         if (packet.payload[0] == TNFS_RESULT_SUCCESS)
@@ -739,14 +1112,79 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
             m_info->dir_handle = packet.payload[1];
             m_info->dir_entries = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 2);
             Debug_printf("Directory opened, handle ID: %hd, entries: %u\r\n", m_info->dir_handle, m_info->dir_entries);
+
+            // Start collecting a listing to keep for next time
+            pListing = m_info->new_dirlisting(fullpath, pattern, sortopts, diropts, maxresults);
+            if (pListing != nullptr)
+            {
+                pListing->fetched_ms = fnSystem.millis();
+                m_info->dir_listing = pListing;
+            }
         }
         return packet.payload[0];
     }
     return -1;
 }
 
-void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
+/*
+    Reports whether a kept listing is recent enough to be used again
+*/
+bool _tnfs_dirlisting_current(tnfsDirListing *pListing)
+{
+    if (fnSystem.millis() - pListing->fetched_ms < TNFS_DIRLISTING_TTL_MS)
+        return true;
+    Debug_printf("TNFS kept listing for \"%s\" has expired\r\n", pListing->path);
+    return false;
+}
+
+/*
+    Adds an entry read from the server to the listing being collected for the open directory.
+    Entries have to arrive in order; a gap (after a SEEKDIR) means we can't keep the listing.
+*/
+void _tnfs_dirlisting_add(tnfsMountInfo *m_info, tnfsDirCacheEntry *pCached)
+{
+    tnfsDirListing *pListing = m_info->dir_listing;
+    if (pListing == nullptr || m_info->dir_from_listing || pListing->complete)
+        return;
+
+    // Already have this one
+    if (pCached->dirpos < pListing->entries.size())
+        return;
+
+    if (pCached->dirpos > pListing->entries.size() || pListing->entries.size() >= TNFS_MAX_DIRLISTING_ENTRIES)
+    {
+        m_info->delete_dirlisting(pListing);
+        return;
+    }
+
+    tnfsDirListingEntry entry;
+    entry.flags = pCached->flags;
+    entry.filesize = pCached->filesize;
+    entry.m_time = pCached->m_time;
+    entry.c_time = pCached->c_time;
+    entry.name = pListing->names.size();
+    pListing->entries.push_back(entry);
+    pListing->names.insert(pListing->names.end(), pCached->entryname, pCached->entryname + strlen(pCached->entryname) + 1);
+}
+
+/*
+    Stops filling or serving the listing of the open directory
+    Listings that weren't read to the end can't be reused and are dropped
+*/
+void _tnfs_dirlisting_detach(tnfsMountInfo *m_info)
+{
+    tnfsDirListing *pListing = m_info->dir_listing;
+    if (pListing != nullptr && (pListing->complete == false || pListing->discard))
+        m_info->delete_dirlisting(pListing);
+    m_info->dir_listing = nullptr;
+    m_info->dir_from_listing = false;
+    m_info->dir_listing_pos = 0;
+}
+
+void _readdirx_fill_response(tnfsMountInfo *m_info, tnfsDirCacheEntry *pCached, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
 {
+    _tnfs_dirlisting_add(m_info, pCached);
+
     filestat->isDir = pCached->flags & TNFS_READDIRX_DIR ? true : false;
     filestat->filesize = pCached->filesize;
     filestat->m_time = pCached->m_time;
@@ -779,8 +1217,28 @@ void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, cha
 */
 int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
 {
+    if (m_info == nullptr)
+        return -1;
+
+    // Serve directories opened from a kept listing
+    if (m_info->dir_from_listing)
+    {
+        tnfsDirListing *pListing = m_info->dir_listing;
+        if (m_info->dir_listing_pos >= pListing->entries.size())
+            return TNFS_RESULT_END_OF_FILE;
+
+        const tnfsDirListingEntry &entry = pListing->entries[m_info->dir_listing_pos++];
+        filestat->isDir = entry.flags & TNFS_READDIRX_DIR ? true : false;
+        filestat->filesize = entry.filesize;
+        filestat->m_time = entry.m_time;
+        filestat->c_time = entry.c_time;
+        filestat->a_time = 0;
+        strlcpy(dir_entry, pListing->names.data() + entry.name, dir_entry_len);
+        return 0;
+    }
+
     // Check for a valid open handle ID
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
         return -1;
 
     // See if we have an entry in our directory cache to return first
@@ -788,7 +1246,7 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
     if(pCached != nullptr)
     {
         Debug_print("tnfs_readdirx responding from cached entry\r\n");
-        _readdirx_fill_response(pCached, filestat, dir_entry, dir_entry_len);
+        _readdirx_fill_response(m_info, pCached, filestat, dir_entry, dir_entry_len);
         return 0;
     }
 
@@ -796,6 +1254,8 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
     if(m_info->get_dircache_eof() == true)
     {
         Debug_print("tnfs_readdirx returning EOF based on cached value\r\n");
+        if (m_info->dir_listing != nullptr)
+            m_info->dir_listing->complete = true;
         return TNFS_RESULT_END_OF_FILE;
     }
 
@@ -865,9 +1325,13 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
             Debug_printf("tnfs_readdirx cached %d entries\r\n", loaded);
             // Now that we've cached our entries, return the first one
             if(loaded > 0)
-                _readdirx_fill_response(m_info->next_dircache_entry(), filestat, dir_entry, dir_entry_len);
+                _readdirx_fill_response(m_info, m_info->next_dircache_entry(), filestat, dir_entry, dir_entry_len);
 
         }
+        else if (packet.payload[0] == TNFS_RESULT_END_OF_FILE && m_info->dir_listing != nullptr)
+        {
+            m_info->dir_listing->complete = true;
+        }
         return packet.payload[0];
     }
     return -1;
@@ -878,10 +1342,16 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
 */
 int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || position == nullptr)
         return -1;
 
-    if(position == nullptr)
+    if (m_info->dir_from_listing)
+    {
+        *position = m_info->dir_listing_pos;
+        return 0;
+    }
+
+    if (false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
         return -1;
 
     // First see if we're pointing at a currently-cached directory entry and return that
@@ -912,7 +1382,16 @@ int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 */
 int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr)
+        return -1;
+
+    if (m_info->dir_from_listing)
+    {
+        m_info->dir_listing_pos = position;
+        return 0;
+    }
+
+    if (false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
         return -1;
 
     // A SEEKDIR will always invalidate our directory cache
@@ -936,11 +1415,23 @@ int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 */
 int tnfs_closedir(tnfsMountInfo *m_info)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr)
+        return -1;
+
+    // Nothing to tell the server if we served the directory from a kept listing
+    if (m_info->dir_from_listing)
+    {
+        _tnfs_dirlisting_detach(m_info);
+        return TNFS_RESULT_SUCCESS;
+    }
+
+    if (false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
         return -1;
 
     // Throw out any existing cached directory entries
     m_info->empty_dircache();
+    // Keep the listing only if we got all of it
+    _tnfs_dirlisting_detach(m_info);
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_CLOSEDIR;
@@ -973,6 +1464,9 @@ int tnfs_mkdir(tnfsMountInfo *m_info, const char *directory)
 
     Debug_printf("TNFS make directory: \"%s\"\r\n", (char *)packet.payload);
 
+    // Directory listings we kept may no longer match the server
+    m_info->invalidate_dirlistings();
+
     if (_tnfs_transaction(m_info, packet, len + 1))
     {
         return packet.payload[0];
@@ -996,6 +1490,9 @@ int tnfs_rmdir(tnfsMountInfo *m_info, const char *directory)
 
     Debug_printf("TNFS remove directory: \"%s\"\r\n", (char *)packet.payload);
 
+    // Directory listings we kept may no longer match the server
+    m_info->invalidate_dirlistings();
+
     if (_tnfs_transaction(m_info, packet, len + 1))
     {
         return packet.payload[0];
@@ -1073,6 +1570,9 @@ int tnfs_unlink(tnfsMountInfo *m_info, const char *filepath)
 
     Debug_printf("TNFS unlink file: \"%s\"\r\n", (char *)packet.payload);
 
+    // Directory listings we kept may no longer match the server
+    m_info->invalidate_dirlistings();
+
     if (_tnfs_transaction(m_info, packet, len + 1))
     {
         return packet.payload[0];
@@ -1098,6 +1598,9 @@ int tnfs_rename(tnfsMountInfo *m_info, const char *old_filepath, const char *new
 
     Debug_printf("TNFS rename file: \"%s\" -> \"%s\"\r\n", (char *)packet.payload, (char *)(packet.payload + l1));
 
+    // Directory listings we kept may no longer match the server
+    m_info->invalidate_dirlistings();
+
     if (_tnfs_transaction(m_info, packet, l1 + l2))
     {
         return packet.payload[0];
@@ -30,6 +30,15 @@ tnfsMountInfo::~tnfsMountInfo()
     }
     // Delete any remaining directory cache entries
     empty_dircache();
+    // And any directory listings we kept
+    for (int i = 0; i < TNFS_MAX_DIRLISTINGS; i++)
+    {
+        if (_dir_listings[i] != nullptr)
+        {
+            delete _dir_listings[i];
+            _dir_listings[i] = nullptr;
+        }
+    }
 }
 
 // Empty the current contents of the directory cache
@@ -87,6 +96,100 @@ int tnfsMountInfo::tell_dircache_entry()
     return _dir_cache[_dir_cache_current]->dirpos;
 }
 
+/*
+ Returns the listing kept for the given directory request or null if there is none
+*/
+tnfsDirListing * tnfsMountInfo::find_dirlisting(const char *path, const char *pattern, uint8_t sortopts, uint8_t diropts, uint16_t maxresults)
+{
+    if (pattern == nullptr)
+        pattern = "";
+
+    for (int i = 0; i < TNFS_MAX_DIRLISTINGS; i++)
+    {
+        tnfsDirListing *p = _dir_listings[i];
+        if (p != nullptr && p->discard == false && p->sortopts == sortopts && p->diropts == diropts &&
+            p->maxresults == maxresults && strcmp(p->path, path) == 0 && strcmp(p->pattern, pattern) == 0)
+        {
+            p->last_used = ++_dir_listing_tick;
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+/*
+ Adds a new, empty listing for the given directory request and returns a pointer to it
+ The least recently used listing is dropped if the table is full.
+ Null is returned if every listing is currently in use
+*/
+tnfsDirListing * tnfsMountInfo::new_dirlisting(const char *path, const char *pattern, uint8_t sortopts, uint8_t diropts, uint16_t maxresults)
+{
+    int slot = -1;
+    for (int i = 0; i < TNFS_MAX_DIRLISTINGS; i++)
+    {
+        if (_dir_listings[i] == nullptr)
+        {
+            slot = i;
+            break;
+        }
+        // Never drop the listing of the currently open directory
+        if (_dir_listings[i] == dir_listing)
+            continue;
+        if (slot < 0 || _dir_listings[i]->last_used < _dir_listings[slot]->last_used)
+            slot = i;
+    }
+    if (slot < 0)
+        return nullptr;
+
+    delete _dir_listings[slot];
+    tnfsDirListing *p = new tnfsDirListing();
+    strlcpy(p->path, path, sizeof(p->path));
+    strlcpy(p->pattern, pattern == nullptr ? "" : pattern, sizeof(p->pattern));
+    p->sortopts = sortopts;
+    p->diropts = diropts;
+    p->maxresults = maxresults;
+    p->last_used = ++_dir_listing_tick;
+    _dir_listings[slot] = p;
+    return p;
+}
+
+/*
+ Removes the given listing
+*/
+void tnfsMountInfo::delete_dirlisting(tnfsDirListing *pListing)
+{
+    for (int i = 0; i < TNFS_MAX_DIRLISTINGS; i++)
+    {
+        if (_dir_listings[i] == pListing)
+        {
+            delete _dir_listings[i];
+            _dir_listings[i] = nullptr;
+        }
+    }
+    if (dir_listing == pListing)
+        dir_listing = nullptr;
+}
+
+/*
+ Drops every kept listing after we changed something on the server
+ The listing of a currently open directory stays until the directory is closed
+*/
+void tnfsMountInfo::invalidate_dirlistings()
+{
+    for (int i = 0; i < TNFS_MAX_DIRLISTINGS; i++)
+    {
+        if (_dir_listings[i] == nullptr)
+            continue;
+        if (_dir_listings[i] == dir_listing)
+        {
+            dir_listing->discard = true;
+            continue;
+        }
+        delete _dir_listings[i];
+        _dir_listings[i] = nullptr;
+    }
+}
+
 /*
  Returns a pointer to the tnfsFileHandleInfo with a matching file handle,
  or null if no match exists in the table.
@@ -118,6 +221,7 @@ tnfsFileHandleInfo *tnfsMountInfo::new_filehandleinfo()
             tnfsFileHandleInfo *p = new tnfsFileHandleInfo;
             if (p != nullptr)
             {
+                p->cache.resize(file_cache_blocks > 0 ? file_cache_blocks : 1);
                 _file_handles[i] = p;
                 return p;
             }
@@ -3,10 +3,15 @@
 
 #include <cstdint>
 #include <mutex>
+#include <vector>
 
 #include "fnDNS.h"
 #include "fnTcpClient.h"
 
+#ifdef ESP_PLATFORM
+#include "../../include/PSRAMAllocator.h"
+#endif
+
 
 #define TNFS_DEFAULT_PORT 16384
 #define TNFS_RETRIES 5 // Number of times to retry if we fail to send/receive a packet
@@ -16,13 +21,44 @@
 #define TNFS_MAX_FILE_HANDLES 8 // Max number of file handles we'll open to the server
 #define TNFS_MAX_FILELEN 256
 
-#define TNFS_FILE_CACHE_SIZE 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
+#define TNFS_FILE_CACHE_BLOCK_SIZE 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
+
+// Each open file caches up to tnfsMountInfo::file_cache_blocks blocks of TNFS_FILE_CACHE_BLOCK_SIZE
+// bytes, keyed by file offset and evicted least-recently-used first.
+// TNFS_READ_WINDOW is the number of TNFS_CMD_READ requests we keep in flight when filling
+// the cache over UDP, i.e. how many blocks one cache miss reads ahead.
+// Set it to 1 for plain stop-and-wait reads.
+#ifdef ESP_PLATFORM
+#define TNFS_FILE_CACHE_BLOCKS 8
+#define TNFS_READ_WINDOW 4
+#else
+#define TNFS_FILE_CACHE_BLOCKS 64
+#define TNFS_READ_WINDOW 8
+#endif
+#define TNFS_READ_WINDOW_MAX_FAILURES 3 // Pipeline failures before we fall back to stop-and-wait for this mount
+#define TNFS_READ_WINDOW_GOOD_RUN 16 // In-order pipelined reads in a row that forgive earlier failures
+
+#define TNFS_CACHE_BLOCK_UNUSED 0xFFFFFFFF
 
 #define TNFS_INVALID_HANDLE -1
 #define TNFS_INVALID_SESSION 0 // We're assuming a '0' is never a valid session ID
 
 #define TNFS_MAX_DIRCACHE_ENTRIES 32 // Max number of directory cache entries we'll store
 
+// Complete directory listings are kept after tnfs_closedir() and reused by tnfs_opendirx()
+// for the same path, pattern and options for TNFS_DIRLISTING_TTL_MS after they were read.
+// Changes we make drop them right away, changes by other clients show up once they expire.
+// The directory's modification time can't be used instead, it doesn't change when a file
+// in it changes size.
+#ifdef ESP_PLATFORM
+#define TNFS_MAX_DIRLISTINGS 2
+#define TNFS_MAX_DIRLISTING_ENTRIES 512 // Larger directories are never kept
+#else
+#define TNFS_MAX_DIRLISTINGS 16
+#define TNFS_MAX_DIRLISTING_ENTRIES 65535
+#endif
+#define TNFS_DIRLISTING_TTL_MS 10000
+
 #define TNFS_PROTOCOL_UNKNOWN 0
 #define TNFS_PROTOCOL_TCP 1
 #define TNFS_PROTOCOL_UDP 2
@@ -39,20 +75,40 @@
 #define TNFS_UDP_SIMULATE_SEND_TWICE_PROB 0.05
 #define TNFS_UDP_SIMULATE_RECV_TWICE_PROB 0.05
 
+// One TNFS_FILE_CACHE_BLOCK_SIZE-aligned piece of an open file
+struct tnfsCacheBlock
+{
+    uint32_t start = TNFS_CACHE_BLOCK_UNUSED; // File position of the first byte in the block
+    uint32_t last_used = 0; // Value of tnfsFileHandleInfo::cache_tick when last accessed
+    uint16_t length = 0; // Number of valid bytes (less than the block size at the end of the file)
+    uint16_t dirty_start = 0; // Bytes written by the client but not yet sent to the server
+    uint16_t dirty_end = 0;
+    bool loaded = false; // False if only the dirty range holds valid data
+
+    uint8_t data[TNFS_FILE_CACHE_BLOCK_SIZE];
+};
+
 // Some things we need to keep track of for every file we open
 struct tnfsFileHandleInfo
 {
     uint8_t handle_id = 0;
+    uint16_t open_mode = 0; // TNFS_OPENMODE_* the file was opened with
 
-    uint32_t file_position = 0; // Current actual file position
+    uint32_t file_position = 0; // Current actual file position on the server
     uint32_t file_size = 0;
-    uint32_t cached_pos = 0; // File position the client thinks we're at (usually somewhere in the cached region)
-    uint32_t cache_start = 0; // The file position at which the cache starts
-    uint32_t cache_available = 0; // Number of valid bytes in the cache
-
-    bool cache_modified = false; // Notes if we've written to the cache
-
-    uint8_t cache[TNFS_FILE_CACHE_SIZE];
+    uint32_t cached_pos = 0; // File position the client thinks we're at
+    bool modified = false; // Set once the client wrote to the file
+
+    uint32_t cache_tick = 0; // Bumped on every block access to keep LRU order
+    uint32_t cache_hits = 0;
+    uint32_t cache_misses = 0;
+    uint32_t cache_evictions = 0;
+
+#ifdef ESP_PLATFORM
+    std::vector<tnfsCacheBlock, PSRAMAllocator<tnfsCacheBlock>> cache; // Sized from tnfsMountInfo::file_cache_blocks on open
+#else
+    std::vector<tnfsCacheBlock> cache; // Sized from tnfsMountInfo::file_cache_blocks on open
+#endif
     char filename[TNFS_MAX_FILELEN];
 };
 
@@ -67,6 +123,39 @@ struct tnfsDirCacheEntry
     char entryname[TNFS_MAX_FILELEN];
 };
 
+// One entry of a kept directory listing
+struct tnfsDirListingEntry
+{
+    uint8_t flags;
+    uint32_t filesize;
+    uint32_t m_time;
+    uint32_t c_time;
+    uint32_t name; // Offset of the zero-terminated name in tnfsDirListing::names
+};
+
+// A directory listing as returned by the server for one TNFS_OPENDIRX request
+struct tnfsDirListing
+{
+    char path[TNFS_MAX_FILELEN] = { '\0' };
+    char pattern[TNFS_MAX_FILELEN] = { '\0' };
+    uint8_t sortopts = 0;
+    uint8_t diropts = 0;
+    uint16_t maxresults = 0;
+
+    uint64_t fetched_ms = 0; // When the listing was read from the server
+    uint32_t last_used = 0;
+    bool complete = false; // Set once the server reported EOF
+    bool discard = false; // Drop the listing when its directory is closed
+
+#ifdef ESP_PLATFORM
+    std::vector<tnfsDirListingEntry, PSRAMAllocator<tnfsDirListingEntry>> entries;
+    std::vector<char, PSRAMAllocator<char>> names; // Entry names, one after the other
+#else
+    std::vector<tnfsDirListingEntry> entries;
+    std::vector<char> names;
+#endif
+};
+
 // Everything we need to know about and keep track of for the server we're talking to
 class tnfsMountInfo
 {
@@ -76,6 +165,8 @@ private:
     uint16_t _dir_cache_current = 0;
     uint16_t _dir_cache_count = 0;
     bool _dir_cache_eof = false;
+    tnfsDirListing * _dir_listings[TNFS_MAX_DIRLISTINGS] = { nullptr };
+    uint32_t _dir_listing_tick = 0;
 
 public:
     ~tnfsMountInfo();
@@ -98,6 +189,11 @@ public:
     void set_dircache_eof() { _dir_cache_eof = true; };
     bool get_dircache_eof() { return _dir_cache_eof; };
 
+    tnfsDirListing * find_dirlisting(const char *path, const char *pattern, uint8_t sortopts, uint8_t diropts, uint16_t maxresults);
+    tnfsDirListing * new_dirlisting(const char *path, const char *pattern, uint8_t sortopts, uint8_t diropts, uint16_t maxresults);
+    void delete_dirlisting(tnfsDirListing *pListing);
+    void invalidate_dirlistings();
+
     uint8_t protocol = TNFS_PROTOCOL_UNKNOWN;
     fnTcpClient tcp_client;
 
@@ -115,9 +211,16 @@ public:
     uint8_t max_retries = TNFS_RETRIES;
     int timeout_ms = TNFS_TIMEOUT;
     uint8_t current_sequence_num = 0; // Updated with each transaction to the server
+    uint8_t read_window = TNFS_READ_WINDOW; // Max READ requests in flight; drops to 1 if the server misbehaves
+    uint8_t file_cache_blocks = TNFS_FILE_CACHE_BLOCKS; // Cache blocks allocated for each file opened from now on
+    uint8_t read_window_failures = 0; // Number of pipelined reads that had to be abandoned
+    uint8_t read_window_good_run = 0; // Pipelined reads completed in order since the last failure
 
     int16_t dir_handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIR
     uint16_t dir_entries = 0; // Stored from server's response to TNFS_OPENDIRX
+    tnfsDirListing *dir_listing = nullptr; // Listing of the open directory, being filled or served
+    bool dir_from_listing = false; // Open directory is served from dir_listing without a server handle
+    uint16_t dir_listing_pos = 0; // Next entry to return when dir_from_listing is set
     std::recursive_mutex transaction_mutex;
 
 #ifdef TNFS_UDP_SIMULATE_RECV_TWICE
@@ -107,6 +107,8 @@ void systemBus::op_reset()
 {
     Debug_printv("op_reset()");
 
+    flush_disks();
+
     // When a reset transaction occurs, set the mounted disk image to the CONFIG disk image.
     theFuji.boot_config = true;
     theFuji.insert_boot_device(Config.get_general_boot_mode());
@@ -260,9 +262,25 @@ void systemBus::op_write()
         return;
     }
 
+    _disk_writes_pending = true;
+    _last_disk_write_ms = fnSystem.millis();
+
     fnDwCom.write(0x00); // success
 }
 
+void systemBus::flush_disks()
+{
+    if (!_disk_writes_pending)
+        return;
+
+    for (int i = 0; i < MAX_DISK_DEVICES; i++)
+    {
+        if (theFuji.get_disks(i)->disk_dev.flush())
+            Debug_printf("Flush error on drive %d\n", i);
+    }
+    _disk_writes_pending = false;
+}
+
 void systemBus::op_fuji()
 {
     theFuji.process();
@@ -524,6 +542,7 @@ void systemBus::_drivewire_process_cmd()
             break;
         case OP_TERM:
             Debug_printf("OP_TERM!\n");
+            flush_disks();
             break;
         case OP_SERTERM:
             op_serterm();
@@ -585,6 +604,8 @@ void systemBus::service()
 
     if (fnDwCom.available())
         _drivewire_process_cmd();
+    else if (_disk_writes_pending && fnSystem.millis() - _last_disk_write_ms >= DRIVEWIRE_FLUSH_IDLE_MS)
+        flush_disks();
 
     fnDwCom.poll(1);
 
@@ -699,6 +720,8 @@ void systemBus::shutdown()
 {
     shuttingDown = true;
 
+    flush_disks();
+
     // TODO: implement device shutdown for all sub-busses
 
     for (std::map<uint8_t, drivewireNetwork *>::iterator it = _netDev.begin();
@@ -33,6 +33,9 @@
 
 #define DRIVEWIRE_BAUDRATE 57600
 
+// Disk writes are held back until the bus has been quiet this long
+#define DRIVEWIRE_FLUSH_IDLE_MS 100
+
 /* Operation Codes */
 #define		OP_NOP		0
 #define     OP_JEFF     0xA5
@@ -221,6 +224,17 @@ private:
      */
     uint8_t sector_data[MEDIA_BLOCK_SIZE];
 
+    /**
+     * @brief Disk writes waiting to be flushed, and when the last one came in
+     */
+    bool _disk_writes_pending = false;
+    uint64_t _last_disk_write_ms = 0;
+
+    /**
+     * @brief Write out sectors held back by the disks
+     */
+    void flush_disks();
+
     /**
      * @brief NOP command (do nothing)
      */
@@ -582,6 +582,8 @@ bool IRAM_ATTR iwmBus::serviceDiskII()
 
   case iwm_enable_state_t::on:
     diskii_xface.d2_enable_seen |= diskii_xface.iwm_enable_states();
+    if (IWM_ACTIVE_DISK2->is_track_pending())
+      IWM_ACTIVE_DISK2->load_pending_track();
 #ifdef DEBUG
     new_track = IWM_ACTIVE_DISK2->get_track_pos();
     if (old_track != new_track)
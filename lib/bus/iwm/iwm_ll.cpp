@@ -8,6 +8,7 @@
 #include <soc/spi_periph.h>
 
 #include "iwm_ll.h"
+#include "iwm_sp_codec.h"
 #include "iwm.h"
 #include "../device/iwm/disk2.h"
 #include "../device/iwm/fuji.h"
@@ -689,83 +690,7 @@ void iwm_sp_ll::encode_packet(uint8_t source, iwm_packet_type_t packet_type, uin
   // status code
   // pointer to the data
   // number of bytes to encode
-
-  uint8_t checksum = 0;
-  int numgrps = 0;
-  int numodds = 0;
-
-  if ((data != nullptr) && (num != 0))
-  {
-  int grpbyte, grpcount;
-  uint8_t grpmsb;
-  uint8_t group_buffer[7];
-                                    // Calculate checksum of sector bytes before we destroy them
-    for (int count = 0; count < num; count++) // xor all the data bytes
-      checksum = checksum ^ data[count];
-
-    // Start assembling the packet at the rear and work
-    // your way to the front so we don't overwrite data
-    // we haven't encoded yet
-
-    // how many groups of 7?
-    numgrps = num / 7;
-    numodds = num % 7;
-
-    // grps of 7
-    for (grpcount = numgrps - 1; grpcount >= 0; grpcount--) // 73
-    {
-      memcpy(group_buffer, data + numodds + (grpcount * 7), 7);
-      // add group msb byte
-      grpmsb = 0;
-      for (grpbyte = 0; grpbyte < 7; grpbyte++)
-        grpmsb = grpmsb | ((group_buffer[grpbyte] >> (grpbyte + 1)) & (0x80 >> (grpbyte + 1)));
-      // groups start after odd bytes, which is at 13 + numodds + (numodds != 0) + 1
-      int grpstart = 13 + numodds + (numodds != 0) + 1;
-      packet_buffer[grpstart + (grpcount * 8)] = grpmsb | 0x80; // set msb to one
-
-      // now add the group data bytes bits 6-0
-      for (grpbyte = 0; grpbyte < 7; grpbyte++)
-        packet_buffer[grpstart + 1 + (grpcount * 8) + grpbyte] = group_buffer[grpbyte] | 0x80;
-    }
-
-    // oddbytes
-    if(numodds)
-    {
-      packet_buffer[14] = 0x80; // init the oddmsb
-      for (int oddcnt = 0; oddcnt < numodds; oddcnt++)
-      {
-        packet_buffer[14] |= (data[oddcnt] & 0x80) >> (1 + oddcnt);
-        packet_buffer[15 + oddcnt] = data[oddcnt] | 0x80;
-      }
-    }
-  }
-
-  // header
-  packet_buffer[0] = 0xff; // sync bytes
-  packet_buffer[1] = 0x3f;
-  packet_buffer[2] = 0xcf;
-  packet_buffer[3] = 0xf3;
-  packet_buffer[4] = 0xfc;
-  packet_buffer[5] = 0xff;
-
-  packet_buffer[6] = 0xc3;  //PBEGIN - start byte
-  packet_buffer[7] = 0x80;  //DEST - dest id - host
-  packet_buffer[8] = source; //SRC - source id - us
-  packet_buffer[9] = static_cast<uint8_t>(packet_type);  //TYPE - 0x82 = data
-  packet_buffer[10] = 0x80; //AUX
-  packet_buffer[11] = status | 0x80; //STAT
-  packet_buffer[12] = numodds | 0x80; //ODDCNT  - 1 odd byte for 512 byte packet
-  packet_buffer[13] = numgrps | 0x80; //GRP7CNT - 73 groups of 7 bytes for 512 byte packet
-
-  for (int count = 7; count < 14; count++) // now xor the packet header bytes
-    checksum = checksum ^ packet_buffer[count];
-  int lastidx = 14 + numodds + (numodds != 0) + numgrps * 8;
-  packet_buffer[lastidx++] = checksum | 0xaa;      // 1 c6 1 c4 1 c2 1 c0
-  packet_buffer[lastidx++] = (checksum >> 1) | 0xaa; // 1 c7 1 c5 1 c3 1 c1
-
-  //end bytes
-  packet_buffer[lastidx++] = 0xc8;  //pkt end
-  packet_buffer[lastidx] = 0x00;  //mark the end of the packet_buffer
+  iwm_sp_encode_packet(packet_buffer, source, static_cast<uint8_t>(packet_type), status, data, num);
 }
 
 //*****************************************************************************
@@ -783,37 +708,8 @@ size_t iwm_sp_ll::decode_data_packet(uint8_t* output_data)
 
 size_t iwm_sp_ll::decode_data_packet(uint8_t* input_data, uint8_t* output_data)
 {
-  int grpbyte, grpcount;
-  uint8_t numgrps, numodd;
-  size_t numdata;
-  uint8_t bit0to6, bit7;
-  uint8_t group_buffer[8];
-
   //Handle arbitrary length packets :)
-  numodd = input_data[11] & 0x7f;
-  numgrps = input_data[12] & 0x7f;
-  numdata = numodd + numgrps * 7;
-  // Debug_printf("\nDecoding %d bytes",numdata);
-
-  // decode oddbyte(s), 1 in a 512 data packet
-  for(int i = 0; i < numodd; i++){
-    output_data[i] = ((input_data[13] << (i+1)) & 0x80) | (input_data[14+i] & 0x7f);
-  }
-
-  // decode groups of 7, 73 grps of 7 in a 512 byte packet
-  int grpstart = 12 + numodd + (numodd != 0) + 1;
-  for (grpcount = 0; grpcount < numgrps; grpcount++)
-  {
-    memcpy(group_buffer, input_data + grpstart + (grpcount * 8), 8);
-    for (grpbyte = 0; grpbyte < 7; grpbyte++)
-    {
-      bit7 = (group_buffer[0] << (grpbyte + 1)) & 0x80;
-      bit0to6 = (group_buffer[grpbyte + 1]) & 0x7f;
-      output_data[numodd + (grpcount * 7) + grpbyte] = bit7 | bit0to6;
-    }
-  }
-
-  return numdata;
+  return iwm_sp_decode_packet(input_data, output_data);
 }
 
 void iwm_sp_ll::set_output_to_spi()
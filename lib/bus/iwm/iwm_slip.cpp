@@ -149,7 +149,7 @@ uint8_t iwm_slip::iwm_phase_vector()
 	}
 
 	// create a Request object from the data
-	std::vector<uint8_t> request_data = request_queue_.front();
+	std::vector<uint8_t> request_data = std::move(request_queue_.front());
 	request_queue_.pop();
 	current_request = Request::from_packet(request_data);
 
@@ -251,7 +251,7 @@ void iwm_slip::wait_for_requests()
 			// }
 
 			std::lock_guard<std::mutex> lock(queue_mutex_);
-			request_queue_.push(request_data);
+			request_queue_.push(std::move(request_data));
 		}
 	}
 }
@@ -0,0 +1,175 @@
+#ifdef BUILD_APPLE
+
+#include "iwm_sp_codec.h"
+
+#include <string.h>
+
+// Groups are handled as little endian words, memcpy becomes a single
+// unaligned access where the target has them
+static inline uint64_t load_group7(const uint8_t *p)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t v = 0;
+  memcpy(&v, p, 7);
+  return v;
+#else
+  return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+         ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48);
+#endif
+}
+
+static inline uint64_t load_group8(const uint8_t *p)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+#else
+  return load_group7(p) | ((uint64_t)p[7] << 56);
+#endif
+}
+
+static inline void store_group7(uint8_t *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(p, &v, 7);
+#else
+  for (int i = 0; i < 7; i++)
+    p[i] = (uint8_t)(v >> (i * 8));
+#endif
+}
+
+static inline void store_group8(uint8_t *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(p, &v, 8);
+#else
+  for (int i = 0; i < 8; i++)
+    p[i] = (uint8_t)(v >> (i * 8));
+#endif
+}
+
+// msb byte of a group -> bit 7 of each of the 7 data bytes
+struct sp_msb_table
+{
+  uint64_t bits[128];
+  constexpr sp_msb_table() : bits()
+  {
+    for (int msb = 0; msb < 128; msb++)
+      for (int i = 0; i < 7; i++)
+        if (msb & (0x40 >> i))
+          bits[msb] |= (uint64_t)0x80 << (i * 8);
+  }
+};
+static constexpr sp_msb_table msb_table;
+
+// Encodes one group of 7 and returns the XOR of its bytes spread over the word.
+// All but the last group are read as whole words, the byte after them is masked off.
+static inline uint64_t encode_group(uint8_t *out, const uint8_t *in, bool last)
+{
+  uint64_t v = last ? load_group7(in) : load_group8(in) & 0x00ffffffffffffffULL;
+  // gather bit 7 of byte i into bit 6-i
+  uint64_t msb = (((v >> 7) & 0x0001010101010101ULL) * 0x8040201008040201ULL) >> 57;
+  store_group8(out, (v << 8) | msb | 0x8080808080808080ULL);
+  return v;
+}
+
+// All but the last group are written as whole words, the next group overwrites the extra byte
+static inline void decode_group(uint8_t *out, const uint8_t *in, bool last)
+{
+  uint64_t v = load_group8(in);
+  v = ((v >> 8) & 0x007f7f7f7f7f7f7fULL) | msb_table.bits[v & 0x7f];
+  if (last)
+    store_group7(out, v);
+  else
+    store_group8(out, v);
+}
+
+size_t iwm_sp_encode_packet(uint8_t *packet, uint8_t source, uint8_t packet_type, uint8_t status, const uint8_t *data, uint16_t num)
+{
+  uint8_t checksum = 0;
+  int numgrps = 0;
+  int numodds = 0;
+
+  if ((data != nullptr) && (num != 0))
+  {
+    uint64_t sum = 0;
+
+    numgrps = num / 7;
+    numodds = num % 7;
+
+    // groups start after odd bytes, which is at 13 + numodds + (numodds != 0) + 1
+    // work from the rear so data in the packet buffer is read before it is overwritten
+    uint8_t *grpstart = packet + 14 + numodds + (numodds != 0);
+    for (int grpcount = numgrps - 1; grpcount >= 0; grpcount--)
+      sum ^= encode_group(grpstart + (grpcount * 8), data + numodds + (grpcount * 7), grpcount == numgrps - 1);
+
+    sum ^= sum >> 32;
+    sum ^= sum >> 16;
+    sum ^= sum >> 8;
+    checksum = (uint8_t)sum;
+
+    // oddbytes
+    if (numodds)
+    {
+      uint8_t oddmsb = 0x80;
+      for (int oddcnt = 0; oddcnt < numodds; oddcnt++)
+      {
+        checksum ^= data[oddcnt];
+        oddmsb |= (data[oddcnt] & 0x80) >> (1 + oddcnt);
+      }
+      // odd bytes may be where they go, fill from the rear as well
+      for (int oddcnt = numodds - 1; oddcnt >= 0; oddcnt--)
+        packet[15 + oddcnt] = data[oddcnt] | 0x80;
+      packet[14] = oddmsb;
+    }
+  }
+
+  // header
+  packet[0] = 0xff; // sync bytes
+  packet[1] = 0x3f;
+  packet[2] = 0xcf;
+  packet[3] = 0xf3;
+  packet[4] = 0xfc;
+  packet[5] = 0xff;
+
+  packet[6] = 0xc3;  //PBEGIN - start byte
+  packet[7] = 0x80;  //DEST - dest id - host
+  packet[8] = source; //SRC - source id - us
+  packet[9] = packet_type;  //TYPE - 0x82 = data
+  packet[10] = 0x80; //AUX
+  packet[11] = status | 0x80; //STAT
+  packet[12] = numodds | 0x80; //ODDCNT  - 1 odd byte for 512 byte packet
+  packet[13] = numgrps | 0x80; //GRP7CNT - 73 groups of 7 bytes for 512 byte packet
+
+  for (int count = 7; count < 14; count++) // now xor the packet header bytes
+    checksum = checksum ^ packet[count];
+  int lastidx = 14 + numodds + (numodds != 0) + numgrps * 8;
+  packet[lastidx++] = checksum | 0xaa;      // 1 c6 1 c4 1 c2 1 c0
+  packet[lastidx++] = (checksum >> 1) | 0xaa; // 1 c7 1 c5 1 c3 1 c1
+
+  //end bytes
+  packet[lastidx++] = 0xc8;  //pkt end
+  packet[lastidx] = 0x00;  //mark the end of the packet_buffer
+
+  return lastidx;
+}
+
+size_t iwm_sp_decode_packet(const uint8_t *packet, uint8_t *data)
+{
+  uint8_t numodd = packet[11] & 0x7f;
+  uint8_t numgrps = packet[12] & 0x7f;
+
+  // decode oddbyte(s), 1 in a 512 data packet
+  for (int i = 0; i < numodd; i++)
+    data[i] = ((packet[13] << (i + 1)) & 0x80) | (packet[14 + i] & 0x7f);
+
+  // decode groups of 7, 73 grps of 7 in a 512 byte packet
+  const uint8_t *grpstart = packet + 13 + numodd + (numodd != 0);
+  for (int grpcount = 0; grpcount < numgrps; grpcount++)
+    decode_group(data + numodd + (grpcount * 7), grpstart + (grpcount * 8), grpcount == numgrps - 1);
+
+  return numodd + numgrps * 7;
+}
+
+#endif // BUILD_APPLE
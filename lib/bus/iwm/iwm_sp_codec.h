@@ -0,0 +1,24 @@
+#ifdef BUILD_APPLE
+#ifndef IWM_SP_CODEC_H
+#define IWM_SP_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SmartPort packet encoding, kept apart from the bus so it can be built and
+// checked on the host (tools/smartport_bench.cpp)
+//
+// Data bytes go out as odd bytes followed by groups of 7, each group led by a
+// byte holding the msb's of the 7. Groups are done 8 bytes at a time in a
+// 64-bit word instead of bit by bit.
+
+// Builds the packet for num data bytes into packet, returns its length without the terminating 0x00.
+// data may be in the packet buffer itself, as long as it starts before the data part of the packet.
+size_t iwm_sp_encode_packet(uint8_t *packet, uint8_t source, uint8_t packet_type, uint8_t status, const uint8_t *data, uint16_t num);
+
+// Decodes the data of a packet as read from the bus (ODDCNT at 11), returns the number of data bytes.
+// Checksum is not verified here.
+size_t iwm_sp_decode_packet(const uint8_t *packet, uint8_t *data);
+
+#endif // IWM_SP_CODEC_H
+#endif // BUILD_APPLE
@@ -521,6 +521,10 @@ void systemBus::service()
         if (_netDev[i] != nullptr)
             _netDev[i]->sio_poll_interrupt();
     }
+
+    // Let devices finish deferred work, e.g. buffered disk writes
+    for (auto devicep : _daisyChain)
+        devicep->sio_idle();
 #ifndef ESP_PLATFORM
     // loop until all SIO "events" are processed
     //   true  = SIO port needs handling
@@ -216,6 +216,9 @@ protected:
     // Optional shutdown/reboot cleanup routine
     virtual void shutdown(){};
 
+    // Optional routine called on every pass of the bus service loop, for deferred work
+    virtual void sio_idle(){};
+
 public:
     /**
      * @brief get the SIO device Number (1-255)
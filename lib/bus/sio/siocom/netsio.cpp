@@ -13,6 +13,11 @@
 #include <unistd.h> // write(), read(), close()
 #include <errno.h> // Error integer and strerror() function
 #include <fcntl.h> // Contains file controls like O_RDWR
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#endif
 
 #include "../../include/debug.h"
 
@@ -43,13 +48,22 @@ NetSioPort::NetSioPort() :
     _initialized(false),
     _command_asserted(false),
     _motor_asserted(false),
+    _command_latched(false),
     _rxhead(0),
     _rxtail(0),
     _rxfull(false),
+    _txsize(0),
     _sync_request_num(-1),
     _sync_write_size(-1),
     _errcount(0),
-    _credit(3)
+    _cold_reset(false),
+    _credit(3),
+    _credit_updates(0),
+    _connection(0),
+    _rx_running(false),
+    _wake_fd(-1),
+    _rx_events(0),
+    _polled_events(0)
 {}
 
 NetSioPort::~NetSioPort()
@@ -69,6 +83,7 @@ void NetSioPort::begin(int baud)
 
     _command_asserted = false;
     _motor_asserted = false;
+    _command_latched = false;
     rxbuffer_flush();
 
     // Wait for WiFi
@@ -143,6 +158,7 @@ void NetSioPort::begin(int baud)
     send(_fd, (char *)&connect, 1, 0);
 
     _alive_request = _alive_time = fnSystem.millis();
+    start_receiver();
 
     Debug_printf("### NetSIO initialized ###\n");
     // Set initialized.
@@ -153,6 +169,10 @@ void NetSioPort::begin(int baud)
 
 void NetSioPort::end()
 {
+    stop_receiver();
+    _txsize = 0;
+    _connection++;
+
     if (_fd >= 0)
     {
         uint8_t disconnect = NETSIO_DEVICE_DISCONNECT;
@@ -165,12 +185,24 @@ void NetSioPort::end()
     _initialized = false;
 }
 
+/* Waits up to ms for a message from the hub, returns true if any arrived since the last poll
+*/
 bool NetSioPort::poll(int ms)
 {
-    if (_initialized)
-        return wait_sock_readable(ms);
-    fnSystem.delay(ms);
-    return false;
+    if (!handle_netsio())
+    {
+        fnSystem.delay(ms);
+        return false;
+    }
+
+    flush_tx();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _rx_cv.wait_for(lock, std::chrono::milliseconds(ms),
+        [this] { return _rx_events != _polled_events || !_rx_running; });
+    bool events = (_rx_events != _polled_events);
+    _polled_events = _rx_events;
+    return events;
 }
 
 void NetSioPort::suspend(int ms)
@@ -297,16 +329,19 @@ bool NetSioPort::keep_alive()
 {
     ssize_t result;
     uint64_t ms = fnSystem.millis();
+    // the receiver updates it, check one value
+    uint64_t alive_time = _alive_time;
 
     // if ALIVE_RATE_MS time passed since last alive request was sent
     if (ms - _alive_request >= ALIVE_RATE_MS)
     {
         // if alive request was send but we did not received any response then we lost connection
-        if (ms - _alive_request < ALIVE_TIMEOUT_MS && ms - _alive_time >= ALIVE_TIMEOUT_MS)
+        if (ms - _alive_request < ALIVE_TIMEOUT_MS && ms - alive_time >= ALIVE_TIMEOUT_MS)
         {
             Debug_println("NetSIO connection lost");
-            // Debug_printf("> %lu %lu %lu  %lu %lu\n", ms, _alive_request, _alive_time, ms-_alive_request, ms-_alive_time);
-            // ping hub
+            // Debug_printf("> %lu %lu %lu  %lu %lu\n", ms, _alive_request, alive_time, ms-_alive_request, ms-alive_time);
+            // ping hub, the receiver would take the response
+            stop_receiver();
             if (ping(2, 1000, 2000) < 0)
             {
                 // no ping response
@@ -318,7 +353,7 @@ bool NetSioPort::keep_alive()
             begin(_baud);
         }
         // if nothing received for longer than ALIVE_RATE_MS, keep sending alive requests at ALIVE_RATE_MS rate
-        else if (ms - _alive_time >= ALIVE_RATE_MS)
+        else if (ms - alive_time >= ALIVE_RATE_MS)
         {
             _alive_request = ms;
             uint8_t alive = NETSIO_ALIVE_REQUEST;
@@ -329,108 +364,224 @@ bool NetSioPort::keep_alive()
     return _initialized;
 }
 
-/* read NetSIO message from socket and update internal variables */
-int NetSioPort::handle_netsio()
+/* Keeps the connection up, returns true if it is */
+bool NetSioPort::handle_netsio()
 {
-    uint8_t rxbuf[514]; // must be able to hold whole netsio datagram, i.e. >= rxbuffer_len+2 defined in netsio.atdevice
-    uint8_t b;
-    int received;
-
     if (!resume_test())
-        return 0;
+        return false;
 
-    received = recv(_fd, (char *)rxbuf, sizeof(rxbuf), 0);
-    if (received > 0)
+    if (_cold_reset)
     {
+        // emulator cold reset, do fujinet restart
+        _cold_reset = false;
+#ifndef DEBUG_NO_REBOOT
+        fnSystem.reboot();
+#endif
+    }
+
+    return keep_alive();
+}
+
+/* update internal variables from a NetSIO message, called by the receiver with _mutex held */
+void NetSioPort::handle_message(const uint8_t *rxbuf, int received)
+{
+    uint8_t b;
+
 #ifdef VERBOSE_SIO
-        Debug_printf("NetSIO RECV <%i> BYTES\n\t", received);
-        for (int i = 0; i < received; i++)
-            Debug_printf("%02x ", rxbuf[i]);
-        Debug_print("\n");
+    Debug_printf("NetSIO RECV <%i> BYTES\n\t", received);
+    for (int i = 0; i < received; i++)
+        Debug_printf("%02x ", rxbuf[i]);
+    Debug_print("\n");
 #endif
-        _alive_time = fnSystem.millis(); // update last received
-        switch (rxbuf[0])
-        {
-            case NETSIO_DATA_BYTE_SYNC:
-                if (received >= 3)
-                    _sync_request_num = rxbuf[2];
-                // [[fallthrough]]; // > No warning
-
-            case NETSIO_DATA_BYTE:
-                b = rxbuf[1];
-                if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
-                    b ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
-                if (rxbuffer_put(b))
-                    Debug_println("NetSIO rxbuffer overrun");
-                break;
+    _alive_time = fnSystem.millis(); // update last received
+    switch (rxbuf[0])
+    {
+        case NETSIO_DATA_BYTE_SYNC:
+            if (received >= 3)
+                _sync_request_num = rxbuf[2];
+            // [[fallthrough]]; // > No warning
+
+        case NETSIO_DATA_BYTE:
+            b = rxbuf[1];
+            if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
+                b ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
+            if (rxbuffer_put(b))
+                Debug_println("NetSIO rxbuffer overrun");
+            break;
 
-            case NETSIO_DATA_BLOCK:
-                if (received >= 2)
+        case NETSIO_DATA_BLOCK:
+            if (received >= 2)
+            {
+                for (int i = 1; i < received-1; i++) // TODO received-1, to test packet SNs
+                // for (int i = 1; i < received; i++)
                 {
-                    for (int i = 1; i < received-1; i++) // TODO received-1, to test packet SNs
-                    // for (int i = 1; i < received; i++)
-                    {
-                        b = rxbuf[i];
-                        if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
-                            b ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
-                        if (rxbuffer_put(b))
-                            Debug_println("NetSIO rxbuffer overrun");
-                    }
+                    b = rxbuf[i];
+                    if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
+                        b ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
+                    if (rxbuffer_put(b))
+                        Debug_println("NetSIO rxbuffer overrun");
                 }
-                break;
+            }
+            break;
 
-            case NETSIO_COMMAND_OFF_SYNC:
-                if (received >= 2) 
-                    _sync_request_num = rxbuf[1]; // sync request sequence number
-                // [[fallthrough]]; // > No warning
+        case NETSIO_COMMAND_OFF_SYNC:
+            if (received >= 2) 
+                _sync_request_num = rxbuf[1]; // sync request sequence number
+            // [[fallthrough]]; // > No warning
 
-            case NETSIO_COMMAND_OFF:
-                _command_asserted = false;
-                break;
+        case NETSIO_COMMAND_OFF:
+            _command_asserted = false;
+            break;
 
-            case NETSIO_COMMAND_ON:
-                _command_asserted = true;
-                _sync_request_num = -1; // cancel any sync request
-                _sync_write_size = -1;
-                rxbuffer_flush();   // flush any stray input data
-                break;
+        case NETSIO_COMMAND_ON:
+            _command_latched = true; // the whole command may be in before the bus looks
+            _command_asserted = true;
+            _sync_request_num = -1; // cancel any sync request
+            _sync_write_size = -1;
+            rxbuffer_flush();   // flush any stray input data
+            break;
 
-            case NETSIO_MOTOR_OFF:
-                _motor_asserted = false;
-                break;
+        case NETSIO_MOTOR_OFF:
+            _motor_asserted = false;
+            break;
 
-            case NETSIO_MOTOR_ON:
-                _motor_asserted = true;
-                break;
+        case NETSIO_MOTOR_ON:
+            _motor_asserted = true;
+            break;
 
-            case NETSIO_SPEED_CHANGE:
-                // speed change notification
-                if (received >= 5)
-                {
-                    _baud_peer = rxbuf[1] | (rxbuf[2] << 8) | (rxbuf[3] << 16) | (rxbuf[4] << 24);
-                    Debug_printf("NetSIO peer baudrate: %d\n", _baud_peer);
-                }
-                break;
+        case NETSIO_SPEED_CHANGE:
+            // speed change notification
+            if (received >= 5)
+            {
+                _baud_peer = rxbuf[1] | (rxbuf[2] << 8) | (rxbuf[3] << 16) | (rxbuf[4] << 24);
+                Debug_printf("NetSIO peer baudrate: %d\n", _baud_peer);
+            }
+            break;
 
-            case NETSIO_CREDIT_UPDATE:
-                _credit = rxbuf[1];
-                break;
+        case NETSIO_CREDIT_UPDATE:
+            _credit = rxbuf[1];
+            _credit_updates++;
+            break;
 
-            case NETSIO_COLD_RESET:
-                // emulator cold reset, do fujinet restart
-#ifndef DEBUG_NO_REBOOT
-                fnSystem.reboot();
+        case NETSIO_COLD_RESET:
+            // restart from the bus side, not from the receiver
+            _cold_reset = true;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void NetSioPort::start_receiver()
+{
+#ifdef __linux__
+    _wake_fd = eventfd(0, EFD_NONBLOCK);
 #endif
-                break;
+    _rx_running = true;
+    _rx_thread = std::thread(&NetSioPort::receiver, this);
+}
 
-            default:
-                break;
+void NetSioPort::stop_receiver()
+{
+    if (!_rx_thread.joinable())
+        return;
+
+    _rx_running = false;
+#ifdef __linux__
+    uint64_t one = 1;
+    if (_wake_fd >= 0)
+        ::write(_wake_fd, &one, sizeof(one));
+#endif
+    _rx_thread.join();
+#ifdef __linux__
+    if (_wake_fd >= 0)
+        ::close(_wake_fd);
+    _wake_fd = -1;
+#endif
+    _rx_cv.notify_all();
+}
+
+/* receiver thread, hands every datagram to handle_message() */
+void NetSioPort::receiver()
+{
+#ifdef __linux__
+    static uint8_t rxbufs[NETSIO_RX_BATCH][NETSIO_RX_DATAGRAM];
+    struct mmsghdr msgs[NETSIO_RX_BATCH];
+    struct iovec iovs[NETSIO_RX_BATCH];
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < NETSIO_RX_BATCH; i++)
+    {
+        iovs[i].iov_base = rxbufs[i];
+        iovs[i].iov_len = NETSIO_RX_DATAGRAM;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int epfd = epoll_create1(0);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = _fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, _fd, &ev);
+    ev.data.fd = _wake_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, _wake_fd, &ev);
+
+    while (_rx_running)
+    {
+        struct epoll_event events[2];
+        int n = epoll_wait(epfd, events, 2, 1000);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            Debug_printf("NetSIO receiver epoll error %d: %s\n", errno, strerror(errno));
+            break;
         }
+
+        // take everything queued, NETSIO_RX_BATCH datagrams at a time
+        int received;
+        do
+        {
+            received = recvmmsg(_fd, msgs, NETSIO_RX_BATCH, MSG_DONTWAIT, nullptr);
+            if (received <= 0)
+                break;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (int i = 0; i < received; i++)
+                {
+                    if (msgs[i].msg_len > 0)
+                        handle_message(rxbufs[i], msgs[i].msg_len);
+                }
+                _rx_events += received;
+            }
+            _rx_cv.notify_all();
+        } while (received == NETSIO_RX_BATCH);
     }
+    ::close(epfd);
+#else
+    uint8_t rxbuf[NETSIO_RX_DATAGRAM];
 
-    keep_alive();
+    while (_rx_running)
+    {
+        if (!wait_sock_readable(100))
+            continue;
 
-    return received;
+        int received;
+        while ((received = recv(_fd, (char *)rxbuf, sizeof(rxbuf), 0)) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                handle_message(rxbuf, received);
+                _rx_events++;
+            }
+            _rx_cv.notify_all();
+        }
+    }
+#endif
+    _rx_running = false;
+    _rx_cv.notify_all();
 }
 
 timeval NetSioPort::timeval_from_ms(const uint32_t millis)
@@ -551,38 +702,152 @@ ssize_t NetSioPort::write_sock(const uint8_t *buffer, size_t size, uint32_t time
 
 bool NetSioPort::wait_for_data(uint32_t timeout_ms)
 {
-    while (rxbuffer_empty())
-    {
-        if (!wait_sock_readable(timeout_ms))
-            return false;  // timeout
-        handle_netsio();
-        // TODO adjust timeout_ms
-    }
+    // the hub may be waiting for what we hold
+    flush_tx();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _rx_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+        [this] { return !rxbuffer_empty() || !_rx_running; });
     // data available for read
-    return true;
+    return !rxbuffer_empty();
 }
 
-bool NetSioPort::wait_for_credit(int needed)
+/* Waits until needed credit is available and takes it, with up to wanted if more is there.
+   Returns the credit taken, 0 if disconnected or reconnected meanwhile. updates gets the CREDIT_UPDATE
+   count for give_back_credit()
+*/
+int NetSioPort::wait_for_credit(int needed, int wanted, uint32_t *updates)
 {
     uint8_t txbuf[2];
-    txbuf[0] = NETSIO_CREDIT_STATUS;
-    txbuf[1] = (uint8_t)_credit;
+    uint32_t connection = _connection;
+    std::unique_lock<std::mutex> lock(_mutex);
 
     // wait for credit
     while (needed > _credit)
     {
-        if (!_initialized) 
-            return false; // disconnected
+        if (!_initialized || !_rx_running)
+            return 0; // disconnected
         // inform HUB we need more credit
+        txbuf[0] = NETSIO_CREDIT_STATUS;
+        txbuf[1] = (uint8_t)_credit;
         send(_fd, (char *)txbuf, sizeof(txbuf), 0);
         //Debug_printf("waiting for credit %d\n", _credit);
-        wait_sock_readable(500);
-        handle_netsio();
+        if (!_rx_cv.wait_for(lock, std::chrono::milliseconds(500), [&] { return needed <= _credit || !_rx_running; }))
+        {
+            // nothing from the hub, is it still there?
+            lock.unlock();
+            keep_alive();
+            lock.lock();
+            // a new hub session knows nothing of what the caller holds
+            if (_connection != connection)
+                return 0;
+        }
     }
     // consume credit
-    _credit -= needed;
+    int taken = (wanted > _credit) ? _credit : (wanted > needed ? wanted : needed);
+    _credit -= taken;
     //Debug_printf("credit %d\n", _credit);
-    return true;
+    if (updates != nullptr)
+        *updates = _credit_updates;
+    return taken;
+}
+
+/* Returns credit taken by wait_for_credit() but not used. If the hub has sent
+   a CREDIT_UPDATE since, its count is newer and already leaves the unused part out
+*/
+void NetSioPort::give_back_credit(int unused, uint32_t updates)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (updates == _credit_updates)
+        _credit += unused;
+}
+
+/* Sends up to count datagrams of held data, returns the data bytes sent
+*/
+size_t NetSioPort::send_blocks(const uint8_t *data, size_t size, int count)
+{
+    // a lone byte goes as DATA_BYTE, like it always did
+    static uint8_t data_block = NETSIO_DATA_BLOCK;
+    static uint8_t data_byte = NETSIO_DATA_BYTE;
+    uint8_t *cmd = (size == 1) ? &data_byte : &data_block;
+
+#ifdef __linux__
+    struct mmsghdr msgs[NETSIO_TX_DATAGRAMS];
+    struct iovec iovs[NETSIO_TX_DATAGRAMS][2];
+    size_t queued = 0;
+    int n;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (n = 0; n < count && n < NETSIO_TX_DATAGRAMS && queued < size; n++)
+    {
+        size_t len = (size - queued > NETSIO_TX_BLOCK) ? NETSIO_TX_BLOCK : size - queued;
+        iovs[n][0].iov_base = cmd;
+        iovs[n][0].iov_len = 1;
+        iovs[n][1].iov_base = (void *)(data + queued);
+        iovs[n][1].iov_len = len;
+        msgs[n].msg_hdr.msg_iov = iovs[n];
+        msgs[n].msg_hdr.msg_iovlen = 2;
+        queued += len;
+    }
+
+    if (!wait_sock_writable(500))
+    {
+        Debug_println("NetSIO send_blocks() TIMEOUT");
+        return 0;
+    }
+    int result = sendmmsg(_fd, msgs, n, 0);
+    if (result < 0)
+    {
+        Debug_printf("NetSIO send_blocks() sendmmsg error %d: %s\n", errno, strerror(errno));
+        return 0;
+    }
+
+    size_t sent = 0;
+    for (int i = 0; i < result; i++)
+        sent += msgs[i].msg_len > 0 ? msgs[i].msg_len - 1 : 0;
+    return sent;
+#else
+    uint8_t txbuf[NETSIO_TX_BLOCK + 1];
+    size_t sent = 0;
+
+    for (int n = 0; n < count && sent < size; n++)
+    {
+        size_t len = (size - sent > NETSIO_TX_BLOCK) ? NETSIO_TX_BLOCK : size - sent;
+        txbuf[0] = *cmd;
+        memcpy(txbuf + 1, data + sent, len);
+        ssize_t result = write_sock(txbuf, len + 1);
+        if (result <= 0)
+            break;
+        sent += result - 1;
+    }
+    return sent;
+#endif
+}
+
+/* Sends the data bytes held by write()
+*/
+void NetSioPort::flush_tx()
+{
+    size_t sent = 0;
+
+    while (sent < _txsize && _initialized)
+    {
+        // one credit per datagram, send as many as the credit allows
+        int blocks = (_txsize - sent + NETSIO_TX_BLOCK - 1) / NETSIO_TX_BLOCK;
+        uint32_t updates;
+        int credit = wait_for_credit(1, blocks, &updates);
+        if (credit == 0)
+            break;
+        size_t result = send_blocks(_txbuf + sent, _txsize - sent, credit);
+        // only the last datagram holds less than a block
+        int used = (int)((result + NETSIO_TX_BLOCK - 1) / NETSIO_TX_BLOCK);
+        if (used < credit)
+            give_back_credit(credit - used, updates);
+        if (result == 0)
+            break;
+        sent += result;
+    }
+    _txsize = 0;
 }
 
 /* Discards anything in the input buffer
@@ -590,7 +855,10 @@ bool NetSioPort::wait_for_credit(int needed)
 void NetSioPort::flush_input()
 {
     if (_initialized)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
         rxbuffer_flush();
+    }
 }
 
 /* Clears input buffer and flushes out transmit buffer waiting at most
@@ -600,7 +868,9 @@ void NetSioPort::flush()
 {
     if (_initialized)
     {
+        // drop stale input before sending, what comes after answers the data sent
         flush_input();
+        flush_tx();
         wait_sock_writable(500);
     }
 }
@@ -609,8 +879,10 @@ void NetSioPort::flush()
 */
 int NetSioPort::available()
 {
-    if (rxbuffer_empty())
-        handle_netsio();
+    handle_netsio();
+    flush_tx();
+
+    std::lock_guard<std::mutex> lock(_mutex);
     return rxbuffer_available();
 }
 
@@ -629,8 +901,11 @@ void NetSioPort::set_baudrate(uint32_t baud)
     txbuf[2] = (baud >> 8) & 0xff;
     txbuf[3] = (baud >> 16) & 0xff;
     txbuf[4] = (baud >> 24) & 0xff;
+    flush_tx();
     wait_for_credit(1);
     send(_fd, (char *)txbuf, sizeof(txbuf), 0);
+
+    std::lock_guard<std::mutex> lock(_mutex);
     _baud = baud;
 }
 
@@ -641,14 +916,20 @@ uint32_t NetSioPort::get_baudrate()
 
 bool NetSioPort::command_asserted(void)
 {
-    // process NetSIO message, if any
+    // back in the bus loop, send what the last command left
     handle_netsio();
-    return _command_asserted;
+    flush_tx();
+    // report a command even if it was over before we got here,
+    // the latch is set before the line so reading it second clears it for this command
+    bool asserted = _command_asserted;
+    bool latched = _command_latched.exchange(false);
+    return asserted || latched;
 }
 
 bool NetSioPort::motor_asserted(void)
 {
     handle_netsio();
+    flush_tx();
     return _motor_asserted;
 }
 
@@ -665,6 +946,7 @@ void NetSioPort::set_proceed(bool level)
     Debug_print(level ? "_" : "-");
     last_level = new_level;
 
+    flush_tx();
     wait_for_credit(1);
     uint8_t cmd = level ? NETSIO_PROCEED_ON : NETSIO_PROCEED_OFF;
     write_sock(&cmd, 1);
@@ -683,6 +965,7 @@ void NetSioPort::set_interrupt(bool level)
     Debug_print(level ? "\\" : "/");
     last_level = new_level;
 
+    flush_tx();
     wait_for_credit(1);
     uint8_t cmd = level ? NETSIO_INTERRUPT_ON : NETSIO_INTERRUPT_OFF;
     write_sock(&cmd, 1);
@@ -695,6 +978,7 @@ void NetSioPort::bus_idle(uint16_t ms)
     cmd[1] = ms & 0xff;
     cmd[2] = (ms >> 8) & 0xff;
 
+    flush_tx();
     wait_for_credit(1);
     write_sock(cmd, sizeof(cmd));
 }
@@ -712,6 +996,7 @@ int NetSioPort::read(void)
         Debug_println("NetSIO read() - TIMEOUT");
         return -1;
     }
+    std::lock_guard<std::mutex> lock(_mutex);
     return rxbuffer_get();
 }
 
@@ -723,35 +1008,34 @@ size_t NetSioPort::read(uint8_t *buffer, size_t length)
     if (!_initialized)
         return 0;
 
+    std::unique_lock<std::mutex> lock(_mutex);
     if (_sync_request_num >= 0 && _sync_write_size >= 0)
     {
+        lock.unlock();
         // handle pending sync request
         // send late ACK byte
         send_sync_response(NETSIO_ACK_SYNC, _sync_ack_byte, _sync_write_size);
         // no delay here, emulator is not running
         // 850 us pre-ACK delay will be added by netsio.atdevice
     }
+    else
+        lock.unlock();
 
-    int result;
-    int rxbytes;
-    for (rxbytes=0; rxbytes<length;)
+    size_t rxbytes = 0;
+    while (rxbytes < length)
     {
-        result = read();
-        // Debug_printf("read: %d\n", result);
-        if (result < 0)
+        if (!wait_for_data(500))
         {
+            Debug_println("NetSIO read() - TIMEOUT");
             break;
         }
-        else
-        {
-            buffer[rxbytes++] = (uint8_t)result;
-        }
 
-        if (rxbytes == length)
-        {
-            // done
-            break;
-        }
+        // take all that is there
+        lock.lock();
+        int b;
+        while (rxbytes < length && (b = rxbuffer_get()) >= 0)
+            buffer[rxbytes++] = (uint8_t)b;
+        lock.unlock();
     }
     return rxbytes;
 }
@@ -759,15 +1043,19 @@ size_t NetSioPort::read(uint8_t *buffer, size_t length)
 /* write single byte via NetSIO */
 ssize_t NetSioPort::write(uint8_t c)
 {
-    uint8_t txbuf[2];
-
     if (!_initialized)
         return 0;
 
-    if (_sync_request_num >= 0)
+    std::unique_lock<std::mutex> lock(_mutex);
+    int sync_request_num = _sync_request_num;
+    int sync_write_size = _sync_write_size;
+    lock.unlock();
+
+    if (sync_request_num >= 0)
     {
-        // handle pending sync request
-        if (_sync_write_size < 0)
+        // handle pending sync request, after the data bytes before it
+        flush_tx();
+        if (sync_write_size < 0)
         {
             // SYNC RESPONSE
             // send byte (should be ACK/NAK) bundled in sync response
@@ -783,43 +1071,33 @@ ssize_t NetSioPort::write(uint8_t c)
     }
 
 
-    // DATA BYTE
+    // DATA BYTE, held until flush_tx()
 
-    if (!wait_for_credit(1))
-        return 0;
+    _txbuf[_txsize++] = c;
+    if (_txsize == sizeof(_txbuf))
+        flush_tx();
 
-    // send byte as usually
-    txbuf[0] = NETSIO_DATA_BYTE; // byte command
-    txbuf[1] = c;                // value
-    ssize_t result = write_sock(txbuf, sizeof(txbuf));
-
-    return (result > 0) ? 1 : 0; // amount of data bytes written
+    return 1; // amount of data bytes written
 }
 
 ssize_t NetSioPort::write(const uint8_t *buffer, size_t size)
 {
-    int result;
-    int to_send;
-    int txbytes = 0;
-    uint8_t txbuf[513];
+    size_t txbytes = 0;
 
     if (!_initialized)
         return 0;
 
+    // held until flush_tx()
     while (txbytes < size)
     {
-        // send block
-        to_send = ((size-txbytes) > sizeof(txbuf)-1) ? sizeof(txbuf)-1 : (size-txbytes);
-        txbuf[0] = NETSIO_DATA_BLOCK;
-        memcpy(txbuf+1, buffer+txbytes, to_send);
-        // ? calculate credit based on amount of data ?
-        if (!wait_for_credit(1))
-            break;
-        result = write_sock(txbuf, to_send+1);
-        if (result > 0)
-            txbytes += result-1;
-        else if (result < 0)
-            break;
+        size_t len = size - txbytes;
+        if (len > sizeof(_txbuf) - _txsize)
+            len = sizeof(_txbuf) - _txsize;
+        memcpy(_txbuf + _txsize, buffer + txbytes, len);
+        _txsize += len;
+        txbytes += len;
+        if (_txsize == sizeof(_txbuf))
+            flush_tx();
     }
     return txbytes;
 }
@@ -843,12 +1121,14 @@ const char* NetSioPort::get_host(int &port)
 
 void NetSioPort::set_sync_ack_byte(int ack_byte)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     _sync_ack_byte = ack_byte;
     _sync_write_size = 0;
 }
 
 void NetSioPort::set_sync_write_size(int write_size)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     _sync_write_size = write_size;
 }
 
@@ -856,8 +1136,11 @@ ssize_t NetSioPort::send_sync_response(uint8_t response_type, uint8_t ack_byte,
 {
     uint8_t txbuf[6];
 
+    flush_tx();
+
     // SYNC RESPONSE
     // send byte (should be ACK/NAK) bundled in sync response
+    std::unique_lock<std::mutex> lock(_mutex);
     txbuf[0] = NETSIO_SYNC_RESPONSE;
     txbuf[1] = (uint8_t)_sync_request_num;
     txbuf[2] = response_type;
@@ -867,6 +1150,7 @@ ssize_t NetSioPort::send_sync_response(uint8_t response_type, uint8_t ack_byte,
     // clear sync request
     _sync_request_num = -1;
     _sync_write_size = -1;
+    lock.unlock();
 
     wait_for_credit(1);
     ssize_t result = write_sock(txbuf, sizeof(txbuf));
@@ -875,7 +1159,11 @@ ssize_t NetSioPort::send_sync_response(uint8_t response_type, uint8_t ack_byte,
 
 void NetSioPort::send_empty_sync()
 {
-    if (_sync_request_num >= 0)
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool pending = (_sync_request_num >= 0);
+    lock.unlock();
+
+    if (pending)
         send_sync_response(NETSIO_EMPTY_SYNC);
 }
 
@@ -2,9 +2,26 @@
 #define NETSIO_H
 
 #include <sys/time.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "sioport.h"
 #include "fnDNS.h"
 
+#define NETSIO_TX_BLOCK     512 // data bytes per DATA_BLOCK datagram
+#define NETSIO_TX_DATAGRAMS 4   // DATA_BLOCKs held before they are sent
+#define NETSIO_RX_DATAGRAM  514 // must be able to hold whole netsio datagram, i.e. >= rxbuffer_len+2 defined in netsio.atdevice
+#define NETSIO_RX_BATCH     16  // datagrams taken per recvmmsg() call
+
+/*
+ * Datagrams are received by a thread of their own (epoll and recvmmsg on Linux,
+ * select elsewhere) which updates the port state below under _mutex. The bus
+ * side never reads the socket, it waits on _rx_cv.
+ * Data bytes written by the bus are held and go out together as few
+ * DATA_BLOCK datagrams as possible (sendmmsg on Linux) when the bus reads,
+ * flushes, changes a line, answers a sync request or polls for the next event.
+ */
 class NetSioPort : public SioPort
 {
 private:
@@ -16,14 +33,18 @@ private:
     uint32_t _baud_peer;
     int _fd;
     bool _initialized;
-    bool _command_asserted;
-    bool _motor_asserted;
+    std::atomic<bool> _command_asserted;
+    std::atomic<bool> _motor_asserted;
+    std::atomic<bool> _command_latched; // COMMAND_ON not seen by command_asserted() yet
 
     uint8_t _rxbuf[1024];
     int _rxhead;
     int _rxtail;
     bool _rxfull;
 
+    uint8_t _txbuf[NETSIO_TX_BLOCK * NETSIO_TX_DATAGRAMS]; // data bytes not sent yet
+    size_t _txsize;
+
     int _sync_request_num;  // 0..255 sync request sequence number, -1 if sync is not requested
     uint8_t _sync_ack_byte; // ACK byte to send with sync response
     int _sync_write_size;   // 0 .. no SIO write (from computer), > 0 .. expected bytes written
@@ -31,25 +52,44 @@ private:
     // serial port error counter
     int _errcount;
     uint64_t _resume_time;
-    uint64_t _alive_time;    // when last message was received
+    std::atomic<uint64_t> _alive_time; // when last message was received
     uint64_t _alive_request; // when last ALIVE request was sent
+    std::atomic<bool> _cold_reset;     // reboot requested by the emulator
     // flow control
     int _credit;
+    uint32_t _credit_updates; // CREDIT_UPDATE messages received, credit given back only if none came since
+    uint32_t _connection;     // counts end() calls, a wait that saw a reconnect must not send held data
+
+    // receiver thread
+    std::thread _rx_thread;
+    std::atomic<bool> _rx_running;
+    int _wake_fd;           // eventfd to stop the receiver (Linux)
+    std::mutex _mutex;      // guards rx buffer, credit, sync request and _rx_events
+    std::condition_variable _rx_cv;
+    uint32_t _rx_events;    // messages handled by the receiver
+    uint32_t _polled_events;
 
 protected:
     void suspend(int ms=5000);
     bool resume_test();
     bool keep_alive();
 
-    int handle_netsio();
+    bool handle_netsio();
+    void handle_message(const uint8_t *rxbuf, int received);
+    void start_receiver();
+    void stop_receiver();
+    void receiver();
     static timeval timeval_from_ms(const uint32_t millis);
 
     bool wait_sock_readable(uint32_t timeout_ms);
     bool wait_for_data(uint32_t timeout_ms);
-    bool wait_for_credit(int needed);
+    int wait_for_credit(int needed, int wanted=0, uint32_t *updates=nullptr);
+    void give_back_credit(int unused, uint32_t updates);
 
     bool wait_sock_writable(uint32_t timeout_ms);
     ssize_t write_sock(const uint8_t *buffer, size_t size, uint32_t timeout_ms=500);
+    size_t send_blocks(const uint8_t *data, size_t size, int count);
+    void flush_tx();
 
     bool rxbuffer_empty();
     bool rxbuffer_put(uint8_t b);
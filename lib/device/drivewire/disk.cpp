@@ -65,6 +65,7 @@ mediatype_t drivewireDisk::mount(fnFile *f, const char *filename, uint32_t disks
     
 void drivewireDisk::unmount()
 {
+    flush();
 }
 
 bool drivewireDisk::read(uint32_t lsn, uint8_t *buf)
@@ -92,6 +93,15 @@ bool drivewireDisk::write(uint32_t lsn, uint8_t *buf)
     return r;
 }
 
+// Write out sectors the media is holding back
+bool drivewireDisk::flush()
+{
+    if (!_media)
+        return false;
+
+    return _media->flush();
+}
+
 void drivewireDisk::get_media_buffer(uint8_t **p_buffer, uint16_t *p_blk_size)
 {
     if (_media)
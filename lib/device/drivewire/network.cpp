@@ -47,8 +47,8 @@ void onTimer(void *info)
  */
 drivewireNetwork::drivewireNetwork()
 {
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -315,11 +315,10 @@ void drivewireNetwork::read()
     read_channel(num_bytes);
 
     // And set response buffer.
-    response += *receiveBuffer;
+    response.append(receiveBuffer->data(), receiveBuffer->size());
  
-    // Remove from receive buffer and shrink.
-    receiveBuffer->erase(0, num_bytes);
-    receiveBuffer->shrink_to_fit();
+    // Remove from receive buffer.
+    receiveBuffer->consume(num_bytes);
 }
 
 /**
@@ -1257,7 +1256,7 @@ void drivewireNetwork::json_query()
 
     // don't copy past first nul char in tmp
     auto null_pos = std::find(tmp.begin(), tmp.end(), 0);
-    *receiveBuffer += std::string(tmp.begin(), null_pos);
+    receiveBuffer->append((const char *)tmp.data(), null_pos - tmp.begin());
 
     for (int i=0;i<in_string.length();i++)
         Debug_printf("%02X ",in_string[i]);
@@ -33,8 +33,8 @@
  */
 H89Network::H89Network()
 {
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -223,7 +223,7 @@ void H89Network::write()
     // H89_recv_buffer(response, num_bytes);
     // H89_send_ack();
 
-    // *transmitBuffer += string((char *)response, num_bytes);
+    // transmitBuffer->append((char *)response, num_bytes);
     // err = write_channel(num_bytes);
 
     // H89_send_complete();
@@ -260,7 +260,7 @@ void H89Network::read()
 
     // H89_send_buffer((uint8_t *)receiveBuffer->data(), num_bytes);
     // H89_flush();
-    // receiveBuffer->erase(0, num_bytes);
+    // receiveBuffer->consume(num_bytes);
 
     // Debug_printf("H89Network::read sent %u bytes\n", num_bytes);
 
@@ -385,7 +385,7 @@ void H89Network::H89_set_json_query()
     // json_bytes_remaining = json.readValueLen();
     // tmp = (uint8_t *)malloc(json.readValueLen());
     // json.readValue(tmp,json_bytes_remaining);
-    // *receiveBuffer += string((const char *)tmp,json_bytes_remaining);
+    // receiveBuffer->append((const char *)tmp, json_bytes_remaining);
     // free(tmp);
 
     // Debug_printf("Query set to %s\n",inp);
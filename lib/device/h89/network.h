@@ -124,12 +124,12 @@ private:
     /**
      * The Receive buffer for this N: device
      */
-    std::string *receiveBuffer = nullptr;
+    NetworkBuffer *receiveBuffer = nullptr;
 
     /**
      * The transmit buffer for this N: device
      */
-    std::string *transmitBuffer = nullptr;
+    NetworkBuffer *transmitBuffer = nullptr;
 
     /**
      * The special buffer for this N: device
@@ -235,8 +235,8 @@ void iecNetwork::iec_reopen_load()
         if ((!ns.connected) || ns.error == 136) // EOF
             eoi = true;
 
-        IEC.sendBytes(channel_data.receiveBuffer, true);
-        channel_data.receiveBuffer.erase(0, blockSize);
+        IEC.sendBytes(channel_data.receiveBuffer.data(), channel_data.receiveBuffer.size(), true);
+        channel_data.receiveBuffer.consume(blockSize);
     }
 
     iecStatus.error = NETWORK_ERROR_END_OF_FILE;
@@ -281,7 +281,7 @@ void iecNetwork::iec_reopen_save()
 
     // force incoming data from HOST to fixed ascii
     // Debug_printv("[1] DATA: >%s< [%s]", channel_data.transmitBuffer.c_str(), mstr::toHex(channel_data.transmitBuffer).c_str());
-    clean_transform_petscii_to_ascii(channel_data.transmitBuffer);
+    clean_transform_petscii_to_ascii(channel_data.transmitBuffer.str());
     // Debug_printv("[2] DATA: >%s< [%s]", transmitBuffer[commanddata.channel]->c_str(), mstr::toHex(channel_data.transmitBuffer).c_str());
 
     Debug_printf("Received %u bytes. Transmitting.\r\n", channel_data.transmitBuffer.length());
@@ -346,14 +346,13 @@ void iecNetwork::iec_reopen_channel_listen()
 
     // force incoming data from HOST to fixed ascii
     // Debug_printv("[1] DATA: >%s< [%s]", channel_data.transmitBuffer.c_str(), mstr::toHex(channel_data.transmitBuffer).c_str());
-    clean_transform_petscii_to_ascii(channel_data.transmitBuffer);
+    clean_transform_petscii_to_ascii(channel_data.transmitBuffer.str());
     // Debug_printv("[2] DATA: >%s< [%s]", channel_data.transmitBuffer.c_str(), mstr::toHex(channel_data.transmitBuffer).c_str());
 
     Debug_printf("Received %u bytes. Transmitting.\r\n", channel_data.transmitBuffer.length());
 
     channel_data.protocol->write(channel_data.transmitBuffer.length());
-    channel_data.transmitBuffer.clear();
-    channel_data.transmitBuffer.shrink_to_fit();
+    channel_data.transmitBuffer.release();
 }
 
 void iecNetwork::iec_reopen_channel_talk()
@@ -390,7 +389,8 @@ void iecNetwork::iec_reopen_channel_talk()
 
     // ALWAYS translate the data to PETSCII towards the host. Translation mode needs rewriting.
     util_devicespec_fix_9b((uint8_t *) channel_data.receiveBuffer.data(), channel_data.receiveBuffer.length());
-    channel_data.receiveBuffer = mstr::toPETSCII2(channel_data.receiveBuffer);
+    channel_data.receiveBuffer = mstr::toPETSCII2(channel_data.receiveBuffer.str());
+    channel_data.receiveBuffer.mark();
 
     // Debug_printv("TALK: sending data to host: >%s< [%s]", receiveBuffer[commanddata.channel]->c_str(), mstr::toHex(*receiveBuffer[commanddata.channel]).c_str());
     do
@@ -411,7 +411,7 @@ void iecNetwork::iec_reopen_channel_talk()
 
 #if 0
         if ( !(IEC.flags & ATN_ASSERTED) )
-            channel_data.receiveBuffer.erase(0, 1);
+            channel_data.receiveBuffer.consume(1);
 #endif
 
     } while( /*!(IEC.flags & ATN_ASSERTED) &&*/ !set_eoi );
@@ -543,7 +543,7 @@ void iecNetwork::query_json()
     size_t len = channel_data.json->readValueLen();
     std::vector<uint8_t> buffer(len);
     channel_data.json->readValue(buffer.data(), buffer.size());
-    channel_data.receiveBuffer += std::string(buffer.begin(), buffer.end());
+    channel_data.receiveBuffer.append((const char *)buffer.data(), buffer.size());
 
     snprintf(reply, 80, "query set to %s", s.c_str());
     iecStatus.error = NETWORK_ERROR_SUCCESS;
@@ -585,7 +585,7 @@ void iecNetwork::parse_bite()
     //mstr::replaceAll(*receiveBuffer[channel], ":", "\":\"");
     //mstr::replaceAll(*receiveBuffer[channel], "\r", "\"\r\"");
     //mstr::replaceAll(*receiveBuffer[channel], "\"", "\"\"");
-    mstr::replaceAll(channel_data.receiveBuffer, "\"", "");
+    mstr::replaceAll(channel_data.receiveBuffer.str(), "\"", "");
 
     // break up receiveBuffer[channel] into bites less than bite_size bytes
     std::string bites = "\"";
@@ -605,13 +605,13 @@ void iecNetwork::parse_bite()
             len = bite_size;
 
         // Don't make extra bites!
-        end = channel_data.receiveBuffer.find('\r', start);
+        end = channel_data.receiveBuffer.str().find('\r', start);
         if ( end == std::string::npos )
             end = start + len; // None found so set end
 
         // Take a bite
         Debug_printv("start[%d] end[%d] len[%d] bite_size[%d]", start, end, len, bite_size);
-        std::string bite = channel_data.receiveBuffer.substr(start, len);
+        std::string bite = channel_data.receiveBuffer.str().substr(start, len);
         bites += bite;
         Debug_printv("bite[%s]", bite.c_str());
 
@@ -625,6 +625,7 @@ void iecNetwork::parse_bite()
     //bites += "\"";
     //Debug_printv("[%s]", bites.c_str());
     channel_data.receiveBuffer = bites;
+    channel_data.receiveBuffer.mark();
 }
 
 void iecNetwork::set_translation_mode()
@@ -144,6 +144,15 @@ void IRAM_ATTR iwmDisk2::change_track(int indicator)
   // and where the track data is located so it can convert it
   if (((MediaTypeWOZ *)_disk)->trackmap(track_pos) != 255)
   {
+    // tracks are loaded on demand. The ISR can't read the SD card, so it
+    // spins a blank track until the bus task has loaded this one.
+    if (!((MediaTypeWOZ *)_disk)->track_ready(track_pos))
+    {
+      if (indicator)
+        track_pending = true;
+      else
+        ((MediaTypeWOZ *)_disk)->load_track(track_pos);
+    }
     diskii_xface.copy_track(
         ((MediaTypeWOZ *)_disk)->get_track(track_pos),
         ((MediaTypeWOZ *)_disk)->track_len(track_pos),
@@ -161,6 +170,15 @@ void IRAM_ATTR iwmDisk2::change_track(int indicator)
   // Since the empty track has no data, and therefore no length, using a fake length of 51,200 bits (6400 bytes) works very well.
 }
 
+void iwmDisk2::load_pending_track()
+{
+  track_pending = false;
+  if (!device_active)
+    return;
+  ((MediaTypeWOZ *)_disk)->load_track(track_pos);
+  change_track(0);
+}
+
 bool iwmDisk2::write_sector(int track, int sector, uint8_t* buffer)
 {
   return _disk->write_sector(track, sector, buffer);
@@ -26,6 +26,7 @@ protected:
     int track_pos;
     int old_pos;
     uint8_t oldphases;
+    volatile bool track_pending = false; // head is on a track that still has to be loaded
 
 public:
     iwmDisk2();
@@ -37,6 +38,8 @@ public:
     bool phases_valid(uint8_t phases);
     bool move_head();
     void change_track(int indicator);
+    bool is_track_pending() { return track_pending; };
+    void load_pending_track();
     void disableD2() { 
         enabledD2 = false;
 #ifndef DEV_RELAY_SLIP
@@ -651,7 +651,7 @@ bool iwmNetwork::read_channel(unsigned short num_bytes, iwm_decoded_cmd_t cmd)
     else // everything ok
     {
         memcpy(data_buffer, current_network_data.receiveBuffer.data(), data_len);
-        current_network_data.receiveBuffer.erase(0, data_len);
+        current_network_data.receiveBuffer.consume(data_len);
     }
     return false;
 }
@@ -714,7 +714,7 @@ void iwmNetwork::net_write()
 {
     auto& current_network_data = network_data_map[current_network_unit];
     // TODO: Handle errors.
-    current_network_data.transmitBuffer += string((char *)data_buffer, data_len);
+    current_network_data.transmitBuffer.append((char *)data_buffer, data_len);
     write_channel(data_len);
 }
 
@@ -740,7 +740,7 @@ void iwmNetwork::iwm_write(iwm_decoded_cmd_t cmd)
         iwm_return_ioerror();
     else
     {
-        current_network_data.transmitBuffer += string((char *)data_buffer, num_bytes);
+        current_network_data.transmitBuffer.append((char *)data_buffer, num_bytes);
         if (write_channel(num_bytes))
         {
             send_reply_packet(SP_ERR_IOERROR);
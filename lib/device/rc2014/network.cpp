@@ -37,8 +37,8 @@ rc2014Network::rc2014Network()
     status_response[2] = 0x04; // 1024 bytes
     status_response[3] = 0x00; // Character device
 
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -227,7 +227,7 @@ void rc2014Network::write()
     rc2014_recv_buffer(response, num_bytes);
     rc2014_send_ack();
 
-    *transmitBuffer += string((char *)response, num_bytes);
+    transmitBuffer->append((char *)response, num_bytes);
     err = write_channel(num_bytes);
 
     rc2014_send_complete();
@@ -264,7 +264,7 @@ void rc2014Network::read()
 
     rc2014_send_buffer((uint8_t *)receiveBuffer->data(), num_bytes);
     rc2014_flush();
-    receiveBuffer->erase(0, num_bytes);
+    receiveBuffer->consume(num_bytes);
 
     Debug_printf("rc2014Network::read sent %u bytes\n", num_bytes);
 
@@ -388,7 +388,7 @@ void rc2014Network::rc2014_set_json_query()
     json_bytes_remaining = json.readValueLen();
     tmp = (uint8_t *)malloc(json.readValueLen());
     json.readValue(tmp,json_bytes_remaining);
-    *receiveBuffer += string((const char *)tmp,json_bytes_remaining);
+    receiveBuffer->append((const char *)tmp, json_bytes_remaining);
     free(tmp);
 
     Debug_printf("Query set to %s\n",inp);
@@ -47,8 +47,8 @@ void onTimer(void *info)
  */
 rs232Network::rs232Network()
 {
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -232,7 +232,7 @@ void rs232Network::rs232_read()
 
     // And send off to the computer
     bus_to_computer((uint8_t *)receiveBuffer->data(), num_bytes, err);
-    receiveBuffer->erase(0, num_bytes);
+    receiveBuffer->consume(num_bytes);
 }
 
 /**
@@ -304,7 +304,7 @@ void rs232Network::rs232_write()
 
     // Get the data from the Atari
     bus_to_peripheral(newData, num_bytes);
-    *transmitBuffer += string((char *)newData, num_bytes);
+    transmitBuffer->append((char *)newData, num_bytes);
     free(newData);
 
     // Do the channel write
@@ -1035,7 +1035,7 @@ void rs232Network::rs232_set_json_query()
     json_bytes_remaining = json.readValueLen();
     tmp = (uint8_t *)malloc(json.readValueLen());
     json.readValue(tmp,json_bytes_remaining);
-    *receiveBuffer += string((const char *)tmp,json_bytes_remaining);
+    receiveBuffer->append((const char *)tmp, json_bytes_remaining);
     free(tmp);
     Debug_printf("Query set to %s\n",inp);
     rs232_complete();
@@ -306,6 +306,13 @@ void sioDisk::unmount()
     }
 }
 
+// Write out buffered sectors once the computer has stopped writing for a while
+void sioDisk::sio_idle()
+{
+    if (_disk != nullptr)
+        _disk->idle();
+}
+
 // Create blank disk
 bool sioDisk::write_blank(fnFile *f, uint16_t sectorSize, uint16_t numSectors)
 {
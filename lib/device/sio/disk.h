@@ -15,6 +15,7 @@ private:
     void sio_format();
     void sio_status() override;
     void sio_process(uint32_t commanddata, uint8_t checksum) override;
+    void sio_idle() override;
 
     void derive_percom_block(uint16_t numSectors);
     void sio_read_percom_block();
@@ -57,8 +57,8 @@ void onTimer(void *info)
  */
 sioNetwork::sioNetwork()
 {
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -296,8 +296,7 @@ void sioNetwork::sio_read()
 
     // And send off to the computer
     bus_to_computer((uint8_t *)receiveBuffer->data(), num_bytes, err);
-    receiveBuffer->erase(0, num_bytes);
-    receiveBuffer->shrink_to_fit();
+    receiveBuffer->consume(num_bytes);
 }
 
 /**
@@ -368,7 +367,7 @@ void sioNetwork::sio_write()
 
     // Get the data from the Atari
     bus_to_peripheral(newData.data(), num_bytes); // TODO test checksum
-    *transmitBuffer += string((char *)newData.data(), num_bytes);
+    transmitBuffer->append((char *)newData.data(), num_bytes);
 
     // Do the channel write
     err = sio_write_channel(num_bytes);
@@ -1209,7 +1208,7 @@ void sioNetwork::sio_set_json_query()
 
     // don't copy past first nul char in tmp
     auto null_pos = std::find(tmp.begin(), tmp.end(), 0);
-    *receiveBuffer += std::string(tmp.begin(), null_pos);
+    receiveBuffer->append((const char *)tmp.data(), null_pos - tmp.begin());
 
     Debug_printf("Query set to >%s<\r\n", inp_string.c_str());
     sio_complete();
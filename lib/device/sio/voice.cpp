@@ -67,7 +67,6 @@ void sioVoice::sio_sam()
 
     // Construct parameter buffer.
     a[n++] = (char *)("sam");
-    a[n++] = (char *)("-debug");
 
     sio_sam_parameters();
 
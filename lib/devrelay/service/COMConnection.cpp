@@ -16,34 +16,29 @@ void COMConnection::send_data(const std::vector<uint8_t> &data)
 		return;
 	}
 
-	const auto slip_data = SLIP::encode(data);
-	sp_nonblocking_write(port_, slip_data.data(), slip_data.size());
+	std::lock_guard<std::mutex> lock(send_mutex_);
+	if (send_buffer_.size() < SLIP::max_encoded_size(data.size()))
+	{
+		send_buffer_.resize(SLIP::max_encoded_size(data.size()));
+	}
+	const size_t size = SLIP::encode(data.data(), data.size(), send_buffer_.data());
+	sp_nonblocking_write(port_, send_buffer_.data(), size);
 }
 
 void COMConnection::create_read_channel()
 {
 	reading_thread_ = std::thread([self = shared_from_this()]() {
+		SLIP::Decoder decoder;
 		std::vector<uint8_t> buffer(1024);
 		while (self->is_connected())
 		{
 			int bytes_read = sp_nonblocking_read(self->port_, buffer.data(), buffer.size());
 			if (bytes_read > 0)
 			{
-				std::vector<std::vector<uint8_t>> decoded_packets = SLIP::split_into_packets(buffer.data(), buffer.size());
-				if (!decoded_packets.empty())
-				{
-					for (const auto &packet : decoded_packets)
-					{
-						if (!packet.empty())
-						{
-							{
-								std::lock_guard<std::mutex> lock(self->data_mutex_);
-								self->data_map_[packet[0]] = packet;
-							}
-							self->data_cv_.notify_all();
-						}
-					}
-				}
+				// frames can be split over reads, the decoder keeps the partial one until the rest arrives
+				decoder.feed(buffer.data(), bytes_read, [&self](const uint8_t *frame, size_t size) {
+					self->deliver(std::vector<uint8_t>(frame, frame + size));
+				});
 			}
 		}
 	});
@@ -36,6 +36,8 @@ public:
 private:
 	std::string port_name_;
 	struct sp_port *port_;
+	std::mutex send_mutex_;
+	std::vector<uint8_t> send_buffer_;
 };
 
 #endif
@@ -1,5 +1,6 @@
 #ifdef DEV_RELAY_SLIP
 
+#include <algorithm>
 #include <condition_variable>
 #include <cstdint>
 #include <mutex>
@@ -18,8 +19,10 @@ std::vector<uint8_t> Connection::wait_for_response(uint8_t request_id, std::chro
 	{
 		throw std::runtime_error("Timeout waiting for response");
 	}
-	std::vector<uint8_t> response_data = data_map_[request_id];
-	data_map_.erase(request_id);
+	const auto it = data_map_.find(request_id);
+	std::vector<uint8_t> response_data = std::move(it->second);
+	data_map_.erase(it);
+	arrival_order_.erase(std::find(arrival_order_.begin(), arrival_order_.end(), request_id));
 	return response_data;
 }
 
@@ -31,10 +34,11 @@ std::vector<uint8_t> Connection::wait_for_request()
 	while (is_connected_)
 	{
 		std::unique_lock<std::mutex> lock(data_mutex_);
-		if (data_cv_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !data_map_.empty(); }))
+		if (data_cv_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !arrival_order_.empty(); }))
 		{
-			const auto it = data_map_.begin();
-			std::vector<uint8_t> request_data = it->second;
+			const auto it = data_map_.find(arrival_order_.front());
+			arrival_order_.pop_front();
+			std::vector<uint8_t> request_data = std::move(it->second);
 			data_map_.erase(it);
 
 			return request_data;
@@ -43,6 +47,26 @@ std::vector<uint8_t> Connection::wait_for_request()
 	return std::vector<uint8_t>();
 }
 
+void Connection::deliver(std::vector<uint8_t> &&packet)
+{
+	{
+		std::lock_guard<std::mutex> lock(data_mutex_);
+		const uint8_t id = packet[0];
+		auto it = data_map_.find(id);
+		if (it == data_map_.end())
+		{
+			data_map_.emplace(id, std::move(packet));
+			arrival_order_.push_back(id);
+		}
+		else
+		{
+			// a repeated id replaces the packet nobody has taken yet, keeping its place
+			it->second = std::move(packet);
+		}
+	}
+	data_cv_.notify_all();
+}
+
 void Connection::join()
 {
 	if (reading_thread_.joinable())
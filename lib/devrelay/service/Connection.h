@@ -6,6 +6,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <mutex>
 #include <thread>
@@ -23,7 +24,9 @@ public:
 	bool is_connected() const { return is_connected_; }
 	void set_is_connected(const bool is_connected) { is_connected_ = is_connected; }
 
+	// Packets are moved out to the caller, not copied
 	std::vector<uint8_t> wait_for_response(uint8_t request_id, std::chrono::seconds timeout);
+	// Requests are handed out in the order they arrived, the requestor may have several in flight
 	std::vector<uint8_t> wait_for_request();
 
 	void join();
@@ -32,7 +35,11 @@ private:
 	std::atomic<bool> is_connected_{false};
 
 protected:
+	// Called by the reading thread for each decoded packet, takes the packet over
+	void deliver(std::vector<uint8_t> &&packet);
+
 	std::map<uint8_t, std::vector<uint8_t>> data_map_;
+	std::deque<uint8_t> arrival_order_; // ids in data_map_, oldest first
 	std::thread reading_thread_;
 
 	std::mutex data_mutex_;
@@ -288,39 +288,58 @@ std::pair<int, int> Listener::first_two_disk_devices(std::function<bool(const st
 {
 	std::pair<int, int> disk_ids = {-1, -1};
 	const auto connections = GetCommandListener().get_all_connections();
-	for (const auto &id_and_connection : connections)
+
+	// The devices of one connection are asked together, with several requests in flight
+	size_t first = 0;
+	while (first < connections.size() && disk_ids.second == -1)
 	{
-		const uint8_t unit_number = id_and_connection.first;
+		Connection *connection = connections[first].second;
+		size_t last = first;
+		while (last < connections.size() && connections[last].second == connection)
+			last++;
 
 		// DIB request to get information block. We need the device id the target understands here, not the unit_number from the ids maintained by host
-		const StatusRequest request(Requestor::next_request_number(), id_and_connection.first, 3, 0); // no network unit here
-
-		std::unique_ptr<Response> response = Requestor::send_request(request, id_and_connection.second);
+		std::vector<StatusRequest> requests;
+		std::vector<const Request *> pending;
+		requests.reserve(last - first);
+		for (size_t i = first; i < last; i++)
+		{
+			requests.emplace_back(Requestor::next_request_number(), connections[i].first, 3, 0); // no network unit here
+			pending.push_back(&requests.back());
+		}
 
-		// Cast the Response to a StatusResponse
-		StatusResponse *statusResponse = dynamic_cast<StatusResponse *>(response.get());
+		std::vector<std::unique_ptr<Response>> responses = Requestor::send_requests(pending, connection);
 
-		if (statusResponse)
+		for (size_t i = 0; i < responses.size(); i++)
 		{
-			const std::vector<uint8_t> &data = statusResponse->get_data();
+			const uint8_t unit_number = connections[first + i].first;
 
-			if (is_disk_device(data))
+			// Cast the Response to a StatusResponse
+			StatusResponse *statusResponse = dynamic_cast<StatusResponse *>(responses[i].get());
+
+			if (statusResponse)
 			{
-				// We use the unique unit_number below, as eventually we'll look these up again in the Listener's map to find a connection.
+				const std::vector<uint8_t> &data = statusResponse->get_data();
 
-				// If first disk device id is not set, set it
-				if (disk_ids.first == -1)
-				{
-					disk_ids.first = unit_number;
-				}
-				// Else if second disk device id is not set, set it and break the loop
-				else if (disk_ids.second == -1)
+				if (is_disk_device(data))
 				{
-					disk_ids.second = unit_number;
-					break;
+					// We use the unique unit_number below, as eventually we'll look these up again in the Listener's map to find a connection.
+
+					// If first disk device id is not set, set it
+					if (disk_ids.first == -1)
+					{
+						disk_ids.first = unit_number;
+					}
+					// Else if second disk device id is not set, set it and break the loop
+					else if (disk_ids.second == -1)
+					{
+						disk_ids.second = unit_number;
+						break;
+					}
 				}
 			}
 		}
+		first = last;
 	}
 
 	return disk_ids;
@@ -5,7 +5,7 @@
 #include "Requestor.h"
 #include "Listener.h"
 
-uint8_t Requestor::request_number_ = 0;
+std::atomic<uint8_t> Requestor::request_number_{0};
 
 Requestor::Requestor() = default;
 
@@ -13,7 +13,30 @@ std::unique_ptr<Response> Requestor::send_request(const Request &request, Connec
 {
 	// Send the serialized request
 	connection->send_data(request.serialize());
+	return receive_response(request, connection);
+}
+
+std::vector<std::unique_ptr<Response>> Requestor::send_requests(const std::vector<const Request *> &requests, Connection *connection, size_t window)
+{
+	std::vector<std::unique_ptr<Response>> responses;
+	responses.reserve(requests.size());
+
+	// Fill the window, then send the next request each time the oldest one is answered
+	size_t sent = 0;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		while (sent < requests.size() && sent < i + window)
+		{
+			connection->send_data(requests[sent]->serialize());
+			sent++;
+		}
+		responses.push_back(receive_response(*requests[i], connection));
+	}
+	return responses;
+}
 
+std::unique_ptr<Response> Requestor::receive_response(const Request &request, Connection *connection)
+{
 	std::vector<uint8_t> response_data;
 	try
 	{
@@ -31,9 +54,8 @@ std::unique_ptr<Response> Requestor::send_request(const Request &request, Connec
 
 uint8_t Requestor::next_request_number()
 {
-	const uint8_t current_number = request_number_;
-	request_number_ = (request_number_ + 1) % 256;
-	return current_number;
+	// wraps from 255 to 0, safe to call from several threads
+	return request_number_++;
 }
 
 #endif
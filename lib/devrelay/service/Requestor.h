@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include "Connection.h"
 #include "../types/Request.h"
@@ -13,8 +15,15 @@ public:
 
 	// The Request's deserialize function will always return a Response, e.g. StatusRequest -> StatusResponse
 	static std::unique_ptr<Response> send_request(const Request &request, Connection *connection);
+	// Sends the requests with up to window of them waiting for a response at a time.
+	// Responses are returned in request order, nullptr for any that did not get one.
+	static std::vector<std::unique_ptr<Response>> send_requests(const std::vector<const Request *> &requests, Connection *connection, size_t window = default_window);
 	static uint8_t next_request_number();
 
+	static constexpr size_t default_window = 4;
+
 private:
-	static uint8_t request_number_;
+	static std::unique_ptr<Response> receive_response(const Request &request, Connection *connection);
+
+	static std::atomic<uint8_t> request_number_;
 };
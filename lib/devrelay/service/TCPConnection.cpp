@@ -14,6 +14,7 @@
 	#define SOCKET_ERROR_CODE WSAGetLastError()
 #else
 	#include <sys/socket.h>
+	#include <sys/uio.h>
 	#include <unistd.h>
 	#include <errno.h>
 	#define CLOSE_SOCKET close
@@ -53,8 +54,75 @@ void TCPConnection::send_data(const std::vector<uint8_t> &data)
 		return;
 	}
 
-	const auto slip_data = SLIP::encode(data);
-	send(socket_, reinterpret_cast<const char *>(slip_data.data()), slip_data.size(), 0);
+	// One frame at a time, a short send must not let another thread's frame in
+	std::lock_guard<std::mutex> lock(send_mutex_);
+
+#ifndef WIN32
+	// Usually the data has few or no bytes to escape, send it where it is
+	SLIP::Segment segments[max_send_segments];
+	const size_t count = SLIP::encode_segments(data.data(), data.size(), segments, max_send_segments);
+	if (count != 0)
+	{
+		iovec iov[max_send_segments];
+		for (size_t i = 0; i < count; i++)
+		{
+			iov[i].iov_base = const_cast<uint8_t *>(segments[i].data);
+			iov[i].iov_len = segments[i].size;
+		}
+		msghdr msg = {};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+		while (msg.msg_iovlen > 0)
+		{
+			ssize_t sent = sendmsg(socket_, &msg, 0);
+			if (sent < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				LogFileOutput("Error sending on TCPConnection socket, error code: %d\n", SOCKET_ERROR_CODE);
+				return;
+			}
+			// skip what went out, the rest goes on the next call
+			while (msg.msg_iovlen > 0 && static_cast<size_t>(sent) >= msg.msg_iov->iov_len)
+			{
+				sent -= msg.msg_iov->iov_len;
+				msg.msg_iov++;
+				msg.msg_iovlen--;
+			}
+			if (msg.msg_iovlen > 0)
+			{
+				msg.msg_iov->iov_base = static_cast<uint8_t *>(msg.msg_iov->iov_base) + sent;
+				msg.msg_iov->iov_len -= sent;
+			}
+		}
+		return;
+	}
+#endif
+
+	if (send_buffer_.size() < SLIP::max_encoded_size(data.size()))
+	{
+		send_buffer_.resize(SLIP::max_encoded_size(data.size()));
+	}
+	const size_t size = SLIP::encode(data.data(), data.size(), send_buffer_.data());
+	size_t total = 0;
+	while (total < size)
+	{
+		int sent = send(socket_, reinterpret_cast<const char *>(send_buffer_.data()) + total, static_cast<int>(size - total), 0);
+		if (sent == SOCKET_ERROR)
+		{
+#ifndef WIN32
+			if (errno == EINTR)
+			{
+				continue;
+			}
+#endif
+			LogFileOutput("Error sending on TCPConnection socket, error code: %d\n", SOCKET_ERROR_CODE);
+			return;
+		}
+		total += sent;
+	}
 }
 
 void TCPConnection::create_read_channel()
@@ -63,8 +131,8 @@ void TCPConnection::create_read_channel()
 
 	// Start a new thread to listen for incoming data
 	reading_thread_ = std::thread([self = std::move(self_ptr)]() {
-		std::vector<uint8_t> complete_data;
-		std::vector<uint8_t> buffer(1024);
+		SLIP::Decoder decoder;
+		std::vector<uint8_t> buffer(4096);
 		bool is_initialising = true;
 
 		// Set a timeout on the socket
@@ -75,62 +143,38 @@ void TCPConnection::create_read_channel()
 
 		while (self->is_connected() || is_initialising)
 		{
-			int valread = 0;
-			do
+			if (is_initialising)
 			{
-				if (is_initialising)
-				{
-					is_initialising = false;
-					LogFileOutput("SmartPortOverSlip TCPConnection: connected\n");
-					self->set_is_connected(true);
-				}
-
-				valread = recv(self->get_socket(), reinterpret_cast<char *>(buffer.data()), static_cast<int>(buffer.size()), 0);
-				const int errsv = errno;
-				if (valread < 0)
-				{
-					// timeout is fine, just reloop.
-					if (errno == EAGAIN || errno == EWOULDBLOCK || errno == 0)
-					{
-						continue;
-					}
-					// otherwise it was a genuine error.
-					LogFileOutput("Error in read thread for connection, errno: %d = %s\n", errsv, strerror(errsv));
-					self->set_is_connected(false);
-				}
-				if (valread == 0)
-				{
-					// disconnected, close connection
-					LogFileOutput("TCPConnection: recv == 0, disconnecting\n");
-					self->set_is_connected(false);
-				}
-				if (valread > 0)
-				{
-					// LogFileOutput("SmartPortOverSlip TCPConnection, inserting data, valread: %d\n", valread);
-					complete_data.insert(complete_data.end(), buffer.begin(), buffer.begin() + valread);
-				}
-			} while (valread == 1024);
+				is_initialising = false;
+				LogFileOutput("SmartPortOverSlip TCPConnection: connected\n");
+				self->set_is_connected(true);
+			}
 
-			if (!complete_data.empty())
+			int valread = recv(self->get_socket(), reinterpret_cast<char *>(buffer.data()), static_cast<int>(buffer.size()), 0);
+			const int errsv = errno;
+			if (valread < 0)
 			{
-				std::vector<std::vector<uint8_t>> decoded_packets = SLIP::split_into_packets(complete_data.data(), complete_data.size());
-				// LogFileOutput("SmartPortOverSlip TCPConnection, packets decoded: %d\n", decoded_packets.size());
-
-				if (!decoded_packets.empty())
+				// timeout is fine, just reloop.
+				if (errno == EAGAIN || errno == EWOULDBLOCK || errno == 0)
 				{
-					for (const auto &packet : decoded_packets)
-					{
-						if (!packet.empty())
-						{
-							{
-								std::lock_guard<std::mutex> lock(self->data_mutex_);
-								self->data_map_[packet[0]] = packet;
-							}
-							self->data_cv_.notify_all();
-						}
-					}
+					continue;
 				}
-				complete_data.clear();
+				// otherwise it was a genuine error.
+				LogFileOutput("Error in read thread for connection, errno: %d = %s\n", errsv, strerror(errsv));
+				self->set_is_connected(false);
+			}
+			if (valread == 0)
+			{
+				// disconnected, close connection
+				LogFileOutput("TCPConnection: recv == 0, disconnecting\n");
+				self->set_is_connected(false);
+			}
+			if (valread > 0)
+			{
+				// frames can be split over reads, the decoder keeps the partial one until the rest arrives
+				decoder.feed(buffer.data(), valread, [&self](const uint8_t *frame, size_t size) {
+					self->deliver(std::vector<uint8_t>(frame, frame + size));
+				});
 			}
 		}
 		GetCommandListener().connection_closed(self.get());
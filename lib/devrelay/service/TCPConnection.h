@@ -3,7 +3,9 @@
 #if defined(DEV_RELAY_SLIP) && defined(SLIP_PROTOCOL_NET)
 
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "Connection.h"
 
@@ -20,6 +22,11 @@ public:
 	void set_socket(int socket) { this->socket_ = socket; }
 
 private:
+	// escapes beyond this many are sent from send_buffer_ instead
+	static constexpr size_t max_send_segments = 16;
+
 	int socket_;
+	std::mutex send_mutex_;
+	std::vector<uint8_t> send_buffer_;
 };
 #endif
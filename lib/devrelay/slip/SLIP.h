@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstring>
 #include <stdint.h>
 #include <vector>
 
@@ -12,6 +13,143 @@
 class SLIP
 {
 public:
+	// A piece of an encoded frame, either a run of the caller's data or a constant
+	struct Segment
+	{
+		const uint8_t *data;
+		size_t size;
+	};
+
+	// Length of the run of bytes at the start of data that need no escaping.
+	// Looks at 8 bytes at a time, a word holding END or ESC is finished byte by byte.
+	static inline size_t plain_run(const uint8_t *data, size_t size)
+	{
+		const uint64_t ones = 0x0101010101010101ULL;
+		const uint64_t highs = 0x8080808080808080ULL;
+		size_t n = 0;
+		for (; n + 8 <= size; n += 8)
+		{
+			uint64_t v;
+			memcpy(&v, data + n, 8);
+			uint64_t end = v ^ (ones * SLIP_END);
+			uint64_t esc = v ^ (ones * SLIP_ESC);
+			if (((end - ones) & ~end & highs) | ((esc - ones) & ~esc & highs))
+				break;
+		}
+		while (n < size && data[n] != SLIP_END && data[n] != SLIP_ESC)
+			n++;
+		return n;
+	}
+
+	// Largest frame encode() can produce for size bytes of data
+	static constexpr size_t max_encoded_size(size_t size) { return 2 * size + 2; }
+
+	// Encodes one frame into out, which must hold max_encoded_size(size) bytes. Returns the frame length.
+	static size_t encode(const uint8_t *data, size_t size, uint8_t *out);
+
+	// Describes one frame as segments for writev/sendmsg without copying the data.
+	// Returns the number of segments used, or 0 if the frame needs more than max_segments.
+	static size_t encode_segments(const uint8_t *data, size_t size, Segment *segments, size_t max_segments);
+
+	// Decodes frames from a byte stream as it arrives, in reads of any size.
+	// Bytes are copied once from the read buffer into the frame buffer, which is reused from frame to frame.
+	class Decoder
+	{
+	public:
+		explicit Decoder(size_t max_frame = 65536) : max_frame_(max_frame) {}
+
+		// Calls on_frame(const uint8_t *frame, size_t size) for each complete frame in data. The frame is only
+		// valid during the call. Empty frames, frames with a bad escape and frames over max_frame are dropped.
+		template <typename F>
+		void feed(const uint8_t *data, size_t size, F &&on_frame)
+		{
+			const uint8_t *p = data;
+			const uint8_t *end = data + size;
+			while (p < end)
+			{
+				if (!synced_)
+				{
+					// nothing before the first END belongs to a frame
+					while (p < end && *p != SLIP_END)
+						p++;
+					if (p == end)
+						break;
+					synced_ = true;
+					p++;
+					continue;
+				}
+
+				if (escaped_)
+				{
+					escaped_ = false;
+					if (*p == SLIP_ESC_END)
+						append(SLIP_END);
+					else if (*p == SLIP_ESC_ESC)
+						append(SLIP_ESC);
+					else
+					{
+						// bad escape drops the frame, an END here still ends it
+						dropping_ = true;
+						if (*p == SLIP_END)
+							continue;
+					}
+					p++;
+					continue;
+				}
+
+				// copy the run up to the next special byte in one go
+				const uint8_t *run = p;
+				p += plain_run(p, end - p);
+				append(run, p - run);
+				if (p == end)
+					break;
+
+				if (*p == SLIP_ESC)
+				{
+					escaped_ = true;
+				}
+				else
+				{
+					if (!dropping_ && !frame_.empty())
+						on_frame(frame_.data(), frame_.size());
+					frame_.clear();
+					dropping_ = false;
+				}
+				p++;
+			}
+		}
+
+		// Forgets any partial frame, the next byte after an END starts a frame again
+		void reset()
+		{
+			frame_.clear();
+			synced_ = false;
+			escaped_ = false;
+			dropping_ = false;
+		}
+
+	private:
+		void append(uint8_t byte) { append(&byte, 1); }
+		void append(const uint8_t *bytes, size_t count)
+		{
+			if (dropping_ || count == 0)
+				return;
+			if (frame_.size() + count > max_frame_)
+			{
+				frame_.clear();
+				dropping_ = true;
+				return;
+			}
+			frame_.insert(frame_.end(), bytes, bytes + count);
+		}
+
+		size_t max_frame_;
+		std::vector<uint8_t> frame_;
+		bool synced_ = false;
+		bool escaped_ = false;
+		bool dropping_ = false;
+	};
+
 	// these encode and decode exactly one SLIP frame, and expect it to be sane.
 	static std::vector<uint8_t> encode(const std::vector<uint8_t> &data);
 	static std::vector<uint8_t> decode(const std::vector<uint8_t> &data);
@@ -6,8 +6,11 @@
  */
 
 #include "fnjson.h"
+#include "fnjsonstream.h"
 
 #include <string.h>
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <math.h>
 #include <iomanip>
@@ -70,7 +73,9 @@ void FNJSON::setQueryParam(uint8_t qp)
 }
 
 /**
- * Set read query string
+ * Set read query string. Queries set before parse() tell the parser which
+ * parts of the document to build, and are resolved once the document is in.
+ * Any other query later on has the whole tree built from the kept text.
  */
 void FNJSON::setReadQuery(const std::string &queryString, uint8_t queryParam)
 {
@@ -79,6 +84,10 @@ void FNJSON::setReadQuery(const std::string &queryString, uint8_t queryParam)
 #endif
     _queryString = queryString;
     _queryParam = queryParam;
+    if (_json == nullptr)
+        _parseQueries.push_back(queryString);
+    else if (!_treeQueries.empty() && std::find(_treeQueries.begin(), _treeQueries.end(), queryString) == _treeQueries.end())
+        parseFull();
     _item = resolveQuery();
     json_bytes_remaining = readValueLen();
 }
@@ -297,7 +306,9 @@ int FNJSON::readValueLen()
 }
 
 /**
- * Parse data from protocol
+ * Parse data from protocol. With queries set before, the document is parsed
+ * while it is received and only the values they select are built, the text
+ * is kept for other queries. Without, the text is collected and parsed whole.
  */
 bool FNJSON::parse()
 {
@@ -305,17 +316,29 @@ bool FNJSON::parse()
 
     if (_json != nullptr)
     {
-        // delete and set to null. we only set a new _json value if the parsebuffer is not empty
+        // delete and set to null. we only set a new _json value if a document was received
         cJSON_Delete(_json);
         _json = nullptr;
     }
+    _item = nullptr;
+    json_bytes_remaining = 0;
+    _treeQueries.clear();
+    std::vector<std::string> queries;
+    queries.swap(_parseQueries);
 
     if (_protocol == nullptr)
     {
         // Debug_printf("FNJSON::parse() - NULL protocol.\r\n");
         return false;
     }
+
+    // an empty query selects the whole document, the stream parser would only be slower
+    bool prune = !queries.empty() && std::find(queries.begin(), queries.end(), std::string()) == queries.end();
+    std::unique_ptr<FNJSONStreamParser> parser;
+    if (prune)
+        parser.reset(new FNJSONStreamParser(queries));
     _parseBuffer.clear();
+
     _protocol->status(&ns);
 #ifdef VERBOSE_PROTOCOL
     Debug_printf("json parse, initial status: ns.rxBW: %d, ns.conn: %d, ns.err: %d\r\n", ns.rxBytesWaiting, ns.connected, ns.error);
@@ -331,33 +354,68 @@ bool FNJSON::parse()
         if (ns.rxBytesWaiting > 0)
         {
             _protocol->read(ns.rxBytesWaiting);
-            _parseBuffer += *_protocol->receiveBuffer;
+            _parseBuffer.append(_protocol->receiveBuffer->data(), _protocol->receiveBuffer->size());
+            // keep draining after a syntax error, the connection has to be read to the end either way
+            if (parser)
+                parser->feed(_protocol->receiveBuffer->data(), _protocol->receiveBuffer->size());
             _protocol->receiveBuffer->clear();
         }
-        _protocol->status(&ns);
 #ifdef ESP_PLATFORM
-        vTaskDelay(10);
+        else
+            vTaskDelay(10);
 #endif
+        _protocol->status(&ns);
     }
 
-    // Debug_printf("S: %s\r\n", _parseBuffer.c_str());
-    // only try and parse the buffer if it has data. Empty response doesn't need parsing.
-    if (!_parseBuffer.empty())
+    // An empty response gives no document
+    if (parser)
     {
-        _json = cJSON_Parse(_parseBuffer.c_str());
+        _json = parser->finish();
+        if (_json != nullptr)
+            _treeQueries = queries;
     }
+    else if (!_parseBuffer.empty())
+        _json = cJSON_Parse(_parseBuffer.c_str());
 
     if (_json == nullptr)
     {
 #ifdef VERBOSE_PROTOCOL
-        Debug_printf("FNJSON::parse() - Could not parse JSON, parseBuffer length: %d\r\n", _parseBuffer.size());
+        Debug_printf("FNJSON::parse() - Could not parse JSON, length: %u\r\n", (unsigned)_parseBuffer.size());
 #endif
+        std::string().swap(_parseBuffer);
         return false;
     }
 
+    // the complete tree needs no text
+    if (_treeQueries.empty())
+        std::string().swap(_parseBuffer);
+
+    // Query given up front, have its value ready to read
+    if (!queries.empty())
+    {
+        _item = resolveQuery();
+        json_bytes_remaining = readValueLen();
+    }
+
     return true;
 }
 
+/**
+ * Replace the pruned tree with the whole document, for a query it was not
+ * pruned to
+ */
+void FNJSON::parseFull()
+{
+    cJSON *json = cJSON_Parse(_parseBuffer.c_str());
+    if (json != nullptr)
+    {
+        cJSON_Delete(_json);
+        _json = json;
+    }
+    _treeQueries.clear();
+    std::string().swap(_parseBuffer);
+}
+
 bool FNJSON::status(NetworkStatus *s)
 {
     // Debug_printf("FNJSON::status(%u) %s\r\n", json_bytes_remaining, getValue(_item).c_str());
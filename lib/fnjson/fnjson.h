@@ -12,6 +12,9 @@
 #include <cJSON_Utils.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+
 #include "../network-protocol/Protocol.h"
 
 class FNJSON
@@ -41,7 +44,11 @@ private:
     uint8_t _queryParam = 0;
     std::string lineEnding;
     std::string getValue(cJSON *item);
-    std::string _parseBuffer;
+    std::vector<std::string> _parseQueries; // queries set before parse(), the tree is pruned to them
+    std::vector<std::string> _treeQueries;  // queries the current tree was pruned to, empty if it is complete
+    std::string _parseBuffer;               // document text, kept while the tree is pruned
+    void parseFull();
+
 };
 
 #endif /* JSON_H */
\ No newline at end of file
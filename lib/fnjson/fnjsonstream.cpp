@@ -0,0 +1,577 @@
+/**
+ * Incremental JSON parser for #FujiNet
+ */
+
+#include "fnjsonstream.h"
+
+#include <cctype>
+#include <cstdlib>
+
+#define JSON_STREAM_MAX_POINTERS 255
+
+/**
+ * Split the JSON pointers into tokens. A pointer without tokens (empty or
+ * not starting with '/') selects the whole document, as in
+ * cJSONUtils_GetPointer(), and turns pruning off.
+ */
+FNJSONStreamParser::FNJSONStreamParser(const std::vector<std::string> &pointers)
+{
+    if (pointers.size() > JSON_STREAM_MAX_POINTERS)
+        return;
+
+    for (const std::string &pointer : pointers)
+    {
+        if (pointer.empty() || pointer[0] != '/')
+        {
+            _pointers.clear();
+            return;
+        }
+
+        std::vector<pointer_token> tokens;
+        size_t pos = 0;
+        while (pos < pointer.size() && pointer[pos] == '/')
+        {
+            size_t end = pointer.find('/', pos + 1);
+            if (end == std::string::npos)
+                end = pointer.size();
+
+            pointer_token t;
+            t.isKey = true;
+            for (size_t i = pos + 1; i < end; i++)
+            {
+                if (pointer[i] != '~')
+                    t.key += pointer[i];
+                else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+                    t.key += pointer[++i] == '0' ? '~' : '/';
+                else
+                    t.isKey = false;
+            }
+
+            // Same rules as cJSON: digits only, no leading zeros, empty is 0
+            const std::string digits = pointer.substr(pos + 1, end - pos - 1);
+            t.index = (digits.size() > 1 && digits[0] == '0') ? -1 : 0;
+            for (char c : digits)
+            {
+                if (t.index < 0 || !isdigit((unsigned char)c) || t.index > 100000000)
+                {
+                    t.index = -1;
+                    break;
+                }
+                t.index = t.index * 10 + (c - '0');
+            }
+
+            tokens.push_back(t);
+            pos = end;
+        }
+        _pointers.push_back(tokens);
+    }
+}
+
+FNJSONStreamParser::~FNJSONStreamParser()
+{
+    if (_root != nullptr)
+        cJSON_Delete(_root);
+}
+
+bool FNJSONStreamParser::fail()
+{
+    _state = STATE_ERROR;
+    return false;
+}
+
+bool FNJSONStreamParser::feed(const char *buf, size_t len)
+{
+    _bytes += len;
+
+    size_t i = 0;
+    while (i < len)
+    {
+        if (_state == STATE_STRING)
+        {
+            // Copy plain runs of a string in one go
+            size_t end = i;
+            while (end < len && buf[end] != '"' && buf[end] != '\\')
+                end++;
+            if (end > i)
+            {
+                if (_surrogate != 0)
+                    return fail();
+                if (_collect)
+                    _token.append(buf + i, end - i);
+                i = end;
+                continue;
+            }
+        }
+        else if (_state == STATE_DONE)
+            return true; // trailing data is ignored, as by cJSON_Parse()
+        else if (_state == STATE_ERROR)
+            return false;
+
+        if (step((uint8_t)buf[i]))
+            i++;
+    }
+
+    return _state != STATE_ERROR;
+}
+
+cJSON *FNJSONStreamParser::finish()
+{
+    // A number is only terminated by the next character
+    if (_state == STATE_NUMBER && _stack.empty())
+        endNumber();
+
+    if (_state != STATE_DONE)
+        return nullptr;
+
+    cJSON *root = _root;
+    _root = nullptr;
+    return root;
+}
+
+/**
+ * Process one character. Returns false if the character ended the current
+ * token and has to be looked at again.
+ */
+bool FNJSONStreamParser::step(uint8_t c)
+{
+    switch (_state)
+    {
+    case STATE_BOM:
+        if (c == (uint8_t)"\xEF\xBB\xBF"[_literalPos])
+        {
+            if (++_literalPos == 3)
+                _state = STATE_VALUE;
+            return true;
+        }
+        if (_literalPos != 0)
+            return fail();
+        _state = STATE_VALUE;
+        return false;
+
+    case STATE_VALUE:
+        if (c > ' ')
+            beginValue(c);
+        return true;
+
+    case STATE_ARRAY_FIRST:
+        if (c <= ' ')
+            return true;
+        if (c == ']')
+        {
+            endContainer(c);
+            return true;
+        }
+        _state = STATE_VALUE;
+        return false;
+
+    case STATE_OBJECT_FIRST:
+    case STATE_OBJECT_KEY:
+        if (c <= ' ')
+            return true;
+        if (c == '"')
+            beginString(true);
+        else if (c == '}' && _state == STATE_OBJECT_FIRST)
+            endContainer(c);
+        else
+            fail();
+        return true;
+
+    case STATE_COLON:
+        if (c == ':')
+            _state = STATE_VALUE;
+        else if (c > ' ')
+            fail();
+        return true;
+
+    case STATE_AFTER_VALUE:
+        if (c <= ' ')
+            return true;
+        if (c == ',')
+        {
+            parse_frame &f = _stack.back();
+            if (f.isArray)
+            {
+                f.index++;
+                _state = STATE_VALUE;
+            }
+            else
+                _state = STATE_OBJECT_KEY;
+        }
+        else if (c == ']' || c == '}')
+            endContainer(c);
+        else
+            fail();
+        return true;
+
+    case STATE_STRING:
+        if (c == '\\')
+            _state = STATE_STRING_ESCAPE;
+        else if (_surrogate != 0)
+            fail(); // high surrogate without the low half
+        else if (c == '"')
+            endString();
+        else if (_collect)
+            _token += (char)c;
+        return true;
+
+    case STATE_STRING_ESCAPE:
+        if (c == 'u')
+        {
+            _unicode = 0;
+            _unicodeDigits = 0;
+            _state = STATE_STRING_UNICODE;
+            return true;
+        }
+        if (_surrogate != 0)
+            return fail();
+        switch (c)
+        {
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        default:
+            return fail();
+        }
+        if (_collect)
+            _token += (char)c;
+        _state = STATE_STRING;
+        return true;
+
+    case STATE_STRING_UNICODE:
+        if (!isxdigit(c))
+            return fail();
+        _unicode = (_unicode << 4) | (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+        if (++_unicodeDigits == 4)
+            endUnicode();
+        return true;
+
+    case STATE_NUMBER:
+        if (isdigit(c) || c == '+' || c == '-' || c == '.' || c == 'e' || c == 'E')
+        {
+            if (_collect)
+                _token += (char)c;
+            return true;
+        }
+        endNumber();
+        return false;
+
+    case STATE_LITERAL:
+        if (c != (uint8_t)_literal[_literalPos])
+            return fail();
+        if (_literal[++_literalPos] == '\0')
+            endLiteral();
+        return true;
+
+    case STATE_DONE:
+    case STATE_ERROR:
+        break;
+    }
+
+    return true;
+}
+
+/**
+ * Work out whether the value starting now is kept, using the key or index
+ * it has in the enclosing container.
+ */
+void FNJSONStreamParser::selectChild()
+{
+    _modePointers.clear();
+
+    if (_stack.empty())
+    {
+        if (_pointers.empty())
+            _mode = MODE_KEEP;
+        else
+        {
+            _mode = MODE_PARTIAL;
+            for (size_t p = 0; p < _pointers.size(); p++)
+                _modePointers.push_back(p);
+        }
+        return;
+    }
+
+    const parse_frame &f = _stack.back();
+    if (f.mode != MODE_PARTIAL)
+    {
+        _mode = f.mode;
+        return;
+    }
+
+    size_t depth = _stack.size() - 1;
+    _mode = MODE_SKIP;
+    for (uint8_t p : f.pointers)
+    {
+        const pointer_token &t = _pointers[p][depth];
+        bool match;
+        if (f.isArray)
+            match = t.index >= 0 && (size_t)t.index == f.index;
+        else
+        {
+            // Keys are matched case insensitive, like the queries do
+            match = t.isKey && t.key.size() == _key.size();
+            for (size_t i = 0; match && i < _key.size(); i++)
+                match = tolower((unsigned char)t.key[i]) == tolower((unsigned char)_key[i]);
+        }
+        if (!match)
+            continue;
+
+        if (depth + 1 == _pointers[p].size())
+        {
+            _mode = MODE_KEEP;
+            _modePointers.clear();
+            return;
+        }
+        _mode = MODE_PARTIAL;
+        _modePointers.push_back(p);
+    }
+}
+
+void FNJSONStreamParser::beginValue(uint8_t c)
+{
+    selectChild();
+
+    switch (c)
+    {
+    case '{':
+        pushContainer(false);
+        break;
+    case '[':
+        pushContainer(true);
+        break;
+    case '"':
+        beginScalar();
+        beginString(false);
+        break;
+    case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        beginScalar();
+        _token.clear();
+        if (_collect)
+            _token += (char)c;
+        _state = STATE_NUMBER;
+        break;
+    case 't':
+    case 'f':
+    case 'n':
+        beginScalar();
+        _literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+        _literalPos = 1;
+        _state = STATE_LITERAL;
+        break;
+    default:
+        fail();
+    }
+}
+
+/**
+ * A pointer cannot continue into a scalar, but a scalar on a selected path
+ * is kept all the same: with duplicate keys the first one is the one a
+ * query finds, so it has to hide a later container of the same name.
+ */
+void FNJSONStreamParser::beginScalar()
+{
+    if (_mode == MODE_PARTIAL)
+        _mode = MODE_KEEP;
+    _collect = _mode == MODE_KEEP;
+}
+
+void FNJSONStreamParser::beginString(bool isKey)
+{
+    _isKey = isKey;
+    if (isKey)
+        _collect = _stack.back().mode != MODE_SKIP;
+    _token.clear();
+    _surrogate = 0;
+    _state = STATE_STRING;
+}
+
+void FNJSONStreamParser::pushContainer(bool isArray)
+{
+    if (_stack.size() >= CJSON_NESTING_LIMIT)
+    {
+        fail();
+        return;
+    }
+
+    cJSON *node = nullptr;
+    if (_mode != MODE_SKIP)
+    {
+        node = isArray ? cJSON_CreateArray() : cJSON_CreateObject();
+        if (node == nullptr || !attach(node))
+        {
+            fail();
+            return;
+        }
+    }
+
+    _stack.push_back({node, _mode, isArray, 0, 0, {}});
+    if (_mode == MODE_PARTIAL)
+        _stack.back().pointers = _modePointers;
+    _state = isArray ? STATE_ARRAY_FIRST : STATE_OBJECT_FIRST;
+}
+
+void FNJSONStreamParser::endContainer(uint8_t c)
+{
+    if (_stack.back().isArray != (c == ']'))
+    {
+        fail();
+        return;
+    }
+    _stack.pop_back();
+    afterValue();
+}
+
+/**
+ * Link a new node into the enclosing container. Array elements that were
+ * skipped in front of it are filled with nulls to keep the indexes.
+ */
+bool FNJSONStreamParser::attach(cJSON *item)
+{
+    if (_stack.empty())
+    {
+        _root = item;
+        return true;
+    }
+
+    parse_frame &f = _stack.back();
+    bool ok = true;
+    if (f.isArray)
+    {
+        for (; ok && f.count < f.index; f.count++)
+        {
+            cJSON *placeholder = cJSON_CreateNull();
+            ok = placeholder != nullptr && cJSON_AddItemToArray(f.node, placeholder);
+        }
+        ok = ok && cJSON_AddItemToArray(f.node, item);
+        f.count++;
+    }
+    else
+        ok = cJSON_AddItemToObject(f.node, _key.c_str(), item);
+
+    if (!ok)
+        cJSON_Delete(item);
+    return ok;
+}
+
+void FNJSONStreamParser::attachScalar(cJSON *item)
+{
+    if (item == nullptr || !attach(item))
+        fail();
+    else
+        afterValue();
+}
+
+void FNJSONStreamParser::afterValue()
+{
+    _state = _stack.empty() ? STATE_DONE : STATE_AFTER_VALUE;
+}
+
+void FNJSONStreamParser::endString()
+{
+    if (_isKey)
+    {
+        if (_collect)
+            _key.swap(_token);
+        _state = STATE_COLON;
+    }
+    else if (_collect)
+        attachScalar(cJSON_CreateString(_token.c_str()));
+    else
+        afterValue();
+}
+
+void FNJSONStreamParser::endNumber()
+{
+    if (!_collect)
+    {
+        afterValue();
+        return;
+    }
+
+    char *end = nullptr;
+    double number = strtod(_token.c_str(), &end);
+    if (end != _token.c_str() + _token.size())
+        fail();
+    else
+        attachScalar(cJSON_CreateNumber(number));
+}
+
+void FNJSONStreamParser::endLiteral()
+{
+    if (!_collect)
+        afterValue();
+    else if (_literal[0] == 't')
+        attachScalar(cJSON_CreateTrue());
+    else if (_literal[0] == 'f')
+        attachScalar(cJSON_CreateFalse());
+    else
+        attachScalar(cJSON_CreateNull());
+}
+
+/**
+ * Four hex digits of a \u escape are complete. Surrogate pairs have to
+ * follow each other directly, as cJSON requires.
+ */
+void FNJSONStreamParser::endUnicode()
+{
+    uint32_t cp = _unicode;
+    _state = STATE_STRING;
+
+    if (cp >= 0xDC00 && cp <= 0xDFFF)
+    {
+        if (_surrogate == 0)
+        {
+            fail();
+            return;
+        }
+        cp = 0x10000 + ((_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+        _surrogate = 0;
+    }
+    else if (_surrogate != 0)
+    {
+        fail();
+        return;
+    }
+    else if (cp >= 0xD800 && cp <= 0xDBFF)
+    {
+        _surrogate = cp;
+        return;
+    }
+
+    appendCodepoint(cp);
+}
+
+void FNJSONStreamParser::appendCodepoint(uint32_t cp)
+{
+    if (!_collect)
+        return;
+
+    if (cp < 0x80)
+        _token += (char)cp;
+    else if (cp < 0x800)
+    {
+        _token += (char)(0xC0 | (cp >> 6));
+        _token += (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        _token += (char)(0xE0 | (cp >> 12));
+        _token += (char)(0x80 | ((cp >> 6) & 0x3F));
+        _token += (char)(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        _token += (char)(0xF0 | (cp >> 18));
+        _token += (char)(0x80 | ((cp >> 12) & 0x3F));
+        _token += (char)(0x80 | ((cp >> 6) & 0x3F));
+        _token += (char)(0x80 | (cp & 0x3F));
+    }
+}
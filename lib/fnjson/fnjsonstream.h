@@ -0,0 +1,131 @@
+/**
+ * Incremental JSON parser for #FujiNet
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <cJSON.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Builds a cJSON tree from a document that arrives in chunks, so the raw
+ * text never has to be held in memory.
+ *
+ * The parser can be given a list of JSON pointers (the same syntax as the
+ * channel queries, see cJSONUtils_GetPointer()). Only the values they select,
+ * and the containers and scalars along their path, are materialized; everything
+ * else is scanned and dropped. Array elements in front of a kept index are stored as
+ * nulls, so the pointers resolve to the same values as on the full document.
+ * Without pointers the complete document is built, like cJSON_Parse().
+ */
+class FNJSONStreamParser
+{
+public:
+    FNJSONStreamParser(const std::vector<std::string> &pointers = {});
+    ~FNJSONStreamParser();
+
+    /**
+     * Parse the next chunk of the document. Returns false once the data
+     * turned out not to be valid JSON; later chunks are ignored.
+     */
+    bool feed(const char *buf, size_t len);
+
+    /**
+     * End of document. Returns the (pruned) tree, which the caller has to
+     * cJSON_Delete(), or nullptr if the document was empty or invalid.
+     */
+    cJSON *finish();
+
+    /**
+     * Number of bytes fed so far
+     */
+    size_t bytes() const { return _bytes; }
+
+private:
+    enum parse_mode : uint8_t
+    {
+        MODE_KEEP,    // value is selected, build it completely
+        MODE_PARTIAL, // container on the way to a selected value
+        MODE_SKIP     // not selected, scan only
+    };
+
+    enum parse_state : uint8_t
+    {
+        STATE_BOM,
+        STATE_VALUE,
+        STATE_ARRAY_FIRST,
+        STATE_OBJECT_FIRST,
+        STATE_OBJECT_KEY,
+        STATE_COLON,
+        STATE_AFTER_VALUE,
+        STATE_STRING,
+        STATE_STRING_ESCAPE,
+        STATE_STRING_UNICODE,
+        STATE_NUMBER,
+        STATE_LITERAL,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    struct pointer_token
+    {
+        std::string key; // unescaped (~0, ~1) key
+        bool isKey;      // false if the token has an invalid escape
+        long index;      // array index, -1 if the token is not one
+    };
+
+    struct parse_frame
+    {
+        cJSON *node;     // nullptr while skipping
+        parse_mode mode;
+        bool isArray;
+        size_t index;    // index of the current element
+        size_t count;    // elements stored so far
+        std::vector<uint8_t> pointers; // pointers still matching below this container
+    };
+
+    std::vector<std::vector<pointer_token>> _pointers;
+    std::vector<parse_frame> _stack;
+    cJSON *_root = nullptr;
+    parse_state _state = STATE_BOM;
+    size_t _bytes = 0;
+
+    // Value being started
+    parse_mode _mode = MODE_KEEP;
+    std::vector<uint8_t> _modePointers;
+
+    // Scalar / key being collected
+    std::string _token;
+    std::string _key;
+    bool _isKey = false;
+    bool _collect = false;
+    const char *_literal = nullptr;
+    uint8_t _literalPos = 0;
+    uint32_t _unicode = 0;
+    uint8_t _unicodeDigits = 0;
+    uint32_t _surrogate = 0;
+
+    bool step(uint8_t c);
+    void selectChild();
+    void beginValue(uint8_t c);
+    void beginScalar();
+    void beginString(bool isKey);
+    void pushContainer(bool isArray);
+    void endContainer(uint8_t c);
+    bool attach(cJSON *item);
+    void attachScalar(cJSON *item);
+    void afterValue();
+    void endString();
+    void endNumber();
+    void endLiteral();
+    void endUnicode();
+    void appendCodepoint(uint32_t cp);
+    bool fail();
+};
+
+#endif /* JSON_STREAM_H */
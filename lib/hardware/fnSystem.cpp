@@ -773,6 +773,28 @@ FILE *SystemManager::make_tempfile(char *result_filename)
         return make_tempfile(&fsFlash, result_filename);
 }
 
+/*
+ Free space on the file system make_tempfile() uses. UINT64_MAX if the file
+ system doesn't report its size (FujiNet-PC)
+*/
+uint64_t SystemManager::tempfile_free_bytes()
+{
+    uint64_t total, used;
+    if (fnSDFAT.running())
+    {
+        total = fnSDFAT.total_bytes();
+        used = fnSDFAT.used_bytes();
+    }
+    else
+    {
+        total = fsFlash.total_bytes();
+        used = fsFlash.used_bytes();
+    }
+    if (total == 0)
+        return UINT64_MAX;
+    return total > used ? total - used : 0;
+}
+
 // Copy file from source filesystem/filename to destination filesystem/name using optional buffer_hint for buffer size
 size_t SystemManager::copy_file(FileSystem *source_fs, const char *source_filename, FileSystem *dest_fs, const char *dest_filename, size_t buffer_hint)
 {
@@ -155,6 +155,7 @@ public:
     FILE *make_tempfile(char *result_filename);
     void delete_tempfile(FileSystem *fs, const char *filename);
     void delete_tempfile(const char *filename);
+    uint64_t tempfile_free_bytes();
 
     int load_firmware(const char *filename, uint8_t *buffer);
     void debug_print_tasks();
@@ -23,6 +23,25 @@
 #include <string>
 #include <cstdint>
 
+#if !defined(ESP_PLATFORM) && !defined(_WIN32)
+#include <memory>
+#include <thread>
+
+// What woke UARTManager::poll(), and how long it took to see line changes and wake() calls
+struct uart_poll_stats
+{
+    uint32_t polls = 0;
+    uint32_t timeouts = 0;
+    uint32_t data = 0;          // new bytes arrived
+    uint32_t line = 0;          // command line changed
+    uint32_t events = 0;        // wake() called
+    uint32_t latency_count = 0; // line changes and wake() calls timed
+    uint64_t latency_us_sum = 0;
+    uint32_t latency_us_max = 0;
+};
+
+struct uart_events;
+#endif
 
 class UARTManager
 {
@@ -45,6 +64,11 @@ private:
     int _command_tiocm;
     int _proceed_tiocm;
     int _fd;
+    int _epoll_fd = -1;     // port and event fd (Linux)
+    int _last_command = 0;  // command line level at the last poll(), when sampled
+    std::shared_ptr<uart_events> _events; // shared with the line watcher thread
+    std::thread _watcher;                 // TIOCMIWAIT line watcher, joined by end()
+    uart_poll_stats _poll_stats;
 #endif
     // serial port error counter
     int _errcount;
@@ -54,6 +78,9 @@ private:
     bool _initialized = false; // is UART ready?
 
     size_t _print_number(unsigned long n, uint8_t base);
+#if !defined(ESP_PLATFORM) && !defined(_WIN32)
+    void note_latency(uint64_t us);
+#endif
 
 public:
 #ifdef ESP_PLATFORM
@@ -104,6 +131,10 @@ public:
     void begin(int baud);
     void end();
     bool poll(int ms);
+#if !defined(_WIN32)
+    void wake(); // wakes poll() from another thread
+    const uart_poll_stats &get_poll_stats() { return _poll_stats; }
+#endif
 
     void suspend(int sec=5);
     bool initialized() { return _initialized; }
@@ -15,9 +15,18 @@
 #include <termios.h> // Contains POSIX terminal control definitions
 #include <sys/ioctl.h> // TIOCM_DSR etc.
 #include <fcntl.h> // Contains file controls like O_RDWR
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #if defined(__linux__)
 #include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include "linux_termios2.h"
 #elif defined(__APPLE__)
 #include <IOKit/serial/ioss.h>
@@ -33,6 +42,100 @@
 #define UART_DEFAULT_BAUD 19200
 
 
+static uint64_t uart_now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Wakes poll() for anything other than received data: command line changes seen
+   by the line watcher thread and wake() calls. Shared with the watcher.
+*/
+struct uart_events
+{
+    int read_fd = -1;   // readable while signalled
+    int write_fd = -1;  // same as read_fd for an eventfd
+    std::atomic<bool> stop{false};
+    std::atomic<bool> watching{false};  // watcher is running, TIOCMIWAIT works on the port
+    std::atomic<uint64_t> line_us{0};   // when the watcher saw a change, 0 if none pending
+    std::atomic<uint64_t> wake_us{0};   // when wake() was called, 0 if none pending
+
+    ~uart_events()
+    {
+        if (write_fd >= 0 && write_fd != read_fd)
+            close(write_fd);
+        if (read_fd >= 0)
+            close(read_fd);
+    }
+
+    bool open()
+    {
+#if defined(__linux__)
+        read_fd = write_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        return read_fd >= 0;
+#else
+        int fds[2];
+        if (pipe(fds) < 0)
+            return false;
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        read_fd = fds[0];
+        write_fd = fds[1];
+        return true;
+#endif
+    }
+
+    // stamp keeps the time of the first signal not yet seen by poll()
+    void signal(std::atomic<uint64_t> &stamp)
+    {
+        uint64_t none = 0;
+        stamp.compare_exchange_strong(none, uart_now_us());
+        uint64_t one = 1;
+        if (::write(write_fd, &one, write_fd == read_fd ? sizeof(one) : 1) < 0 && errno != EAGAIN)
+            Debug_printf("UART event write error %d: %s\n", errno, strerror(errno));
+    }
+
+    void drain()
+    {
+        uint64_t buf[8];
+        while (::read(read_fd, buf, sizeof(buf)) > 0)
+            ;
+    }
+};
+
+#ifdef TIOCMIWAIT
+// Only there to make a blocked TIOCMIWAIT return with EINTR
+#define UART_WATCH_SIGNAL SIGUSR2
+
+static void uart_watch_signal(int)
+{
+}
+
+/* Waits for command line changes with TIOCMIWAIT on its own copy of the port fd.
+   Closing the port doesn't end the ioctl, end() sets stop and sends the thread
+   UART_WATCH_SIGNAL until it is gone. Ports without TIOCMIWAIT (pty, some USB
+   adapters) fail at once and poll() goes back to sampling the line.
+*/
+static void uart_watch_lines(std::shared_ptr<uart_events> events, int fd, int mask)
+{
+    while (!events->stop)
+    {
+        if (ioctl(fd, TIOCMIWAIT, mask) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            Debug_printf("UART TIOCMIWAIT not available (%d: %s), sampling command line\n", errno, strerror(errno));
+            break;
+        }
+        if (events->stop)
+            break;
+        events->signal(events->line_us);
+    }
+    events->watching = false;
+    close(fd);
+}
+#endif
+
 // Constructor
 // UARTManager::UARTManager(uart_port_t uart_num) : _uart_num(uart_num), _uart_q(NULL) {}
 UARTManager::UARTManager() :
@@ -44,6 +147,36 @@ UARTManager::UARTManager() :
 
 void UARTManager::end()
 {
+    if (_events)
+    {
+        _events->stop = true;
+#ifdef TIOCMIWAIT
+        // again until it is out, the signal may come just before the thread enters the ioctl
+        while (_watcher.joinable() && _events->watching)
+        {
+            pthread_kill(_watcher.native_handle(), UART_WATCH_SIGNAL);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+#endif
+        _events.reset();
+    }
+    if (_watcher.joinable())
+        _watcher.join();
+#if defined(__linux__)
+    if (_epoll_fd >= 0)
+    {
+        close(_epoll_fd);
+        _epoll_fd = -1;
+    }
+#endif
+    if (_poll_stats.polls != 0)
+    {
+        Debug_printf("UART poll: %u polls, %u data, %u line, %u wake, %u timeout, latency avg %llu max %u us\n",
+            _poll_stats.polls, _poll_stats.data, _poll_stats.line, _poll_stats.events, _poll_stats.timeouts,
+            (unsigned long long)(_poll_stats.latency_count ? _poll_stats.latency_us_sum / _poll_stats.latency_count : 0),
+            _poll_stats.latency_us_max);
+        _poll_stats = uart_poll_stats();
+    }
     if (_fd >= 0)
     {
         close(_fd);
@@ -53,11 +186,102 @@ void UARTManager::end()
     _initialized = false;
 }
 
+/* Waits up to ms for new input data, a command line change or a wake() call.
+   Returns true if any of them happened. Data that was already there and not
+   read does not count again.
+*/
 bool UARTManager::poll(int ms)
 {
-    // TODO check serial port command link and input data
-    fnSystem.delay_microseconds(500); // TODO use ms parameter
-    return false;
+    if (!_initialized || !_events)
+    {
+        fnSystem.delay(ms);
+        return false;
+    }
+
+    bool data = false;
+    bool signalled = false;
+    int n;
+#if defined(__linux__)
+    // port is edge triggered, it reports bytes that arrived since the last wait
+    epoll_event ev[2];
+    n = epoll_wait(_epoll_fd, ev, 2, ms);
+    for (int i = 0; i < n; i++)
+    {
+        if (ev[i].data.fd == _fd)
+            data = true;
+        else
+            signalled = true;
+    }
+#else
+    // poll() is level triggered, unread data would wake it at once, so wait on
+    // the port only while it is empty and compare the count afterwards
+    int pending = available();
+    struct pollfd fds[2] = {{_events->read_fd, POLLIN, 0}, {_fd, POLLIN, 0}};
+    n = ::poll(fds, pending > 0 ? 1 : 2, ms);
+    signalled = n > 0 && (fds[0].revents & POLLIN);
+    data = n > 0 && available() > pending;
+#endif
+    if (n < 0 && errno != EINTR)
+        Debug_printf("UART poll() error %d: %s\n", errno, strerror(errno));
+
+    bool line = false;
+    bool woken = false;
+    if (signalled)
+    {
+        _events->drain();
+        uint64_t now = uart_now_us();
+        uint64_t t;
+        if ((t = _events->line_us.exchange(0)) != 0)
+        {
+            line = true;
+            note_latency(now - t);
+        }
+        if ((t = _events->wake_us.exchange(0)) != 0)
+        {
+            woken = true;
+            note_latency(now - t);
+        }
+    }
+
+    // without the watcher look at the command line every time
+    if (_command_tiocm != 0 && !_events->watching)
+    {
+        int status;
+        if (ioctl(_fd, TIOCMGET, &status) == 0 && (status & _command_tiocm) != _last_command)
+        {
+            _last_command = status & _command_tiocm;
+            line = true;
+        }
+    }
+
+    _poll_stats.polls++;
+    if (n == 0)
+        _poll_stats.timeouts++;
+    if (data)
+        _poll_stats.data++;
+    if (line)
+        _poll_stats.line++;
+    if (woken)
+        _poll_stats.events++;
+    return data || line || woken;
+}
+
+void UARTManager::note_latency(uint64_t us)
+{
+    _poll_stats.latency_count++;
+    _poll_stats.latency_us_sum += us;
+    if (us > _poll_stats.latency_us_max)
+        _poll_stats.latency_us_max = (uint32_t)us;
+}
+
+/* Makes a poll() in progress, or the next one, return true. Safe from other
+   threads while the port is open.
+*/
+void UARTManager::wake()
+{
+    std::shared_ptr<uart_events> events = _events;
+    if (events)
+        events->signal(events->wake_us);
 }
 
 void UARTManager::set_port(const char *device, int command_pin, int proceed_pin)
@@ -222,6 +446,53 @@ void UARTManager::begin(int baud)
     // Set initialized.
     _initialized = true;
     set_baudrate(baud);
+
+    // poll() waits on the port and the event fd, without them it falls back to sleeping
+    _events = std::make_shared<uart_events>();
+    if (!_events->open())
+    {
+        Debug_printf("UART event fd error %d: %s\n", errno, strerror(errno));
+        _events.reset();
+        return;
+    }
+#if defined(__linux__)
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = _fd;
+    bool ok = _epoll_fd >= 0 && epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _fd, &ev) == 0;
+    ev.events = EPOLLIN;
+    ev.data.fd = _events->read_fd;
+    ok = ok && epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _events->read_fd, &ev) == 0;
+    if (!ok)
+    {
+        Debug_printf("UART epoll error %d: %s\n", errno, strerror(errno));
+        if (_epoll_fd >= 0)
+            close(_epoll_fd);
+        _epoll_fd = -1;
+        _events.reset();
+        return;
+    }
+#endif
+
+    int status;
+    _last_command = (ioctl(_fd, TIOCMGET, &status) == 0) ? (status & _command_tiocm) : 0;
+#ifdef TIOCMIWAIT
+    if (_command_tiocm != 0)
+    {
+        // no SA_RESTART, the ioctl must come back with EINTR
+        struct sigaction sa = {};
+        sa.sa_handler = uart_watch_signal;
+        sigaction(UART_WATCH_SIGNAL, &sa, nullptr);
+
+        int fd = dup(_fd);
+        if (fd >= 0)
+        {
+            _events->watching = true;
+            _watcher = std::thread(uart_watch_lines, _events, fd, _command_tiocm);
+        }
+    }
+#endif
 }
 
 
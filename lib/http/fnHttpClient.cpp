@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "fnHttpClient.h"
+#include "httpConnectionPool.h"
 
 #include "../../include/debug.h"
 
@@ -20,6 +21,17 @@ using namespace fujinet;
 
 const char *webdav_depths[] = {"0", "1", "infinity"};
 
+// Request headers set by the methods below, removed before a handle is pooled
+static const char *pooled_header_keys[] = {"Content-Type", "Content-Length", "Depth", "Destination", "Overwrite"};
+
+static void http_pool_close(esp_http_client_handle_t handle)
+{
+    esp_http_client_cleanup(handle);
+}
+
+// Idle keep-alive clients, each handle holds its open connection
+static HttpConnectionPool<esp_http_client_handle_t> http_pool(http_pool_close);
+
 fnHttpClient::fnHttpClient()
 {
     _buffer = (char *)malloc(DEFAULT_HTTP_BUF_SIZE);
@@ -31,7 +43,7 @@ fnHttpClient::~fnHttpClient()
     close();
 
     Debug_printv("BEFORE free heap/low: %lu/%lu", esp_get_free_heap_size(), esp_get_free_internal_heap_size());
-    if (_handle != nullptr)
+    if (_handle != nullptr && !_release_to_pool())
     {
         esp_http_client_cleanup(_handle);
     }
@@ -60,6 +72,20 @@ bool fnHttpClient::begin(const std::string &url)
     // Keep track of the auth type set
     _auth_type = cfg.auth_type;
 
+    // Take over an idle keep-alive connection to the same server if there is one
+    _handle = http_pool.acquire(http_pool_key(url.c_str()));
+    if (_handle != nullptr)
+    {
+        if (esp_http_client_set_url(_handle, url.c_str()) == ESP_OK)
+        {
+            _handle->user_data = this;
+            _handle->redirect_counter = 0;
+            _reused = true;
+            return true;
+        }
+        esp_http_client_cleanup(_handle);
+    }
+
     _handle = esp_http_client_init(&cfg);
     if (_handle == nullptr)
         return false;
@@ -237,12 +263,42 @@ void fnHttpClient::close()
     // Debug_println("::close");
     _delete_subtask_if_running();
 
-    if (_handle != nullptr)
+    // an idle keep-alive connection stays open, the destructor hands it to the pool
+    if (_handle != nullptr && !_is_reusable())
         esp_http_client_close(_handle);
 
     _stored_headers.clear();
 }
 
+// Finished the last request and the server agreed to keep the connection open
+bool fnHttpClient::_is_reusable()
+{
+    return _handle != nullptr && _transaction_done && _taskh_subtask == nullptr &&
+           _client_err == ESP_OK && _handle->state == HTTP_STATE_CONNECTED &&
+           _handle->connection_info.username == nullptr && _handle->auth_header == nullptr;
+}
+
+// Strip this client's request state from the handle and park it in the pool
+bool fnHttpClient::_release_to_pool()
+{
+    if (!_is_reusable())
+        return false;
+
+    for (const auto &key : _request_header_keys)
+        esp_http_client_delete_header(_handle, key.c_str());
+    for (const char *key : pooled_header_keys)
+        esp_http_client_delete_header(_handle, key);
+    esp_http_client_set_post_field(_handle, nullptr, 0);
+    _handle->user_data = nullptr;
+
+    // a redirect may have moved the connection to another server
+    const connection_info_t &ci = _handle->connection_info;
+    std::string url = std::string(ci.scheme) + "://" + ci.host + ":" + std::to_string(ci.port);
+    http_pool.release(http_pool_key(url.c_str()), _handle);
+    _handle = nullptr;
+    return true;
+}
+
 /*
  Typical event order:
 
@@ -260,6 +316,10 @@ esp_err_t fnHttpClient::_httpevent_handler(esp_http_client_event_t *evt)
     // Our user_data should be a pointer to our fnHttpClient object
     fnHttpClient *client = (fnHttpClient *)evt->user_data;
 
+    // pooled handle being closed, no client attached
+    if (client == nullptr)
+        return ESP_OK;
+
     switch (evt->event_id)
     {
     case HTTP_EVENT_ERROR: // This event occurs when there are any errors during execution
@@ -389,6 +449,13 @@ void fnHttpClient::_perform_subtask(void *param)
     // Debug_printf("esp_http_client_perform start\r\n");
 
     esp_err_t e = esp_http_client_perform(parent->_handle);
+    if (e != ESP_OK && parent->_reused && parent->_transaction_begin)
+    {
+        // the server dropped the pooled connection meanwhile, nothing was received, try a new one
+        esp_http_client_close(parent->_handle);
+        e = esp_http_client_perform(parent->_handle);
+    }
+    parent->_reused = false;
 #ifdef VERBOSE_HTTP
     Debug_printf("esp_http_client_perform returned %d, stack HWM %u\r\n", e, uxTaskGetStackHighWaterMark(nullptr));
 #endif
@@ -788,6 +855,7 @@ bool fnHttpClient::set_header(const char *header_key, const char *header_value)
         Debug_printf("fnHttpClient::set_header error %d\r\n", e);
         return false;
     }
+    _request_header_keys.push_back(header_key);
     return true;
 }
 
@@ -32,11 +32,13 @@ private:
     int _redirect_count = 0;
     int _max_redirects = 0;
     bool connected = false;
+    bool _reused = false; // handle came from the connection pool
     esp_http_client_auth_type_t _auth_type;
-    esp_err_t _client_err;
+    esp_err_t _client_err = ESP_OK;
 
     uint16_t _port = 80;
     header_map_t _stored_headers;
+    std::vector<std::string> _request_header_keys; // removed before the handle is pooled
 
     esp_http_client_handle_t _handle = nullptr;
 
@@ -47,6 +49,9 @@ private:
 
     void _flush_response();
 
+    bool _is_reusable();
+    bool _release_to_pool();
+
     int _perform();
     int _perform_stream(esp_http_client_method_t method, uint8_t *write_data, int write_size);
 
@@ -0,0 +1,235 @@
+/**
+ * Pool of idle HTTP keep-alive connections, shared by all HTTP clients
+ */
+
+#ifndef HTTP_CONNECTION_POOL_H
+#define HTTP_CONNECTION_POOL_H
+
+#include <cctype>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fnSystem.h"
+
+#define HTTP_POOL_MAX_PER_HOST 2     // idle connections kept per scheme+host+port
+#define HTTP_POOL_MAX_IDLE 8         // idle connections kept in total
+#define HTTP_POOL_IDLE_TIMEOUT 30000 // ms before an idle connection is closed
+#define HTTP_POOL_MAX_OPEN_PER_HOST 8 // connections open at once per scheme+host+port, in use or idle
+
+/**
+ * Pool key of a URL: "scheme://host:port", lower case, with the default port
+ * filled in. Credentials, path and query are not part of it.
+ */
+inline std::string http_pool_key(const char *url)
+{
+    std::string u(url == nullptr ? "" : url);
+    std::string scheme = "http";
+
+    size_t p = u.find("://");
+    if (p != std::string::npos)
+    {
+        scheme = u.substr(0, p);
+        u.erase(0, p + 3);
+    }
+    u = u.substr(0, u.find_first_of("/?#"));
+    p = u.rfind('@');
+    if (p != std::string::npos)
+        u.erase(0, p + 1);
+
+    // port, if any, follows the last ':' outside of an [IPv6] address
+    std::string port;
+    p = u.rfind(':');
+    if (p != std::string::npos && u.find(']', p) == std::string::npos)
+    {
+        port = u.substr(p + 1);
+        u.erase(p);
+    }
+
+    for (auto &c : scheme)
+        c = tolower(c);
+    for (auto &c : u)
+        c = tolower(c);
+    if (port.empty())
+        port = (scheme == "https" || scheme == "wss") ? "443" : "80";
+
+    return scheme + "://" + u + ":" + port;
+}
+
+/**
+ * Keeps connections that finished a request with keep-alive, so the next
+ * request to the same server skips the TCP (and TLS) handshake. CONN is the
+ * client library's connection handle, close_fn shuts one down for good.
+ *
+ * At most HTTP_POOL_MAX_PER_HOST idle connections are kept per key and
+ * HTTP_POOL_MAX_IDLE in total, the least recently used one is closed to make
+ * room. Connections idle for longer than HTTP_POOL_IDLE_TIMEOUT are closed
+ * the next time the pool is used.
+ *
+ * A client that reports the connections it opens with opened() and closed()
+ * can also ask can_open() before opening another one, which keeps the
+ * connections to a server, in use or idle, at HTTP_POOL_MAX_OPEN_PER_HOST.
+ */
+template <typename CONN>
+class HttpConnectionPool
+{
+public:
+    typedef void (*close_fn_t)(CONN conn);
+
+    HttpConnectionPool(close_fn_t close_fn) : _close(close_fn) {}
+
+    /**
+     * Take the most recently used idle connection for key.
+     * Returns nullptr if there is none.
+     */
+    CONN acquire(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        expire_locked();
+        for (size_t i = _idle.size(); i-- > 0;)
+        {
+            if (_idle[i].key == key)
+            {
+                CONN conn = _idle[i].conn;
+                _idle.erase(_idle.begin() + i);
+                _reused++;
+                return conn;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Hand back a connection that is ready for another request.
+     */
+    void release(const std::string &key, CONN conn)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        expire_locked();
+
+        size_t same_host = 0;
+        for (const auto &ic : _idle)
+            if (ic.key == key)
+                same_host++;
+
+        // make room by closing the least recently used connection(s)
+        for (size_t i = 0; i < _idle.size() && (same_host >= HTTP_POOL_MAX_PER_HOST || _idle.size() >= HTTP_POOL_MAX_IDLE);)
+        {
+            if (_idle.size() >= HTTP_POOL_MAX_IDLE || _idle[i].key == key)
+            {
+                if (_idle[i].key == key)
+                    same_host--;
+                CONN old = _idle[i].conn;
+                _idle.erase(_idle.begin() + i);
+                _close(old);
+            }
+            else
+                i++;
+        }
+
+        _idle.push_back({key, conn, fnSystem.millis()});
+    }
+
+    /**
+     * Whether another connection to key may be opened: fewer than
+     * HTTP_POOL_MAX_OPEN_PER_HOST are open to it, in use or idle.
+     */
+    bool can_open(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t same_host = 0;
+        for (const auto &oc : _open)
+            if (oc.key == key)
+                same_host++;
+        return same_host < HTTP_POOL_MAX_OPEN_PER_HOST;
+    }
+
+    /**
+     * Count a new connection to key as open until closed() is called for it.
+     */
+    void opened(const std::string &key, CONN conn)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _open.push_back({key, conn, 0});
+    }
+
+    /**
+     * Forget a connection that went away, in use or idle, e.g. closed by the server.
+     */
+    void closed(CONN conn)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _idle.size(); i++)
+        {
+            if (_idle[i].conn == conn)
+            {
+                _idle.erase(_idle.begin() + i);
+                break;
+            }
+        }
+        for (size_t i = 0; i < _open.size(); i++)
+        {
+            if (_open[i].conn == conn)
+            {
+                _open.erase(_open.begin() + i);
+                break;
+            }
+        }
+    }
+
+    /**
+     * Close all idle connections, e.g. before the program ends.
+     */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &ic : _idle)
+            _close(ic.conn);
+        _idle.clear();
+    }
+
+    size_t idle_count()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _idle.size();
+    }
+
+    unsigned long reuse_count()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _reused;
+    }
+
+private:
+    struct idle_conn
+    {
+        std::string key;
+        CONN conn;
+        uint64_t since;
+    };
+
+    std::vector<idle_conn> _idle; // least recently used first
+    std::vector<idle_conn> _open; // all connections reported by opened(), since is unused
+    close_fn_t _close;
+    std::mutex _mutex;
+    unsigned long _reused = 0;
+
+    void expire_locked()
+    {
+        uint64_t now = fnSystem.millis();
+        for (size_t i = 0; i < _idle.size();)
+        {
+            if (now - _idle[i].since > HTTP_POOL_IDLE_TIMEOUT)
+            {
+                CONN old = _idle[i].conn;
+                _idle.erase(_idle.begin() + i);
+                _close(old);
+            }
+            else
+                i++;
+        }
+    }
+};
+
+#endif /* HTTP_CONNECTION_POOL_H */
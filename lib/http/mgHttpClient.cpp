@@ -7,10 +7,12 @@
 #include <ctype.h>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 // #include <mbedtls/debug.h>
@@ -40,6 +42,7 @@
 #include "fnSystem.h"
 #include "utils.h"
 #include "mgHttpClient.h"
+#include "httpConnectionPool.h"
 
 #include "../../include/debug.h"
 
@@ -51,6 +54,53 @@
 
 const char *webdav_depths[] = {"0", "1", "infinity"};
 
+// All clients share one mongoose manager, so a connection can outlive the
+// client that opened it and wait in the pool for the next request. A poll
+// runs the event handlers of every client's connections, so the manager, its
+// connections and the client state the handlers update are only used with
+// http_mutex held.
+static std::recursive_mutex http_mutex;
+static mg_mgr *http_manager = nullptr;
+
+static mg_mgr *http_mgr()
+{
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
+    if (http_manager == nullptr)
+    {
+        http_manager = new mg_mgr();
+        mg_mgr_init(http_manager);
+    }
+    return http_manager;
+}
+
+static void http_pool_close(struct mg_connection *c)
+{
+    c->is_closing = 1;
+}
+
+static HttpConnectionPool<struct mg_connection *> http_pool(http_pool_close);
+
+// Event handler of pooled connections while they are idle
+static void http_pool_handler(struct mg_connection *c, int ev, void *ev_data)
+{
+    if (ev == MG_EV_READ)
+        c->is_closing = 1; // nothing is expected, the server is closing or confused
+    else if (ev == MG_EV_CLOSE)
+        http_pool.closed(c);
+}
+
+// Close the pooled and any other open connections and free the manager
+void mgHttpClient::shutdown()
+{
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
+    if (http_manager == nullptr)
+        return;
+    http_pool.clear();
+    mg_mgr_free(http_manager); // clients still open see their connection close
+    delete http_manager;
+    http_manager = nullptr;
+}
+
 mgHttpClient::mgHttpClient()
 {
     // Used for cert debugging:
@@ -69,12 +119,6 @@ mgHttpClient::~mgHttpClient()
         free(_buffer);
         _buffer = nullptr;
     }
-
-    if (current_message != nullptr) {
-        freeHttpMessage(current_message);
-        current_message = nullptr;
-    }
-
 }
 
 void mgHttpClient::load_system_certs() {
@@ -262,60 +306,65 @@ bool mgHttpClient::begin(std::string url)
 
     _max_redirects = 10;
 
-    _handle.reset(new mg_mgr());
+    _handle = http_mgr();
     if (_handle == nullptr)
         return false;
 
+    drop_connection();
     _url = std::move(url);
-    mg_mgr_init(_handle.get());
     return true;
 }
 
 int mgHttpClient::available()
 {
-    int result = 0;
+    if (_handle == nullptr)
+        return 0;
 
-    if (_handle != nullptr) {
-        int len = _buffer_len;
-        if (len - _buffer_total_read >= 0)
-            result = len - _buffer_total_read;
-    }
-    return result;
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
+
+    // let the body trickle in while the caller is waiting for it
+    if (_buffer_len == 0 && !_transaction_done)
+        mg_mgr_poll(http_mgr(), 0);
+
+    return _buffer_len;
 }
 
 /*
  Reads HTTP response data
  Return value is bytes stored in buffer or -1 on error
  Buffer will NOT be zero-terminated
- Return value >= 0 but less than dest_bufflen indicates end of data
+ Return value may be less than dest_bufflen, or 0, while more data is on its way;
+ the body is complete once is_transaction_done() is true and available() is 0
 */
 int mgHttpClient::read(uint8_t *dest_buffer, int dest_bufflen)
 {
     if (_handle == nullptr || dest_buffer == nullptr)
         return -1;
 
-    int bytes_left;
-    int bytes_to_copy;
-
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
     int bytes_copied = 0;
 
-    // Start by using our own buffer if there's still data there
-    // if (_buffer_pos > 0 && _buffer_pos < _buffer_len)
-    if (_buffer_len > 0 && _buffer_pos < _buffer_len)
+    // Copy out of the ring, in up to two pieces if it wraps
+    while (bytes_copied < dest_bufflen && _buffer_len > 0)
     {
-        bytes_left = _buffer_len - _buffer_pos;
-        bytes_to_copy = dest_bufflen > bytes_left ? bytes_left : dest_bufflen;
-
-        //Debug_printf("::read from buffer %d\n", bytes_to_copy);
-        memcpy(dest_buffer, _buffer + _buffer_pos, bytes_to_copy);
-        _buffer_pos += bytes_to_copy;
+        int bytes_to_copy = HTTP_BODY_BUFFER_SIZE - _buffer_pos;
+        if (bytes_to_copy > _buffer_len)
+            bytes_to_copy = _buffer_len;
+        if (bytes_to_copy > dest_bufflen - bytes_copied)
+            bytes_to_copy = dest_bufflen - bytes_copied;
+
+        memcpy(dest_buffer + bytes_copied, _buffer + _buffer_pos, bytes_to_copy);
+        _buffer_pos = (_buffer_pos + bytes_to_copy) % HTTP_BODY_BUFFER_SIZE;
+        _buffer_len -= bytes_to_copy;
         _buffer_total_read += bytes_to_copy;
-
-        bytes_copied = bytes_to_copy;
+        bytes_copied += bytes_to_copy;
     }
 
-    return bytes_copied;
+    // There is room again, move over what mongoose is holding and resume reading
+    if (_conn != nullptr && _conn->is_full)
+        pump_body(_conn);
 
+    return bytes_copied;
 }
 
 void mgHttpClient::_flush_response()
@@ -328,6 +377,19 @@ void mgHttpClient::close()
     Debug_println("mgHttpClient::close");
     _stored_headers.clear();
     _request_headers.clear();
+    drop_connection();
+}
+
+// Close the connection of an unfinished request and detach it from this client
+void mgHttpClient::drop_connection()
+{
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
+    if (_conn != nullptr)
+    {
+        _conn->is_closing = 1;
+        _conn->fn_data = nullptr;
+        _conn = nullptr;
+    }
 }
 
 void mgHttpClient::handle_connect(struct mg_connection *c)
@@ -335,8 +397,6 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
 #ifdef VERBOSE_HTTP
     Debug_printf("mgHttpClient: Connected\n");
 #endif
-    _transaction_done = false;
-
     const char *url = _url.c_str();
     struct mg_str host = mg_url_host(url);
     // If url is https://, tell client connection to use TLS
@@ -358,6 +418,17 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
         mg_tls_init(c, &opts);
     }
 
+    send_request(c);
+}
+
+// Send the request, on a new connection or one taken from the pool
+void mgHttpClient::send_request(struct mg_connection *c)
+{
+    _transaction_done = false;
+
+    const char *url = _url.c_str();
+    struct mg_str host = mg_url_host(url);
+
     // reset response status code
     _status_code = -1;
 
@@ -375,7 +446,7 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
     {
         case HTTP_GET:
         {
-            mg_printf(c, "GET %s HTTP/1.0\r\n"
+            mg_printf(c, "GET %s HTTP/1.1\r\n"
                             "Host: %.*s\r\n",
                             mg_url_uri(url), (int)host.len, host.ptr);
             // send auth header
@@ -389,10 +460,11 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
         }
         case HTTP_PUT:
         case HTTP_POST:
+        case HTTP_PROPFIND:
         {
-            mg_printf(c, "%s %s HTTP/1.0\r\n"
+            mg_printf(c, "%s %s HTTP/1.1\r\n"
                             "Host: %.*s\r\n",
-                            (_method == HTTP_PUT) ? "PUT" : "POST",
+                            (_method == HTTP_PUT) ? "PUT" : (_method == HTTP_POST) ? "POST" : "PROPFIND",
                             mg_url_uri(url), (int)host.len, host.ptr);
             // send auth header
             if (!_username.empty())
@@ -416,7 +488,7 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
         }
         case HTTP_DELETE:
         {
-            mg_printf(c, "DELETE %s HTTP/1.0\r\n"
+            mg_printf(c, "DELETE %s HTTP/1.1\r\n"
                             "Host: %.*s\r\n",
                             mg_url_uri(url), (int)host.len, host.ptr);
             // send auth header
@@ -438,64 +510,28 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
     }
 }
 
-void mgHttpClient::deepCopyHttpMessage(const struct mg_http_message *src, struct mg_http_message *dest) {
-    // First, shallow copy the entire struct to copy over the non-pointer fields
-    *dest = *src;
-
-    // Now, deep copy each mg_str field that contains a pointer
-    dest->method.ptr = util_strndup(src->method.ptr, src->method.len);
-    dest->uri.ptr = util_strndup(src->uri.ptr, src->uri.len);
-    dest->query.ptr = util_strndup(src->query.ptr, src->query.len);
-    dest->proto.ptr = util_strndup(src->proto.ptr, src->proto.len);
-    dest->body.ptr = util_strndup(src->body.ptr, src->body.len);
-    dest->head.ptr = util_strndup(src->head.ptr, src->head.len);
-    dest->message.ptr = util_strndup(src->message.ptr, src->message.len);
-
-    // Deep copy headers array
-    for (int i = 0; i < MG_MAX_HTTP_HEADERS && src->headers[i].name.len > 0; ++i) {
-        dest->headers[i].name.ptr = util_strndup(src->headers[i].name.ptr, src->headers[i].name.len);
-        dest->headers[i].value.ptr = util_strndup(src->headers[i].value.ptr, src->headers[i].value.len);
-    }
-}
-
-void mgHttpClient::freeHttpMessage(struct mg_http_message *msg) {
-    // Free each allocated string
-    free((void*)msg->method.ptr);
-    free((void*)msg->uri.ptr);
-    free((void*)msg->query.ptr);
-    free((void*)msg->proto.ptr);
-    free((void*)msg->body.ptr);
-    free((void*)msg->head.ptr);
-    free((void*)msg->message.ptr);
-
-    // Free headers
-    for (int i = 0; i < MG_MAX_HTTP_HEADERS && msg->headers[i].name.len > 0; ++i) {
-        free((void*)msg->headers[i].name.ptr);
-        free((void*)msg->headers[i].value.ptr);
-    }
-}
-
-void mgHttpClient::send_data(struct mg_http_message *hm, int status_code)
+void mgHttpClient::handle_headers(struct mg_connection *c, struct mg_http_message *hm)
 {
 #ifdef VERBOSE_HTTP
-    Debug_printf("mgHttpClient: send_data\n");
+    Debug_printf("mgHttpClient: handle_headers\n");
+    Debug_printf("  Status: %.*s\n", (int) hm->uri.len, hm->uri.ptr);
 #endif
 
     // get response status code and content length
-    _status_code = status_code;
-    _content_length = (int)hm->body.len;
+    _status_code = mg_http_status(hm);
 
     if (_status_code == 301 || _status_code == 302)
     {
-        // remember Location on redirect response
+        // remember Location on redirect response, the body is not wanted
         struct mg_str *loc = mg_http_get_header(hm, "Location");
         if (loc != nullptr)
             _location = std::string(loc->ptr, loc->len);
+        _skip_body = true;
     }
 
     // get response headers client is interested in
     size_t max_headers = sizeof(hm->headers) / sizeof(hm->headers[0]);
-    for (int i = 0; i < max_headers && hm->headers[i].name.len > 0; i++) 
+    for (int i = 0; i < max_headers && hm->headers[i].name.len > 0 && !_skip_body; i++) 
     {
         // Check to see if we should store this response header
         if (_stored_headers.size() <= 0)
@@ -504,41 +540,183 @@ void mgHttpClient::send_data(struct mg_http_message *hm, int status_code)
         set_header_value(&hm->headers[i].name, &hm->headers[i].value);
     }
 
-    // allocate buffer for received data
-    // realloc == malloc if first param is NULL
-    _buffer = (char *)realloc(_buffer, hm->body.len);
+    // work out where the body ends
+    struct mg_str *te = mg_http_get_header(hm, "Transfer-Encoding");
+    struct mg_str *cl = mg_http_get_header(hm, "Content-Length");
+    is_chunked = te != nullptr && mg_vcasecmp(te, "chunked") == 0;
+    _chunk_state = CHUNK_SIZE;
+    _chunk_remaining = 0;
+    _chunk_digits = 0;
+    if (_method == HTTP_HEAD || _status_code == 204 || _status_code == 304)
+        _body_remaining = 0;
+    else if (!is_chunked && cl != nullptr)
+        _body_remaining = strtoul(std::string(cl->ptr, cl->len).c_str(), nullptr, 10);
+    else
+        _body_remaining = SIZE_MAX; // chunked, or until the server closes
+    _content_length = _body_remaining == SIZE_MAX ? -1 : (int)_body_remaining;
+    _body_done = _body_remaining == 0;
+
+    // the connection can take another request if the body is delimited and nobody asked to close it
+    struct mg_str *conn_hdr = mg_http_get_header(hm, "Connection");
+    if (conn_hdr != nullptr)
+        _keep_alive = mg_vcasecmp(conn_hdr, "keep-alive") == 0;
+    else
+        _keep_alive = mg_vcmp(&hm->method, "HTTP/1.1") == 0; // response version
+    if (!is_chunked && _body_remaining == SIZE_MAX)
+        _keep_alive = false;
+}
 
-    // copy received data into buffer
-    _buffer_pos = 0;
-    if (_buffer != nullptr) {
-        _buffer_len = hm->body.len;
-        memcpy(_buffer, hm->body.ptr, _buffer_len);
+// Append decoded body bytes to the ring, returns how many fit
+size_t mgHttpClient::store_body(const char *src, size_t len)
+{
+    size_t stored = 0;
+    if (_skip_body)
+        return len;
+    if (_buffer == nullptr)
+        return 0;
+    while (stored < len && _buffer_len < HTTP_BODY_BUFFER_SIZE)
+    {
+        int tail = (_buffer_pos + _buffer_len) % HTTP_BODY_BUFFER_SIZE;
+        size_t n = tail < _buffer_pos ? _buffer_pos - tail : HTTP_BODY_BUFFER_SIZE - tail;
+        if (n > len - stored)
+            n = len - stored;
+        memcpy(_buffer + tail, src + stored, n);
+        _buffer_len += n;
+        stored += n;
     }
-    else {
-        _buffer_len = 0;
-        if (hm->body.len != 0) {
-            Debug_printf("mgHttpClient ERROR: buffer was not allocated for received data.");
+    return stored;
+}
+
+/*
+ * Strips the chunked transfer coding from the next len bytes of the stream,
+ * keeping its place between calls. Chunk extensions and trailers are skipped.
+ * Returns the number of bytes consumed, which is less than len if the ring
+ * is full or the last chunk has been seen.
+ */
+size_t mgHttpClient::decode_chunked(const char *src, size_t len)
+{
+    size_t i = 0;
+    while (i < len && !_body_done)
+    {
+        char ch = src[i];
+        switch (_chunk_state)
+        {
+        case CHUNK_SIZE:
+            if (isxdigit((unsigned char)ch))
+            {
+                // more than 8 digits would overflow, no chunk is that large
+                if (++_chunk_digits > 8)
+                {
+                    _chunk_state = CHUNK_BAD;
+                    return i;
+                }
+                _chunk_remaining = _chunk_remaining * 16 + (isdigit((unsigned char)ch) ? ch - '0' : (tolower(ch) - 'a' + 10));
+            }
+            else if (ch == '\n')
+                _chunk_state = _chunk_remaining == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+            else
+                _chunk_state = CHUNK_EXTENSION; // ';' extensions, '\r'
+            i++;
+            break;
+        case CHUNK_EXTENSION:
+            if (ch == '\n')
+                _chunk_state = _chunk_remaining == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+            i++;
+            break;
+        case CHUNK_DATA:
+        {
+            size_t n = len - i < _chunk_remaining ? len - i : _chunk_remaining;
+            size_t stored = store_body(src + i, n);
+            i += stored;
+            _chunk_remaining -= stored;
+            if (_chunk_remaining == 0)
+                _chunk_state = CHUNK_DATA_END;
+            else if (stored < n)
+                return i; // ring is full
+            break;
+        }
+        case CHUNK_DATA_END:
+            if (ch == '\n')
+            {
+                _chunk_state = CHUNK_SIZE;
+                _chunk_digits = 0;
+            }
+            i++;
+            break;
+        case CHUNK_TRAILER:
+            // trailer lines until an empty one
+            if (ch == '\n')
+            {
+                if (_chunk_remaining == 0)
+                    _body_done = true;
+                _chunk_remaining = 0;
+            }
+            else if (ch != '\r')
+                _chunk_remaining = 1;
+            i++;
+            break;
+        case CHUNK_BAD:
+            return i;
         }
     }
-
+    return i;
 }
 
-void mgHttpClient::handle_http_msg(struct mg_connection *c, struct mg_http_message *hm)
+// Move received body bytes from mongoose into the ring, pausing reads when it is full
+void mgHttpClient::pump_body(struct mg_connection *c)
 {
-#ifdef VERBOSE_HTTP
-    Debug_printf("mgHttpClient: handle_http_msg\n");
-    Debug_printf("  Status: %.*s\n", (int) hm->uri.len, hm->uri.ptr);
-    Debug_printf("  Received: %ld\n", (unsigned long) hm->message.len);
-    Debug_printf("  Body: %ld bytes\n", (unsigned long) hm->body.len);
-#endif
+    size_t used = 0;
 
-    int status_code = std::stoi(std::string(hm->uri.ptr, hm->uri.len));
-    send_data(hm, status_code);
+    if (is_chunked)
+    {
+        used = decode_chunked((const char *)c->recv.buf, c->recv.len);
+        if (_chunk_state == CHUNK_BAD)
+        {
+            Debug_printf("mgHttpClient: bad chunk size\n");
+            c->is_closing = 1;
+            _processed = true;
+            return;
+        }
+    }
+    else if (!_body_done)
+    {
+        size_t n = c->recv.len < _body_remaining ? c->recv.len : _body_remaining;
+        used = store_body((const char *)c->recv.buf, n);
+        if (_body_remaining != SIZE_MAX)
+        {
+            _body_remaining -= used;
+            _body_done = _body_remaining == 0;
+        }
+    }
 
-    c->is_closing = 1;          // Tell mongoose to close this connection as it's completed
-    c->recv.len = 0;            // Reset the buffer to 0
-    _processed = true;    // Tell event loop to stop
+    if (used > 0)
+    {
+        mg_iobuf_del(&c->recv, 0, used);
+        if (!_skip_body)
+            _processed = true; // new data for the consumer
+    }
+
+    if (_body_done)
+        finish_body(c);
+    else
+        c->is_full = c->recv.len > 0;
+}
 
+// Response complete: park a keep-alive connection in the pool, close any other
+void mgHttpClient::finish_body(struct mg_connection *c)
+{
+    if (_keep_alive && c->recv.len == 0 && !c->is_closing)
+    {
+        c->fn = http_pool_handler;
+        c->fn_data = nullptr;
+        c->is_full = 0;
+        http_pool.release(_pool_key, c);
+        _conn = nullptr;
+        _transaction_done = true;
+    }
+    else
+        c->is_closing = 1;
+    _processed = true;
 }
 
 void mgHttpClient::handle_read(struct mg_connection *c)
@@ -547,75 +725,29 @@ void mgHttpClient::handle_read(struct mg_connection *c)
     Debug_printf("mgHttpClient: handle_read\n");
 #endif
 
-    struct mg_http_message hm;
-    int n = mg_http_parse((const char *) c->recv.buf, c->recv.len, &hm);
-    // Debug_printf("handle_read, n: %d, recv: %s, recv.len: %d, hm.body: >%s<, len: %d\n", n, c->recv.buf, c->recv.len, hm.body.ptr, hm.body.len);
-    if (hm.body.len == -1 && n > 0) {
-        // 1st block of chunked data, decode it. we abuse the string data as we'll empty it at the end anyway. sorry const
-        int decoded_len = process_chunked_data_in_place((char *) hm.body.ptr, c->recv.size);
-        if (decoded_len == 0) {
-            Debug_printf("mgHttpClient: no chunks in data, but also no content-length! quitting processing this as a block.\n");
+    if (!_headers_done)
+    {
+        struct mg_http_message hm;
+        int n = mg_http_parse((const char *) c->recv.buf, c->recv.len, &hm);
+        if (n == 0)
+            return; // headers are not complete yet
+        if (n < 0)
+        {
+            Debug_printf("mgHttpClient: bad HTTP response\n");
+            c->is_closing = 1;
+            _status_code = 901; // Fake HTTP status code to indicate connection error
+            _processed = true;
             return;
         }
 
-        // looks like it was chunked data, so continue.
-        hm.body.len = decoded_len;
-        is_chunked = true;
-
-        // Debug_printf("[1] about to send '%s' [%d]\n", hm.body.ptr, hm.body.len);
-
-        // keep a copy of the http message for subsequent blocks, we will amend its data. we need the headers kept around
-        if (current_message != nullptr) {
-            freeHttpMessage(current_message);
-        }
-        current_message = (struct mg_http_message *) malloc(sizeof(struct mg_http_message));
-        deepCopyHttpMessage(&hm, current_message);
-
-        int status_code = std::stoi(std::string(current_message->uri.ptr, current_message->uri.len));
-        send_data(current_message, status_code);
-
-        // is this correct? we might get a small chunked block that is complete.
-        c->is_closing = 0;
-        c->recv.len = 0;
-        _processed = true;
-
-    }
-    else if (is_chunked) {
-        // subsequent chunked data without the http header, just the data
-        if (c->recv.len > 0) {
-            // Turn the recv buffer into a processable chunk by null terminating it. This stops the chunk processing from running into old data in case this isn't the last chunk.
-            c->recv.buf[c->recv.len] = '\0';
-        }
-
-        size_t new_len = process_chunked_data_in_place((char *) c->recv.buf, c->recv.size);
-
-        // Allocate or reallocate memory for current_message->body.ptr to hold the new data
-        char* new_body_ptr = (char*)realloc((void*)current_message->body.ptr, new_len);
-
-        // Since realloc might return a different pointer, update current_message->body.ptr
-        current_message->body.ptr = new_body_ptr;
-
-        // Copy the processed data into the newly allocated memory
-        memcpy((void*)current_message->body.ptr, c->recv.buf, new_len);
-
-        // Update current_message->body.len with the new length
-        current_message->body.len = new_len;
-
-        // Debug_printf("[2] about to send '%s' [%d]\n", current_message.body.ptr, current_message.body.len);
-        send_data(current_message, 200);
-
-        c->is_closing = c->recv.len == 0 ? 1 : 0;      // there's more data to get yet, so don't close until we have got the end of message, which is when recv.len is 0.
-        c->recv.len = 0;
-        // reset the buffer_total_read for this new block of data. If it's over the size that is subsequently requested, it'll come out of the buffer
-        _buffer_total_read = 0;
-        _processed = true;
-    }
-    else {
-#ifdef VERBOSE_HTTP
-        Debug_printf("mgHttpClient: handle_read ignoring this block\n");
-#endif
+        handle_headers(c, &hm);
+        mg_iobuf_del(&c->recv, 0, n);
+        _headers_done = true;
+        if (!_skip_body)
+            _processed = true; // status is known, body follows
     }
 
+    pump_body(c);
 }
 
 void report_unhandled(int ev)
@@ -668,17 +800,26 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
     // // Our user_data should be a pointer to our mgHttpClient object
     mgHttpClient *client = (mgHttpClient *)c->fn_data;
     bool progress = true;
-    
+
+    if (ev == MG_EV_CLOSE)
+        http_pool.closed(c);
+
+    // detached by close(), the connection is on its way out
+    if (client == nullptr)
+        return;
+
+    // ignore connections left over from a redirect or a closed request
+    if (ev == MG_EV_OPEN)
+        client->_conn = c;
+    if (c != client->_conn)
+        return;
+
     switch (ev)
     {
     case MG_EV_CONNECT:
         client->handle_connect(c);
         break;
 
-    case MG_EV_HTTP_MSG:
-        client->handle_http_msg(c, (struct mg_http_message *) ev_data);
-        break;
-
     case MG_EV_READ:
         client->handle_read(c);
         break;
@@ -687,12 +828,24 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
 #ifdef VERBOSE_HTTP
         Debug_printf("mgHttpClient: Connection closed\n");
 #endif
+        if (client->_reused && !client->_headers_done)
+        {
+            // the server dropped the pooled connection meanwhile, send the request on a new one
+            client->_reused = false;
+            client->_conn = mg_connect(c->mgr, client->_url.c_str(), _httpevent_handler, client);
+            if (client->_conn != nullptr)
+                http_pool.opened(client->_pool_key, client->_conn);
+            break;
+        }
         client->_transaction_done = true;
-        client->is_chunked = false;
+        client->_conn = nullptr;
+        client->_processed = true; // nothing more will arrive
         break;
     
     case MG_EV_ERROR:
         Debug_printf("mgHttpClient: Error - %s\n", (const char*)ev_data);
+        if (client->_reused && !client->_headers_done)
+            break; // retried on close
         client->_transaction_done = true;
         client->_processed = true;  // Error, tell event loop to stop
         client->_status_code = 901; // Fake HTTP status code to indicate connection error
@@ -730,6 +883,7 @@ int mgHttpClient::_perform()
     _redirect_count = 0;
     bool done = false;
 
+    std::unique_lock<std::recursive_mutex> lock(http_mutex);
     uint64_t ms_update = fnSystem.millis();
     // create client connection if this is a new request. If we were in the middle of processing chunks, we don't redo it.
     if (_transaction_done) {
@@ -740,7 +894,17 @@ int mgHttpClient::_perform()
     {
         while (!_processed)
         {
-            mg_mgr_poll(_handle.get(), 50);
+            // waiting for a connection to the server to come free
+            if (_conn == nullptr)
+                open_connection();
+
+            mg_mgr_poll(http_mgr(), 50);
+
+            // let other threads use their clients between polls
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+
             if (_progressed)
             {
                 _progressed = false;
@@ -806,10 +970,58 @@ void mgHttpClient::_perform_connect()
 {
     _status_code = -1;
     _content_length = 0;
+    _buffer_pos = 0;
     _buffer_len = 0;
     _buffer_total_read = 0;
-    
-    mg_http_connect(_handle.get(), _url.c_str(), _httpevent_handler, this);  // Create client connection
+    _headers_done = false;
+    _body_done = false;
+    _skip_body = false;
+    _keep_alive = false;
+    is_chunked = false;
+
+    // allocated once, reused for every request
+    if (_buffer == nullptr)
+        _buffer = (char *)malloc(HTTP_BODY_BUFFER_SIZE);
+
+    drop_connection();
+
+    _pool_key = http_pool_key(_url.c_str());
+    open_connection();
+}
+
+/*
+ Reuses an idle keep-alive connection to the same server if there is one, else
+ opens a new one if fewer than HTTP_POOL_MAX_OPEN_PER_HOST are open to it.
+ Otherwise _conn stays nullptr and _perform() tries again while it polls,
+ until another request gives a connection back or it times out.
+ */
+void mgHttpClient::open_connection()
+{
+    _conn = http_pool.acquire(_pool_key);
+    _reused = _conn != nullptr;
+    if (_reused)
+    {
+#ifdef VERBOSE_HTTP
+        Debug_printf("mgHttpClient: reusing connection to %s\n", _pool_key.c_str());
+#endif
+        _conn->fn = _httpevent_handler;
+        _conn->fn_data = this;
+        send_request(_conn);
+        return;
+    }
+
+    if (!http_pool.can_open(_pool_key))
+        return;
+
+    // Plain connection, the response is parsed in handle_read() so the body can be streamed
+    _conn = mg_connect(http_mgr(), _url.c_str(), _httpevent_handler, this);  // Create client connection
+    if (_conn == nullptr)
+    {
+        _status_code = 901; // Fake HTTP status code to indicate connection error
+        _processed = true;
+        return;
+    }
+    http_pool.opened(_pool_key, _conn);
 }
 
 int mgHttpClient::PUT(const char *put_data, int put_datalen)
@@ -833,6 +1045,10 @@ int mgHttpClient::PROPFIND(webdav_depth depth, const char *properties_xml)
         return -1;
 
     _method = HTTP_PROPFIND;
+    set_header("Depth", webdav_depths[depth]);
+    set_header("Content-Type", "text/xml");
+    _post_data = properties_xml;
+    _post_datalen = properties_xml == nullptr ? 0 : strlen(properties_xml);
     return _perform();
 }
 
@@ -935,11 +1151,13 @@ bool mgHttpClient::set_header(const char *header_key, const char *header_value)
 // Returns number of response headers available to read
 int mgHttpClient::get_header_count()
 {
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
     return _stored_headers.size();
 }
 
 char *mgHttpClient::get_header(int index, char *buffer, int buffer_len)
 {
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
     if (index < 0 || index > (_stored_headers.size() - 1))
         return nullptr;
 
@@ -953,6 +1171,7 @@ char *mgHttpClient::get_header(int index, char *buffer, int buffer_len)
 
 const std::string mgHttpClient::get_header(int index)
 {
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
     if (index < 0 || index > (_stored_headers.size() - 1))
         return std::string();
 
@@ -964,6 +1183,7 @@ const std::string mgHttpClient::get_header(int index)
 // Returns value of requested response header or empty string if there is no match
 const std::string mgHttpClient::get_header(const char *header)
 {
+    std::lock_guard<std::recursive_mutex> lock(http_mutex);
     std::string hkey = util_tolower(header);
     header_map_t::iterator it = _stored_headers.find(hkey);
     if (it != _stored_headers.end())
@@ -996,77 +1216,4 @@ void mgHttpClient::set_header_value(const struct mg_str *name, const struct mg_s
     }
 }
 
-/*
- * Replaces a piece of chunked html (with size and data) with just the data.
- * Works for multiple blocks.
- * Also ignores any CHUNK EXTENSIONS, e.g. D;foo=bar;baz;qux=123\r\n
- * 
- * Data is only changed if any valid chunk blocks are detected within the upper_bound size given.
- * If none are found, 0 is returned and data is untouched.
- * 
- */
-size_t mgHttpClient::process_chunked_data_in_place(char* data, size_t upper_bound) {
-    if (!std::isxdigit(data[0])) {
-        return 0; // Not chunk-encoded data
-    }
-
-    std::string decoded_data; // Accumulate decoded chunks here
-    char* input_ptr = data;
-    size_t processed_length = 0; // Track how much of the input we have processed
-
-    while (processed_length < upper_bound) {
-        char* end_of_chunk_size_line = strstr(input_ptr, "\r\n");
-        if (!end_of_chunk_size_line) {
-            // No complete chunk size line found
-            break; // Stop processing, but keep valid chunks processed so far
-        }
-
-        char* semicolon_pos = strchr(input_ptr, ';');
-        if (semicolon_pos && semicolon_pos < end_of_chunk_size_line) {
-            *semicolon_pos = '\0'; // Ignore extensions for simplicity
-        } else {
-            *end_of_chunk_size_line = '\0';
-        }
-
-        unsigned int chunk_size;
-        if (sscanf(input_ptr, "%x", &chunk_size) != 1) {
-            // Failed to parse chunk size
-            break; // Stop processing, but keep valid chunks processed so far
-        }
-
-        // Restore the modified character
-        if (semicolon_pos && semicolon_pos < end_of_chunk_size_line) {
-            *semicolon_pos = ';';
-        } else {
-            *end_of_chunk_size_line = '\r';
-        }
-
-        if (chunk_size == 0) {
-            // This is the last chunk
-            break;
-        }
-
-        input_ptr = end_of_chunk_size_line + 2; // Move past the chunk size line
-        processed_length += (input_ptr - data); // Update processed length
-
-        if (processed_length + chunk_size + 2 > upper_bound || strncmp(input_ptr + chunk_size, "\r\n", 2) != 0) {
-            // No end of chunk marker or chunk data exceeds buffer
-            break; // Stop processing, but keep valid chunks processed so far
-        }
-
-        decoded_data.append(input_ptr, chunk_size); // Add chunk data to decoded_data
-        input_ptr += chunk_size + 2; // Move to the next chunk
-        processed_length += chunk_size + 2; // Update processed length
-    }
-
-    if (!decoded_data.empty()) {
-        // Replace the original buffer with the accumulated decoded data
-        memcpy(data, decoded_data.c_str(), decoded_data.size());
-        data[decoded_data.size()] = '\0'; // Null-terminate the result
-        return decoded_data.size(); // Return the length of the decoded data
-    }
-
-    return 0; // No valid chunks were processed
-}
-
-#endif // !ESP_PLATFORM
\ No newline at end of file
+#endif // !ESP_PLATFORM
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <memory>
 #include <cstdint>
 
@@ -14,6 +15,11 @@
 // while debugging, increase timeout
 // #define HTTP_TIMEOUT 600000
 
+// size of the response body ring buffer, reads from the server pause while it is full
+#ifndef HTTP_BODY_BUFFER_SIZE
+#define HTTP_BODY_BUFFER_SIZE (32 * 1024)
+#endif
+
 // using namespace fujinet;
 
 // on Windows/MinGW DELETE is defined already ...
@@ -21,15 +27,6 @@
 #undef DELETE
 #endif
 
-struct MgMgrDeleter {
-    void operator()(mg_mgr* ptr) const {
-        if (ptr != nullptr) {
-            mg_mgr_free(ptr);
-            delete ptr;
-        }
-    }
-};
-
 class mgHttpClient
 {
 private:
@@ -38,14 +35,14 @@ private:
 
     std::string _url;
 
-    char *_buffer; // Will be allocated to hold message received by mongoose
+    char *_buffer; // Ring buffer of HTTP_BODY_BUFFER_SIZE bytes holding the decoded response body
 
     // char *_dechunk_buffer; // allocated to handle dechunking
     // will the read keep returning the old data? or can we detect and move on? the service won't be repeating, so we need to reset buffer correctly after dechunking
     // uint16_t old_chunk_length = 0;
 
-    int _buffer_pos;
-    int _buffer_len;
+    int _buffer_pos; // read position in the ring
+    int _buffer_len; // bytes waiting in the ring
     int _buffer_total_read;
 
     // TaskHandle_t _taskh_consumer = nullptr;
@@ -68,7 +65,7 @@ private:
     header_map_t _request_headers;
 
     // esp_http_client_handle_t _handle = nullptr;
-    std::unique_ptr<mg_mgr, MgMgrDeleter> _handle;
+    mg_mgr *_handle = nullptr; // set by begin(), the manager is shared by all clients, see http_mgr()
 
     // http response status code and content length
     int _status_code;
@@ -112,16 +109,43 @@ private:
     void _perform_connect();
     // int _perform_stream(esp_http_client_method_t method, uint8_t *write_data, int write_size);
 
+    // response parsing state
+    struct mg_connection *_conn = nullptr; // connection of the current request
+    bool _headers_done = false;
+    bool _body_done = false;
+    bool _skip_body = false; // redirect, read past the body without keeping it
+    size_t _body_remaining = 0; // SIZE_MAX if the body ends when the server closes
+
+    // keep-alive, see httpConnectionPool.h
+    std::string _pool_key;
+    bool _keep_alive = false; // connection can go back to the pool after this response
+    bool _reused = false;     // request was sent on a pooled connection
+
+    enum chunk_state
+    {
+        CHUNK_SIZE,
+        CHUNK_EXTENSION,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILER,
+        CHUNK_BAD // malformed chunk size, the connection is dropped
+    };
     bool is_chunked = false;
-    size_t process_chunked_data_in_place(char* data, size_t upper_bound);
+    chunk_state _chunk_state = CHUNK_SIZE;
+    size_t _chunk_remaining = 0;
+    int _chunk_digits = 0;
+
     void handle_connect(struct mg_connection *c);
-    void handle_http_msg(struct mg_connection *c, struct mg_http_message *hm);
+    void send_request(struct mg_connection *c);
+    void drop_connection();
+    void open_connection();
+    void handle_headers(struct mg_connection *c, struct mg_http_message *hm);
     void handle_read(struct mg_connection *c);
-    void send_data(struct mg_http_message *hm, int status_code);
+    size_t store_body(const char *src, size_t len);
+    size_t decode_chunked(const char *src, size_t len);
+    void pump_body(struct mg_connection *c);
+    void finish_body(struct mg_connection *c);
 
-    void deepCopyHttpMessage(const struct mg_http_message *src, struct mg_http_message *dest);
-    void freeHttpMessage(struct mg_http_message *msg);
-    struct mg_http_message *current_message = nullptr;
     std::string certDataStorage; // Store the processed certificate data
 
 public:
@@ -139,6 +163,9 @@ public:
     bool begin(std::string url);
     void close();
 
+    // Close all connections and free the manager shared by the clients
+    static void shutdown();
+
     int GET();
     int HEAD();
     int POST(const char *post_data, int post_datalen);
@@ -4,42 +4,47 @@
 //#include "meat_broker.h"
 #include "endianness.h"
 
+#include <algorithm>
+
 // D64 Utility Functions
 
-bool D64MStream::seekBlock(uint64_t index, uint8_t offset)
+// First block of each track, built once as the format's sector counts are
+// only final after the derived constructors have run
+uint32_t D64MStream::trackOffset(uint8_t track)
 {
-    uint16_t sectorOffset = 0;
-    uint8_t track = 0;
+    if (track >= trackOffsets.size())
+    {
+        uint16_t c = partitions[partition].block_allocation_map.size() - 1;
+        uint16_t end_track = std::max<uint16_t>(partitions[partition].block_allocation_map[c].end_track, track);
+
+        trackOffsets.assign(end_track + 2, 0);
+        for (uint16_t t = 1; t <= end_track; t++)
+            trackOffsets[t + 1] = trackOffsets[t] + getSectorCount(t);
+    }
+    return trackOffsets[track];
+}
 
+bool D64MStream::seekBlock(uint64_t index, uint8_t offset)
+{
     // Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
 
     // Determine actual track & sector from index
-    do
-    {
-        track++;
-        uint8_t count = getSectorCount(track);
-        if (sectorOffset + count < index)
-            sectorOffset += count;
-        else
-            break;
-
-        // Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", track, speedZone(track), count, sectorOffset);
-    } while (true);
-    uint8_t sector = index - sectorOffset;
+    trackOffset(1);
+    auto next = std::upper_bound(trackOffsets.begin() + 2, trackOffsets.end(), index);
+    uint8_t track = (next == trackOffsets.end() ? trackOffsets.size() : next - trackOffsets.begin()) - 1;
+    uint8_t sector = index - trackOffsets[track];
 
     this->block = index;
     this->track = track;
     this->sector = sector;
 
-    // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
+    // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), trackOffsets[track]);
 
-    return containerStream->seek((index * block_size) + offset);
+    return seekContainer((index * block_size) + offset);
 }
 
 bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
 {
-    uint16_t sectorOffset = 0;
-
     //Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
 
     // Is this a valid track?
@@ -60,14 +65,7 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
         return false;
     }
 
-    track--;
-    for (uint8_t index = 0; index < track; ++index)
-    {
-        sectorOffset += getSectorCount(index + 1);
-        //Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", (index + 1), speedZone(index), getSectorCount(index + 1), sectorOffset);
-    }
-    track++;
-    sectorOffset += sector;
+    uint32_t sectorOffset = trackOffset(track) + sector;
 
     this->block = sectorOffset;
     this->track = track;
@@ -75,7 +73,7 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
 
     //Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
 
-    return containerStream->seek((sectorOffset * block_size) + offset);
+    return seekContainer((sectorOffset * block_size) + offset);
 }
 
 bool D64MStream::seekSector(std::vector<uint8_t> trackSectorOffset)
@@ -80,6 +80,7 @@ public:
     std::vector<Partition> partitions;
     std::vector<uint16_t> sectorsPerTrack = { 17, 18, 19, 21 };
     std::vector<uint8_t> interleave = { 3, 10 }; // Directory, File
+    std::vector<uint32_t> trackOffsets;          // First block of each track
 
     uint8_t dos_version = 0x41;
     std::string dos_rom = "dos1541";
@@ -90,6 +91,8 @@ public:
 
     D64MStream(std::shared_ptr<MStream> is) : MMediaStream(is) 
     {
+        block_buffered = true;
+
         // D64 Partition Info
         std::vector<BlockAllocationMap> b = { 
             {
@@ -233,6 +236,7 @@ public:
     {
         return sectorsPerTrack[speedZone(track)];
     }
+    uint32_t trackOffset( uint8_t track );
     uint16_t getTrackCount()
     {
         return partitions[0].block_allocation_map[0].end_track;
@@ -1,5 +1,8 @@
 #include "meat_media.h"
 
+#include <algorithm>
+#include <cstdint>
+
 std::unordered_map<std::string, MMediaStream*> ImageBroker::repo;
 
 // Utility Functions
@@ -96,9 +99,125 @@ uint32_t MMediaStream::seekFileSize( uint8_t start_track, uint8_t start_sector )
 };
 
 
+bool MMediaStream::seekContainer(uint32_t pos)
+{
+    if ( !block_buffered )
+        return containerStream->seek(pos);
+
+    _container_pos = pos;
+
+    // Still in the cached block?
+    if ( pos - _block_start < _block_fill )
+        return true;
+
+    uint32_t start = pos - (pos % block_size);
+    if ( start == _stream_pos )
+        return true;
+
+    if ( !containerStream->seek(start) )
+    {
+        _stream_pos = UINT32_MAX;
+        return false;
+    }
+    _stream_pos = start;
+    return true;
+}
+
 uint32_t MMediaStream::readContainer(uint8_t *buf, uint32_t size)
 {
-    return containerStream->read(buf, size);
+    if ( !block_buffered )
+        return containerStream->read(buf, size);
+
+    uint32_t total = 0;
+    while ( size > 0 )
+    {
+        uint32_t in_block = _container_pos - _block_start;
+        if ( in_block >= _block_fill )
+        {
+            uint32_t start = _container_pos - (_container_pos % block_size);
+            if ( start != _stream_pos )
+            {
+                if ( !containerStream->seek(start) )
+                {
+                    _stream_pos = UINT32_MAX;
+                    break;
+                }
+                _stream_pos = start;
+            }
+
+            // Whole blocks go straight to the caller
+            if ( start == _container_pos && size >= block_size )
+            {
+                uint32_t n = containerStream->read(buf, size - (size % block_size));
+                _stream_pos += n;
+                _container_pos += n;
+                buf += n;
+                total += n;
+                size -= n;
+                if ( n == 0 )
+                    break;
+                continue;
+            }
+
+            if ( !_block_cache )
+                _block_cache.reset(new uint8_t[block_size]);
+            _block_start = start;
+            _block_fill = containerStream->read(_block_cache.get(), block_size);
+            _stream_pos += _block_fill;
+
+            in_block = _container_pos - _block_start;
+            if ( in_block >= _block_fill )
+                break; // end of the image
+        }
+
+        uint32_t n = std::min(size, _block_fill - in_block);
+        memcpy(buf, _block_cache.get() + in_block, n);
+        _container_pos += n;
+        buf += n;
+        total += n;
+        size -= n;
+    }
+    return total;
+}
+
+uint32_t MMediaStream::readContainerUntil(std::string &out, uint8_t delimiter)
+{
+    uint32_t total = 0;
+    uint8_t b = 0;
+
+    if ( !block_buffered )
+    {
+        while ( containerStream->read(&b, 1) )
+        {
+            total++;
+            if ( b == delimiter )
+                break;
+            out += b;
+        }
+        return total;
+    }
+
+    // Search the cached block, one block at a time
+    while ( readContainer(&b, 1) )
+    {
+        total++;
+        if ( b == delimiter )
+            break;
+        out += b;
+
+        uint32_t in_block = _container_pos - _block_start;
+        if ( in_block < _block_fill )
+        {
+            const uint8_t *p = _block_cache.get() + in_block;
+            uint32_t left = _block_fill - in_block;
+            const uint8_t *d = (const uint8_t *)memchr(p, delimiter, left);
+            uint32_t n = d ? d - p : left;
+            out.append((const char *)p, n);
+            _container_pos += n;
+            total += n;
+        }
+    }
+    return total;
 }
 
 
@@ -5,7 +5,9 @@
 #include "meatloaf.h"
 
 #include <map>
+#include <memory>
 #include <bitset>
+#include <cstring>
 #include <unordered_map>
 #include <sstream>
 
@@ -44,63 +46,43 @@ public:
     // read = (size) => this.containerStream.read(size);
     virtual uint8_t read() {
         uint8_t b = 0;
-        containerStream->read( &b, 1 );
+        readContainer( &b, 1 );
         _position++;
         return b;
     }
     // readUntil = (delimiter = 0x00) => this.containerStream.readUntil(delimiter);
     virtual std::string readUntil( uint8_t delimiter = 0x00 )
     {
-        uint8_t b = 0, s = 0;
-        std::string bytes = "";
-        do
-        {
-            s = containerStream->read( &b, 1 );
-            _position += s;
-            if ( b != delimiter )
-            {
-                bytes += b;
-            }
-            else
-                break;
-        } while ( s );
-
+        std::string bytes;
+        _position += readContainerUntil( bytes, delimiter );
         return bytes;
     }
     // readString = (size) => this.containerStream.readString(size);
     virtual std::string readString( uint8_t size )
     {
         uint8_t b[size];
-        if ( auto s = containerStream->read( b, size ) )
+        if ( auto s = readContainer( b, size ) )
         {
             _position += s;
-            return std::string((char *)b);
+            return std::string((char *)b, strnlen((char *)b, s));
         }
         return std::string();
     }
     // readStringUntil = (delimiter = 0x00) => this.containerStream.readStringUntil(delimiter);
     virtual std::string readStringUntil( uint8_t delimiter = '\0' )
     {
-        uint8_t b = 0;
-        std::stringstream ss;
-        while( containerStream->read( &b, 1 ) )
-        {
-            _position++;
-            if ( b == delimiter )
-                ss << b;
-        }
-        return ss.str();
+        return readUntil( delimiter );
     }
 
     // seek = (offset) => this.containerStream.seek(offset + this.media_header_size);
     bool seek(uint32_t offset) override {
         _position = media_header_size + offset;
-        return containerStream->seek( _position ); 
+        return seekContainer( _position );
     }
     // seekCurrent = (offset) => this.containerStream.seekCurrent(offset);
     bool seekCurrent(uint32_t offset) {
         _position += offset;
-        return containerStream->seek( _position );
+        return seekContainer( _position );
     }
 
     bool seekPath(std::string path) override { return false; };
@@ -158,7 +140,20 @@ protected:
     virtual bool seekEntry( std::string filename ) { return false; };
     virtual bool seekEntry( uint16_t index ) { return false; };
 
+    // Sector cache between the image and containerStream. Formats that address
+    // the image by track and sector turn it on: seeks then only move
+    // _container_pos and reads are served from whole blocks.
+    bool block_buffered = false;
+    std::unique_ptr<uint8_t[]> _block_cache;
+    uint32_t _block_start = 0;     // container offset of the cached block
+    uint32_t _block_fill = 0;      // bytes in the cache
+    uint32_t _container_pos = 0;   // where the next readContainer() reads from
+    uint32_t _stream_pos = UINT32_MAX; // where containerStream is (UINT32_MAX: unknown)
+
+    bool seekContainer(uint32_t pos);
     virtual uint32_t readContainer(uint8_t *buf, uint32_t size);
+    // Appends bytes up to the delimiter to out, returns the bytes consumed including it
+    uint32_t readContainerUntil(std::string &out, uint8_t delimiter);
     virtual uint32_t readFile(uint8_t* buf, uint32_t size) = 0;
     virtual std::string decodeType(uint8_t file_type, bool show_hidden = false);
     virtual std::string decodeType(std::string file_type);
@@ -3,6 +3,7 @@
 #include <esp_idf_version.h>
 
 #include "../../../include/debug.h"
+#include "fnSystem.h"
 //#include "../../../include/global_defines.h"
 
 /********************************************************
@@ -155,9 +156,23 @@ bool HttpIStream::open() {
 void HttpIStream::close() {
     //Debug_printv("CLOSE called explicitly on this HTTP stream!");    
     _http.close();
+
+    if ( _cache )
+    {
+        Debug_printv("requests[%d] cache hits[%d] misses[%d]", _http.requests, _cache->hits, _cache->misses);
+        _cache.reset();
+    }
+
+    _copy.reset();
 }
 
 bool HttpIStream::seek(uint32_t pos) {
+    if ( _cache || _copy )
+    {
+        _position = pos;
+        return true;
+    }
+
     if ( !_http._is_open )
     {
         Debug_printv("error");
@@ -165,9 +180,94 @@ bool HttpIStream::seek(uint32_t pos) {
         return false;
     }
 
+    if ( pos == _position )
+        return true;
+
+    // Random access on a GET of known size. Seeks then only move _position,
+    // the reads fetch what they need.
+    bool sized = ( _size > 0 && _size != UINT32_MAX );
+    if ( !(mode & std::ios_base::out) && sized )
+    {
+        if ( _http.isFriendlySkipper )
+        {
+            _cache = HttpBlockCache::obtain(url, _size);
+            _position = pos;
+            return true;
+        }
+
+        // No Range support, work from a local copy
+        if ( makeCopy() )
+            return seek(pos);
+        if ( !_http._is_open )
+            return false;
+    }
+
     return _http.seek(pos);
 }
 
+// Copies of resources from servers without Range support, shared by URL
+static std::map<std::string, std::weak_ptr<HttpLocalCopy>> local_copies;
+
+HttpLocalCopy::~HttpLocalCopy() {
+    if ( file != nullptr )
+    {
+        fclose(file);
+        fnSystem.delete_tempfile(name);
+    }
+}
+
+// Downloads the whole resource into a temp file, unless another stream did
+bool HttpIStream::makeCopy() {
+    auto found = local_copies.find(url);
+    if ( found != local_copies.end() )
+    {
+        _copy = found->second.lock();
+        if ( _copy )
+            return true;
+        local_copies.erase(found);
+    }
+
+    // Content-Length has to fit on the SD card or flash
+    if ( _size > fnSystem.tempfile_free_bytes() )
+    {
+        Debug_printv("no room to copy [%s], [%d] bytes", url.c_str(), _size);
+        return false;
+    }
+
+    auto copy = std::make_shared<HttpLocalCopy>();
+    copy->file = fnSystem.make_tempfile(copy->name);
+    if ( copy->file == nullptr )
+        return false;
+
+    Debug_printv("Server doesn't support ranges, copying [%s] to [%s]", url.c_str(), copy->name);
+
+    _http.close();
+    uint32_t copied = 0;
+    if ( _http.processRedirectsAndOpen(0) )
+    {
+        uint8_t buf[1024];
+        int n;
+        while ( (n = (int)_http.read(buf, sizeof(buf))) > 0 )
+        {
+            if ( fwrite(buf, 1, n, copy->file) != (size_t)n )
+                break;
+            copied += n;
+        }
+    }
+    _http.close();
+
+    if ( copied < _size )
+    {
+        Debug_printv("copy failed at [%d] of [%d]", copied, _size);
+        _error = 1;
+        return false;
+    }
+
+    _copy = copy;
+    local_copies[url] = copy;
+    return true;
+}
+
 uint32_t HttpIStream::read(uint8_t* buf, uint32_t size) {
     uint32_t bytesRead = 0;
     if ( size > available() )
@@ -175,9 +275,30 @@ uint32_t HttpIStream::read(uint8_t* buf, uint32_t size) {
     
     if ( size > 0 )
     {
-        bytesRead = _http.read(buf, size);
+        if ( _copy )
+        {
+            // The file is shared, so position it every time
+            if ( fseek(_copy->file, _position, SEEK_SET) == 0 )
+                bytesRead = fread(buf, 1, size, _copy->file);
+        }
+        else if ( _cache )
+        {
+            bytesRead = _cache->read(&_http, _position, buf, size);
+
+            // Answered a Range request with the whole resource
+            if ( bytesRead == 0 && !_http.isFriendlySkipper )
+            {
+                _cache.reset();
+                if ( makeCopy() && fseek(_copy->file, _position, SEEK_SET) == 0 )
+                    bytesRead = fread(buf, 1, size, _copy->file);
+            }
+        }
+        else
+        {
+            bytesRead = _http.read(buf, size);
+            _error = _http._error;
+        }
         _position += bytesRead;
-        _error = _http._error;
     }
 
     return bytesRead;
@@ -236,18 +357,18 @@ bool MeatHttpClient::HEAD(std::string dstUrl) {
     return rc;
 }
 
-bool MeatHttpClient::processRedirectsAndOpen(int range) {
+bool MeatHttpClient::processRedirectsAndOpen(int range, uint32_t range_end) {
     wasRedirected = false;
     _size = -1;
 
     Debug_printv("reopening url[%s] from position:%d", url.c_str(), range);
-    lastRC = openAndFetchHeaders(lastMethod, range);
+    lastRC = openAndFetchHeaders(lastMethod, range, range_end);
 
     while(lastRC == HttpStatus_MovedPermanently || lastRC == HttpStatus_Found || lastRC == 303)
     {
         Debug_printv("--- Page moved, doing redirect to [%s]", url.c_str());
         close();
-        lastRC = openAndFetchHeaders(lastMethod, range);
+        lastRC = openAndFetchHeaders(lastMethod, range, range_end);
         wasRedirected = true;
     }
     
@@ -261,6 +382,7 @@ bool MeatHttpClient::processRedirectsAndOpen(int range) {
     _is_open = true;
     _exists = true;
     _position = 0;
+    _stream_end = _size;
 
     Debug_printv("size[%d] avail[%d] isFriendlySkipper[%d] isText[%d] httpCode[%d] method[%d]", _size, available(), isFriendlySkipper, isText, lastRC, lastMethod);
 
@@ -287,6 +409,38 @@ void MeatHttpClient::close() {
     _is_open = false;
 }
 
+uint32_t MeatHttpClient::streamPosition() {
+    if ( _is_open && _position < _stream_end )
+        return _position;
+
+    return UINT32_MAX;
+}
+
+bool MeatHttpClient::requestRange(uint32_t start, uint32_t end) {
+    // Content-Length of a 206 is the length of the range
+    uint32_t size = _size;
+
+    close();
+    bool op = processRedirectsAndOpen(start, end);
+    _size = size;
+
+    Debug_printv("range[%d-%d] RC=%d", start, end - 1, lastRC);
+
+    if ( !op )
+        return false;
+
+    if ( lastRC != 206 )
+    {
+        // The whole resource came back, ranges aren't supported after all
+        isFriendlySkipper = false;
+        return false;
+    }
+
+    _position = start;
+    _stream_end = end;
+    return true;
+}
+
 void MeatHttpClient::setOnHeader(const std::function<int(char*, char*)> &lambda) {
     onHeader = lambda;
 }
@@ -386,7 +540,7 @@ uint32_t MeatHttpClient::write(const uint8_t* buf, uint32_t size) {
     return 0;
 };
 
-int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resume) {
+int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resume, uint32_t range_end) {
 
     if ( url.size() < 5)
         return 0;
@@ -414,7 +568,12 @@ int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resum
         esp_http_client_set_header(_http, pair.first.c_str(), pair.second.c_str());
     }
 
-    if(resume > 0) {
+    if(range_end > 0) {
+        char str[40];
+        snprintf(str, sizeof str, "bytes=%lu-%lu", (unsigned long)resume, (unsigned long)range_end - 1);
+        esp_http_client_set_header(_http, "range", str);
+    }
+    else if(resume > 0) {
         char str[40];
         snprintf(str, sizeof str, "bytes=%lu-", (unsigned long)resume);
         esp_http_client_set_header(_http, "range", str);
@@ -422,6 +581,7 @@ int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resum
 
     //Debug_printv("--- PRE OPEN");
 
+    requests++;
     esp_err_t initOk = esp_http_client_open(_http, 0); // or open? It's not entirely clear...
 
     if(initOk == ESP_FAIL)
@@ -11,6 +11,7 @@
 #include "meatloaf.h"
 
 #include <esp_http_client.h>
+#include <cstdio>
 #include <functional>
 #include <map>
 
@@ -18,6 +19,7 @@
 //#include "../../include/global_defines.h"
 #include "../../include/version.h"
 #include "utils.h"
+#include "http_cache.h"
 
 #define HTTP_BLOCK_SIZE 256
 
@@ -26,10 +28,10 @@
 #define PLATFORM_DETAILS "C64; 6510; 2; NTSC; EN;" // Make configurable. This will help server side to select appropriate content.
 #define USER_AGENT "MEATLOAF/" FN_VERSION_FULL " (" PLATFORM_DETAILS ")"
 
-class MeatHttpClient {
+class MeatHttpClient: public HttpBlockSource {
     esp_http_client_handle_t _http = nullptr;
     static esp_err_t _http_event_handler(esp_http_client_event_t *evt);
-    int openAndFetchHeaders(esp_http_client_method_t meth, int resume = 0);
+    int openAndFetchHeaders(esp_http_client_method_t meth, int resume = 0, uint32_t range_end = 0);
     esp_http_client_method_t lastMethod;
     std::function<int(char*, char*)> onHeader = [] (char* key, char* value){ 
         //Debug_printv("HTTP_EVENT_ON_HEADER, key=%s, value=%s", key, value);
@@ -66,7 +68,7 @@ public:
     bool PUT(std::string url);
     bool HEAD(std::string url);
 
-    bool processRedirectsAndOpen(int range);
+    bool processRedirectsAndOpen(int range, uint32_t range_end = 0);
     bool open(std::string url, esp_http_client_method_t meth);
     void close();
     void setOnHeader(const std::function<int(char*, char*)> &f);
@@ -74,6 +76,11 @@ public:
     uint32_t read(uint8_t* buf, uint32_t size);
     uint32_t write(const uint8_t* buf, uint32_t size);
 
+    // HttpBlockSource
+    uint32_t streamPosition() override;
+    bool requestRange(uint32_t start, uint32_t end) override;
+    uint32_t readStream(uint8_t *buf, uint32_t size) override { return read(buf, size); };
+
     bool _is_open = false;
     bool _exists = false;
 
@@ -84,7 +91,9 @@ public:
     uint32_t _size = 0;
     // uint32_t m_bytesAvailable = 0;
     uint32_t _position = 0;
+    uint32_t _stream_end = 0; // end of the open response
     size_t _error = 0;
+    uint32_t requests = 0;
 
     bool m_isWebDAV = false;
     bool m_isDirectory = false;
@@ -138,6 +147,14 @@ public:
  * Streams
  ********************************************************/
 
+// Temp file holding a resource from a server without Range support
+struct HttpLocalCopy {
+    FILE *file = nullptr;
+    char name[9] = { 0 };
+
+    ~HttpLocalCopy();
+};
+
 class HttpIStream: public MStream {
 
 public:
@@ -173,6 +190,12 @@ public:
 protected:
     MeatHttpClient _http;
 
+    // Random access, set up by the first seek: a block cache when the server
+    // takes Range requests, otherwise a local copy of the whole resource
+    std::shared_ptr<HttpBlockCache> _cache;
+    std::shared_ptr<HttpLocalCopy> _copy;
+
+    bool makeCopy();
 };
 
 
@@ -0,0 +1,139 @@
+#include "http_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::map<std::string, std::weak_ptr<HttpBlockCache>> HttpBlockCache::repo;
+
+std::shared_ptr<HttpBlockCache> HttpBlockCache::obtain(const std::string &url, uint32_t size)
+{
+    // Drop the caches nobody holds any more
+    for (auto it = repo.begin(); it != repo.end();)
+    {
+        if (it->second.expired())
+            it = repo.erase(it);
+        else
+            ++it;
+    }
+
+    auto found = repo.find(url);
+    if (found != repo.end())
+    {
+        auto cache = found->second.lock();
+        if (cache->_size == size)
+            return cache;
+    }
+
+    // New, or the resource changed size
+    auto cache = std::make_shared<HttpBlockCache>(size);
+    repo[url] = cache;
+    return cache;
+}
+
+int HttpBlockCache::find(uint32_t block)
+{
+    for (int i = 0; i < (int)_slots.size(); i++)
+    {
+        if (_slots[i].block == block)
+            return i;
+    }
+    return -1;
+}
+
+int HttpBlockCache::evict()
+{
+    if (!_data)
+    {
+        _data.reset(new uint8_t[HTTP_CACHE_BLOCK_SIZE * HTTP_CACHE_BLOCKS]);
+        _slots.resize(HTTP_CACHE_BLOCKS);
+    }
+
+    int lru = 0;
+    for (int i = 1; i < (int)_slots.size(); i++)
+    {
+        if (_slots[i].used < _slots[lru].used)
+            lru = i;
+    }
+    _slots[lru].block = UINT32_MAX;
+    _slots[lru].fill = 0;
+    return lru;
+}
+
+bool HttpBlockCache::fill(HttpBlockSource *source, uint32_t block)
+{
+    uint32_t start = block * HTTP_CACHE_BLOCK_SIZE;
+    uint32_t count = 1;
+
+    // Carry on with the open response if it is already here,
+    // otherwise ask for this block and the uncached ones after it
+    if (source->streamPosition() != start)
+    {
+        while (count <= HTTP_CACHE_READ_AHEAD &&
+               (block + count) * HTTP_CACHE_BLOCK_SIZE < _size &&
+               find(block + count) < 0)
+            count++;
+
+        uint32_t end = std::min((block + count) * HTTP_CACHE_BLOCK_SIZE, _size);
+        requests++;
+        if (!source->requestRange(start, end) || source->streamPosition() != start)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t want = std::min<uint32_t>(HTTP_CACHE_BLOCK_SIZE, _size - start);
+        int s = evict();
+        uint8_t *p = _data.get() + (s * HTTP_CACHE_BLOCK_SIZE);
+
+        uint32_t got = 0;
+        while (got < want)
+        {
+            uint32_t n = source->readStream(p + got, want - got);
+            if (n == 0 || n == UINT32_MAX)
+                break;
+            got += n;
+        }
+        if (got < want)
+            return i > 0; // the block asked for made it in
+
+        _slots[s].block = block + i;
+        _slots[s].fill = got;
+        _slots[s].used = ++_tick;
+        start += got;
+    }
+    return true;
+}
+
+uint32_t HttpBlockCache::read(HttpBlockSource *source, uint32_t pos, uint8_t *buf, uint32_t size)
+{
+    uint32_t total = 0;
+
+    if (pos >= _size)
+        return 0;
+    size = std::min(size, _size - pos);
+
+    while (total < size)
+    {
+        uint32_t block = pos / HTTP_CACHE_BLOCK_SIZE;
+        int s = find(block);
+        if (s < 0)
+        {
+            misses++;
+            if (!fill(source, block) || (s = find(block)) < 0)
+                break;
+        }
+        else
+            hits++;
+
+        _slots[s].used = ++_tick;
+        uint32_t offset = pos - (block * HTTP_CACHE_BLOCK_SIZE);
+        if (offset >= _slots[s].fill)
+            break;
+
+        uint32_t n = std::min(size - total, _slots[s].fill - offset);
+        memcpy(buf + total, _data.get() + (s * HTTP_CACHE_BLOCK_SIZE) + offset, n);
+        pos += n;
+        total += n;
+    }
+    return total;
+}
@@ -0,0 +1,70 @@
+// Block cache for random access to HTTP resources
+//
+// Disk images opened straight from a URL are read by track and sector, which
+// hops all over the file. Rather than opening a new request on every seek,
+// reads are served from a small LRU cache of aligned blocks. Missing blocks
+// are fetched with one Range request together with the uncached blocks that
+// follow them, and a response that is already positioned at the block needed
+// is simply read on. Streams open on the same URL share one cache, so a LOAD
+// finds the directory and BAM sectors the listing already fetched.
+//
+
+#ifndef MEATLOAF_HTTP_CACHE
+#define MEATLOAF_HTTP_CACHE
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define HTTP_CACHE_BLOCK_SIZE 4096 // bytes per cached block, Range requests are aligned to it
+#define HTTP_CACHE_BLOCKS 8        // blocks kept, least recently used is dropped
+#define HTTP_CACHE_READ_AHEAD 3    // uncached blocks fetched after a missing one
+
+// Where the cache gets its data from
+class HttpBlockSource {
+public:
+    virtual ~HttpBlockSource() {};
+
+    // Offset the open response delivers next, UINT32_MAX if there is none or it is used up
+    virtual uint32_t streamPosition() = 0;
+    // Open a response for bytes [start, end) of the resource
+    virtual bool requestRange(uint32_t start, uint32_t end) = 0;
+    // Read from the open response
+    virtual uint32_t readStream(uint8_t *buf, uint32_t size) = 0;
+};
+
+class HttpBlockCache {
+    struct Slot {
+        uint32_t block = UINT32_MAX;
+        uint32_t fill = 0;
+        uint32_t used = 0;
+    };
+
+    static std::map<std::string, std::weak_ptr<HttpBlockCache>> repo;
+
+    uint32_t _size;
+    std::unique_ptr<uint8_t[]> _data;
+    std::vector<Slot> _slots;
+    uint32_t _tick = 0;
+
+    int find(uint32_t block);
+    int evict();
+    bool fill(HttpBlockSource *source, uint32_t block);
+
+public:
+    HttpBlockCache(uint32_t size) : _size(size) {};
+
+    // Cache of the resource at url, shared while any stream holds it
+    static std::shared_ptr<HttpBlockCache> obtain(const std::string &url, uint32_t size);
+
+    // Copies size bytes at pos into buf, fetching missing blocks from source. Returns the bytes copied.
+    uint32_t read(HttpBlockSource *source, uint32_t pos, uint8_t *buf, uint32_t size);
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t requests = 0; // Range requests made
+};
+
+#endif /* MEATLOAF_HTTP_CACHE */
@@ -5,6 +5,7 @@
 #endif
 #include "mediaTypeDSK.h"
 #include "../../include/debug.h"
+#include "fnSystem.h"
 #include <string.h>
 
 
@@ -17,18 +18,25 @@
 #define BYTES_PER_TRACK 4096
 #define BYTES_PER_SECTOR 256
 
+// Layout of a track written by serialise_track(), in bits
+#define GAP1_BITS 160         // 16 sync words
+#define SECTOR_BITS 3134      // address field, gap 2, data field, gap 3
+#define SECTOR_DATA_OFFSET 206 // address field and gap 2, data prologue
+#define TRACK_BITS (GAP1_BITS + 16 * SECTOR_BITS)
+
 // routines to convert DSK to WOZ stolen from DSK2WOZ by Tom Harte 
 // https://github.com/TomHarte/dsk2woz
 
 // forward reference
 static void serialise_track(uint8_t *dest, const uint8_t *src, uint8_t track_number, bool is_prodos);
+static size_t write_sector_data(uint8_t *dest, size_t track_position, const uint8_t *src);
 
 bool MediaTypeDSK::write_sector(int qtrack, int sector, uint8_t *buffer)
 {
   size_t offset, size;
   size_t sectors_per_track = 16; // FIXME - what about 13 sector disks?
-  uint8_t *trackbuf;
   int track = tmap[qtrack];
+  int physical = sector;
   const int phys2log[] = {0, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 15};
   const int prodos[] = {0, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 15};
 
@@ -53,32 +61,18 @@ bool MediaTypeDSK::write_sector(int qtrack, int sector, uint8_t *buffer)
   if (size != BYTES_PER_SECTOR)
     return true;
 
-  offset = track * sectors_per_track * BYTES_PER_SECTOR;
-  if (fnio::fseek(_media_fileh, offset, SEEK_SET) != 0)
-    return true;
-
-  size = sectors_per_track * BYTES_PER_SECTOR;
-  trackbuf = (uint8_t *) malloc(size);
-  if (!trackbuf)
-    return true;
-
-  offset = fnio::fread(trackbuf, 1, size, _media_fileh);
-  if (offset != size)
-    return true;
-
-  offset = sector * BYTES_PER_SECTOR;
-  memcpy(&trackbuf[offset], buffer, BYTES_PER_SECTOR);
-
-  memset(trk_ptrs[track], 0, WOZ1_NUM_BLKS * 512);
-  serialise_track(trk_ptrs[track], trackbuf, track, _mediatype == MEDIATYPE_PO);
-
-  free(trackbuf);
+  // Only the data field of this sector changes, re-encode it in place if the
+  // track is resident. Otherwise it is nibblized from the file when loaded.
+  if (trk_ptrs[track] != nullptr)
+    write_sector_data(trk_ptrs[track], GAP1_BITS + physical * SECTOR_BITS + SECTOR_DATA_OFFSET, buffer);
 
   return false;
 }
 
 mediatype_t MediaTypeDSK::mount(fnFile *f, uint32_t disksize)
 {
+    uint32_t start_ms = fnSystem.millis();
+
     switch (disksize) {
         case 35 * BYTES_PER_TRACK:
         case 36 * BYTES_PER_TRACK:
@@ -93,28 +87,50 @@ mediatype_t MediaTypeDSK::mount(fnFile *f, uint32_t disksize)
     _media_fileh = f;
     diskiiemulation = true;
     num_tracks = disksize / BYTES_PER_TRACK;
+    reset_tracks();
 
-    // allocated SPRAM
-    const size_t dsk_image_size = num_tracks * BYTES_PER_TRACK;
+    // tracks are read and nibblized by load_track() when the head gets there
 #ifdef ESP_PLATFORM
-    uint8_t *dsk = (uint8_t*)heap_caps_malloc(dsk_image_size, MALLOC_CAP_SPIRAM);
+    if (dsk_track == nullptr)
+        dsk_track = (uint8_t*)heap_caps_malloc(BYTES_PER_TRACK, MALLOC_CAP_SPIRAM);
 #else
-	uint8_t *dsk = (uint8_t*)malloc(dsk_image_size);
+    if (dsk_track == nullptr)
+        dsk_track = (uint8_t*)malloc(BYTES_PER_TRACK);
 #endif
-    if (fnio::fseek(f, 0, SEEK_SET) != 0)
-        return MEDIATYPE_UNKNOWN;
-    size_t bytes_read = fnio::fread(dsk, 1, dsk_image_size, f);
-    if (bytes_read != dsk_image_size)
+    if (dsk_track == nullptr)
         return MEDIATYPE_UNKNOWN;
 
     dsk2woz_info();
     dsk2woz_tmap();
-	dsk2woz_tracks(dsk);
+	dsk2woz_tracks();
 
-    free(dsk);
+    mount_ms = fnSystem.millis() - start_ms;
+    Debug_printf("\nDSK mounted in %lu ms, tracks are nibblized on demand", (unsigned long)mount_ms);
     return MEDIATYPE_WOZ;
 }
 
+MediaTypeDSK::~MediaTypeDSK()
+{
+    free(dsk_track);
+}
+
+void MediaTypeDSK::unmount()
+{
+    MediaTypeWOZ::unmount();
+    free(dsk_track);
+    dsk_track = nullptr;
+}
+
+bool MediaTypeDSK::read_track(int trk, uint8_t *dest)
+{
+    if (fnio::fseek(_media_fileh, trk * BYTES_PER_TRACK, SEEK_SET) != 0)
+        return true;
+    if (fnio::fread(dsk_track, 1, BYTES_PER_TRACK, _media_fileh) != BYTES_PER_TRACK)
+        return true;
+    serialise_track(dest, dsk_track, trk, _mediatype == MEDIATYPE_PO);
+    return false;
+}
+
 void MediaTypeDSK::dsk2woz_info()
 {
 	optimal_bit_timing = WOZ1_BIT_TIME; // 4 us
@@ -149,7 +165,7 @@ void MediaTypeDSK::dsk2woz_tmap()
 #endif
 }
 
-bool MediaTypeDSK::dsk2woz_tracks(uint8_t *dsk)
+bool MediaTypeDSK::dsk2woz_tracks()
 {    // depend upon little endian-ness
 
     // woz1 track data organized as:
@@ -162,44 +178,16 @@ bool MediaTypeDSK::dsk2woz_tracks(uint8_t *dsk)
     // +6653	uint8	    Splice Bit Count	Bit count of splice nibble (write hint).
     // +6654	uint16		Reserved for future use.
 
-    // Debug_printf("\nStart Block, Block Count, Bit Count");
-    
 	Debug_printf("\nMediaTypeDSK is_prodos: %s", _mediatype == MEDIATYPE_PO ? "Y" : "N");
 
-	// TODO: adapt this to that
-	// Write out all tracks.
+	// Every serialised track has the same layout, so the sizes are known
+	// without nibblizing anything.
 	for (size_t c = 0; c < num_tracks; c++)
 	{
-		uint16_t bytes_used;
-		uint16_t bit_count;
-#ifdef ESP_PLATFORM
-		uint8_t* temp_ptr = (uint8_t *)heap_caps_malloc(WOZ1_NUM_BLKS * 512, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#else
-		uint8_t* temp_ptr = (uint8_t *)malloc(WOZ1_NUM_BLKS * 512);
-#endif
-		if (temp_ptr != nullptr)
-		{
-			trk_ptrs[c] = temp_ptr;
-			memset(trk_ptrs[c], 0, WOZ1_NUM_BLKS * 512);
-			serialise_track(trk_ptrs[c], &dsk[c * 16 * 256], c, _mediatype == MEDIATYPE_PO);
-			temp_ptr += WOZ1_TRACK_LEN;
-			bytes_used = temp_ptr[0] + (temp_ptr[1] << 8);
-			temp_ptr += sizeof(uint16_t);
-			bit_count = temp_ptr[0] + (temp_ptr[1] << 8);
-			trks[c].block_count = WOZ1_NUM_BLKS; //bytes_used / 512;
-			// if (bytes_used % 512)
-			// 	trks[c].block_count++;
-			trks[c].bit_count = bit_count;
-			Debug_printf("\nStored %d bytes containing %d bits of track %d into location %lu", bytes_used, bit_count, c, trk_ptrs[c]);
-			Debug_printf(" -- %02x %02x %02x %02x %02x", trk_ptrs[c][0], trk_ptrs[c][1], trk_ptrs[c][2], trk_ptrs[c][3], trk_ptrs[c][4] );
-		}
-		else
-		{
-			Debug_printf("\nNo RAM allocated!");
-			free(temp_ptr);
-			return true;
-            }
+		trks[c].block_count = WOZ1_NUM_BLKS;
+		trks[c].bit_count = TRACK_BITS;
 	}
+	slot_size = WOZ1_NUM_BLKS * 512;
 	return false;
 }
 
@@ -498,6 +486,30 @@ uint16_t decode_6_and_2(uint8_t *dest, const uint8_t *src)
   return checksum;
 }
 
+/*!
+	Encodes a 256-byte sector and writes its 343 nibbles to a track, replacing
+	the bits already there. Used by serialise_track() and to update a single
+	sector of a resident track.
+
+	@param dest The WOZ track.
+	@param track_position The position of the first nibble, in bits.
+	@param src The 256-byte source data.
+	@return The position immediately after the sector contents.
+*/
+static size_t write_sector_data(uint8_t *dest, size_t track_position, const uint8_t *src) {
+	uint8_t contents[343];
+	encode_6_and_2(contents, src);
+
+	const size_t shift = track_position & 7;
+	for(size_t c = 0; c < sizeof(contents); ++c) {
+		const size_t byte_position = track_position >> 3;
+		dest[byte_position] &= ~(0xff >> shift);
+		if(shift) dest[byte_position+1] &= ~(0xff << (8 - shift));
+		track_position = write_byte(dest, track_position, contents[c]);
+	}
+	return track_position;
+}
+
 /*!
 	Converts a DSK-style track to a WOZ-style track.
 
@@ -558,11 +570,7 @@ static void serialise_track(uint8_t *dest, const uint8_t *src, uint8_t track_num
 		const int logical_sector = (sector == 15) ? 15 : ((sector * (is_prodos ? 8 : 7)) % 15);
 
 		// Sector contents.
-		uint8_t contents[343];
-		encode_6_and_2(contents, &src[logical_sector * 256]);
-		for(size_t c = 0; c < sizeof(contents); ++c) {
-			track_position = write_byte(dest, track_position, contents[c]);			
-		}
+		track_position = write_sector_data(dest, track_position, &src[logical_sector * 256]);
 
 		// Epilogue.
 		track_position = write_byte(dest, track_position, 0xde);
@@ -20,15 +20,20 @@ class MediaTypeDSK  : public MediaTypeWOZ
 {
 private:
     size_t num_tracks = 0;
+    uint8_t *dsk_track = nullptr; // one decoded DSK track, for nibblizing
 
     void dsk2woz_info();
     void dsk2woz_tmap();
-    bool dsk2woz_tracks(uint8_t *dsk); 
+    bool dsk2woz_tracks();
+
+protected:
+    virtual bool read_track(int trk, uint8_t *dest) override;
 
 public:
+    virtual ~MediaTypeDSK();
 
     virtual mediatype_t mount(fnFile *f, uint32_t disksize) override;
-    // virtual void unmount() override;
+    virtual void unmount() override;
     virtual bool write_sector(int track, int sector, uint8_t *buffer) override;
 
     // static bool create(FILE *f, uint32_t numBlock);
@@ -5,6 +5,7 @@
 #endif
 #include "mediaTypeWOZ.h"
 #include "../../include/debug.h"
+#include "fnSystem.h"
 #include <string.h>
 
 #define WOZ1 '1'
@@ -18,8 +19,11 @@ bool MediaTypeWOZ::write_sector(int track, int sector, uint8_t *buffer)
 
 mediatype_t MediaTypeWOZ::mount(fnFile *f, uint32_t disksize)
 {
+    uint32_t start_ms = fnSystem.millis();
+
     _media_fileh = f;
     diskiiemulation = true;
+    reset_tracks();
     // check WOZ header
     if (wozX_check_header())
         return MEDIATYPE_UNKNOWN;
@@ -47,17 +51,126 @@ mediatype_t MediaTypeWOZ::mount(fnFile *f, uint32_t disksize)
         return MEDIATYPE_UNKNOWN;
     }
 
+    mount_ms = fnSystem.millis() - start_ms;
+    Debug_printf("\nWOZ mounted in %lu ms, tracks are loaded on demand", (unsigned long)mount_ms);
     return MEDIATYPE_WOZ;
 }
 
 void MediaTypeWOZ::unmount()
 {
     MediaType::unmount();
+    free_tracks();
+}
+
+void MediaTypeWOZ::reset_tracks()
+{
+    free_tracks();
+    memset(trks, 0, sizeof(trks));
+    memset(slot_trk, 0xFF, sizeof(slot_trk));
+    lru_clock = 0;
+    slot_size = 0;
+}
+
+void MediaTypeWOZ::free_tracks()
+{
     for (int i = 0; i < MAX_TRACKS; i++)
+        trk_ptrs[i] = nullptr;
+    for (int i = 0; i < WOZ_RESIDENT_TRACKS; i++)
+    {
+        if (slot_buf[i] != nullptr)
+            free(slot_buf[i]);
+        slot_buf[i] = nullptr;
+        slot_trk[i] = 0xFF;
+        slot_used[i] = 0;
+    }
+}
+
+size_t MediaTypeWOZ::resident_bytes()
+{
+    size_t n = 0;
+    for (int i = 0; i < WOZ_RESIDENT_TRACKS; i++)
+        if (slot_buf[i] != nullptr)
+            n += slot_size;
+    return n;
+}
+
+bool MediaTypeWOZ::load_track(int t)
+{
+    if (track_ready(t))
+        return false;
+
+    uint8_t trk = tmap[t];
+
+    // Pick a free slot, else the least recently used one. Tracks within a
+    // track of the head are left alone, the ISR may be copying them.
+    int victim = -1;
+    for (int i = 0; i < WOZ_RESIDENT_TRACKS && victim < 0; i++)
+        if (slot_buf[i] == nullptr || slot_trk[i] == 0xFF)
+            victim = i;
+    if (victim < 0)
+    {
+        for (int i = 0; i < WOZ_RESIDENT_TRACKS; i++)
+        {
+            bool near_head = false;
+            for (int q = t - 4; q <= t + 4 && !near_head; q++)
+                if (q >= 0 && q < MAX_TRACKS && tmap[q] == slot_trk[i])
+                    near_head = true;
+            if (!near_head && (victim < 0 || slot_used[i] < slot_used[victim]))
+                victim = i;
+        }
+        if (victim < 0)
+            victim = 0;
+    }
+
+    if (slot_buf[victim] == nullptr)
+    {
+#ifdef ESP_PLATFORM
+        slot_buf[victim] = (uint8_t *)heap_caps_malloc(slot_size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+#else
+        slot_buf[victim] = (uint8_t *)malloc(slot_size);
+#endif
+        if (slot_buf[victim] == nullptr)
+        {
+            Debug_printf("\nNo RAM allocated!");
+            return true;
+        }
+    }
+    else if (slot_trk[victim] != 0xFF)
+        trk_ptrs[slot_trk[victim]] = nullptr;
+    slot_trk[victim] = 0xFF;
+
+    memset(slot_buf[victim], 0, slot_size);
+    if (read_track(trk, slot_buf[victim]))
+    {
+        Debug_printf("\nError reading track %d", trk);
+        return true;
+    }
+
+    slot_trk[victim] = trk;
+    slot_used[victim] = ++lru_clock;
+    trk_ptrs[trk] = slot_buf[victim];
+    Debug_printf("\nLoaded track %d into slot %d, %u bytes resident", trk, victim, (unsigned)resident_bytes());
+    return false;
+}
+
+bool MediaTypeWOZ::read_track(int trk, uint8_t *dest)
+{
+    size_t s = trks[trk].block_count * 512;
+    long offset;
+
+    if (woz_version == WOZ1)
     {
-        if (trk_ptrs[i] != nullptr)
-            free(trk_ptrs[i]);
+        offset = 256 + trk * WOZ1_TRACK_STRIDE;
+        s = WOZ1_TRACK_LEN;
     }
+    else
+        offset = trks[trk].start_block * 512;
+
+    if (s > slot_size)
+        s = slot_size;
+    if (fnio::fseek(_media_fileh, offset, SEEK_SET) != 0)
+        return true;
+    return fnio::fread(dest, 1, s, _media_fileh) != s;
 }
 
 bool MediaTypeWOZ::wozX_check_header()
@@ -157,7 +270,6 @@ bool MediaTypeWOZ::wozX_read_tmap()
 
 bool MediaTypeWOZ::woz1_read_tracks()
 {    // depend upon little endian-ness
-    fnio::fseek(_media_fileh, 256, SEEK_SET);
 
     // woz1 track data organized as:
     // Offset	Size	    Name	        Usage
@@ -169,55 +281,36 @@ bool MediaTypeWOZ::woz1_read_tracks()
     // +6653	uint8	    Splice Bit Count	Bit count of splice nibble (write hint).
     // +6654	uint16		Reserved for future use.
 
+    // Only the sizes are read here, the bitstreams are loaded by load_track()
     Debug_printf("\nStart Block, Block Count, Bit Count");
-    
-#ifdef ESP_PLATFORM
-    uint8_t *temp_ptr = (uint8_t *)heap_caps_malloc(WOZ1_NUM_BLKS * 512, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-#else
-    uint8_t *temp_ptr = (uint8_t *)malloc(WOZ1_NUM_BLKS * 512);
-#endif
+
+    bool used[MAX_TRACKS] = { };
+    for (int i = 0; i < MAX_TRACKS; i++)
+        if (tmap[i] != 0xFF)
+            used[tmap[i]] = true;
+
     uint16_t bytes_used;
     uint16_t bit_count;
 
     for (int i = 0; i < MAX_TRACKS; i++)
     {
-        memset(temp_ptr, 0, WOZ1_NUM_BLKS * 512);
-        fnio::fread(temp_ptr, 1, WOZ1_TRACK_LEN, _media_fileh);
-        fnio::fread(&bytes_used, sizeof(bytes_used), 1, _media_fileh);
-        fnio::fread(&bit_count, sizeof(bit_count), 1, _media_fileh);
+        if (!used[i])
+            continue;
+        if (fnio::fseek(_media_fileh, 256 + i * WOZ1_TRACK_STRIDE + WOZ1_TRACK_LEN, SEEK_SET) != 0 ||
+            fnio::fread(&bytes_used, sizeof(bytes_used), 1, _media_fileh) != 1 ||
+            fnio::fread(&bit_count, sizeof(bit_count), 1, _media_fileh) != 1)
+        {
+            Debug_printf("\nTrack %d is missing!", i);
+            return true;
+        }
         trks[i].block_count = bytes_used / 512;
         if (bytes_used % 512)
             trks[i].block_count++;
         trks[i].bit_count = bit_count;
-        if (bit_count > 0)
-        {
-            size_t s = trks[i].block_count * 512;
-#ifdef ESP_PLATFORM
-            trk_ptrs[i] = (uint8_t *)heap_caps_malloc(s, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#else
-            trk_ptrs[i] = (uint8_t *)malloc(s);
-#endif
-            if (trk_ptrs[i] != nullptr)
-            {
-                Debug_printf("\nStoring %d bytes of track %d into location %lu", bytes_used, i, trk_ptrs[i]);
-                memset(trk_ptrs[i],0,s);
-                memcpy(trk_ptrs[i], temp_ptr, bytes_used);
-            }
-            else
-            {
-                Debug_printf("\nNo RAM allocated!");
-                free(temp_ptr);
-                return true;
-            }
-        }
-        else
-        {
-            trk_ptrs[i] = nullptr;
+        if (bit_count == 0)
             Debug_printf("\nTrack %d is blank!",i);
-        }
-        fnio::fread(temp_ptr, 1, 6, _media_fileh); // read through rest of bytes in track
     }
-    free(temp_ptr);
+    slot_size = WOZ1_NUM_BLKS * 512;
     return false;
 }
 
@@ -230,31 +323,11 @@ bool MediaTypeWOZ::woz2_read_tracks()
     for (int i=0; i<MAX_TRACKS; i++)
         Debug_printf("\n%d, %d, %lu", trks[i].start_block, trks[i].block_count, trks[i].bit_count);
 #endif
-    // read WOZ tracks into RAM
+    // tracks are loaded by load_track(), size the buffers for the largest one
+    slot_size = 0;
     for (int i=0; i<MAX_TRACKS; i++)
-    {
-        size_t s = trks[i].block_count * 512;
-        if (s != 0)
-        {
-#ifdef ESP_PLATFORM
-            trk_ptrs[i] = (uint8_t *)heap_caps_malloc(s, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#else
-            trk_ptrs[i] = (uint8_t *)malloc(s);
-#endif
-            if (trk_ptrs[i] != nullptr)
-            {
-                Debug_printf("\nReading %d bytes of track %d into location %lu", s, i, trk_ptrs[i]);
-                fnio::fseek(_media_fileh, trks[i].start_block * 512, SEEK_SET);
-                fnio::fread(trk_ptrs[i], 1, s, _media_fileh);
-                Debug_printf("\n%d, %d, %lu", trks[i].start_block, trks[i].block_count, trks[i].bit_count);
-            }
-            else
-            {
-                Debug_printf("\nNo RAM allocated!");
-                return true;
-            }
-        }
-    }
+        if (trks[i].block_count * 512 > slot_size)
+            slot_size = trks[i].block_count * 512;
     return false;
 }
 
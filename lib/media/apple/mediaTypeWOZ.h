@@ -9,6 +9,8 @@
 #define WOZ1_TRACK_LEN 6646
 #define WOZ1_NUM_BLKS 13
 #define WOZ1_BIT_TIME 32
+#define WOZ1_TRACK_STRIDE 6656
+#define WOZ_RESIDENT_TRACKS 8 // track buffers kept in RAM, loaded on demand
 struct TRK_t
 {
     uint16_t start_block;
@@ -28,12 +30,28 @@ private:
     bool woz1_read_tracks();
     bool woz2_read_tracks();
 
+    // Track buffers, allocated on first use and reused until unmount, so the
+    // phase ISR never sees memory being freed under it.
+    uint8_t *slot_buf[WOZ_RESIDENT_TRACKS] = { };
+    uint8_t slot_trk[WOZ_RESIDENT_TRACKS];
+    uint32_t slot_used[WOZ_RESIDENT_TRACKS] = { };
+    uint32_t lru_clock = 0;
+
 protected:
     uint8_t tmap[MAX_TRACKS];
     TRK_t trks[MAX_TRACKS];
-    uint8_t *trk_ptrs[MAX_TRACKS] = { };
+    uint8_t *trk_ptrs[MAX_TRACKS] = { }; // resident tracks only
+    size_t slot_size = 0;
+    uint32_t mount_ms = 0;
+
+    void reset_tracks();
+    void free_tracks();
+    // Fill dest (slot_size bytes) with track trk from the image
+    virtual bool read_track(int trk, uint8_t *dest);
 
 public:
+    virtual ~MediaTypeWOZ() { free_tracks(); };
+
     virtual bool read(uint32_t blockNum, uint16_t *count, uint8_t* buffer) override { return false; };
     virtual bool write(uint32_t blockNum, uint16_t *count, uint8_t* buffer) override { return false; };
     virtual bool write_sector(int track, int sector, uint8_t *buffer) override;
@@ -46,7 +64,22 @@ public:
     virtual bool status() override {return (_media_fileh != nullptr);}
 
     uint8_t trackmap(uint8_t t) { return tmap[t]; };
-    uint8_t *get_track(int t) { return trk_ptrs[tmap[t]]; };
+    // nullptr for blank tracks and for tracks that are not resident yet, see track_ready()
+    uint8_t *get_track(int t)
+    {
+        uint8_t *p = trk_ptrs[tmap[t]];
+        if (p != nullptr)
+            for (int i = 0; i < WOZ_RESIDENT_TRACKS; i++)
+                if (slot_buf[i] == p)
+                    slot_used[i] = ++lru_clock;
+        return p;
+    };
+    bool track_ready(int t) { return tmap[t] == 0xFF || trks[tmap[t]].bit_count == 0 || trk_ptrs[tmap[t]] != nullptr; };
+    // Make the track at quarter track t resident. Task context only, may evict
+    // the least recently used track that is not next to the head.
+    bool load_track(int t);
+    size_t resident_bytes();
+    uint32_t mount_time() { return mount_ms; };
     int track_len(int t) { return trks[tmap[t]].block_count * 512; };
     int num_bits(int t) { return trks[tmap[t]].bit_count; };
     uint8_t optimal_bit_timing;
@@ -98,6 +98,11 @@ public:
     
     virtual void status(uint8_t statusbuff[4]) = 0;
 
+    // Write out any buffered sectors. Returns TRUE if an error condition occurred
+    virtual bool flush() { return false; };
+    // Called while the bus has nothing else to do
+    virtual void idle() {};
+
     static mediatype_t discover_disktype(const char *filename);
 
     void dump_percom_block();
@@ -7,6 +7,8 @@
 #include <unistd.h>
 #include <errno.h>
 
+#include <algorithm>
+
 #include "../../include/debug.h"
 
 #include "disk.h"
@@ -51,6 +53,65 @@ uint32_t MediaTypeATR::_sector_to_offset(uint16_t sectorNum)
     return offset;
 }
 
+// Returns number of bytes taken by count sectors starting at first
+uint32_t MediaTypeATR::_extent_size(uint16_t first, uint16_t count)
+{
+    uint16_t last = first + count - 1;
+    return _sector_to_offset(last) + sector_size(last) - _sector_to_offset(first);
+}
+
+// Sectors are stored back to back, so a run of them is one read.
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::_read_sectors(uint16_t first, uint16_t count, uint8_t *buf)
+{
+    bool err = false;
+    // Perform a seek if we're not reading the sector after the last one we accessed
+    if (first != _disk_last_sector + 1)
+        err = fnio::fseek(_disk_fileh, _sector_to_offset(first), SEEK_SET) != 0;
+
+    uint32_t size = _extent_size(first, count);
+    if (err == false)
+        err = fnio::fread(buf, 1, size, _disk_fileh) != size;
+
+    if (err == false)
+        _disk_last_sector = first + count - 1;
+    else
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+
+    return err;
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::_write_sectors(uint16_t first, uint16_t count, const uint8_t *buf)
+{
+    // Perform a seek if we're not writing the sector after the last one we accessed
+    if (first != _disk_last_sector + 1)
+    {
+        int e = fnio::fseek(_disk_fileh, _sector_to_offset(first), SEEK_SET);
+        if (e != 0)
+        {
+            Debug_printf("::write seek error %d\r\n", e);
+            _disk_last_sector = INVALID_SECTOR_VALUE;
+            return true;
+        }
+    }
+
+    uint32_t size = _extent_size(first, count);
+    size_t e = fnio::fwrite(buf, 1, size, _disk_fileh);
+    if (e != size)
+    {
+        Debug_printf("::write error %u, %d\r\n", (unsigned)e, errno);
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+        return true;
+    }
+
+    int ret = fnio::fflush(_disk_fileh); // Since we might get reset at any moment, go ahead and sync the file
+    Debug_printf("ATR::write fflush:%d\r\n", ret);
+
+    _disk_last_sector = first + count - 1;
+    return false;
+}
+
 // Returns TRUE if an error condition occurred
 bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 {
@@ -69,21 +130,43 @@ bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 
     memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
 
+    // Sectors still waiting to be written are newer than the image
+    if (_dirty_count > 0 && sectornum >= _dirty_first && sectornum < _dirty_first + _dirty_count)
+    {
+        memcpy(_disk_sectorbuff, &_dirty[_sector_to_offset(sectornum) - _sector_to_offset(_dirty_first)], sectorSize);
+        _last_read = sectornum;
+        *readcount = sectorSize;
+        return false;
+    }
+
     bool err = false;
-    // Perform a seek if we're not reading the sector after the last one we read
-    if (sectornum != _disk_last_sector + 1)
+    // Fetch the sector if it isn't in the window. Reading in sequence also brings in the ones after it.
+    if (sectornum < _cache_first || sectornum >= _cache_first + _cache_count)
     {
-        uint32_t offset = _sector_to_offset(sectornum);
-        err = fnio::fseek(_disk_fileh, offset, SEEK_SET) != 0;
+        uint16_t count = 1;
+        if (sectornum == _last_read + 1)
+            count = std::min<uint32_t>(ATR_CACHE_SECTORS, _disk_num_sectors - sectornum + 1);
+
+        _cache_count = 0;
+        err = _read_sectors(sectornum, count, _cache.data());
+        // The image may be shorter than its header says, try the sector on its own
+        if (err && count > 1)
+        {
+            count = 1;
+            err = _read_sectors(sectornum, count, _cache.data());
+        }
+
+        if (err == false)
+        {
+            _cache_first = sectornum;
+            _cache_count = count;
+        }
     }
 
     if (err == false)
-        err = fnio::fread(_disk_sectorbuff, 1, sectorSize, _disk_fileh) != sectorSize;
+        memcpy(_disk_sectorbuff, &_cache[_sector_to_offset(sectornum) - _sector_to_offset(_cache_first)], sectorSize);
 
-    if (err == false)
-        _disk_last_sector = sectornum;
-    else
-        _disk_last_sector = INVALID_SECTOR_VALUE;
+    _last_read = sectornum;
 
     *readcount = sectorSize;
 
@@ -95,23 +178,15 @@ bool inHighScoreRange(int minimum, int maximum, int val)
     return ((minimum <= val) && (val <= maximum));
 }
 
+// Write the sector straight to the image, reopening it for high score mode.
 // Returns TRUE if an error condition occurred
-bool MediaTypeATR::write(uint16_t sectornum, bool verify)
+bool MediaTypeATR::_write_through(uint16_t sectornum)
 {
     fnFile *oldFileh, *hsFileh;
 
     oldFileh = nullptr;
     hsFileh = nullptr;
 
-    Debug_printf("ATR WRITE %d / %d\r\n", sectornum, _disk_num_sectors);
-
-    // Return an error if we're trying to write beyond the end of the disk
-    if (sectornum > _disk_num_sectors)
-    {
-        Debug_printf("::write sector %d > %d\r\n", sectornum, _disk_num_sectors);
-        return true;
-    }
-
     if (_high_score_sector != 0)
     {
         Debug_printf("High score mode activated, attempting write open\r\n");
@@ -125,50 +200,131 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
             hsFileh = _disk_host->fnfile_open(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "rb+");
             _disk_fileh = hsFileh;
         }
+        _disk_last_sector = INVALID_SECTOR_VALUE;
     }
-    uint16_t sectorSize = sector_size(sectornum);
-    uint32_t offset = _sector_to_offset(sectornum);
 
-    _disk_last_sector = INVALID_SECTOR_VALUE;
+    bool err = _write_sectors(sectornum, 1, _disk_sectorbuff);
 
-    // Perform a seek if we're writing to the sector after the last one
-    int e;
-    if (sectornum != _disk_last_sector + 1)
+    if (_high_score_sector != 0)
     {
-        e = fnio::fseek(_disk_fileh, offset, SEEK_SET);
-        if (e != 0)
-        {
-            Debug_printf("::write seek error %d\r\n", e);
-            return true;
-        }
+        Debug_printf("Closing high score sector.\r\n");
+
+        if (hsFileh != nullptr)
+            fnio::fclose(hsFileh);
+
+        _disk_fileh = oldFileh;
+        _disk_last_sector = INVALID_SECTOR_VALUE; // force a cache invalidate.
     }
-    // Write the data
-    e = fnio::fwrite(_disk_sectorbuff, 1, sectorSize, _disk_fileh);
-    if (e != sectorSize)
+
+    return err;
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::write(uint16_t sectornum, bool verify)
+{
+    Debug_printf("ATR WRITE %d / %d\r\n", sectornum, _disk_num_sectors);
+
+    // Return an error if we're trying to write beyond the end of the disk
+    if (sectornum > _disk_num_sectors)
     {
-        Debug_printf("::write error %d, %d\r\n", e, errno);
+        Debug_printf("::write sector %d > %d\r\n", sectornum, _disk_num_sectors);
         return true;
     }
 
-    int ret = fnio::fflush(_disk_fileh); // Since we might get reset at any moment, go ahead and sync the file
-    Debug_printf("ATR::write fflush:%d\r\n", ret);
+    uint16_t sectorSize = sector_size(sectornum);
 
-    if (_high_score_sector != 0)
+    // Until a write succeeded we don't know if the image can be written at all, and the
+    // error has to be reported for the sector at hand. High score writes reopen the file each
+    // time, and a write with verify has to be in the image before it is acknowledged.
+    if (_high_score_sector != 0 || _writable == false || verify)
     {
-        Debug_printf("Closing high score sector.\r\n");
+        // Anything pending goes first, so an older copy can't overwrite this one later
+        if (flush())
+            return true;
 
-        if (hsFileh != nullptr)
-            fnio::fclose(hsFileh);
+        bool err = _write_through(sectornum);
+        if (err == false)
+        {
+            // Keep the read-ahead window current
+            if (sectornum >= _cache_first && sectornum < _cache_first + _cache_count)
+                memcpy(&_cache[_sector_to_offset(sectornum) - _sector_to_offset(_cache_first)], _disk_sectorbuff, sectorSize);
+            _writable = _high_score_sector == 0;
+        }
+        return err;
+    }
 
-        _disk_fileh = oldFileh;
-        _disk_last_sector = INVALID_SECTOR_VALUE; // force a cache invalidate.
+    // Add to the pending run if it continues or overlaps it, otherwise write that out first
+    if (_dirty_count == 0 || sectornum < _dirty_first || sectornum > _dirty_first + _dirty_count ||
+        (sectornum == _dirty_first + _dirty_count && _dirty_count == ATR_CACHE_SECTORS))
+    {
+        if (flush())
+            return true;
+        _dirty_first = sectornum;
+    }
+
+    if (_dirty.empty())
+        _dirty.resize(_cache.size());
+    memcpy(&_dirty[_sector_to_offset(sectornum) - _sector_to_offset(_dirty_first)], _disk_sectorbuff, sectorSize);
+    if (sectornum == _dirty_first + _dirty_count)
+        _dirty_count++;
+    _dirty_ms = fnSystem.millis();
+
+    return false;
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::flush()
+{
+    if (_dirty_count == 0)
+        return false;
+
+    Debug_printf("ATR FLUSH %u sectors from %u\r\n", _dirty_count, _dirty_first);
+
+    // Keep the run if it failed, idle() tries again and the next status reports it
+    if (_write_sectors(_dirty_first, _dirty_count, _dirty.data()))
+    {
+        _write_failed = true;
+        _dirty_ms = fnSystem.millis();
+        return true;
     }
-    else
-        _disk_last_sector = sectornum;
 
+    // Now the image has it, bring the read-ahead window up to date
+    uint16_t first = std::max(_cache_first, _dirty_first);
+    int last = std::min(_cache_first + _cache_count, _dirty_first + _dirty_count) - 1;
+    if (_cache_count > 0 && first <= last)
+        memcpy(&_cache[_sector_to_offset(first) - _sector_to_offset(_cache_first)],
+               &_dirty[_sector_to_offset(first) - _sector_to_offset(_dirty_first)],
+               _extent_size(first, last - first + 1));
+
+    _dirty_count = 0;
     return false;
 }
 
+void MediaTypeATR::idle()
+{
+    if (_dirty_count > 0 && fnSystem.millis() - _dirty_ms >= ATR_WRITE_BEHIND_MS)
+        flush();
+}
+
+void MediaTypeATR::unmount()
+{
+    if (flush())
+        Debug_printf("ATR unmount lost %u unwritten sectors from %u\r\n", _dirty_count, _dirty_first);
+
+    std::vector<uint8_t>().swap(_cache);
+    std::vector<uint8_t>().swap(_dirty);
+    _cache_count = 0;
+    _writable = false;
+
+    MediaType::unmount();
+}
+
+MediaTypeATR::~MediaTypeATR()
+{
+    // The base class destructor only closes the file
+    flush();
+}
+
 void MediaTypeATR::status(uint8_t statusbuff[4])
 {
     statusbuff[0] = DISK_DRIVE_STATUS_CLEAR;
@@ -183,6 +339,11 @@ void MediaTypeATR::status(uint8_t statusbuff[4])
 
 
 
+    // A buffered write that failed after it was acknowledged
+    if (_write_failed)
+        statusbuff[0] |= DISK_DRIVE_STATUS_PUT_FAILED;
+    _write_failed = false;
+
     statusbuff[1] = ~_disk_controller_status; // Negate the controller status
 }
 
@@ -267,6 +428,13 @@ mediatype_t MediaTypeATR::mount(fnFile *f, uint32_t disksize)
     _disk_image_size = disksize;
     _disk_last_sector = INVALID_SECTOR_VALUE;
 
+    _cache.assign(ATR_CACHE_SECTORS * std::max<uint16_t>(_disk_sector_size, DISK_BYTES_PER_SECTOR_SINGLE), 0);
+    _cache_count = 0;
+    _dirty.clear();
+    _dirty_count = 0;
+    _writable = false;
+    _write_failed = false;
+
     _high_score_sector = UINT16_FROM_HILOBYTES(buf[14], buf[13]);
     _high_score_num_sectors = buf[12] - 1;
 
@@ -1,14 +1,50 @@
 #ifndef _MEDIATYPE_ATR_
 #define _MEDIATYPE_ATR_
 
+#include <vector>
+
 #include "diskType.h"
 
+// Sectors held by the read-ahead window and by the write-behind extent
+#define ATR_CACHE_SECTORS 16
+// Buffered writes are flushed once the bus has been idle this long, a failed flush is retried as often
+#define ATR_WRITE_BEHIND_MS 500
+
 class MediaTypeATR : public MediaType
 {
 private:
     uint32_t _sector_to_offset(uint16_t sectorNum);
+    uint32_t _extent_size(uint16_t first, uint16_t count);
+
+    bool _read_sectors(uint16_t first, uint16_t count, uint8_t *buf);
+    bool _write_sectors(uint16_t first, uint16_t count, const uint8_t *buf);
+    bool _write_through(uint16_t sectornum);
+
+    // Read-ahead window, filled when sectors are read in sequence
+    std::vector<uint8_t> _cache;
+    uint16_t _cache_first = 0;
+    uint16_t _cache_count = 0;
+    uint16_t _last_read = 0;
+
+    // Run of consecutive sectors written but not yet stored in the image, kept until it is
+    std::vector<uint8_t> _dirty;
+    uint16_t _dirty_first = 0;
+    uint16_t _dirty_count = 0;
+    uint64_t _dirty_ms = 0;
+
+    // A buffered write failed since the last status, reported there
+    bool _write_failed = false;
+
+    // Set once a write went through, so the image is known to be writable
+    bool _writable = false;
 
 public:
+    virtual ~MediaTypeATR();
+
+    virtual void unmount() override;
+    virtual bool flush() override;
+    virtual void idle() override;
+
     virtual bool read(uint16_t sectornum, uint16_t *readcount) override;
     virtual bool write(uint16_t sectornum, bool verify) override;
 
@@ -4,6 +4,7 @@
 
 #include <unistd.h>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <errno.h>
 
@@ -15,6 +16,86 @@ uint32_t MediaTypeDSK::_block_to_offset(uint32_t blockNum)
     return blockNum * MEDIA_BLOCK_SIZE;
 }
 
+// Returns TRUE if an error condition occurred
+bool MediaTypeDSK::_read_blocks(uint32_t blockNum, uint8_t *buf, uint16_t count)
+{
+    bool err = false;
+    // Perform a seek if the file isn't already at this block
+    if (blockNum != _file_block)
+    {
+        uint32_t offset = _block_to_offset(blockNum);
+        err = fnio::fseek(_media_fileh, offset, SEEK_SET) != 0;
+    }
+
+    size_t len = count * MEDIA_BLOCK_SIZE;
+    if (err == false)
+        err = fnio::fread(buf, 1, len, _media_fileh) != len;
+
+    _file_block = err ? INVALID_SECTOR_VALUE : blockNum + count;
+    return err;
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeDSK::_write_blocks(uint32_t blockNum, const uint8_t *buf, uint16_t count)
+{
+    // Always seek, stdio needs one between reading and writing
+    int e = fnio::fseek(_media_fileh, _block_to_offset(blockNum), SEEK_SET);
+    if (e != 0)
+    {
+        Debug_printf("::write seek error %d\n", e);
+        _file_block = INVALID_SECTOR_VALUE;
+        return true;
+    }
+
+    size_t len = count * MEDIA_BLOCK_SIZE;
+    size_t n = fnio::fwrite(buf, 1, len, _media_fileh);
+    if (n != len)
+    {
+        Debug_printf("::write error %u, %d\n", (unsigned)n, errno);
+        _file_block = INVALID_SECTOR_VALUE;
+        return true;
+    }
+
+    _file_block = blockNum + count;
+    return false;
+}
+
+// Read up to a track's worth of blocks from blockNum in one go
+// Returns TRUE if an error condition occurred
+bool MediaTypeDSK::_read_track(uint32_t blockNum)
+{
+    _track_count = 0;
+
+    uint32_t count = _media_num_blocks - blockNum;
+    if (count > DSK_TRACK_BLOCKS)
+        count = DSK_TRACK_BLOCKS;
+    if (count < 2)
+        return true;
+
+    if (_track_buff == nullptr)
+        _track_buff = (uint8_t *)malloc(DSK_TRACK_BLOCKS * MEDIA_BLOCK_SIZE);
+    if (_track_buff == nullptr || _read_blocks(blockNum, _track_buff, count))
+        return true;
+
+    // Blocks waiting to be written are newer than the file
+    for (int i = 0; i < _dirty_count; i++)
+        if (_dirty_blocks[i] - blockNum < count)
+            memcpy(_track_buff + (_dirty_blocks[i] - blockNum) * MEDIA_BLOCK_SIZE,
+                   _dirty_buff + i * MEDIA_BLOCK_SIZE, MEDIA_BLOCK_SIZE);
+
+    _track_first = blockNum;
+    _track_count = count;
+    return false;
+}
+
+int MediaTypeDSK::_dirty_index(uint32_t blockNum)
+{
+    for (int i = 0; i < _dirty_count; i++)
+        if (_dirty_blocks[i] == blockNum)
+            return i;
+    return -1;
+}
+
 // Returns TRUE if an error condition occurred
 bool MediaTypeDSK::read(uint32_t blockNum, uint16_t *readcount)
 {
@@ -31,53 +112,125 @@ bool MediaTypeDSK::read(uint32_t blockNum, uint16_t *readcount)
         return true;
     }
 
-    memset(_media_blockbuff, 0, sizeof(_media_blockbuff));
+    bool sequential = blockNum == _last_read + 1;
+    _last_read = blockNum;
+    _media_controller_status = 0;
 
-    bool err = false;
-    // Perform a seek if we're not reading the sector after the last one we read
-    if (blockNum != _media_last_block + 1)
+    const uint8_t *cached = nullptr;
+    int i = _dirty_index(blockNum);
+    if (i >= 0)
+        cached = _dirty_buff + i * MEDIA_BLOCK_SIZE;
+    else
     {
-        uint32_t offset = _block_to_offset(blockNum);
-        err = fnio::fseek(_media_fileh, offset, SEEK_SET) != 0;
+        // Once reads are sequential, fetch a track ahead and serve the rest of it from memory
+        if (blockNum - _track_first >= _track_count && sequential)
+            _read_track(blockNum);
+        if (blockNum - _track_first < _track_count)
+            cached = _track_buff + (blockNum - _track_first) * MEDIA_BLOCK_SIZE;
+    }
+
+    if (cached != nullptr)
+    {
+        memcpy(_media_blockbuff, cached, MEDIA_BLOCK_SIZE);
+        _media_last_block = blockNum;
+        return false;
     }
-    
-    if (err == false)
-        err = fnio::fread(_media_blockbuff, 1, MEDIA_BLOCK_SIZE, _media_fileh) != MEDIA_BLOCK_SIZE;
+
+    memset(_media_blockbuff, 0, sizeof(_media_blockbuff));
+
+    bool err = _read_blocks(blockNum, _media_blockbuff, 1);
 
     if (err == false)
         _media_last_block = blockNum;
     else
         _media_last_block = INVALID_SECTOR_VALUE;
 
-    _media_controller_status = 0;
-
     return err;
 }
 
+// Writes are held back and go to the file together in flush()
 // Returns TRUE if an error condition occurred
 bool MediaTypeDSK::write(uint32_t blockNum, bool verify)
 {
     // Debug_printf("DSK WRITE\n", blockNum, _media_num_blocks);
 
-    uint32_t offset = _block_to_offset(blockNum);
-
     _media_last_block = INVALID_SECTOR_VALUE;
 
-    // Perform a seek if we're writing to the sector after the last one
-    int e;
-    e = fnio::fseek(_media_fileh, offset, SEEK_SET);
-    if (e != 0)
-    {
-        Debug_printf("::write seek error %d\n", e);
-        _media_controller_status = 2;
+    // A failed flush is reported on the next write, unless it goes through now
+    if (_write_error && flush())
         return true;
+
+    // Keep the read ahead current
+    if (blockNum - _track_first < _track_count)
+        memcpy(_track_buff + (blockNum - _track_first) * MEDIA_BLOCK_SIZE, _media_blockbuff, MEDIA_BLOCK_SIZE);
+
+    if (_dirty_buff == nullptr)
+        _dirty_buff = (uint8_t *)malloc(DSK_DIRTY_BLOCKS * MEDIA_BLOCK_SIZE);
+    if (_dirty_buff == nullptr)
+    {
+        // No memory to hold it back, write it through
+        if (_write_blocks(blockNum, _media_blockbuff, 1))
+        {
+            _media_controller_status = 2;
+            return true;
+        }
+        fnio::fflush(_media_fileh);
+        _media_controller_status = 0;
+        return false;
     }
-    // Write the data
-    e = fnio::fwrite(&_media_blockbuff, 1, MEDIA_BLOCK_SIZE, _media_fileh);
 
-    if (e != MEDIA_BLOCK_SIZE)
+    int i = _dirty_index(blockNum);
+    if (i < 0)
     {
-        Debug_printf("::write error %d, %d\n", e, errno);
+        if (_dirty_count == DSK_DIRTY_BLOCKS && flush())
+            return true;
+
+        // Insert in block order, so runs of blocks can be written at once
+        i = 0;
+        while (i < _dirty_count && _dirty_blocks[i] < blockNum)
+            i++;
+        memmove(&_dirty_blocks[i + 1], &_dirty_blocks[i], (_dirty_count - i) * sizeof(_dirty_blocks[0]));
+        memmove(_dirty_buff + (i + 1) * MEDIA_BLOCK_SIZE, _dirty_buff + i * MEDIA_BLOCK_SIZE,
+                (_dirty_count - i) * MEDIA_BLOCK_SIZE);
+        _dirty_blocks[i] = blockNum;
+        _dirty_count++;
+    }
+    memcpy(_dirty_buff + i * MEDIA_BLOCK_SIZE, _media_blockbuff, MEDIA_BLOCK_SIZE);
+
+    _media_controller_status = 0;
+    return false;
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeDSK::flush()
+{
+    if (_dirty_count == 0)
+        return false;
+
+    bool err = false;
+    int i = 0;
+    // One write for each run of consecutive blocks
+    while (i < _dirty_count)
+    {
+        int n = 1;
+        while (i + n < _dirty_count && _dirty_blocks[i + n] == _dirty_blocks[i] + n)
+            n++;
+        err = _write_blocks(_dirty_blocks[i], _dirty_buff + i * MEDIA_BLOCK_SIZE, n);
+        if (err)
+            break;
+        i += n;
+    }
+
+    // Keep the blocks that didn't make it to the file, the next write or flush tries them again
+    _dirty_count -= i;
+    memmove(&_dirty_blocks[0], &_dirty_blocks[i], _dirty_count * sizeof(_dirty_blocks[0]));
+    memmove(_dirty_buff, _dirty_buff + i * MEDIA_BLOCK_SIZE, _dirty_count * MEDIA_BLOCK_SIZE);
+    _write_error = err;
+
+    if (err)
+    {
+        Debug_printf("DSK::flush %u blocks not written\n", (unsigned)_dirty_count);
+        _media_controller_status = 2;
         return true;
     }
 
@@ -88,15 +241,16 @@ bool MediaTypeDSK::write(uint32_t blockNum, bool verify)
     // https://discord.com/channels/655893677146636301/1209535440915406848/1231880068528214026
     // fnio::fflush() should be sufficient for syncing as well.
 //    ret = fsync(fileno(_media_fileh)); // Since we might get reset at any moment, go ahead and sync the file (not clear if fflush does this)
-    Debug_printf("DSK::write fsync:%d\n", ret);
+    Debug_printf("DSK::flush fsync:%d\n", ret);
 
-    _media_last_block = INVALID_SECTOR_VALUE;
-    _media_controller_status = 0;
     return false;
 }
 
 uint8_t MediaTypeDSK::status()
 {
+    // Held blocks that could not be written are an error until they are
+    if (_write_error)
+        return 2;
     return _media_controller_status;
 }
 
@@ -114,9 +268,36 @@ mediatype_t MediaTypeDSK::mount(fnFile *f, uint32_t disksize)
     _mediatype = MEDIATYPE_DSK;
     _media_num_blocks = disksize / MEDIA_BLOCK_SIZE;
 
+    _file_block = INVALID_SECTOR_VALUE;
+    _last_read = INVALID_SECTOR_VALUE;
+    _track_count = 0;
+    _dirty_count = 0;
+    _write_error = false;
+
     return _mediatype;
 }
 
+void MediaTypeDSK::unmount()
+{
+    if (_media_fileh != nullptr)
+        flush();
+
+    free(_track_buff);
+    free(_dirty_buff);
+    _track_buff = nullptr;
+    _dirty_buff = nullptr;
+    _track_count = 0;
+    _dirty_count = 0;
+    _write_error = false;
+
+    MediaType::unmount();
+}
+
+MediaTypeDSK::~MediaTypeDSK()
+{
+    unmount();
+}
+
 // Returns FALSE on error
 bool MediaTypeDSK::create(FILE *f, uint32_t numBlocks)
 {
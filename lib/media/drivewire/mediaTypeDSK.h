@@ -5,18 +5,47 @@
 
 #include "mediaType.h"
 
+#define DSK_TRACK_BLOCKS 18 // sectors read ahead once reads are sequential, one CoCo track
+#define DSK_DIRTY_BLOCKS 18 // sectors written back together
+
 class MediaTypeDSK : public MediaType
 {
 private:
     uint32_t _block_to_offset(uint32_t blockNum);
 
+    // Block the file is positioned at, saves a seek for sequential access
+    uint32_t _file_block = INVALID_SECTOR_VALUE;
+    // Last block asked for, to spot sequential reads
+    uint32_t _last_read = INVALID_SECTOR_VALUE;
+
+    // Read ahead, _track_count blocks from _track_first
+    uint8_t *_track_buff = nullptr;
+    uint32_t _track_first = INVALID_SECTOR_VALUE;
+    uint16_t _track_count = 0;
+
+    // Written blocks not in the file yet, sorted by block number
+    uint8_t *_dirty_buff = nullptr;
+    uint32_t _dirty_blocks[DSK_DIRTY_BLOCKS];
+    uint8_t _dirty_count = 0;
+    // The last flush() left blocks in _dirty_buff
+    bool _write_error = false;
+
+    bool _read_blocks(uint32_t blockNum, uint8_t *buf, uint16_t count);
+    bool _write_blocks(uint32_t blockNum, const uint8_t *buf, uint16_t count);
+    bool _read_track(uint32_t blockNum);
+    int _dirty_index(uint32_t blockNum);
+
 public:
+    virtual ~MediaTypeDSK();
+
     virtual bool read(uint32_t blockNum, uint16_t *readcount) override;
     virtual bool write(uint32_t blockNum, bool verify) override;
+    virtual bool flush() override;
 
     virtual bool format(uint16_t *responsesize) override;
 
     virtual mediatype_t mount(fnFile *f, uint32_t disksize) override;
+    virtual void unmount() override;
 
     virtual uint8_t status() override;
 
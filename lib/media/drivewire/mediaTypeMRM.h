@@ -7,6 +7,8 @@
 
 #define MRM_BLOCK_SIZE  32768
 
+// No read ahead or held writes like MediaTypeDSK: a block is already 32K,
+// sequential reads skip the seek, and the images are never written.
 class MediaTypeMRM : public MediaType
 {
 private:
@@ -17,11 +17,13 @@
 #include <cstring>
 #include <memory>
 #include <iostream>
+#include <algorithm>
 #include <vector>
 
 #define ENTRY_BUFFER_SIZE 256
+#define DIR_BUFFER_FILL 512 // listing text kept formatted ahead of the host
 
-NetworkProtocolFS::NetworkProtocolFS(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolFS::NetworkProtocolFS(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     fileSize = 0;
@@ -95,10 +97,33 @@ bool NetworkProtocolFS::open_dir()
         return true;
     }
 
+    // Entries are fetched as the host reads the listing, see fill_dir_buffer()
+    dirEOF = false;
+    fill_dir_buffer(DIR_BUFFER_FILL);
+
+    return error != NETWORK_ERROR_SUCCESS;
+}
+
+void NetworkProtocolFS::fill_dir_buffer(size_t len)
+{
     std::vector<uint8_t> entryBuffer(ENTRY_BUFFER_SIZE);
 
-    while (read_dir_entry((char *)entryBuffer.data(), ENTRY_BUFFER_SIZE - 1) == false)
+    while (!dirEOF && dirBuffer.size() < len)
     {
+        if (read_dir_entry((char *)entryBuffer.data(), ENTRY_BUFFER_SIZE - 1) == true)
+        {
+            dirEOF = true;
+
+#ifdef BUILD_ATARI
+            // Finally, drop a FREE SECTORS trailer.
+            dirBuffer += "999+FREE SECTORS\x9b";
+#endif /* BUILD_ATARI */
+
+            if (error == NETWORK_ERROR_END_OF_FILE)
+                error = NETWORK_ERROR_SUCCESS;
+            break;
+        }
+
         if (aux2_open & 0x80)
         {
             // Long entry
@@ -117,16 +142,6 @@ bool NetworkProtocolFS::open_dir()
         // Clearing the buffer for reuse
         std::fill(entryBuffer.begin(), entryBuffer.end(), 0); // fenrock was right.
     }
-
-#ifdef BUILD_ATARI
-    // Finally, drop a FREE SECTORS trailer.
-    dirBuffer += "999+FREE SECTORS\x9b";
-#endif /* BUILD_ATARI */
-
-    if (error == NETWORK_ERROR_END_OF_FILE)
-        error = NETWORK_ERROR_SUCCESS;
-
-    return error != NETWORK_ERROR_SUCCESS;
 }
 
 void NetworkProtocolFS::update_dir_filename(PeoplesUrlParser *url)
@@ -199,25 +214,23 @@ bool NetworkProtocolFS::read(unsigned short len)
 
 bool NetworkProtocolFS::read_file(unsigned short len)
 {
-    std::vector<uint8_t> buf = std::vector<uint8_t>(len);
-
 #ifdef VERBOSE_HTTP
     Debug_printf("NetworkProtocolFS::read_file(%u)\r\n", len);
 #endif
 
     if (receiveBuffer->length() == 0)
     {
-        // Do block read.
-        if (read_file_handle(buf.data(), len) == true)
+        // Do block read, straight into the receive buffer.
+        if (read_file_handle((uint8_t *)receiveBuffer->prepare(len), len) == true)
         {
 #ifdef VERBOSE_PROTOCOL
             Debug_printf("Nothing new from adapter, bailing.\n");
 #endif
+            receiveBuffer->clear();
             return true;
         }
 
-        // Append to receive buffer.
-        receiveBuffer->insert(receiveBuffer->end(), buf.begin(), buf.end());
+        receiveBuffer->commit(len);
         fileSize -= len;
     }
     else
@@ -233,7 +246,8 @@ bool NetworkProtocolFS::read_dir(unsigned short len)
 
     if (receiveBuffer->length() == 0)
     {
-        *receiveBuffer = dirBuffer.substr(0, len);
+        fill_dir_buffer(len);
+        receiveBuffer->append(dirBuffer.data(), std::min<size_t>(len, dirBuffer.size()));
         dirBuffer.erase(0, len);
         dirBuffer.shrink_to_fit();
     }
@@ -254,7 +268,7 @@ bool NetworkProtocolFS::write_file(unsigned short len)
     if (write_file_handle((uint8_t *)transmitBuffer->data(), len) == true)
         return true;
 
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
     return false;
 }
 
@@ -294,6 +308,8 @@ bool NetworkProtocolFS::status_file(NetworkStatus *status)
 
 bool NetworkProtocolFS::status_dir(NetworkStatus *status)
 {
+    fill_dir_buffer(DIR_BUFFER_FILL);
+
     status->rxBytesWaiting = dirBuffer.length();
     status->connected = dirBuffer.length() > 0 ? 1 : 0;
     status->error = dirBuffer.length() > 0 ? error : NETWORK_ERROR_END_OF_FILE;
@@ -37,7 +37,7 @@ public:
      * @param sp_buf pointer to special buffer
      * @return a NetworkProtocolFS object
      */
-    NetworkProtocolFS(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf);
+    NetworkProtocolFS(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf);
 
     /**
      * dTOR
@@ -154,6 +154,11 @@ protected:
      * Directory buffer
      */
     std::string dirBuffer;
+
+    /**
+     * All directory entries have been formatted into dirBuffer
+     */
+    bool dirEOF = true;
     
     /**
      * Is open file a directory?
@@ -188,6 +193,12 @@ protected:
      */
     virtual bool open_dir();
 
+    /**
+     * @brief Format directory entries into dirBuffer until it holds len bytes or the directory ends
+     * @param len number of bytes wanted in dirBuffer
+     */
+    void fill_dir_buffer(size_t len);
+
     /**
      * @brief Open directory handle
      * @return FALSE if successful, TRUE on error.
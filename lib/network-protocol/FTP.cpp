@@ -15,7 +15,7 @@
 #include <vector>
 
 
-NetworkProtocolFTP::NetworkProtocolFTP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolFTP::NetworkProtocolFTP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocolFS(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolFTP::ctor\r\n");
@@ -32,7 +32,7 @@ DELETE, MKCOL, RMCOL, COPY, MOVE, are all handled via idempotent XIO commands.
 DELETE can be done via special/XIO if you do not want to handle the response, otherwise use aux1=5/9 with normal open/read.
 */
 
-NetworkProtocolHTTP::NetworkProtocolHTTP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolHTTP::NetworkProtocolHTTP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocolFS(rx_buf, tx_buf, sp_buf)
 {
     rename_implemented = true;
@@ -154,8 +154,6 @@ bool NetworkProtocolHTTP::open_file_handle()
 
 bool NetworkProtocolHTTP::open_dir_handle()
 {
-    int len, actual_len;
-
 #ifdef VERBOSE_PROTOCOL
     Debug_printf("NetworkProtocolHTTP::open_dir_handle()\r\n");
 #endif
@@ -192,24 +190,50 @@ bool NetworkProtocolHTTP::open_dir_handle()
         error = NETWORK_ERROR_GENERAL;
         return true;
     }
+    dirParsed = false;
 
-    std::vector<uint8_t> buf;
+    // Parse up to the first entry, the rest follows as read_dir_entry() asks for it
+    if (fetch_dir_entries())
+    {
+#ifdef VERBOSE_PROTOCOL
+        Debug_printf("NetworkProtocolHTTP::open_dir_handle() - error %u\r\n", error);
+#endif
+        webDAV.end_parser(true); // release parser resources + clear collected entries
+        dirParsed = true;
+        return true;
+    }
+
+    // Directory open, entries are returned by read_dir_entry()
+    return false;
+}
 
-    // Process all response chunks
-    while ( !client->is_transaction_done() || client->available() > 0)
+bool NetworkProtocolHTTP::fetch_dir_entries()
+{
+    int len, actual_len;
+
+    // Feed the PROPFIND response to the parser a piece at a time, until an entry is ready
+    while (!dirParsed && !webDAV.entry_ready())
     {
+        if (client->is_transaction_done() && client->available() <= 0)
+        {
+            // finish parsing, then release parser resources (keep directory entries)
+            webDAV.parse(nullptr, 0, true);
+            webDAV.end_parser();
+            dirParsed = true;
+            break;
+        }
+
         len = client->available();
         if (len > 0)
         {
 #ifdef VERBOSE_PROTOCOL
             Debug_printf("data available %d ...\n", len);
 #endif
-            // increase chunk buffer if necessary
-            if (len >= buf.size())
-                buf.resize(len+1); // +1 for '\0'
+            if (len > WEBDAV_CHUNK_SIZE)
+                len = WEBDAV_CHUNK_SIZE;
 
             // Grab the buffer
-            actual_len = client->read(buf.data(), len);
+            actual_len = client->read((uint8_t *)dirChunk, len);
 
             if (actual_len != len)
             {
@@ -217,18 +241,18 @@ bool NetworkProtocolHTTP::open_dir_handle()
                 Debug_printf("Expected %d bytes, actually got %d bytes.\r\n", len, actual_len);
 #endif
                 error = NETWORK_ERROR_GENERAL;
-                break;
+                return true;
             }
-            buf[len] = '\0'; // make buffer C string compatible for Debug_printf()
+            dirChunk[len] = '\0'; // make buffer C string compatible for Debug_printf()
 
             // Parse the buffer
-            if (webDAV.parse((char *)buf.data(), len, false))
+            if (webDAV.parse(dirChunk, len, false))
             {
 #ifdef VERBOSE_PROTOCOL
                 Debug_printf("Could not parse buffer, returning 144\r\n");
 #endif
                 error = NETWORK_ERROR_GENERAL;
-                break;
+                return true;
             }
         }
         else if (len == 0)
@@ -246,36 +270,10 @@ bool NetworkProtocolHTTP::open_dir_handle()
             Debug_println("ERROR: negative length returned from client->available()\r\n");
 #endif
             error = NETWORK_ERROR_GENERAL;
-            break;
+            return true;
         }
     }
 
-    if (error != NETWORK_ERROR_SUCCESS)
-    {
-#ifdef VERBOSE_PROTOCOL
-        Debug_printf("NetworkProtocolHTTP::open_dir_handle() - error %u\r\n", error);
-#endif
-        webDAV.end_parser(true); // release parser resources + clear collected entries
-        return true;
-    }
-
-    // finish parsing (not sure if this is necessary)
-    webDAV.parse(nullptr, 0, true);
-
-    // Release parser resources (keep directory entries)
-    webDAV.end_parser();
-
-    // Scoot to beginning of directory entries.
-    dirEntryCursor = webDAV.rewind();
-
-    if (client != nullptr)
-    {
-        delete client;
-        client = new HTTP_CLIENT_CLASS();
-        client->begin(opened_url->url);
-    }
-
-    // Directory parsed, ready to be returned by read_dir_entry()
     return false;
 }
 
@@ -526,12 +524,18 @@ bool NetworkProtocolHTTP::read_dir_entry(char *buf, unsigned short len)
     Debug_printf("NetworkProtocolHTTP::read_dir_entry(%p,%u)\r\n", buf, len);
 #endif
 
-    if (dirEntryCursor != webDAV.entries.end())
+    if (fetch_dir_entries())
+    {
+        webDAV.end_parser(true);
+        dirParsed = true;
+        return true;
+    }
+
+    if (webDAV.next_entry(dirEntry))
     {
-        strlcpy(buf, dirEntryCursor->filename.c_str(), len);
-        fileSize = atoi(dirEntryCursor->fileSize.c_str());
-        is_directory = dirEntryCursor->isDir;
-        ++dirEntryCursor;
+        strlcpy(buf, dirEntry.filename.c_str(), len);
+        fileSize = dirEntry.fileSize;
+        is_directory = dirEntry.isDir;
 #ifdef VERBOSE_PROTOCOL
         Debug_printf("Returning: %s, %u, %s\r\n", buf, fileSize, is_directory ? "DIR" : "FILE");
 #endif
@@ -568,7 +572,16 @@ bool NetworkProtocolHTTP::close_dir_handle()
 #ifdef VERBOSE_PROTOCOL
     Debug_printf("NetworkProtocolHTTP::close_dir_handle()\r\n");
 #endif
-    webDAV.clear(); // release directory entries
+    webDAV.end_parser(true); // release parser resources + directory entries
+    dirParsed = true;
+
+    // drop the rest of the PROPFIND response, start over for the next request
+    if (client != nullptr)
+    {
+        delete client;
+        client = new HTTP_CLIENT_CLASS();
+        client->begin(opened_url->url);
+    }
     return false;
 }
 
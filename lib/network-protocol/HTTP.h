@@ -2,6 +2,7 @@
 #define NETWORKPROTOCOLHTTP_H
 
 #include <expat.h>
+#include <vector>
 
 #include "WebDAV.h"
 #include "FS.h"
@@ -20,6 +21,8 @@
 #endif
 
 
+#define WEBDAV_CHUNK_SIZE 1024 // PROPFIND response bytes parsed per step
+
 #define OPEN_MODE_HTTP_GET      (0x04)
 #define OPEN_MODE_HTTP_PUT      (0x08)
 #define OPEN_MODE_HTTP_GET_H    (0x0C)
@@ -38,7 +41,7 @@ public:
      * @param sp_buf pointer to special buffer
      * @return a NetworkProtocolFS object
      */
-    NetworkProtocolHTTP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf);
+    NetworkProtocolHTTP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf);
 
     /**
      * dTOR
@@ -245,9 +248,19 @@ private:
     WebDAV webDAV;
 
     /**
-     * Current Directory entry cursor
+     * Directory entry being returned
+     */
+    WebDAV::DAVEntry dirEntry;
+
+    /**
+     * PROPFIND response fully parsed (or abandoned)
      */
-    std::vector<WebDAV::DAVEntry>::iterator dirEntryCursor;
+    bool dirParsed = true;
+
+    /**
+     * Piece of the PROPFIND response being parsed, +1 for '\0'
+     */
+    char dirChunk[WEBDAV_CHUNK_SIZE + 1];
 
     /**
      * Do HTTP transaction
@@ -308,6 +321,12 @@ private:
      */
     bool write_file_handle_data(uint8_t *buf, unsigned short len);
 
+    /**
+     * @brief Parse more of the PROPFIND response, until an entry is ready or it ends
+     * @return TRUE on error, FALSE on success.
+     */
+    bool fetch_dir_entries();
+
     /**
      * @brief Parse directory retrieved from PROPFIND
      * @param buf the source buffer
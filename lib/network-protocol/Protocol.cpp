@@ -5,6 +5,7 @@
 #include "Protocol.h"
 
 #include <algorithm>
+#include <array>
 #include <errno.h>
 
 #include "../../include/debug.h"
@@ -70,8 +71,8 @@ using namespace std;
  * @param tx_buf pointer to transmit buffer
  * @param sp_buf pointer to special buffer
  */
-NetworkProtocol::NetworkProtocol(std::string *rx_buf,
-                                 std::string *tx_buf,
+NetworkProtocol::NetworkProtocol(NetworkBuffer *rx_buf,
+                                 NetworkBuffer *tx_buf,
                                  std::string *sp_buf)
 {
 #ifdef VERBOSE_PROTOCOL
@@ -137,11 +138,9 @@ bool NetworkProtocol::close()
     if (!transmitBuffer->empty())
         write(transmitBuffer->length());
 
-    receiveBuffer->clear();
-    transmitBuffer->clear();
+    receiveBuffer->release();
+    transmitBuffer->release();
     specialBuffer->clear();
-    receiveBuffer->shrink_to_fit();
-    transmitBuffer->shrink_to_fit();
     specialBuffer->shrink_to_fit();
     
     error = 1;
@@ -189,11 +188,97 @@ bool NetworkProtocol::status(NetworkStatus *status)
     return false;
 }
 
+/**
+ * Translation tables, one per translation mode (plus one for unknown modes), mapping each
+ * byte to its translated value in a single lookup. Built at compile time by applying the
+ * same replacements, in the same order, the per-character passes used to do.
+ */
+typedef std::array<uint8_t, 256> translation_table_t;
+
+#define TRANSLATION_TABLES 6 // NONE, CR, LF, CRLF, PETSCII, anything else
+
+static constexpr void _table_remap(translation_table_t &table, uint8_t from, uint8_t to)
+{
+    for (size_t i = 0; i < table.size(); i++)
+        if (table[i] == from)
+            table[i] = to;
+}
+
+static constexpr translation_table_t _make_rx_table(uint8_t mode)
+{
+    translation_table_t table = {};
+    for (size_t i = 0; i < table.size(); i++)
+        table[i] = i;
+
+    if (mode == TRANSLATION_MODE_NONE)
+        return table;
+
+#ifdef BUILD_ATARI
+    _table_remap(table, ASCII_BELL, ATASCII_BUZZER);
+    _table_remap(table, ASCII_BACKSPACE, ATASCII_DEL);
+    _table_remap(table, ASCII_TAB, ATASCII_TAB);
+#endif
+
+    switch (mode)
+    {
+    case TRANSLATION_MODE_CR:
+        _table_remap(table, ASCII_CR, EOL);
+        break;
+    case TRANSLATION_MODE_LF:
+        _table_remap(table, ASCII_LF, EOL);
+        break;
+    case TRANSLATION_MODE_CRLF:
+#ifndef BUILD_APPLE
+        // With Apple2, we would be translating CR to CR; a waste of CPU
+        _table_remap(table, ASCII_CR, EOL);
+#endif
+        break;
+    }
+    return table;
+}
+
+static constexpr translation_table_t _make_tx_table(uint8_t mode)
+{
+    translation_table_t table = {};
+    for (size_t i = 0; i < table.size(); i++)
+        table[i] = i;
+
+    if (mode == TRANSLATION_MODE_NONE)
+        return table;
+
+#ifdef BUILD_ATARI
+    _table_remap(table, ATASCII_BUZZER, ASCII_BELL);
+    _table_remap(table, ATASCII_DEL, ASCII_BACKSPACE);
+    _table_remap(table, ATASCII_TAB, ASCII_TAB);
+#endif
+
+    // CRLF keeps EOL in the table, it is expanded to two bytes while translating
+    switch (mode)
+    {
+    case TRANSLATION_MODE_CR:
+        _table_remap(table, EOL, ASCII_CR);
+        break;
+    case TRANSLATION_MODE_LF:
+        _table_remap(table, EOL, ASCII_LF);
+        break;
+    }
+    return table;
+}
+
+static constexpr std::array<translation_table_t, TRANSLATION_TABLES> _rx_tables = {
+    _make_rx_table(0), _make_rx_table(1), _make_rx_table(2), _make_rx_table(3), _make_rx_table(4), _make_rx_table(5)};
+
+static constexpr std::array<translation_table_t, TRANSLATION_TABLES> _tx_tables = {
+    _make_tx_table(0), _make_tx_table(1), _make_tx_table(2), _make_tx_table(3), _make_tx_table(4), _make_tx_table(5)};
+
+static inline const translation_table_t &_translation_table(const std::array<translation_table_t, TRANSLATION_TABLES> &tables, uint8_t mode)
+{
+    return tables[mode < TRANSLATION_TABLES ? mode : TRANSLATION_TABLES - 1];
+}
+
 /**
  * Perform end of line translation on receive buffer. based on translation_mode.
- * @param rx_buf The receive buffer to transform
- * @param len The length of the receive buffer
- * @return length after transformation.
+ * Only the bytes added since the previous translation are touched, in one pass.
   */
 void NetworkProtocol::translate_receive_buffer()
 {
@@ -201,42 +286,49 @@ void NetworkProtocol::translate_receive_buffer()
     Debug_printf("#### Translating receive buffer, mode: %u\r\n", translation_mode);
 #endif
     if (translation_mode == 0)
+    {
+        receiveBuffer->mark();
         return;
+    }
 
-    #ifdef BUILD_ATARI
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BELL, ATASCII_BUZZER);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BACKSPACE, ATASCII_DEL);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_TAB, ATASCII_TAB);
-    #endif   
+    const translation_table_t &table = _translation_table(_rx_tables, translation_mode);
+    uint8_t *p = (uint8_t *)receiveBuffer->unmarked();
+    size_t len = receiveBuffer->unmarked_size();
 
-    switch (translation_mode)
+    if (translation_mode == TRANSLATION_MODE_CRLF)
+    {
+        // translate and drop the LF half of each CR/LF in the same pass
+        size_t out = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            uint8_t c = table[p[i]];
+            if (c != ASCII_LF)
+                p[out++] = c;
+        }
+        receiveBuffer->truncate(receiveBuffer->size() - (len - out));
+    }
+    else
+    {
+        for (size_t i = 0; i < len; i++)
+            p[i] = table[p[i]];
+    }
+
+    if (translation_mode == TRANSLATION_MODE_PETSCII)
     {
-    case TRANSLATION_MODE_CR:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
-        break;
-    case TRANSLATION_MODE_LF:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_LF, EOL);
-        break;
-    case TRANSLATION_MODE_CRLF:
-    #ifndef BUILD_APPLE
-        // With Apple2, we would be translating CR to CR; a waste of CPU
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
-    #endif
-        break;
-    case TRANSLATION_MODE_PETSCII:
 #ifdef VERBOSE_PROTOCOL
         Debug_printf("!!! PETSCII !!!\r\n");
 #endif
-        *receiveBuffer = mstr::toUTF8(*receiveBuffer);
-        break;
+        std::string utf8 = mstr::toUTF8(std::string((char *)p, len));
+        receiveBuffer->truncate(receiveBuffer->size() - len);
+        receiveBuffer->append(utf8);
     }
 
-    if (translation_mode == TRANSLATION_MODE_CRLF)
-        receiveBuffer->erase(std::remove(receiveBuffer->begin(), receiveBuffer->end(), '\n'), receiveBuffer->end());
+    receiveBuffer->mark();
 }
 
 /**
  * Perform end of line translation on transmit buffer. based on translation_mode
+ * Only the bytes added since the previous translation are touched, in one pass.
  * @return new length after translation
  */
 unsigned short NetworkProtocol::translate_transmit_buffer()
@@ -245,30 +337,49 @@ unsigned short NetworkProtocol::translate_transmit_buffer()
     Debug_printf("#### Translating transmit buffer, mode: %u\r\n", translation_mode);
 #endif
     if (translation_mode == 0)
+    {
+        transmitBuffer->mark();
         return transmitBuffer->length();
+    }
 
-    #ifdef BUILD_ATARI
-    util_replaceAll(*transmitBuffer, STR_ATASCII_BUZZER, STR_ASCII_BELL);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_DEL, STR_ASCII_BACKSPACE);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_TAB, STR_ASCII_TAB);
-    #endif
+    const translation_table_t &table = _translation_table(_tx_tables, translation_mode);
+    uint8_t *p = (uint8_t *)transmitBuffer->unmarked();
+    size_t len = transmitBuffer->unmarked_size();
+    size_t eols = 0;
 
-    switch (translation_mode)
+    for (size_t i = 0; i < len; i++)
     {
-    case TRANSLATION_MODE_CR:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CR);
-        break;
-    case TRANSLATION_MODE_LF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_LF);
-        break;
-    case TRANSLATION_MODE_CRLF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CRLF);
-        break;
-    case TRANSLATION_MODE_PETSCII:
-        *transmitBuffer = mstr::toUTF8(*transmitBuffer);
-        break;
+        p[i] = table[p[i]];
+        if (p[i] == EOL)
+            eols++;
+    }
+
+    if (translation_mode == TRANSLATION_MODE_CRLF && eols > 0)
+    {
+        // grow by one byte per EOL and expand from the back, so nothing is moved twice
+        transmitBuffer->prepare(eols);
+        p = (uint8_t *)transmitBuffer->unmarked();
+        size_t w = len + eols;
+        for (size_t i = len; i-- > 0;)
+        {
+            if (p[i] == EOL)
+            {
+                p[--w] = ASCII_LF;
+                p[--w] = ASCII_CR;
+            }
+            else
+                p[--w] = p[i];
+        }
+        transmitBuffer->commit(eols);
+    }
+    else if (translation_mode == TRANSLATION_MODE_PETSCII)
+    {
+        std::string utf8 = mstr::toUTF8(std::string((char *)p, len));
+        transmitBuffer->truncate(transmitBuffer->size() - len);
+        transmitBuffer->append(utf8);
     }
 
+    transmitBuffer->mark();
     return transmitBuffer->length();
 }
 
@@ -25,7 +25,7 @@
  * @param sp_buf pointer to special buffer
  * @return a NetworkProtocolTCP object
  */
-NetworkProtocolTCP::NetworkProtocolTCP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolTCP::NetworkProtocolTCP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolTCP::ctor\r\n");
@@ -115,7 +115,6 @@ bool NetworkProtocolTCP::close()
 bool NetworkProtocolTCP::read(unsigned short len)
 {
     unsigned short actual_len = 0;
-    std::vector<uint8_t> newData = std::vector<uint8_t>(len);
 
     Debug_printf("NetworkProtocolTCP::read(%u)\r\n", len);
 
@@ -128,24 +127,24 @@ bool NetworkProtocolTCP::read(unsigned short len)
             return true; // error
         }
 
-        // Do the read from client socket.
-        actual_len = client.read(newData.data(), len);
+        // Do the read from client socket, straight into the receive buffer.
+        actual_len = client.read((uint8_t *)receiveBuffer->prepare(len), len);
+        receiveBuffer->commit(actual_len);
 
         // bail if the connection is reset.
         if (errno == ECONNRESET)
         {
             error = NETWORK_ERROR_CONNECTION_RESET;
+            receiveBuffer->clear();
             return true;
         }
         else if (actual_len != len) // Read was short and timed out.
         {
             Debug_printf("Short receive. We got %u bytes, returning %u bytes and ERROR\r\n", actual_len, len);
             error = NETWORK_ERROR_SOCKET_TIMEOUT;
+            receiveBuffer->clear();
             return true;
         }
-
-        // Add new data to buffer.
-        receiveBuffer->insert(receiveBuffer->end(), newData.begin(), newData.end());
     }    
     error = 1;
     return NetworkProtocol::read(len);
@@ -190,7 +189,7 @@ bool NetworkProtocolTCP::write(unsigned short len)
 
     // Return success
     error = 1;
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
 
     return false;
 }
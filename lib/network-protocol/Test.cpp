@@ -8,7 +8,7 @@
 
 #include <vector>
 
-NetworkProtocolTest::NetworkProtocolTest(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolTest::NetworkProtocolTest(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolTest::NetworkProtocolTest(%p,%p,%p)\r\n", rx_buf, tx_buf, sp_buf);
@@ -90,7 +90,7 @@ bool NetworkProtocolTest::write(unsigned short len)
         Debug_printf("%02x ", (unsigned char)transmitBuffer->at(i));
     Debug_printf("\r\n");
 
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
 
     return err;
 }
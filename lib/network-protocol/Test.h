@@ -18,7 +18,7 @@ public:
     /**
      * ctor
      */
-    NetworkProtocolTest(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf);
+    NetworkProtocolTest(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf);
 
     /**
      * dtor
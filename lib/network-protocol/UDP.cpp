@@ -19,7 +19,7 @@
 
 
 
-NetworkProtocolUDP::NetworkProtocolUDP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolUDP::NetworkProtocolUDP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolUDP::ctor\r\n");
@@ -96,8 +96,6 @@ bool NetworkProtocolUDP::close()
 
 bool NetworkProtocolUDP::read(unsigned short len)
 {
-    std::vector<uint8_t> newData = std::vector<uint8_t>(len);
-
     Debug_printf("NetworkProtocolUDP::read(%u)\r\n", len);
 
     if (receiveBuffer->length() == 0)
@@ -108,11 +106,9 @@ bool NetworkProtocolUDP::read(unsigned short len)
             return true;
         }
 
-        // Do the read.
-        udp.read(newData.data(), len);
-
-        // Add new data to buffer.
-        receiveBuffer->insert(receiveBuffer->end(),newData.begin(),newData.end());
+        // Do the read, straight into the receive buffer.
+        udp.read((uint8_t *)receiveBuffer->prepare(len), len);
+        receiveBuffer->commit(len);
     }
 
     // Return success
@@ -153,7 +149,7 @@ bool NetworkProtocolUDP::write(unsigned short len)
 
     // Return success
     error = 1;
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
 
     return false;
 }
@@ -0,0 +1,174 @@
+/**
+ * Network receive/transmit buffer
+ */
+
+#ifndef NETWORKBUFFER_H
+#define NETWORKBUFFER_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Byte queue used for the protocol receive and transmit buffers.
+ *
+ * Bytes are appended at the tail and consumed from the head. consume() only advances
+ * a read offset; the consumed space is reclaimed by moving the remaining bytes down once
+ * it is larger than what is left or when the storage would otherwise have to grow. The
+ * allocation is kept across reads, so a steady stream of reads and writes runs without
+ * heap traffic. Waiting bytes are always contiguous, data() can be handed to the bus as is.
+ */
+class NetworkBuffer
+{
+public:
+    /**
+     * Number of bytes waiting
+     */
+    size_t size() const { return _buf.size() - _head; }
+    size_t length() const { return size(); }
+    bool empty() const { return _buf.size() == _head; }
+
+    /**
+     * Peek at the waiting bytes, valid until the next append/prepare.
+     */
+    char *data() { return &_buf[_head]; }
+    const char *data() const { return _buf.data() + _head; }
+    const char *c_str() const { return _buf.c_str() + _head; }
+    char *begin() { return data(); }
+    char *end() { return data() + size(); }
+    char &at(size_t pos) { return _buf.at(_head + pos); }
+    char &front() { return _buf[_head]; }
+
+    /**
+     * Drop len bytes from the head.
+     */
+    void consume(size_t len)
+    {
+        if (len >= size())
+            clear();
+        else
+        {
+            _head += len;
+            if (_mark < _head)
+                _mark = _head;
+        }
+    }
+
+    /**
+     * Keep only the first len waiting bytes.
+     */
+    void truncate(size_t len)
+    {
+        if (len < size())
+            _buf.resize(_head + len);
+        if (_mark > _buf.size())
+            _mark = _buf.size();
+    }
+
+    /**
+     * Bytes added since the last mark(), so each byte is only translated once.
+     */
+    char *unmarked() { return &_buf[marked()]; }
+    size_t unmarked_size() const { return _buf.size() - marked(); }
+    void mark() { _mark = _buf.size(); }
+
+    void append(const char *src, size_t len)
+    {
+        reclaim(len);
+        _buf.append(src, len);
+    }
+    void append(const std::string &s) { append(s.data(), s.size()); }
+    void push_back(char c)
+    {
+        reclaim(1);
+        _buf.push_back(c);
+    }
+    NetworkBuffer &operator+=(const std::string &s)
+    {
+        append(s);
+        return *this;
+    }
+
+    /**
+     * Reserve len bytes at the tail to read into directly, e.g. from a socket.
+     * Must be followed by commit() with the number of bytes actually stored, or by
+     * clear() if the read failed. Until then size() counts all len bytes.
+     */
+    char *prepare(size_t len)
+    {
+        reclaim(len);
+        _prepared = _buf.size();
+        _buf.resize(_prepared + len);
+        return &_buf[_prepared];
+    }
+    void commit(size_t len)
+    {
+        _buf.resize(_prepared + len);
+        if (_mark > _buf.size())
+            _mark = _buf.size();
+    }
+
+    /**
+     * Empty the buffer, keeping its storage for reuse.
+     */
+    void clear()
+    {
+        _buf.clear();
+        _head = _mark = 0;
+    }
+
+    /**
+     * Empty the buffer and give its storage back.
+     */
+    void release()
+    {
+        std::string().swap(_buf);
+        _head = _mark = 0;
+    }
+
+    /**
+     * Waiting bytes as a string, for in place transformations (e.g. PETSCII).
+     * The mark stays where it was, bytes already translated are not translated again.
+     */
+    std::string &str()
+    {
+        compact();
+        return _buf;
+    }
+
+    /**
+     * Replace the content, none of it counts as translated. Call mark() after if it is ready for the bus.
+     */
+    NetworkBuffer &operator=(const std::string &s)
+    {
+        _buf = s;
+        _head = _mark = 0;
+        return *this;
+    }
+
+private:
+    std::string _buf;
+    size_t _head = 0;
+    size_t _mark = 0; // end of the bytes already translated
+    size_t _prepared = 0;
+
+    // The mark can be past the end after an edit through str() that shortened the content.
+    size_t marked() const { return _mark < _buf.size() ? _mark : _buf.size(); }
+
+    void compact()
+    {
+        if (_head == 0)
+            return;
+        _buf.erase(0, _head);
+        _mark = _mark > _head ? _mark - _head : 0;
+        _head = 0;
+    }
+
+    // Move waiting bytes down if the consumed space outgrew them or the append would reallocate.
+    void reclaim(size_t len)
+    {
+        if (_head > 0 && (_head >= size() || _buf.size() + len > _buf.capacity()))
+            compact();
+    }
+};
+
+#endif /* NETWORKBUFFER_H */
@@ -7,6 +7,8 @@
 #include <memory>
 #include <string>
 
+#include "networkBuffer.h"
+
 class NetworkProtocol;
 class FNJSON;
 class PeoplesUrlParser;
@@ -14,8 +16,8 @@ class PeoplesUrlParser;
 struct NetworkData {
     std::unique_ptr<NetworkProtocol> protocol;
     std::unique_ptr<FNJSON> json;
-    std::string receiveBuffer;
-    std::string transmitBuffer;
+    NetworkBuffer receiveBuffer;
+    NetworkBuffer transmitBuffer;
     std::string specialBuffer;
     std::string deviceSpec;
     std::unique_ptr<PeoplesUrlParser> urlParser;
@@ -13,13 +13,13 @@ void atari1025::set_line_long()
     {
         if (!BOLflag)
             pdf_end_line();     // close out string array
-        fprintf(_file, "ET\r\n"); // close out text object
+        pdf_printf("ET\r\n"); // close out text object
         // set new margins
         leftMargin = 18.0;  // (8.5-8.0)/2*72
         printWidth = 576.0; // 8 inches
         pdf_begin_text(pdf_Y);
         // start text string array at beginning of line
-        fprintf(_file, "[(");
+        pdf_printf("[(");
         BOLflag = false;
         shortFlag = false;
     }
@@ -31,13 +31,13 @@ void atari1025::set_line_short()
     {
         if (!BOLflag)
             pdf_end_line();     // close out string array
-        fprintf(_file, "ET\r\n"); // close out text object
+        pdf_printf("ET\r\n"); // close out text object
         // set new margins
         leftMargin = 75.6;  // (8.5-6.4)/2.0*72.0;
         printWidth = 460.8; //6.4*72.0; // 6.4 inches
         pdf_begin_text(pdf_Y);
         // start text string array at beginning of line
-        fprintf(_file, "[(");
+        pdf_printf("[(");
         BOLflag = false;
         shortFlag = true;
     }
@@ -86,15 +86,15 @@ void atari1025::print_char(uint8_t c)
             }
         if (valid)
         {
-            fputc(d, _file);
+            pdf_putc(d);
             pdf_X += charWidth; // update x position
         }
     }
     else if (c > 31 && c < 127)
     {
         if (c == '\\' || c == '(' || c == ')')
-            fputc('\\', _file);
-        fputc(c, _file);
+            pdf_putc('\\');
+        pdf_putc(c);
         pdf_X += charWidth; // update x position
     }
 }
@@ -120,7 +120,7 @@ void atari1025::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             // change font to elongated like
             if (fontNumber != 2)
             {
-                fprintf(_file, ")]TJ\n/F2 12 Tf [(");
+                pdf_printf(")]TJ\n/F2 12 Tf [(");
                 charWidth = 14.4; //72.0 / 5.0;
                 fontNumber = 2;
                 fontUsed[1] = true;
@@ -130,7 +130,7 @@ void atari1025::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             // change font to normal
             if (fontNumber != 1)
             {
-                fprintf(_file, ")]TJ\n/F1 12 Tf [(");
+                pdf_printf(")]TJ\n/F1 12 Tf [(");
                 charWidth = 7.2; //72.0 / 10.0;
                 fontNumber = 1;
                 // fontUsed[0]=true; // redundant
@@ -140,7 +140,7 @@ void atari1025::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             // change font to compressed
             if (fontNumber != 3)
             {
-                fprintf(_file, ")]TJ\n/F3 12 Tf [(");
+                pdf_printf(")]TJ\n/F3 12 Tf [(");
                 charWidth = 72.0 / 16.5;
                 fontNumber = 3;
                 fontUsed[2] = true;
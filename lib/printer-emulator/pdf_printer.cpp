@@ -1,44 +1,111 @@
 #include "pdf_printer.h"
 
+#include <cstdarg>
+
 #include "../../include/debug.h"
 
 #include "fsFlash.h"
 
 #include "utils.h"
 
+#define PDF_FONT_COPY_BUFLEN 1024
+
 void pdfPrinter::pdf_header()
 {
     Debug_println("pdf header");
     pdf_Y = 0;
     pdf_X = 0;
     pdf_pageCounter = 0;
-    fprintf(_file, "%%PDF-1.4\n");
+    pageObjects.clear();
+    objLocations.assign(1, {0, 0, 65535}); // object 0 is the head of the free list
+    objStmIndex.clear();
+    objStmBody.clear();
+    objStmCount = 0;
+    // binary comment so transfer programs don't mangle the compressed streams
+    fprintf(_file, "%%PDF-1.5\n%%\xE2\xE3\xCF\xD3\n");
     // first object: catalog of pages
     pdf_objCtr = 1;
-    objLocations[pdf_objCtr] = ftell(_file);
-    fprintf(_file, "1 0 obj\n<</Type /Catalog /Pages 2 0 R>>\nendobj\n");
-    // object 2 0 R is printed by pdf_page_resource() before xref
-    // object 3 0 R is printed at pdf_font_resource() before xref
+    pdf_obj_in_stream(1, "<</Type /Catalog /Pages 2 0 R>>");
+    // object 2 0 R is made by pdf_page_resource() before xref
+    // object 3 0 R is made by pdf_font_resource() before xref
     pdf_objCtr = 3; // set up counter for pdf_add_font()
+    objLocations.resize(pdf_objCtr + 1, {0, 0, 0});
 }
 
-void pdfPrinter::pdf_page_resource()
+// Object obj starts at the current file position
+void pdfPrinter::pdf_obj_in_file(int obj)
+{
+    if (objLocations.size() <= (size_t)obj)
+        objLocations.resize(obj + 1, {0, 0, 0});
+    objLocations[obj] = {1, (uint32_t)ftell(_file), 0};
+}
+
+// Object obj goes into the object stream, written out by pdf_xref()
+void pdfPrinter::pdf_obj_in_stream(int obj, const std::string &body)
 {
-    objLocations[2] = ftell(_file); // hard code page catalog as object #2
-    fprintf(_file, "2 0 obj\n<</Type /Pages /Kids [ ");
-    for (int i = 0; i < pdf_pageCounter; i++)
+    if (objLocations.size() <= (size_t)obj)
+        objLocations.resize(obj + 1, {0, 0, 0});
+    objLocations[obj] = {2, 0, objStmCount++};
+    objStmIndex += std::to_string(obj) + " " + std::to_string(objStmBody.size()) + " ";
+    objStmBody += body;
+    objStmBody += '\n';
+}
+
+// Write a complete stream object, data is already compressed if flate is set
+void pdfPrinter::pdf_write_stream(int obj, const std::string &dict, const std::string &data, bool flate)
+{
+    pdf_obj_in_file(obj);
+    fprintf(_file, "%d 0 obj\n<<%s%s /Length %u>>\nstream\n", obj, dict.c_str(),
+            flate ? " /Filter /FlateDecode" : "", (unsigned)data.size());
+    fwrite(data.data(), 1, data.size(), _file);
+    fprintf(_file, "\nendstream\nendobj\n");
+}
+
+void pdfPrinter::pdf_printf(const char *fmt, ...)
+{
+    char buf[128];
+    va_list args;
+    va_list args2;
+
+    va_start(args, fmt);
+    va_copy(args2, args);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (len >= (int)sizeof(buf))
     {
-        fprintf(_file, "%d 0 R ", pageObjects[i]);
+        std::vector<char> big(len + 1);
+        vsnprintf(big.data(), big.size(), fmt, args2);
+        pdf_write(big.data(), len);
     }
-    fprintf(_file, "] /Count %d>>\nendobj\n", pdf_pageCounter);
+    else if (len > 0)
+        pdf_write(buf, len);
+    va_end(args2);
+}
+
+void pdfPrinter::pdf_write(const void *data, size_t len)
+{
+    if (pdf_deflate.active())
+        pdf_deflate.write(data, len);
+    else
+        pdf_stream.append((const char *)data, len);
+}
+
+void pdfPrinter::pdf_page_resource()
+{
+    // hard code page catalog as object #2
+    std::string pages = "<</Type /Pages /Kids [ ";
+    for (int page : pageObjects)
+        pages += std::to_string(page) + " 0 R ";
+    pages += "] /Count " + std::to_string(pdf_pageCounter) + ">>";
+    pdf_obj_in_stream(2, pages);
 }
 
 void pdfPrinter::pdf_font_resource()
 {
     int fntCtr = 0;
-    objLocations[3] = ftell(_file);
     // font catalog
-    fprintf(_file, "3 0 obj\n<</Font <<");
+    std::string fonts = "<</Font <<";
     for (int i = 0; i < MAXFONTS; i++)
     {
         if (fontUsed[i])
@@ -48,23 +115,37 @@ void pdfPrinter::pdf_font_resource()
             //  font descriptor
             //  font widths
             //  font file
-            fprintf(_file, "/F%d %d 0 R ", i + 1, pdf_objCtr + 1 + fntCtr * 4); /// F1 4 0 R /F2 8 0 R>>>>\nendobj\n
+            fonts += "/F" + std::to_string(i + 1) + " " + std::to_string(pdf_objCtr + 1 + fntCtr * 4) + " 0 R "; /// F1 4 0 R /F2 8 0 R>>>>
             fntCtr++;
         }
     }
-    fprintf(_file, ">>>>\nendobj\n");
+    fonts += ">>>>";
+    pdf_obj_in_stream(3, fonts);
 }
 
 void pdfPrinter::pdf_add_fonts() // pdfFont_t *fonts[],
 {
     Debug_print("pdf add fonts: ");
 
+    // The font files are PDF objects with a "%d" in front of each object
+    // number: > 0 is a reference to pdf_objCtr + n, 0 starts a new object.
+    // The LUT has the file position after each of them.
+    static const int8_t fontPlaceholders[7] = {0, 1, 3, 0, 1, 0, 0};
+
     // OPEN LUT FILE
     char fname[30]; // filename: /f/shortname/Fi
     sprintf(fname, "/f/%s/LUT", shortname.c_str());
     FILE *lut = fsFlash.file_open(fname);
     int maxFonts = util_parseInt(lut);
 
+    char *buf = (char *)malloc(PDF_FONT_COPY_BUFLEN);
+    if (buf == nullptr)
+    {
+        Debug_println("no memory for fonts");
+        fclose(lut);
+        return;
+    }
+
     // font dictionary
     for (int i = 0; i < maxFonts; i++)
     {
@@ -82,84 +163,29 @@ void pdfPrinter::pdf_add_fonts() // pdfFont_t *fonts[],
             sprintf(fname, "/f/%s/F%d", shortname.c_str(), i + 1); // e.g. /f/a820/F2
             FILE *fff = fsFlash.file_open(fname);                 // Font File File - fff
 
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            pdf_objCtr++; // = 6;
-            objLocations[pdf_objCtr] = ftell(_file);
-            fprintf(_file, "%d", pdf_objCtr); // 6
-            while (fp < fontObjPos[0])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            fprintf(_file, "%d", pdf_objCtr + 1); // 7
-            while (fp < fontObjPos[1])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            fprintf(_file, "%d", pdf_objCtr + 3); // 9
-            while (fp < fontObjPos[2])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            pdf_objCtr++; // = 7;
-            objLocations[pdf_objCtr] = ftell(_file);
-            fprintf(_file, "%d", pdf_objCtr); // 7
-            while (fp < fontObjPos[3])
+            for (int j = 0; j < 7; j++)
             {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            fprintf(_file, "%d", pdf_objCtr + 1); // 8
-            while (fp < fontObjPos[4])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            pdf_objCtr++; // = 8;
-            objLocations[pdf_objCtr] = ftell(_file);
-            fprintf(_file, "%d", pdf_objCtr); // 8
-            while (fp < fontObjPos[5])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
-            fgetc(fff); // '%'
-            fp++;
-            fgetc(fff); // 'd'
-            fp++;
-            pdf_objCtr++; // = 9;
-            objLocations[pdf_objCtr] = ftell(_file);
-            fprintf(_file, "%d", pdf_objCtr); // 9
-            // insert rest of file
-            while (fp < fontObjPos[6]) //(fff.available())
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
+                // skip the '%d'
+                fp += fread(buf, 1, 2, fff);
+                if (fontPlaceholders[j] == 0)
+                {
+                    pdf_objCtr++;
+                    pdf_obj_in_file(pdf_objCtr);
+                    fprintf(_file, "%d", pdf_objCtr);
+                }
+                else
+                    fprintf(_file, "%d", pdf_objCtr + fontPlaceholders[j]);
+
+                // copy up to the next one, or the rest of the file
+                while (fp < fontObjPos[j])
+                {
+                    size_t want = fontObjPos[j] - fp;
+                    size_t count = fread(buf, 1, want < PDF_FONT_COPY_BUFLEN ? want : PDF_FONT_COPY_BUFLEN, fff);
+                    if (count == 0)
+                        break;
+                    fwrite(buf, 1, count, _file);
+                    fp += count;
+                }
             }
             fclose(fff);
             fputc('\n', _file); // make sure there's a seperator
@@ -168,6 +194,7 @@ void pdfPrinter::pdf_add_fonts() // pdfFont_t *fonts[],
             Debug_print("unused; ");
     }
 
+    free(buf);
     fclose(lut);
     Debug_println("done.");
 }
@@ -176,19 +203,16 @@ void pdfPrinter::pdf_new_page()
 { // open a new page
     Debug_println("pdf new page");
     pdf_objCtr++;
-    pageObjects[pdf_pageCounter] = pdf_objCtr;
-    objLocations[pdf_objCtr] = ftell(_file);
-    fprintf(_file, "%d 0 obj\n<</Type /Page /Parent 2 0 R /Resources 3 0 R /MediaBox [0 0 %g %g] /Contents [ ", pdf_objCtr, pageWidth, pageHeight);
+    pageObjects.push_back(pdf_objCtr);
+    char page[128];
+    snprintf(page, sizeof(page), "<</Type /Page /Parent 2 0 R /Resources 3 0 R /MediaBox [0 0 %g %g] /Contents %d 0 R>>",
+             pageWidth, pageHeight, pdf_objCtr + 1);
+    pdf_obj_in_stream(pdf_objCtr, page);
     pdf_objCtr++; // increment for the contents stream object
-    fprintf(_file, "%d 0 R ", pdf_objCtr);
-    fprintf(_file, "]>>\nendobj\n");
 
-    // open content stream
-    objLocations[pdf_objCtr] = ftell(_file);
-    fprintf(_file, "%d 0 obj\n<</Length ", pdf_objCtr);
-    idx_stream_length = ftell(_file);
-    fprintf(_file, "0000000000 >>\nstream\n");
-    idx_stream_start = ftell(_file);
+    // open content stream, kept in memory until the page is done
+    pdf_stream.clear();
+    pdf_flate = pdf_deflate.begin(&pdf_stream);
 
     // open new text object
     pdf_begin_text(pageHeight - topMargin);
@@ -198,10 +222,10 @@ void pdfPrinter::pdf_begin_text(double Y)
 {
     Debug_println("pdf begin text");
     // open new text object
-    fprintf(_file, "BT\n");
+    pdf_printf("BT\n");
     TOPflag = false;
-    fprintf(_file, "/F%u %g Tf %d Tz\n", fontNumber, fontSize, fontHorizScale);
-    fprintf(_file, "%g %g Td\n", leftMargin, Y);
+    pdf_printf("/F%u %g Tf %d Tz\n", fontNumber, fontSize, fontHorizScale);
+    pdf_printf("%g %g Td\n", leftMargin, Y);
     pdf_Y = Y; // reset print roller to top of page
     pdf_X = 0; // set carriage to LHS
     BOLflag = true;
@@ -213,11 +237,11 @@ void pdfPrinter::pdf_new_line()
 
     // position new line and start text string array
     if (pdf_dY != 0)
-        fprintf(_file, "0 Ts ");
+        pdf_printf("0 Ts ");
 #if !defined(BUILD_APPLE) && !defined(BUILD_RC2014)
     pdf_dY -= lineHeight;
 #endif
-    fprintf(_file, "0 %g Td [(", pdf_dY);
+    pdf_printf("0 %g Td [(", pdf_dY);
     pdf_Y += pdf_dY; // line feed
     pdf_dY = 0;
     // pdf_X = 0;              // CR over in end line()
@@ -227,7 +251,7 @@ void pdfPrinter::pdf_new_line()
 void pdfPrinter::pdf_end_line()
 {
     Debug_println("pdf end line");
-    fprintf(_file, ")]TJ\n"); // close the line
+    pdf_printf(")]TJ\n"); // close the line
     // pdf_Y -= lineHeight; // line feed - moved to new line()
     pdf_X = 0; // CR
     BOLflag = true;
@@ -237,7 +261,7 @@ void pdfPrinter::pdf_end_line()
 
 void pdfPrinter::pdf_set_rise()
 {
-    fprintf(_file, ")]TJ %g Ts [(", pdf_dY);
+    pdf_printf(")]TJ %g Ts [(", pdf_dY);
 }
 
 void pdfPrinter::pdf_end_page()
@@ -246,15 +270,12 @@ void pdfPrinter::pdf_end_page()
     // close text object & stream
     if (!BOLflag)
         pdf_end_line();
-    fprintf(_file, "ET\n");
-    idx_stream_stop = ftell(_file);
-    fprintf(_file, "endstream\nendobj\n");
-    size_t idx_temp = ftell(_file);
-    fflush(_file);
-    fseek(_file, idx_stream_length, SEEK_SET);
-    fprintf(_file, "%10u", (unsigned)(idx_stream_stop - idx_stream_start));
-    fflush(_file);
-    fseek(_file, idx_temp, SEEK_SET);
+    pdf_printf("ET\n");
+    pdf_deflate.end();
+    // the whole page goes out at once, no seeking back to patch the length
+    pdf_write_stream(pdf_objCtr, "", pdf_stream, pdf_flate);
+    pdf_stream.clear();
+    pdf_flate = false;
     // set counters
     pdf_pageCounter++;
     TOPflag = true;
@@ -263,19 +284,43 @@ void pdfPrinter::pdf_end_page()
 void pdfPrinter::pdf_xref()
 {
     Debug_println("pdf xref");
-    size_t xref = ftell(_file);
-    pdf_objCtr++;
-    fprintf(_file, "xref\n");
-    fprintf(_file, "0 %d\n", pdf_objCtr);
-    fprintf(_file, "0000000000 65535 f\n");
-    for (int i = 1; i < pdf_objCtr; i++)
+
+    // object stream with the catalog, resources and page dictionaries
+    int objStm = ++pdf_objCtr;
+    std::string data;
+    bool flate = zlibStream::compress(objStmIndex + objStmBody, data);
+    if (!flate)
+        data = objStmIndex + objStmBody;
+    pdf_write_stream(objStm, " /Type /ObjStm /N " + std::to_string(objStmCount) + " /First " + std::to_string(objStmIndex.size()),
+                     data, flate);
+
+    // cross reference stream, takes the place of the xref table and trailer
+    int xrefStm = ++pdf_objCtr;
+    pdf_obj_in_file(xrefStm);
+    size_t xref = objLocations[xrefStm].offset;
+    std::string table;
+    for (const pdf_xref_t &entry : objLocations)
     {
-        fprintf(_file, "%010u 00000 n\n", (unsigned)objLocations[i]);
+        uint32_t field2 = entry.type == 2 ? objStm : entry.offset;
+        table += (char)entry.type;
+        for (int shift = 24; shift >= 0; shift -= 8)
+            table += (char)(field2 >> shift);
+        table += (char)(entry.index >> 8);
+        table += (char)entry.index;
     }
-    fprintf(_file, "trailer <</Size %d/Root 1 0 R>>\n", pdf_objCtr);
+    data.clear();
+    flate = zlibStream::compress(table, data);
+    pdf_write_stream(xrefStm, " /Type /XRef /Size " + std::to_string(pdf_objCtr + 1) + " /W [1 4 2] /Root 1 0 R",
+                     flate ? data : table, flate);
+
     fprintf(_file, "startxref\n");
     fprintf(_file, "%u\n", (unsigned)xref);
     fprintf(_file, "%%%%EOF\n");
+
+    // drop the buffers until the next document
+    std::string().swap(objStmIndex);
+    std::string().swap(objStmBody);
+    std::string().swap(pdf_stream);
 }
 
 bool pdfPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
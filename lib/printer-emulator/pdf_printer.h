@@ -5,10 +5,12 @@
  inherited from by other, full-fledged printer classes (e.g. Atari 820/822)
 */
 #include <string>
+#include <vector>
 
 #include "../../include/atascii.h"
 
 #include "printer_emulator.h"
+#include "zlib_stream.h"
 
 
 #define MAXFONTS 33 // maximum number of fonts can use
@@ -47,11 +49,30 @@ protected:
     bool textMode = true;
     colorMode_t colorMode = colorMode_t::off;
 
-    int pageObjects[256];
+    std::vector<int> pageObjects;
     int pdf_pageCounter = 0.;
-    size_t objLocations[256]; // reference table storage
     int pdf_objCtr = 0;       // count the objects
 
+    // cross reference entry, objects are either in the file or in the object stream
+    struct pdf_xref_t
+    {
+        uint8_t type;   // 1 = at offset in file, 2 = index in object stream
+        uint32_t offset;
+        uint16_t index;
+    };
+    std::vector<pdf_xref_t> objLocations; // reference table storage
+
+    // page dictionaries, catalog and resources, written compressed at the end
+    std::string objStmIndex; // "objnum offset" pairs
+    std::string objStmBody;
+    uint16_t objStmCount = 0;
+
+    // content of the current page, compressed as it is printed and
+    // written to the file in one go at the end of the page
+    zlibStream pdf_deflate;
+    std::string pdf_stream;
+    bool pdf_flate = false;
+
     void pdf_header();
     void pdf_add_fonts(); // pdfFont_t *fonts[],
     void pdf_new_page();
@@ -64,9 +85,14 @@ protected:
     void pdf_font_resource();
     void pdf_xref();
 
-    size_t idx_stream_length = 0; // file location of stream length indictor
-    size_t idx_stream_start = 0;  // file location of start of stream
-    size_t idx_stream_stop = 0;   // file location of end of stream
+    void pdf_obj_in_file(int obj);
+    void pdf_obj_in_stream(int obj, const std::string &body);
+    void pdf_write_stream(int obj, const std::string &dict, const std::string &data, bool flate);
+
+    // page content output, used instead of writing to _file
+    void pdf_printf(const char *fmt, ...);
+    void pdf_write(const void *data, size_t len);
+    void pdf_putc(uint8_t c) { pdf_write(&c, 1); }
 
     virtual void pdf_clear_modes() = 0;
     virtual void pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2) = 0;
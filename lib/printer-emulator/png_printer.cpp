@@ -1,12 +1,13 @@
 #include "png_printer.h"
 
+#include <cstdlib>
+#include <cstring>
+
 #include "../../include/debug.h"
 
 
 // rewrite of TinyPngOut https://www.nayuki.io/page/tiny-png-output
 
-#define DEFLATE_MAX_BLOCK_SIZE 0xFFFF
-
 void pngPrinter::uint32_to_array(uint32_t src, uint8_t dest[4])
 {
     dest[0] = (uint8_t)((src >> 24) & 0xff);
@@ -15,21 +16,6 @@ void pngPrinter::uint32_to_array(uint32_t src, uint8_t dest[4])
     dest[3] = (uint8_t)(src & 0xff);
 }
 
-uint32_t pngPrinter::update_adler32(uint32_t adler, uint8_t data)
-{
-    // https://gist.github.com/kornelski/710db9d30a64db0807c5bfbdbdecf85e
-    unsigned s1 = adler & 0xffff;
-    unsigned s2 = (adler >> 16) & 0xffff;
-
-    s1 += data;
-    s1 %= 65521;
-
-    s2 += s1;
-    s2 %= 65521;
-
-    return (s2 << 16) | s1;
-}
-
 uint32_t pngPrinter::rc_crc32(uint32_t crc, const uint8_t *buf, size_t len)
 // https://rosettacode.org/wiki/CRC-32#Implementation_2
 {
@@ -111,7 +97,7 @@ void pngPrinter::png_header()
         0x08,                   // 16       1 byte depth
         0x03,                   // 17       0x03 color with palette
         0x00,                   // 18       compression method always 0
-        0x00,                   // 19       no filter
+        0x00,                   // 19       adaptive filtering, a filter type byte per line
         0x00,                   // 20       no interlace
         0, 0, 0, 0,             // 21-24    IHDR CRC-32 placeholder
     };
@@ -197,163 +183,120 @@ void pngPrinter::png_palette()
     fwrite(ccc, 1, 4, _file);
 }
 
-void pngPrinter::png_data()
+// Paeth predictor
+static inline int png_paeth(int a, int b, int c)
 {
-    /*  
-    https://www.w3.org/TR/REC-png.pdf
-
-    4.1.3 IDAT Image data
-    The IDAT chunk contains the actual image data. To create this data:
-    1. Begin with image scanlines represented as described in Image layout (Section 2.3); the layout and total
-    size of this raw data are determined by the fields of IHDR.
-    2. Filter the image data according to the filtering method specified by the IHDR chunk. (Note that with
-    filter method 0, the only one currently defined, this implies prepending a filter type byte to each scanline.)
-    3. Compress the filtered data using the compression method specified by the IHDR chunk.
-    The IDAT chunk contains the output datastream of the compression algorithm.
-    To read the image data, reverse this process.
-    There can be multiple IDAT chunks; if so, they must appear consecutively with no other intervening chunks.
-    The compressed datastream is then the concatenation of the contents of all the IDAT chunks. The encoder
-    can divide the compressed datastream into IDAT chunks however it wishes. (Multiple IDAT chunks are
-    allowed so that encoders can work in a fixed amount of memory; typically the chunk size will correspond
-    to the encoder’s buffer size.) It is important to emphasize that IDAT chunk boundaries have no semantic
-    significance and can occur at any point in the compressed datastream
-*/
-    Debug_println("Starting PNG Image Data...");
-    uint8_t data[] = {
-        // IDAT chunk
-        0x00, 0x00, 0x00, 0x00, // 0-3      size placeholder
-        'I', 'D', 'A', 'T',     // 4-7      IDAT
-    };
-    crc_value = rc_crc32(0, &data[4], 4); // begin CRC calculation
-
-    // Compute data size
-    // imgSize = (width + 1) * height; // +1 per line for filter 0's
-    uint32_t numBlocks = imgSize / DEFLATE_MAX_BLOCK_SIZE;
-    if (imgSize % DEFLATE_MAX_BLOCK_SIZE != 0)
-        numBlocks++; // Round up
-
-    dataSize += numBlocks * 5; // 5 bytes per DEFLATE uncompressed block header
-    dataSize += 2;             // 2 bytes for zlib header
-    dataSize += 4;             // 4 bytes for zlib Adler-32 checksum
-    dataSize += imgSize;       // plus the image data
-
-    uint32_to_array(dataSize, &data[0]); // store the computed size
-
-    fwrite(data, 1, 8, _file); // write out the IDAT header
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
 }
 
-void pngPrinter::png_add_data(uint8_t *buf, uint32_t n)
+void pngPrinter::png_filter()
 {
-    uint8_t c = 0;
-    // Deflate-compressed datastreams within PNG are stored in the “zlib” format
-    // https://tools.ietf.org/html/rfc1950#page-4
+    /*
+    https://www.w3.org/TR/REC-png.pdf
 
-    if (img_pos == 0)
-    {
-        Debug_println("Writing ZLIB header.");
-        // write out a ZLIB header
-        // Compression method/flags code: 1 byte (For PNG compression method 0, the zlib compression method/flags code must specify method code 8 (“deflate” compression))
-        c = 0x08; // ZLIB "Deflate" compression scheme
-        crc_value = rc_crc32(crc_value, c);
-        fputc(c, _file);
-        //  Additional flags/check bits: 1 byte (must be such that method + flags, when viewed as a 16-bit unsigned integer stored in MSB order (CMF*256 + FLG), is a multiple of 31.)
-        c = 0x1D; // precompute so that 0x081D is divisible by 31 [ (0x800 / 31 + 1) * 31 - 0x800 ]
-        crc_value = rc_crc32(crc_value, c);
-        fputc(c, _file);
-
-        //printf("new image\r\n");
-    }
+    6 Filter Algorithms
+    The pixels are palette indexes, where the usual minimum sum of absolute
+    differences heuristic does worse than no filter at all (9.6). What does
+    compress well is long runs of one value, so each line gets the filter
+    that leaves the fewest changes between neighbouring bytes, and a filter
+    other than None has to at least halve them.
+    */
+    uint32_t changes[5] = {0, 0, 0, 0, 0};
+    uint8_t last[5] = {0, 0, 0, 0, 0};
 
-    uint32_t idx = 0;
-    while (idx < n)
+    for (uint32_t x = 0; x < width; x++)
     {
-        // at beginning of block?
-        if (blk_pos == 0)
+        int cur = line_buffer[x];
+        int a = x > 0 ? line_buffer[x - 1] : 0;
+        int b = prev_line[x];
+        int c = x > 0 ? prev_line[x - 1] : 0;
+        uint8_t f[5] = {(uint8_t)cur, (uint8_t)(cur - a), (uint8_t)(cur - b),
+                        (uint8_t)(cur - ((a + b) >> 1)), (uint8_t)(cur - png_paeth(a, b, c))};
+
+        for (int t = 0; t < 5; t++)
         {
-            blkSize = DEFLATE_MAX_BLOCK_SIZE;
-            uint8_t c = 0;
-            if (imgSize - img_pos <= (uint32_t)blkSize)
-            {
-                c = 1; // final block
-                blkSize = (uint16_t)(imgSize - img_pos);
-            }
-
-            Debug_println("Writing ZLIB block header.");
-            // write out block header
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-
-            // write out block size
-            c = (uint8_t)(blkSize >> 0);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)(blkSize >> 8);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)((blkSize >> 0) ^ 0xFF);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)((blkSize >> 8) ^ 0xFF);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-
-            //printf("new block\r\n");
+            if (x > 0 && f[t] != last[t])
+                changes[t]++;
+            last[t] = f[t];
         }
+    }
+
+    uint8_t type = 0;
+    for (uint8_t t = 1; t < 5; t++)
+        if (changes[t] * 2 < changes[type] * (type == 0 ? 1 : 2))
+            type = t;
 
-        //at beginning of a line?
-        if (Xpos == 0)
+    filter_line[0] = type;
+    for (uint32_t x = 0; x < width; x++)
+    {
+        int cur = line_buffer[x];
+        int a = x > 0 ? line_buffer[x - 1] : 0;
+        int b = prev_line[x];
+        int c = x > 0 ? prev_line[x - 1] : 0;
+        switch (type)
         {
-            Debug_printf("Starting PNG line %d ... ",Ypos);
-            c = 0;
-            crc_value = rc_crc32(crc_value, c);
-            adler_value = update_adler32(adler_value, c);
-            fputc(c, _file);
-            //printf("\nnew line %d ", c);
-
-            img_pos++;
-            blk_pos++;
+        case 1:
+            cur -= a;
+            break;
+        case 2:
+            cur -= b;
+            break;
+        case 3:
+            cur -= (a + b) >> 1;
+            break;
+        case 4:
+            cur -= png_paeth(a, b, c);
+            break;
         }
+        filter_line[x + 1] = (uint8_t)cur;
+    }
+}
 
-        // put byte from buffer
-        c = buf[idx];
-        crc_value = rc_crc32(crc_value, c);
-        adler_value = update_adler32(adler_value, c);
-        fputc(c, _file);
-        //printf("%d ", c);
+void pngPrinter::png_add_line(const uint8_t *line)
+{
+    if (height >= PNG_MAX_HEIGHT)
+        return;
+
+    Debug_printf("Adding PNG line %u\r\n", (unsigned)height);
+    if (line != line_buffer)
+        memcpy(line_buffer, line, width);
+    png_filter();
+    memcpy(prev_line, line_buffer, width);
+    deflater.write(filter_line, width + 1);
+    height++;
+
+    if (idat.size() >= PNG_IDAT_SIZE)
+        png_write_idat();
+}
 
-        Xpos++;
-        idx++;
-        img_pos++;
-        blk_pos++;
+void pngPrinter::png_write_idat()
+{
+    /*
+    There can be multiple IDAT chunks; if so, they must appear consecutively with no other intervening chunks.
+    (Multiple IDAT chunks are allowed so that encoders can work in a fixed amount of memory; typically the
+    chunk size will correspond to the encoder’s buffer size.)
+    */
+    if (idat.empty())
+        return;
 
-        // check for end of's
-        if (Xpos == width)
-        {
-            Debug_println("Finished PNG line.");
-            Xpos = 0;
-            Ypos++;
-        }
-        if (blk_pos == blkSize)
-        {
-            Debug_println("End of ZLIB block.");
-            blk_pos = 0;
-        }
+    uint8_t data[] = {
+        // IDAT chunk
+        0x00, 0x00, 0x00, 0x00, // 0-3      size
+        'I', 'D', 'A', 'T',     // 4-7      IDAT
     };
+    uint8_t ccc[] = {0, 0, 0, 0};
 
-    if (img_pos == imgSize)
-    {
-        Debug_println("Writing ZLIB Adler checksum and PNG data CRC.");
-        uint8_t data[] = {
-            0, 0, 0, 0, // Adler32 Check value: 4 bytes
-            0, 0, 0, 0  // CRC32: 4 bytes
-        };
-        uint32_to_array(adler_value, &data[0]);
-        for (int i = 0; i < 4; i++)
-            crc_value = rc_crc32(crc_value, data[i]); // crc_value = rc_crc32(crc_value, data[0],4); ?????????
-        uint32_to_array(crc_value, &data[4]);
-        fwrite(data, 1, 8, _file);
-        png_end();
-    }
+    uint32_to_array(idat.size(), &data[0]);
+    crc_value = rc_crc32(0, &data[4], 4);
+    crc_value = rc_crc32(crc_value, (const uint8_t *)idat.data(), idat.size());
+    uint32_to_array(crc_value, &ccc[0]);
+
+    fwrite(data, 1, 8, _file);
+    fwrite(idat.data(), 1, idat.size(), _file);
+    fwrite(ccc, 1, 4, _file);
+    idat.clear();
 }
 
 void pngPrinter::png_end()
@@ -366,20 +309,44 @@ void pngPrinter::png_end()
     fwrite(end, 1, 12, _file);
 }
 
-// TODO: Anything here?
 void pngPrinter::pre_close_file()
 {
-
+    // pad out to at least one screen
+    memset(line_buffer, 0, width);
+    while (height < PNG_SCREEN_HEIGHT)
+        png_add_line(line_buffer);
+
+    Debug_println("Writing ZLIB Adler checksum and last PNG data.");
+    deflater.end();
+    png_write_idat();
+    std::string().swap(idat);
+    png_end();
+
+    // now the height is known
+    fseek(_file, 8, SEEK_SET);
+    png_header();
+    fseek(_file, 0, SEEK_END);
 }
 
 void pngPrinter::post_new_file()
 {
+    height = 0;
+    BOLflag = true;
+    line_index = 0;
+    memset(prev_line, 0, width);
+    idat.clear();
+    idat.reserve(PNG_IDAT_SIZE + 64);
+    if (!deflater.begin(&idat, PNG_MATCH_CHAIN))
+    {
+        Debug_println("No memory for PNG compression, writing it uncompressed");
+        deflater.begin_stored(&idat);
+    }
+
     // call PNG header routines
     png_signature();
     png_header();
     png_palette();
-    // start IDAT chunk and now ready for data
-    png_data();
+    // IDAT chunks follow as image lines come in
 }
 
 bool pngPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
@@ -387,7 +354,7 @@ bool pngPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
 // copy buffer[] into linebuffer[]
     Debug_printf("%d bytes rx'd by PNG printer\r\n", n);
     uint16_t i = 0;
-    while (i < n && img_pos < imgSize)
+    while (i < n && height < PNG_MAX_HEIGHT)
     {
         //Debug_println("processing buffer.");
         if (BOLflag)
@@ -400,17 +367,13 @@ bool pngPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
         {
             line_buffer[line_index++] = buffer[i++];
         }
-        if (line_index == 320)
+        if (line_index == width)
         {
             while (rep_code-- > 0)
-            {
-                Debug_printf("Adding line %d\r\n", rep_code);
-                png_add_data(&line_buffer[0], 320);
-            }
+                png_add_line(line_buffer);
             BOLflag = true;
             line_index = 0;
         }
     }
     return true;
 }
-
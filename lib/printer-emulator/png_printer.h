@@ -3,43 +3,46 @@
 
 #include "printer.h"
 
+#include <string>
+
 #include "printer_emulator.h"
+#include "zlib_stream.h"
 
-#define DEFLATE_MAX_BLOCK_SIZE 0xFFFF
+#define PNG_WIDTH 320
+#define PNG_SCREEN_HEIGHT 192                  // lines in one screen, the least an image has
+#define PNG_MAX_HEIGHT (PNG_SCREEN_HEIGHT * 16) // taller dumps are cut off here
+#define PNG_IDAT_SIZE 2048                     // compressed bytes collected for each IDAT chunk
+#define PNG_MATCH_CHAIN 128                    // solid colour runs crowd the match candidates
 
 class pngPrinter : public printer_emu
 {
     // complete rewrite of TinyPngOut https://www.nayuki.io/page/tiny-png-output
 protected:
-    const uint32_t width = 320;
-    const uint32_t height = 192;
+    const uint32_t width = PNG_WIDTH;
+    uint32_t height = 0;                     // image lines so far, IHDR is fixed up at the end
 
-    const uint32_t imgSize = (width + 1) * height; // size of image including BOL filter p's for IDAT chunk
-    uint32_t img_pos = 0;                    // serial position within image data including BOL filter p's
-    uint16_t Xpos = 0;                       // current position within image line
-    uint16_t Ypos = 0;                       // current image line number
-    uint32_t dataSize = 0;                   // size of data for IDAT chunk
-    uint16_t blkSize = 0;                    // size of zlib block
-    uint16_t blk_pos = 0;                    // serial position within zlib block
+    zlibStream deflater;                     // compresses the filtered image lines
+    std::string idat;                        // compressed data waiting for the next IDAT chunk
     uint32_t crc_value = 0;                  // running crc32 value
-    uint32_t adler_value = 1;                // running checksum (initilize to 1 https://en.wikipedia.org/wiki/Adler-32)
 
-    uint8_t line_buffer[320];
+    uint8_t line_buffer[PNG_WIDTH];
+    uint8_t prev_line[PNG_WIDTH];            // last line added, for the Up, Average and Paeth filters
+    uint8_t filter_line[PNG_WIDTH + 1];      // filter type byte + filtered line
 
     bool BOLflag = true;
     uint16_t line_index = 0;
     uint8_t rep_code = 0;
 
     void uint32_to_array(uint32_t src, uint8_t dest[4]);
-    uint32_t update_adler32(uint32_t adler, uint8_t data);
     uint32_t rc_crc32(uint32_t crc, const uint8_t *buf, size_t len);
     uint32_t rc_crc32(uint32_t crc, uint8_t c) { return rc_crc32(crc, &c, 1); }
 
     void png_signature();
     void png_header();
     void png_palette();
-    void png_data();
-    void png_add_data(uint8_t *buf, uint32_t n);
+    void png_add_line(const uint8_t *line);
+    void png_filter();
+    void png_write_idat();
     void png_end();
 
     virtual void post_new_file() override;
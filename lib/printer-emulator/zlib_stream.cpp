@@ -0,0 +1,318 @@
+#include "zlib_stream.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#define ZLIB_HASH_SIZE (1 << ZLIB_HASH_BITS)
+#define ZLIB_MIN_MATCH 3
+#define ZLIB_MAX_MATCH 258
+#define ZLIB_LAZY_MATCH 32 // don't look for a better match after one this long
+
+// RFC 1951 3.2.5 length and distance codes
+static const uint16_t len_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                       257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                       7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+bool zlibStream::begin(std::string *out, int max_chain)
+{
+    release();
+
+    _window = (uint8_t *)malloc(2 * ZLIB_WINDOW_SIZE);
+    _head = (uint16_t *)calloc(ZLIB_HASH_SIZE, sizeof(uint16_t));
+    _prev = (uint16_t *)calloc(ZLIB_WINDOW_SIZE, sizeof(uint16_t));
+    if (_window == nullptr || _head == nullptr || _prev == nullptr)
+    {
+        release();
+        return false;
+    }
+
+    start(out);
+    _max_chain = max_chain;
+    // one fixed Huffman block for everything, closed in end()
+    put_bits(0, 1); // BFINAL
+    put_bits(1, 2); // BTYPE fixed
+    return true;
+}
+
+void zlibStream::begin_stored(std::string *out)
+{
+    release();
+    start(out);
+    _stored = true;
+}
+
+void zlibStream::start(std::string *out)
+{
+    _out = out;
+    _pos = _fill = 0;
+    _bitbuf = 0;
+    _bitcnt = 0;
+    _adler = 1;
+    _total_in = 0;
+
+    // zlib header: deflate, 32K window, no dictionary
+    _out->push_back((char)0x78);
+    _out->push_back((char)0x01);
+}
+
+void zlibStream::release()
+{
+    free(_window);
+    free(_head);
+    free(_prev);
+    _window = nullptr;
+    _head = _prev = nullptr;
+    _stored = false;
+}
+
+void zlibStream::write(const void *data, size_t len)
+{
+    const uint8_t *src = (const uint8_t *)data;
+
+    if (!active())
+        return;
+
+    _total_in += len;
+
+    // Adler-32, sums reduced often enough not to overflow
+    uint32_t s1 = _adler & 0xffff, s2 = _adler >> 16;
+    for (size_t i = 0; i < len;)
+    {
+        size_t n = len - i < 5552 ? len - i : 5552;
+        for (size_t j = 0; j < n; j++)
+        {
+            s1 += src[i + j];
+            s2 += s1;
+        }
+        s1 %= 65521;
+        s2 %= 65521;
+        i += n;
+    }
+    _adler = (s2 << 16) | s1;
+
+    if (_stored)
+    {
+        put_stored(src, len, false);
+        return;
+    }
+
+    while (len > 0)
+    {
+        if (_fill == 2 * ZLIB_WINDOW_SIZE)
+            slide();
+        size_t n = 2 * ZLIB_WINDOW_SIZE - _fill;
+        if (n > len)
+            n = len;
+        memcpy(_window + _fill, src, n);
+        _fill += n;
+        src += n;
+        len -= n;
+        deflate(false);
+    }
+}
+
+void zlibStream::end()
+{
+    if (!active())
+        return;
+
+    if (_stored)
+        put_stored(nullptr, 0, true);
+    else
+    {
+        deflate(true);
+        put_literal(256); // end of block
+
+        // empty final block
+        put_bits(1, 1);
+        put_bits(1, 2);
+        put_literal(256);
+        if (_bitcnt > 0)
+            put_bits(0, 8 - _bitcnt);
+    }
+
+    for (int i = 24; i >= 0; i -= 8)
+        _out->push_back((char)(_adler >> i));
+
+    release();
+}
+
+bool zlibStream::compress(const std::string &src, std::string &out)
+{
+    zlibStream z;
+    if (!z.begin(&out))
+        return false;
+    z.write(src);
+    z.end();
+    return true;
+}
+
+// RFC 1951 3.2.4 non-compressed blocks, byte aligned as only these are written
+void zlibStream::put_stored(const uint8_t *data, size_t len, bool final)
+{
+    do
+    {
+        size_t n = len < 0xFFFF ? len : 0xFFFF;
+        len -= n;
+        _out->push_back((char)(final && len == 0 ? 1 : 0)); // BFINAL, BTYPE stored
+        _out->push_back((char)n);
+        _out->push_back((char)(n >> 8));
+        _out->push_back((char)~n);
+        _out->push_back((char)(~n >> 8));
+        if (n > 0)
+            _out->append((const char *)data, n);
+        data += n;
+    } while (len > 0);
+}
+
+// Drop the oldest half of the window
+void zlibStream::slide()
+{
+    memmove(_window, _window + ZLIB_WINDOW_SIZE, ZLIB_WINDOW_SIZE);
+    _pos -= ZLIB_WINDOW_SIZE;
+    _fill -= ZLIB_WINDOW_SIZE;
+    for (int i = 0; i < ZLIB_HASH_SIZE; i++)
+        _head[i] = _head[i] > ZLIB_WINDOW_SIZE ? _head[i] - ZLIB_WINDOW_SIZE : 0;
+    for (int i = 0; i < ZLIB_WINDOW_SIZE; i++)
+        _prev[i] = _prev[i] > ZLIB_WINDOW_SIZE ? _prev[i] - ZLIB_WINDOW_SIZE : 0;
+}
+
+static inline unsigned hash3(const uint8_t *p)
+{
+    return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & (ZLIB_HASH_SIZE - 1);
+}
+
+void zlibStream::insert(size_t p)
+{
+    unsigned h = hash3(_window + p);
+    _prev[p & (ZLIB_WINDOW_SIZE - 1)] = _head[h];
+    _head[h] = (uint16_t)(p + 1);
+}
+
+size_t zlibStream::longest_match(size_t p, size_t &dist)
+{
+    size_t max = _fill - p < ZLIB_MAX_MATCH ? _fill - p : ZLIB_MAX_MATCH;
+    size_t best = 0;
+    unsigned cand = _head[hash3(_window + p)];
+
+    for (int chain = _max_chain; cand != 0 && chain > 0; chain--)
+    {
+        size_t c = cand - 1;
+        if (c >= p || p - c > ZLIB_WINDOW_SIZE)
+            break;
+
+        const uint8_t *a = _window + c, *b = _window + p;
+        if (a[best] == b[best])
+        {
+            size_t n = 0;
+            while (n < max && a[n] == b[n])
+                n++;
+            if (n > best)
+            {
+                best = n;
+                dist = p - c;
+                if (n == max)
+                    break;
+            }
+        }
+
+        unsigned next = _prev[c & (ZLIB_WINDOW_SIZE - 1)];
+        if (next >= cand)
+            break; // overwritten by a newer position
+        cand = next;
+    }
+    return best;
+}
+
+// Code the window up to where a full match could still be cut short by missing input
+void zlibStream::deflate(bool flush)
+{
+    while (flush ? _pos < _fill : _fill - _pos >= ZLIB_MAX_MATCH)
+    {
+        size_t len = 0, dist = 0;
+        if (_fill - _pos >= ZLIB_MIN_MATCH)
+        {
+            len = longest_match(_pos, dist);
+            insert(_pos);
+        }
+
+        // lazy match: a literal is cheaper if the next position matches longer
+        if (len >= ZLIB_MIN_MATCH && len < ZLIB_LAZY_MATCH && _fill - _pos > ZLIB_MIN_MATCH)
+        {
+            size_t dist2 = 0;
+            if (longest_match(_pos + 1, dist2) > len)
+            {
+                put_literal(_window[_pos++]);
+                continue;
+            }
+        }
+
+        if (len >= ZLIB_MIN_MATCH)
+        {
+            put_match(len, dist);
+            for (size_t i = 1; i < len; i++)
+                if (_pos + i + ZLIB_MIN_MATCH <= _fill)
+                    insert(_pos + i);
+            _pos += len;
+        }
+        else
+            put_literal(_window[_pos++]);
+    }
+}
+
+void zlibStream::put_bits(uint32_t bits, int n)
+{
+    _bitbuf |= bits << _bitcnt;
+    _bitcnt += n;
+    while (_bitcnt >= 8)
+    {
+        _out->push_back((char)(_bitbuf & 0xff));
+        _bitbuf >>= 8;
+        _bitcnt -= 8;
+    }
+}
+
+// Huffman codes go out most significant bit first
+void zlibStream::put_code(uint32_t code, int n)
+{
+    uint32_t rev = 0;
+    for (int i = 0; i < n; i++)
+    {
+        rev = (rev << 1) | (code & 1);
+        code >>= 1;
+    }
+    put_bits(rev, n);
+}
+
+// Fixed literal/length code, RFC 1951 3.2.6
+void zlibStream::put_literal(unsigned sym)
+{
+    if (sym < 144)
+        put_code(0x30 + sym, 8);
+    else if (sym < 256)
+        put_code(0x190 + sym - 144, 9);
+    else if (sym < 280)
+        put_code(sym - 256, 7);
+    else
+        put_code(0xc0 + sym - 280, 8);
+}
+
+void zlibStream::put_match(size_t len, size_t dist)
+{
+    int l = 28;
+    while (len_base[l] > len)
+        l--;
+    put_literal(257 + l);
+    put_bits(len - len_base[l], len_extra[l]);
+
+    int d = 29;
+    while (dist_base[d] > dist)
+        d--;
+    put_code(d, 5);
+    put_bits(dist - dist_base[d], dist_extra[d]);
+}
@@ -0,0 +1,71 @@
+#ifndef ZLIB_STREAM_H
+#define ZLIB_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Small streaming zlib (RFC 1950/1951) compressor for the printer emulators.
+// LZ77 over a sliding window with a hash chain, coded with the fixed Huffman
+// tables. Printer output (PDF operators, scanlines) is repetitive enough that
+// this gets most of what zlib would, in a few KB of RAM and no dependency.
+
+#define ZLIB_WINDOW_SIZE 4096 // match history, power of 2, at most 32768
+#define ZLIB_HASH_BITS 12
+#define ZLIB_MAX_CHAIN 16     // default number of match candidates tried per position
+
+class zlibStream
+{
+public:
+    ~zlibStream() { release(); }
+
+    // Start a new stream, compressed bytes are appended to out. A longer
+    // max_chain finds more matches in data with long runs, at a cost in speed.
+    // Returns false if the window could not be allocated.
+    bool begin(std::string *out, int max_chain = ZLIB_MAX_CHAIN);
+
+    // Start a new stream of stored (uncompressed) blocks, one per write().
+    // Needs no window, for output that must be zlib even when begin() fails.
+    void begin_stored(std::string *out);
+
+    // Compress more data
+    void write(const void *data, size_t len);
+    void write(const std::string &data) { write(data.data(), data.size()); }
+
+    // Compress what is left, close the stream (final block, Adler-32) and free the window
+    void end();
+
+    bool active() const { return _window != nullptr || _stored; }
+    uint32_t total_in() const { return _total_in; }
+
+    // One shot: compress src and append the zlib stream to out
+    static bool compress(const std::string &src, std::string &out);
+
+private:
+    std::string *_out = nullptr;
+    uint8_t *_window = nullptr; // 2 * ZLIB_WINDOW_SIZE, history + lookahead
+    uint16_t *_head = nullptr;  // hash -> window position + 1
+    uint16_t *_prev = nullptr;  // older positions with the same hash
+    size_t _pos = 0;            // next byte to code
+    size_t _fill = 0;           // bytes in the window
+    uint32_t _bitbuf = 0;
+    int _bitcnt = 0;
+    uint32_t _adler = 1;
+    uint32_t _total_in = 0;
+    int _max_chain = ZLIB_MAX_CHAIN;
+    bool _stored = false;       // begin_stored(), no window
+
+    void release();
+    void start(std::string *out);
+    void put_stored(const uint8_t *data, size_t len, bool final);
+    void slide();
+    void deflate(bool flush);
+    void insert(size_t p);
+    size_t longest_match(size_t p, size_t &dist);
+    void put_bits(uint32_t bits, int n);
+    void put_code(uint32_t code, int n);
+    void put_literal(unsigned sym);
+    void put_match(size_t len, size_t dist);
+};
+
+#endif // ZLIB_STREAM_H
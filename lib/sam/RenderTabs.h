@@ -101,7 +101,7 @@ const unsigned char sampledConsonantFlags[] =
 
 
 //tab45056
-unsigned char freq1data[]=
+const unsigned char freq1data[]=
 {
     0x00 ,0x13 ,0x13 ,0x13 ,0x13 , 0xA , 0xE ,0x12
     ,  0x18 ,0x1A ,0x16 ,0x14 ,0x10 ,0x14 , 0xE ,0x12
@@ -116,7 +116,7 @@ unsigned char freq1data[]=
 };
 
 //tab451356
-unsigned char freq2data[]=
+const unsigned char freq2data[]=
 {
     0x00 , 0x43 , 0x43 , 0x43 , 0x43 , 0x54 , 0x48 , 0x42 ,
     0x3E , 0x28 , 0x2C , 0x1E , 0x24 , 0x2C , 0x48 , 0x30 ,
@@ -131,7 +131,7 @@ unsigned char freq2data[]=
 };
 
 //tab45216
-unsigned char freq3data[]=
+const unsigned char freq3data[]=
 {
     0x00 , 0x5B , 0x5B , 0x5B , 0x5B , 0x6E , 0x5D , 0x5B ,
     0x58 , 0x59 , 0x57 , 0x58 , 0x52 , 0x59 , 0x5D , 0x3E ,
@@ -10,48 +10,11 @@
 
 extern int debug;
 
-unsigned char wait1 = 7;
-unsigned char wait2 = 6;
-
-extern unsigned char A, X, Y;
-extern unsigned char mem44;
-extern unsigned char mem47;
-extern unsigned char mem49;
-extern unsigned char mem39;
-extern unsigned char mem50;
-extern unsigned char mem51;
-extern unsigned char mem53;
-extern unsigned char mem56;
-
-extern unsigned char speed;
-extern unsigned char pitch;
-extern int singmode;
-
-extern unsigned char phonemeIndexOutput[60];  //tab47296
-extern unsigned char stressOutput[60];        //tab47365
-extern unsigned char phonemeLengthOutput[60]; //tab47416
-
-unsigned char pitches[256]; // tab43008
-
-unsigned char frequency1[256];
-unsigned char frequency2[256];
-unsigned char frequency3[256];
-
-unsigned char amplitude1[256];
-unsigned char amplitude2[256];
-unsigned char amplitude3[256];
-
-unsigned char sampledConsonantFlag[256]; // tab44800
-
-void AddInflection(unsigned char mem48, unsigned char phase1);
-unsigned char trans(unsigned char mem39212, unsigned char mem39213);
-
-// contains the final soundbuffer
-extern int bufferpos;
-extern char *buffer;
+static void AddInflection(struct sam_render *r, unsigned char mem48, unsigned char phase1);
+static unsigned char trans(unsigned char mem39212, unsigned char mem39213);
 
 //timetable for more accurate c64 simulation
-int timetable[5][5] =
+static const int timetable[5][5] =
     {
         {162, 167, 167, 127, 128},
         {226, 60, 60, 0, 0},
@@ -59,24 +22,71 @@ int timetable[5][5] =
         {200, 0, 0, 54, 55},
         {199, 0, 0, 54, 54}};
 
-static unsigned oldtimetableindex = 0;
-void Output8BitAry(int index, unsigned char ary[5])
+static void InitRender(struct sam_render *r, const struct sam_voice *voice, sam_pcm_sink sink, void *user)
+{
+    r->speed = voice->speed;
+    r->pitch = voice->pitch;
+    r->singmode = voice->singmode;
+    memcpy(r->freq1data, freq1data, sizeof(r->freq1data));
+    memcpy(r->freq2data, freq2data, sizeof(r->freq2data));
+    r->sink = sink;
+    r->user = user;
+}
+
+// The render code below is the 6502 translation and works on the registers,
+// zero page locations and tables by their old global names. These map them
+// onto the state of the current call.
+#define A (r->A)
+#define X (r->X)
+#define Y (r->Y)
+#define mem39 (r->mem39)
+#define mem44 (r->mem44)
+#define mem47 (r->mem47)
+#define mem49 (r->mem49)
+#define mem50 (r->mem50)
+#define mem51 (r->mem51)
+#define mem53 (r->mem53)
+#define mem56 (r->mem56)
+#define speed (r->speed)
+#define pitch (r->pitch)
+#define singmode (r->singmode)
+#define freq1data (r->freq1data)
+#define freq2data (r->freq2data)
+#define phonemeIndexOutput (r->phonemeIndexOutput)
+#define stressOutput (r->stressOutput)
+#define phonemeLengthOutput (r->phonemeLengthOutput)
+#define pitches (r->pitches)
+#define frequency1 (r->frequency1)
+#define frequency2 (r->frequency2)
+#define frequency3 (r->frequency3)
+#define amplitude1 (r->amplitude1)
+#define amplitude2 (r->amplitude2)
+#define amplitude3 (r->amplitude3)
+#define sampledConsonantFlag (r->sampledConsonantFlag)
+#define bufferpos (r->bufferpos)
+#define oldtimetableindex (r->oldtimetableindex)
+
+static void Output8BitAry(struct sam_render *r, int index, unsigned char ary[5])
 {
-    // printf("Output8BitAry\r\n");
     int k;
     bufferpos += timetable[oldtimetableindex][index];
     oldtimetableindex = index;
     // write a little bit in advance
     for (k = 0; k < 5; k++)
+        r->window[bufferpos / 50 - r->flushed + k] = ary[k];
+
+    // nothing is written before bufferpos / 50 any more, pass on full chunks
+    if (bufferpos / 50 - r->flushed >= SAM_CHUNK)
     {
-        // printf("%d %d\r\n", bufferpos,k);
-        buffer[bufferpos / 50 + k] = ary[k];
+        r->sink(r->user, r->window, SAM_CHUNK);
+        memmove(r->window, r->window + SAM_CHUNK, sizeof(r->window) - SAM_CHUNK);
+        r->flushed += SAM_CHUNK;
     }
 }
-void Output8Bit(int index, unsigned char A)
+static void Output8Bit(struct sam_render *r, int index, unsigned char value)
 {
-    unsigned char ary[5] = {A, A, A, A, A};
-    Output8BitAry(index, ary);
+    unsigned char ary[5] = {value, value, value, value, value};
+    Output8BitAry(r, index, ary);
 }
 
 //written by me because of different table positions.
@@ -88,54 +98,54 @@ void Output8Bit(int index, unsigned char A)
 // 172=amplitude1
 // 173=amplitude2
 // 174=amplitude3
-unsigned char Read(unsigned char p, unsigned char Y)
+static unsigned char Read(struct sam_render *r, unsigned char p, unsigned char index)
 {
     switch (p)
     {
     case 168:
-        return pitches[Y];
+        return pitches[index];
     case 169:
-        return frequency1[Y];
+        return frequency1[index];
     case 170:
-        return frequency2[Y];
+        return frequency2[index];
     case 171:
-        return frequency3[Y];
+        return frequency3[index];
     case 172:
-        return amplitude1[Y];
+        return amplitude1[index];
     case 173:
-        return amplitude2[Y];
+        return amplitude2[index];
     case 174:
-        return amplitude3[Y];
+        return amplitude3[index];
     }
     printf("Error reading to tables");
     return 0;
 }
 
-void Write(unsigned char p, unsigned char Y, unsigned char value)
+static void Write(struct sam_render *r, unsigned char p, unsigned char index, unsigned char value)
 {
 
     switch (p)
     {
     case 168:
-        pitches[Y] = value;
+        pitches[index] = value;
         return;
     case 169:
-        frequency1[Y] = value;
+        frequency1[index] = value;
         return;
     case 170:
-        frequency2[Y] = value;
+        frequency2[index] = value;
         return;
     case 171:
-        frequency3[Y] = value;
+        frequency3[index] = value;
         return;
     case 172:
-        amplitude1[Y] = value;
+        amplitude1[index] = value;
         return;
     case 173:
-        amplitude2[Y] = value;
+        amplitude2[index] = value;
         return;
     case 174:
-        amplitude3[Y] = value;
+        amplitude3[index] = value;
         return;
     }
     printf("Error writing to tables\r\n");
@@ -196,7 +206,7 @@ void Write(unsigned char p, unsigned char Y, unsigned char value)
 // For voices samples, samples are interleaved between voiced output.
 
 // Code48227()
-void RenderSample(unsigned char *mem66)
+static void RenderSample(struct sam_render *r, unsigned char *mem66)
 {
     int tempA;
     // current phoneme's index
@@ -256,14 +266,14 @@ pos48280:
         X = mem53;
         //mem[54296] = X;
         // output the byte
-        Output8Bit(1, (X & 0x0f) * 16);
+        Output8Bit(r, 1, (X & 0x0f) * 16);
         // if X != 0, exit loop
         if (X != 0)
             goto pos48296;
     }
 
     // output a 5 for the on bit
-    Output8Bit(2, 5 * 16);
+    Output8Bit(r, 2, 5 * 16);
 
     //48295: NOP
 pos48296:
@@ -302,7 +312,7 @@ pos48315:
 
         // shift through all 8 bits
         mem56 = 8;
-        //A = Read(mem47, Y);
+        //A = Read(r, mem47, Y);
 
         // fetch value from table
         A = sampleTable[mem47 * 256 + Y];
@@ -321,14 +331,14 @@ pos48315:
             {
                 // if bit set, output 26
                 X = 26;
-                Output8Bit(3, (X & 0xf) * 16);
+                Output8Bit(r, 3, (X & 0xf) * 16);
             }
             else
             {
                 //timetable 4
                 // bit is not set, output a 6
                 X = 6;
-                Output8Bit(4, (X & 0xf) * 16);
+                Output8Bit(r, 4, (X & 0xf) * 16);
             }
 
             mem56--;
@@ -366,7 +376,7 @@ pos48315:
 // 4. Render the each frame.
 
 //void Code47574()
-void Render()
+void Render(struct sam_render *r)
 {
     unsigned char phase1 = 0; //mem43
     unsigned char phase2 = 0;
@@ -419,7 +429,7 @@ void Render()
             A = 1;
             mem48 = 1;
             //goto pos48376;
-            AddInflection(mem48, phase1);
+            AddInflection(r, mem48, phase1);
         }
         /*
     if (A == 2) goto pos48372;
@@ -431,7 +441,7 @@ void Render()
             // printf("Render 4\r\n");
             // create falling inflection
             mem48 = 255;
-            AddInflection(mem48, phase1);
+            AddInflection(r, mem48, phase1);
         }
         //  pos47615:
 
@@ -681,20 +691,20 @@ void Render()
                     mem40 = mem36 + mem37;  // length of both halves
                     mem37 += mem49;         // center of next phoneme
                     mem36 = mem49 - mem36;  // center index of current phoneme
-                    A = Read(mem47, mem37); // value at center of next phoneme - end interpolation value
+                    A = Read(r, mem47, mem37); // value at center of next phoneme - end interpolation value
                     //A = mem[address];
 
                     Y = mem36;                      // start index of interpolation
-                    mem53 = A - Read(mem47, mem36); // value to center of current phoneme
+                    mem53 = A - Read(r, mem47, mem36); // value to center of current phoneme
                 }
                 else
                 {
                     // value to interpolate to
-                    A = Read(mem47, speedcounter);
+                    A = Read(r, mem47, speedcounter);
                     // position to start interpolation from
                     Y = phase3;
                     // value to interpolate from
-                    mem53 = A - Read(mem47, phase3);
+                    mem53 = A - Read(r, mem47, phase3);
                 }
 
                 //Code47503(mem40);
@@ -718,7 +728,7 @@ void Render()
                 //pos47908:
                 while (1) //while No. 3
                 {
-                    A = Read(mem47, Y) + mem53; //carry alway cleared
+                    A = Read(r, mem47, Y) + mem53; //carry alway cleared
 
                     mem48 = A;
                     Y++;
@@ -742,7 +752,7 @@ void Render()
                             mem48--;
                     }
                     //pos47945:
-                    Write(mem47, Y, mem48);
+                    Write(r, mem47, Y, mem48);
                 } //while No. 3
 
                 //pos47952:
@@ -838,7 +848,7 @@ void Render()
             // printf("Render 10\r\n");
 
             // render the sample for the phoneme
-            RenderSample(&mem66);
+            RenderSample(r, &mem66);
 
             // skip ahead two in the phoneme buffer
             Y += 2;
@@ -874,7 +884,7 @@ void Render()
             // printf("Render 12\r\n");
 
             // output the accumulated value
-            Output8BitAry(0, ary);
+            Output8BitAry(r, 0, ary);
 
             // printf("Render 13\r\n");
 
@@ -943,72 +953,19 @@ void Render()
 
         // printf("Render 18\r\n");
 
-        RenderSample(&mem66);
+        RenderSample(r, &mem66);
 
         // printf("Render 19\r\n");
 
         goto pos48159;
     } //while
-
-    // The following code is never reached. It's left over from when
-    // the voiced sample code was part of this loop, instead of part
-    // of RenderSample();
-
-    //pos48315:
-    int tempA;
-    phase1 = A ^ 255;
-    Y = mem66;
-    do
-    {
-        //pos48321:
-
-        mem56 = 8;
-        A = Read(mem47, Y);
-
-        //pos48327:
-        do
-        {
-            //48327: ASL A
-            //48328: BCC 48337
-            tempA = A;
-            A = A << 1;
-            if ((tempA & 128) != 0)
-            {
-                X = 26;
-                // mem[54296] = X;
-                bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
-            }
-            else
-            {
-                //mem[54296] = 6;
-                X = 6;
-                bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
-            }
-
-            for (X = wait2; X > 0; X--)
-                ; //wait
-            mem56--;
-        } while (mem56 != 0);
-
-        Y++;
-        phase1++;
-
-    } while (phase1 != 0);
-    //  if (phase1 != 0) goto pos48321;
-    A = 1;
-    mem44 = 1;
-    mem66 = Y;
-    Y = mem49;
-    return;
 }
 
 // Create a rising or falling inflection 30 frames prior to
 // index X. A rising inflection is used for questions, and
 // a falling inflection is used for statements.
 
-void AddInflection(unsigned char mem48, unsigned char phase1)
+static void AddInflection(struct sam_render *r, unsigned char mem48, unsigned char phase1)
 {
     //pos48372:
     //  mem48 = 255;
@@ -1060,7 +1017,7 @@ pos48406:
     mouth formant (F1) and the throat formant (F2). Only the voiced
     phonemes (5-29 and 48-53) are altered.
 */
-void SetMouthThroat(unsigned char mouth, unsigned char throat)
+void SetMouthThroat(struct sam_render *r, unsigned char mouth, unsigned char throat)
 {
     unsigned char initialFrequency;
     unsigned char newFrequency = 0;
@@ -1126,16 +1083,17 @@ void SetMouthThroat(unsigned char mouth, unsigned char throat)
 }
 
 //return = (mem39212*mem39213) >> 1
-unsigned char trans(unsigned char mem39212, unsigned char mem39213)
+static unsigned char trans(unsigned char mem39212, unsigned char mem39213)
 {
     //pos39008:
     unsigned char carry;
     int temp;
     unsigned char mem39214, mem39215;
-    A = 0;
+    unsigned char acc, count;
+    acc = 0;
     mem39215 = 0;
     mem39214 = 0;
-    X = 8;
+    count = 8;
     do
     {
         carry = mem39212 & 1;
@@ -1147,19 +1105,19 @@ unsigned char trans(unsigned char mem39212, unsigned char mem39213)
                         39021: BCC 39033
                         */
             carry = 0;
-            A = mem39215;
-            temp = (int)A + (int)mem39213;
-            A = A + mem39213;
+            acc = mem39215;
+            temp = (int)acc + (int)mem39213;
+            acc = acc + mem39213;
             if (temp > 255)
                 carry = 1;
-            mem39215 = A;
+            mem39215 = acc;
         }
         temp = mem39215 & 1;
         mem39215 = (mem39215 >> 1) | (carry ? 128 : 0);
         carry = temp;
         //39033: ROR 39215
-        X--;
-    } while (X != 0);
+        count--;
+    } while (count != 0);
     temp = mem39214 & 128;
     mem39214 = (mem39214 << 1) | (carry ? 1 : 0);
     carry = temp;
@@ -1169,4 +1127,68 @@ unsigned char trans(unsigned char mem39212, unsigned char mem39213)
 
     return mem39215;
 }
+
+//void Code48547()
+static void PrepareOutput(struct sam_render *r, const struct sam_phonemes *phonemes)
+{
+    A = 0;
+    X = 0;
+    Y = 0;
+
+    //pos48551:
+    while (1)
+    {
+        A = phonemes->index[X];
+        if (A == 255)
+        {
+            A = 255;
+            phonemeIndexOutput[Y] = 255;
+            Render(r);
+            return;
+        }
+        if (A == 254)
+        {
+            X++;
+            int temp = X;
+            //mem[48546] = X;
+            phonemeIndexOutput[Y] = 255;
+            Render(r);
+            //X = mem[48546];
+            X = temp;
+            Y = 0;
+            continue;
+        }
+
+        if (A == 0)
+        {
+            X++;
+            continue;
+        }
+
+        phonemeIndexOutput[Y] = A;
+        phonemeLengthOutput[Y] = phonemes->length[X];
+        stressOutput[Y] = phonemes->stress[X];
+        X++;
+        Y++;
+    }
+}
+
+int SAMRender(const struct sam_phonemes *phonemes, const struct sam_voice *voice, sam_pcm_sink sink, void *user)
+{
+    struct sam_render *r = (struct sam_render *)calloc(1, sizeof(struct sam_render));
+    if (r == NULL)
+        return -1;
+
+    InitRender(r, voice, sink, user);
+    SetMouthThroat(r, voice->mouth, voice->throat);
+    PrepareOutput(r, phonemes);
+
+    // the rest of the samples are final now
+    int samples = bufferpos / 50;
+    if (samples > r->flushed)
+        sink(user, r->window, samples - r->flushed);
+
+    free(r);
+    return samples;
+}
 #endif /* BUILD_ATARI */
\ No newline at end of file
@@ -1,7 +1,47 @@
 #ifndef RENDER_H
 #define RENDER_H
 
-void Render();
-void SetMouthThroat(unsigned char mouth, unsigned char throat);
+#include "sam.h"
+
+// State of one SAMRender() call. Field names are the zero page locations and
+// registers of the original 6502 code, render.c maps the old globals onto them.
+struct sam_render
+{
+    unsigned char A, X, Y;
+    unsigned char mem39, mem44, mem47, mem49, mem50, mem51, mem53, mem56;
+
+    // voice, freq1data and freq2data have mouth and throat applied
+    unsigned char speed;
+    unsigned char pitch;
+    int singmode;
+    unsigned char freq1data[80];
+    unsigned char freq2data[80];
+
+    // phonemes of the part being rendered
+    unsigned char phonemeIndexOutput[60];  //tab47296
+    unsigned char stressOutput[60];        //tab47365
+    unsigned char phonemeLengthOutput[60]; //tab47416
+
+    // frames
+    unsigned char pitches[256]; // tab43008
+    unsigned char frequency1[256];
+    unsigned char frequency2[256];
+    unsigned char frequency3[256];
+    unsigned char amplitude1[256];
+    unsigned char amplitude2[256];
+    unsigned char amplitude3[256];
+    unsigned char sampledConsonantFlag[256]; // tab44800
+
+    // output position in 1/50 samples, samples before bufferpos / 50 are final
+    int bufferpos;
+    unsigned oldtimetableindex;
+    int flushed;                         // samples passed to sink
+    unsigned char window[SAM_CHUNK + 16]; // samples from flushed on, written up to SAM_CHUNK + 8
+    sam_pcm_sink sink;
+    void *user;
+};
+
+void Render(struct sam_render *r);
+void SetMouthThroat(struct sam_render *r, unsigned char mouth, unsigned char throat);
 
 #endif
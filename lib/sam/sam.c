@@ -1,14 +1,15 @@
 
 #include "sam.h"
 
+#ifdef ESP_PLATFORM
 #include <esp_heap_caps.h>
+#endif
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "samdebug.h"
-#include "render.h"
 #include "SamTabs.h"
 
 
@@ -39,11 +40,8 @@ unsigned char stress[256];        //numbers from 0 to 8
 unsigned char phonemeLength[256]; //tab40160
 unsigned char phonemeindex[256];
 
-unsigned char phonemeIndexOutput[60];  //tab47296
-unsigned char stressOutput[60];        //tab47365
-unsigned char phonemeLengthOutput[60]; //tab47416
-
-// contains the final soundbuffer
+// contains the final soundbuffer of SAMMain()
+#define SAM_BUFFER_SIZE (22050 * 10)
 int bufferpos = 0;
 char *buffer = NULL;
 
@@ -77,8 +75,6 @@ void AdjustLengths();
 void Code41240();
 void Insert(unsigned char position, unsigned char mem60, unsigned char mem59, unsigned char mem58);
 void InsertBreath();
-void PrepareOutput();
-void SetMouthThroat(unsigned char mouth, unsigned char throat);
 
 // 168=pitches
 // 169=frequency1
@@ -94,21 +90,6 @@ void Init()
 
     // printf("Initialize!\r\n");
 
-    SetMouthThroat(mouth, throat);
-
-    bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    /*
-    Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
-    The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
-    https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/mem_alloc.html
-    */
-
-    // printf("buffer pointer %d\r\n", buffer);
-
     /*
     freq2data = &mem[45136];
     freq1data = &mem[45056];
@@ -137,18 +118,11 @@ void Init()
         stress[i] = 0;
         phonemeLength[i] = 0;
     }
-
-    for (i = 0; i < 60; i++)
-    {
-        phonemeIndexOutput[i] = 0;
-        stressOutput[i] = 0;
-        phonemeLengthOutput[i] = 0;
-    }
     phonemeindex[255] = 255; //to prevent buffer overflow // ML : changed from 32 to 255 to stop freezing with long inputs
 }
 
 //int Code39771()
-int SAMMain()
+int SAMParse(struct sam_phonemes *phonemes)
 {
     Init();
     phonemeindex[255] = 32; //to prevent buffer overflow
@@ -182,54 +156,53 @@ int SAMMain()
         PrintPhonemes(phonemeindex, phonemeLength, stress);
     }
 
-    PrepareOutput();
-
+    memcpy(phonemes->index, phonemeindex, sizeof(phonemes->index));
+    memcpy(phonemes->length, phonemeLength, sizeof(phonemes->length));
+    memcpy(phonemes->stress, stress, sizeof(phonemes->stress));
     return 1;
 }
 
-//void Code48547()
-void PrepareOutput()
+static void BufferSink(void *user, const unsigned char *pcm, int len)
 {
-    A = 0;
-    X = 0;
-    Y = 0;
+    if (len > SAM_BUFFER_SIZE - bufferpos)
+        len = SAM_BUFFER_SIZE - bufferpos;
+    memcpy(buffer + bufferpos, pcm, len);
+    bufferpos += len;
+}
 
-    //pos48551:
-    while (1)
-    {
-        A = phonemeindex[X];
-        if (A == 255)
-        {
-            A = 255;
-            phonemeIndexOutput[Y] = 255;
-            Render();
-            return;
-        }
-        if (A == 254)
-        {
-            X++;
-            int temp = X;
-            //mem[48546] = X;
-            phonemeIndexOutput[Y] = 255;
-            Render();
-            //X = mem[48546];
-            X = temp;
-            Y = 0;
-            continue;
-        }
+// Renders the whole input into the buffer, up to 10 seconds of it
+int SAMMain()
+{
+    static struct sam_phonemes phonemes;
+    struct sam_voice voice = {speed, pitch, mouth, throat, singmode};
 
-        if (A == 0)
-        {
-            X++;
-            continue;
-        }
+    if (!SAMParse(&phonemes))
+        return 0;
 
-        phonemeIndexOutput[Y] = A;
-        phonemeLengthOutput[Y] = phonemeLength[X];
-        stressOutput[Y] = stress[X];
-        X++;
-        Y++;
+    bufferpos = 0;
+#ifdef ESP_PLATFORM
+    /*
+    Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
+    The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
+    https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/mem_alloc.html
+    */
+    buffer = (char *)heap_caps_malloc(SAM_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+    buffer = (char *)malloc(SAM_BUFFER_SIZE);
+#endif
+    if (buffer == NULL)
+        return 0;
+
+    if (SAMRender(&phonemes, &voice, BufferSink, NULL) < 0)
+    {
+        FreeBuffer();
+        buffer = NULL;
+        return 0;
     }
+
+    // GetBufferLength() is in 1/50 samples, like the render position it used to be
+    bufferpos *= 50;
+    return 1;
 }
 
 //void Code48431()
@@ -19,6 +19,35 @@ extern "C"
     char *GetBuffer();
     int GetBufferLength();
     void FreeBuffer();
+
+    // Phoneme list made by the front end from the input, ends with 255
+    struct sam_phonemes
+    {
+        unsigned char index[256];
+        unsigned char length[256];
+        unsigned char stress[256];
+    };
+
+    struct sam_voice
+    {
+        unsigned char speed;  // default 72
+        unsigned char pitch;  // default 64
+        unsigned char mouth;  // default 128
+        unsigned char throat; // default 128
+        int singmode;
+    };
+
+    // Receives 8-bit unsigned mono PCM at 22050 Hz, at most SAM_CHUNK bytes at a time
+    typedef void (*sam_pcm_sink)(void *user, const unsigned char *pcm, int len);
+#define SAM_CHUNK 1024
+
+    // Runs the front end on the input set by SetInput(). Uses global state, calls must not overlap.
+    int SAMParse(struct sam_phonemes *phonemes);
+
+    // Renders phonemes, passing samples to sink as soon as they are final.
+    // Keeps its state in its own allocation and may run on several threads at once.
+    // Returns the number of samples, or -1 if out of memory.
+    int SAMRender(const struct sam_phonemes *phonemes, const struct sam_voice *voice, sam_pcm_sink sink, void *user);
     
     //char input[]={"/HAALAOAO MAYN NAAMAEAE IHSTT SAEBAASTTIHAAN \x9b\x9b\0"};
     //unsigned char input[]={"/HAALAOAO \x9b\0"};
@@ -0,0 +1,164 @@
+#ifdef BUILD_ATARI
+
+#include "samcache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include "compat_string.h"
+#include "reciter.h"
+
+extern char input[256];
+extern int debug;
+
+SamCache samCache;
+
+struct render_sink
+{
+    const SamCache::output_fn_t *output;
+    SamCache::wave_data_t *wave;
+    size_t max_bytes;
+};
+
+// Passes the pieces on as they come and keeps a copy for the cache
+static void render_to_output(void *user, const unsigned char *pcm, int len)
+{
+    render_sink *sink = (render_sink *)user;
+    (*sink->output)(pcm, len);
+
+    if (sink->wave->size() + len > sink->max_bytes)
+    {
+        // too long to keep
+        sink->wave->clear();
+        sink->wave->shrink_to_fit();
+        sink->max_bytes = 0;
+    }
+    else
+        sink->wave->insert(sink->wave->end(), pcm, pcm + len);
+}
+
+int SamCache::say(const char *text, bool phonetic, const sam_voice &voice, const output_fn_t &output)
+{
+    // the front end takes up to 254 characters, upper case
+    std::string upper(text, strnlen(text, 254));
+    for (auto &c : upper)
+        c = toupper((unsigned char)c);
+
+    std::string key;
+    key += phonetic ? 'P' : 'T';
+    key += (char)voice.speed;
+    key += (char)voice.pitch;
+    key += (char)voice.mouth;
+    key += (char)voice.throat;
+    key += voice.singmode ? 'S' : '-';
+    key += upper;
+
+    wave_t wave = find(key);
+    if (wave)
+    {
+        for (size_t i = 0; i < wave->size(); i += SAM_CHUNK)
+            output(wave->data() + i, std::min<size_t>(SAM_CHUNK, wave->size() - i));
+        return wave->size();
+    }
+
+    std::unique_ptr<sam_phonemes> phonemes(new sam_phonemes);
+    if (!parse(upper, phonetic, *phonemes))
+        return 0;
+
+    std::shared_ptr<wave_data_t> rendered = std::make_shared<wave_data_t>();
+    render_sink sink = {&output, rendered.get(), _max_bytes};
+    int samples = SAMRender(phonemes.get(), &voice, render_to_output, &sink);
+    if (samples <= 0)
+        return 0;
+
+    if (sink.max_bytes != 0)
+        add(key, rendered);
+    return samples;
+}
+
+bool SamCache::parse(const std::string &text, bool phonetic, sam_phonemes &phonemes)
+{
+    std::lock_guard<std::mutex> lock(_parse_mutex);
+
+    memset(input, 0, sizeof(input));
+    memcpy(input, text.data(), text.size());
+
+    if (debug)
+        printf("%s input: %s\r\n", phonetic ? "phonetic" : "text", input);
+
+    if (!phonetic)
+    {
+        strlcat(input, "[", sizeof(input) - strlen(input));
+        if (!TextToPhonemes((unsigned char *)input))
+            return false;
+        if (debug)
+            printf("phonetic input: %s\r\n", input);
+    }
+    else
+        strlcat(input, "\x9b", sizeof(input) - strlen(input));
+
+    return SAMParse(&phonemes) != 0;
+}
+
+SamCache::wave_t SamCache::find(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _phrases.size(); i++)
+    {
+        if (_phrases[i].key == key)
+        {
+            // most recently used goes to the end
+            phrase p = std::move(_phrases[i]);
+            _phrases.erase(_phrases.begin() + i);
+            _phrases.push_back(std::move(p));
+            _hits++;
+            return _phrases.back().wave;
+        }
+    }
+    _misses++;
+    return nullptr;
+}
+
+void SamCache::add(const std::string &key, wave_t wave)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // another caller may have rendered it meanwhile
+    for (const auto &p : _phrases)
+        if (p.key == key)
+            return;
+
+    // make room by dropping the least recently used phrases, a phrase
+    // being played keeps its waveform until it is done
+    while (!_phrases.empty() && _bytes + wave->size() > _max_bytes)
+    {
+        _bytes -= _phrases.front().wave->size();
+        _phrases.erase(_phrases.begin());
+    }
+
+    _bytes += wave->size();
+    _phrases.push_back({key, wave});
+}
+
+void SamCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _phrases.clear();
+    _bytes = 0;
+}
+
+size_t SamCache::phrase_count()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _phrases.size();
+}
+
+size_t SamCache::byte_count()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bytes;
+}
+
+#endif /* BUILD_ATARI */
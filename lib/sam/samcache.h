@@ -0,0 +1,91 @@
+/**
+ * Cache of phrases rendered by SAM, so prompts that are said again play at once
+ */
+
+#ifndef SAMCACHE_H
+#define SAMCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sam.h"
+
+#ifdef ESP_PLATFORM
+#include "../../include/PSRAMAllocator.h"
+#endif
+
+// waveform bytes kept, about 12 seconds of speech, 1.5 seconds without PSRAM
+#if defined(ESP_PLATFORM) && !CONFIG_SPIRAM
+#define SAM_CACHE_BYTES (32 * 1024)
+#else
+#define SAM_CACHE_BYTES (256 * 1024)
+#endif
+
+/**
+ * Says phrases with SAM and keeps the waveforms of the most recent ones.
+ *
+ * A phrase is looked up by its text, phonetic flag and voice. A phrase that
+ * is not in the cache goes through the front end (reciter and parser), which
+ * uses the global state in sam.c and is run by one caller at a time, and is
+ * then rendered outside the lock, handing out pieces as they are ready. The
+ * least recently used phrases are dropped to keep the cache under max_bytes,
+ * a phrase longer than that is played but not kept.
+ */
+class SamCache
+{
+public:
+    // Receives 8-bit unsigned mono PCM at 22050 Hz, in pieces of up to SAM_CHUNK bytes
+    typedef std::function<void(const uint8_t *pcm, size_t len)> output_fn_t;
+
+    // Waveforms are kept in PSRAM when there is some
+#ifdef ESP_PLATFORM
+    typedef std::vector<uint8_t, PSRAMAllocator<uint8_t>> wave_data_t;
+#else
+    typedef std::vector<uint8_t> wave_data_t;
+#endif
+
+    SamCache(size_t max_bytes = SAM_CACHE_BYTES) : _max_bytes(max_bytes) {}
+
+    /**
+     * Say text, or phonemes if phonetic is set, passing the waveform to output.
+     * Returns the number of samples, or 0 if SAM can't say it.
+     */
+    int say(const char *text, bool phonetic, const sam_voice &voice, const output_fn_t &output);
+
+    void clear();
+
+    size_t phrase_count();
+    size_t byte_count();
+    unsigned long hit_count() { return _hits; }
+    unsigned long miss_count() { return _misses; }
+
+private:
+    typedef std::shared_ptr<const wave_data_t> wave_t;
+
+    struct phrase
+    {
+        std::string key;
+        wave_t wave;
+    };
+
+    std::vector<phrase> _phrases; // least recently used first
+    size_t _bytes = 0;
+    size_t _max_bytes;
+    std::mutex _mutex;       // guards the above
+    std::mutex _parse_mutex; // the front end
+    unsigned long _hits = 0;
+    unsigned long _misses = 0;
+
+    wave_t find(const std::string &key);
+    void add(const std::string &key, wave_t wave);
+    bool parse(const std::string &text, bool phonetic, sam_phonemes &phonemes);
+};
+
+extern SamCache samCache;
+
+#endif /* SAMCACHE_H */
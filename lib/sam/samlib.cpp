@@ -1,6 +1,8 @@
 
 #include "samlib.h"
 
+#include <vector>
+
 #include <freertos/FreeRTOS.h>
 #include <freertos/timers.h>
 #include <driver/gpio.h>
@@ -10,10 +12,10 @@
 
 
 #include "fnSystem.h"
+#include "samcache.h"
 
 #ifdef __cplusplus
 extern char input[256];
-extern char *buffer;
 #endif
 
 int debug = 0;
@@ -104,99 +106,50 @@ void PrintUsage()
     */
 }
 
-#ifdef USESDL
-
-int pos = 0;
-void MixAudio(void *unused, Uint8 *stream, int len)
-{
-    int bufferpos = GetBufferLength();
-    char *buffer = GetBuffer();
-    int i;
-    if (pos >= bufferpos)
-        return;
-    if ((bufferpos - pos) < len)
-        len = (bufferpos - pos);
-    for (i = 0; i < len; i++)
-    {
-        stream[i] = buffer[pos];
-        pos++;
-    }
-}
-
-void OutputSound()
+#if defined(ESP_PLATFORM) && !defined(CONFIG_IDF_TARGET_ESP32S3)
+// Plays a phrase on the DAC piece by piece as it is rendered. Samples are timed
+// from the start of the phrase, so the time taken to render the next piece is
+// made up instead of leaving a gap.
+class DacOutput
 {
-    int bufferpos = GetBufferLength();
-    bufferpos /= 50;
-    SDL_AudioSpec fmt;
+public:
+    DacOutput() { dac_output_enable(DAC_CHANNEL_1); }
+    ~DacOutput() { dac_output_disable(DAC_CHANNEL_1); }
 
-    fmt.freq = 22050;
-    fmt.format = AUDIO_U8;
-    fmt.channels = 1;
-    fmt.samples = 2048;
-    fmt.callback = MixAudio;
-    fmt.userdata = NULL;
-
-    /* Open the audio device and start playing sound! */
-    if (SDL_OpenAudio(&fmt, NULL) < 0)
+    void play(const uint8_t *pcm, size_t len)
     {
-        printf("Unable to open audio: %s\r\n", SDL_GetError());
-        exit(1);
-    }
-    SDL_PauseAudio(0);
-    //SDL_Delay((bufferpos)/7);
-
-    while (pos < bufferpos)
-    {
-        SDL_Delay(100);
-    }
-
-    SDL_CloseAudio();
-}
-
-#else
-
-void OutputSound()
-{
-#ifdef ESP_PLATFORM
-#ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
-
-    //fnSystem.dac_output_enable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    //fnSystem.dac_output_voltage(SystemManager::dac_channel_t::DAC_CHANNEL_1, 100);
-
-    dac_output_enable(DAC_CHANNEL_1);
-
-    for (int i = 0; i < n; i++)
-    {
-        //dacWrite(DAC1, s[i]);
-        // fnSystem.dac_write(PIN_DAC1, s[i]);
-        dac_output_voltage(DAC_CHANNEL_1, s[i]);
-        //delayMicroseconds(40);
-        fnSystem.delay_microseconds(40);
+        if (_samples == 0)
+            _start = fnSystem.micros();
+        for (size_t i = 0; i < len; i++)
+        {
+            dac_output_voltage(DAC_CHANNEL_1, pcm[i]);
+            _samples++;
+            unsigned long due = _start + (unsigned long)(_samples * 1000000 / 22050);
+            long wait = (long)(due - fnSystem.micros());
+            if (wait > 0)
+                fnSystem.delay_microseconds(wait);
+        }
     }
 
-    //fnSystem.dac_output_disable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    dac_output_disable(DAC_CHANNEL_1);
-
-    FreeBuffer();
-#endif
-#endif
-}
-
+private:
+    unsigned long _start = 0;
+    uint64_t _samples = 0;
+};
 #endif
 
 int sam(int argc, char **argv)
 {
     int i;
     int phonetic = 0;
+    char text[256];
+    sam_voice voice = {72, 64, 128, 128, 0};
 
 #ifndef ESP_PLATFORM
     char *wavfilename = NULL;
 #endif
 
     for (i = 0; i < 256; i++)
-        input[i] = 0;
+        text[i] = 0;
 
     if (argc <= 1)
     {
@@ -209,8 +162,8 @@ int sam(int argc, char **argv)
     {
         if (argv[i][0] != '-')
         {
-            strlcat(input, argv[i], 255);
-            strlcat(input, " ", 255);
+            strlcat(text, argv[i], 255);
+            strlcat(text, " ", 255);
         }
         else
         {
@@ -226,7 +179,7 @@ int sam(int argc, char **argv)
 
                 if (strcmp(&argv[i][1], "sing") == 0)
             {
-                EnableSingmode();
+                voice.singmode = 1;
             }
             else if (strcmp(&argv[i][1], "phonetic") == 0)
             {
@@ -238,22 +191,22 @@ int sam(int argc, char **argv)
             }
             else if (strcmp(&argv[i][1], "pitch") == 0)
             {
-                SetPitch(atoi(argv[i + 1]));
+                voice.pitch = atoi(argv[i + 1]);
                 i++;
             }
             else if (strcmp(&argv[i][1], "speed") == 0)
             {
-                SetSpeed(atoi(argv[i + 1]));
+                voice.speed = atoi(argv[i + 1]);
                 i++;
             }
             else if (strcmp(&argv[i][1], "mouth") == 0)
             {
-                SetMouth(atoi(argv[i + 1]));
+                voice.mouth = atoi(argv[i + 1]);
                 i++;
             }
             else if (strcmp(&argv[i][1], "throat") == 0)
             {
-                SetThroat(atoi(argv[i + 1]));
+                voice.throat = atoi(argv[i + 1]);
                 i++;
             }
             else
@@ -266,61 +219,36 @@ int sam(int argc, char **argv)
         i++;
     } //while
 
-    // printf("arg parsing done\r\n");
-
-    for (i = 0; input[i] != 0; i++)
-        input[i] = toupper((int)input[i]);
-
-    if (debug)
-    {
-        if (phonetic)
-            printf("phonetic input: %s\r\n", input);
-        else
-            printf("text input: %s\r\n", input);
-    }
-
-    if (!phonetic)
+    // Phrases said before play from the cache, new ones play while they are rendered
+    int samples;
+#ifndef ESP_PLATFORM
+    if (wavfilename != NULL)
     {
-        strlcat(input, "[", sizeof(input) - strlen(input));
-        // printf("TextToPhonemes\r\n");
-        if (!TextToPhonemes((unsigned char *)input))
-            return 1;
-        if (debug)
-            printf("phonetic input: %s\r\n", input);
+        std::vector<uint8_t> wav;
+        samples = samCache.say(text, phonetic, voice, [&wav](const uint8_t *pcm, size_t len) {
+            wav.insert(wav.end(), pcm, pcm + len);
+        });
+        if (samples > 0)
+            WriteWav(wavfilename, (char *)wav.data(), wav.size());
     }
     else
-        strlcat(input, "\x9b", sizeof(input) - strlen(input));
-
-        // printf("done phonetic processing\r\n");
-
-#ifdef USESDL
-    if (SDL_Init(SDL_INIT_AUDIO) < 0)
+#endif // ESP_PLATFORM
     {
-        printf("Unable to init SDL: %s\r\n", SDL_GetError());
-        exit(1);
-    }
-    atexit(SDL_Quit);
-#endif
-
-#ifndef __cplusplus
-    SetInput(input);
+#if defined(ESP_PLATFORM) && !defined(CONFIG_IDF_TARGET_ESP32S3)
+        DacOutput dac;
+        samples = samCache.say(text, phonetic, voice, [&dac](const uint8_t *pcm, size_t len) {
+            dac.play(pcm, len);
+        });
+#else
+        samples = samCache.say(text, phonetic, voice, [](const uint8_t *pcm, size_t len) {});
 #endif
+    }
 
-    // printf("right before SAMMain");
-
-    if (!SAMMain())
+    if (samples <= 0)
     {
         PrintUsage();
         return 1;
     }
-    // printf("right after SAMMain");
-
-#ifndef ESP_PLATFORM
-    if (wavfilename != NULL)
-        WriteWav(wavfilename, GetBuffer(), GetBufferLength() / 50);
-    else
-#endif // ESP_PLATFORM
-        OutputSound();
 
     return 0;
 }
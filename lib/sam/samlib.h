@@ -7,11 +7,6 @@
 #include "sam.h"
 #include "samdebug.h"
 
-#ifdef USESDL
-#include <SDL.h>
-#include <SDL_audio.h>
-#endif
-
 #ifdef ESP_PLATFORM
 #include "../../include/pinmap.h"
 #endif
@@ -26,11 +21,4 @@ void WriteWav(char *filename, char *buffer, int bufferlength);
 
 void PrintUsage();
 
-#ifdef USESDL
-void MixAudio(void *unused, Uint8 *stream, int len);
-void OutputSound();
-#else
-void OutputSound();
-#endif
-
 int sam(int argc, char **argv);
@@ -93,10 +93,12 @@ bool WebDAV::parse(const char *buf, int len, int isFinal)
         return true;
     }
 
+#ifdef VERBOSE_PROTOCOL
     // Put PROPFIND data to debug console
     Debug_printf("WebDAV::parse data (%d bytes):\r\n", len);
     if (len > 0)
-        Debug_printf("%s\r\n", buf);
+        Debug_printf("%.*s\r\n", len, buf);
+#endif
 
     // Parse the damned buffer
     XML_Status xs = XML_Parse(parser, buf, len, isFinal);
@@ -110,12 +112,22 @@ bool WebDAV::parse(const char *buf, int len, int isFinal)
     return false;
 }
 
+bool WebDAV::next_entry(DAVEntry &entry)
+{
+    if (entries.empty())
+        return false;
+
+    entry = std::move(entries.front());
+    entries.pop_front();
+    return true;
+}
+
 void WebDAV::clear()
 {
     entries.clear();
     entries.shrink_to_fit();
     currentEntry.filename.clear();
-    currentEntry.fileSize.clear();
+    currentEntry.fileSize = 0;
     currentEntry.isDir = false;
 }
 
@@ -125,7 +137,9 @@ void WebDAV::Start(const XML_Char *el, const XML_Char **attr)
     size_t el_len = strlen(el);
     if (IS_ANYNS_ELEMENT("response", el, el_len))
     {
+#ifdef VERBOSE_PROTOCOL
         Debug_println("Response Entry:");
+#endif
         insideResponse = true;
     }
     else if (IS_ANYNS_ELEMENT("displayname", el, el_len))
@@ -145,24 +159,21 @@ void WebDAV::End(const XML_Char *el)
         // skip first entry (current directory)
         if (entriesCounter++ == 0) 
             store = false;
-        // skip entries over limit
-        else if (entriesCounter >= 1000)
-        {
-            store = false;
-            if (entriesCounter == 1000)
-                Debug_printf("Too many directory entries");
-        }
         // skip noname entries
         else if (currentEntry.filename.empty())
             store = false;
 
-        // store directory entry
+#ifdef VERBOSE_PROTOCOL
+        Debug_printf("  filename = %s, fileSize = %lu\n", currentEntry.filename.c_str(), (unsigned long)currentEntry.fileSize);
+#endif
+
+        // queue directory entry
         if (store)
-            entries.push_back(currentEntry);
+            entries.push_back(std::move(currentEntry));
 
         // reset currentEntry
         currentEntry.filename.clear();
-        currentEntry.fileSize.clear();
+        currentEntry.fileSize = 0;
         currentEntry.isDir = false;
     }
     else if (IS_ANYNS_ELEMENT("displayname", el, el_len))
@@ -175,17 +186,16 @@ void WebDAV::End(const XML_Char *el)
 
 void WebDAV::Char(const XML_Char *s, int len)
 {
+    // expat may deliver the text of one element in several calls
     if (insideResponse == true)
     {
         if (insideDisplayName == true)
-        {
-            currentEntry.filename = std::string(s, len);
-            Debug_printf("  filename = %s\n", currentEntry.filename.c_str());
-        }
+            currentEntry.filename.append(s, len);
         else if (insideGetContentLength == true)
         {
-            currentEntry.fileSize = std::string(s, len);
-            Debug_printf("  fileSize = %s\n", currentEntry.fileSize.c_str());
+            for (int i = 0; i < len; i++)
+                if (s[i] >= '0' && s[i] <= '9')
+                    currentEntry.fileSize = currentEntry.fileSize * 10 + (s[i] - '0');
         }
     }
 }
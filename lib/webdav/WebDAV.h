@@ -6,13 +6,18 @@
 #define WebDAV_H
 
 #include <expat.h>
+#include <cstdint>
+#include <deque>
 #include <string>
-#include <vector>
 
 // using namespace std;
 
 /**
  * @brief a class wrapping expat parser for directory entries
+ *
+ * The PROPFIND response is fed in pieces with parse(), each completed entry
+ * is queued until next_entry() hands it out. The caller only parses more
+ * once the queue is empty, so memory use does not grow with the directory.
  */
 class WebDAV
 {
@@ -34,7 +39,7 @@ public:
         /**
          * Entry filesize
          */
-        std::string fileSize;
+        uint32_t fileSize;
     };
 
     /**
@@ -54,9 +59,16 @@ public:
     bool parse(const char *buf, int len, int isFinal);
 
     /**
-     * @brief Called to scoot to beginning of directory entries
+     * @brief Take the next parsed directory entry
+     * @param entry receives the entry
+     * @return false if no entry is waiting
      */
-    std::vector<WebDAV::DAVEntry>::iterator rewind() {return entries.begin();};
+    bool next_entry(DAVEntry &entry);
+
+    /**
+     * @brief Is a parsed directory entry waiting?
+     */
+    bool entry_ready() { return !entries.empty(); }
 
     /**
      * @brief Called to remove all stored directory entries
@@ -83,12 +95,12 @@ public:
      */
     void Char(const XML_Char *s, int len);
 
+protected:
     /**
-     * @brief collection of DAV entries.
+     * @brief DAV entries parsed but not yet taken
      */
-    std::vector<DAVEntry> entries;
+    std::deque<DAVEntry> entries;
 
-protected:
     /**
      * @brief the current entry
      */
@@ -112,7 +124,7 @@ protected:
     /**
      * Expat XML parser
      */
-    XML_Parser parser;
+    XML_Parser parser = nullptr;
 
     /*
      * Parsed entries counter
@@ -30,6 +30,7 @@
 
 #ifndef ESP_PLATFORM
 #include "fnTaskManager.h"
+#include "mgHttpClient.h"
 #include "version.h"
 #include "build_version.h"
 #endif
@@ -91,6 +92,11 @@ void main_shutdown_handler()
     // Give devices an opportunity to clean up before rebooting
 
     SYSTEM_BUS.shutdown();
+
+#ifndef ESP_PLATFORM
+    // idle keep-alive connections and the HTTP clients' manager
+    mgHttpClient::shutdown();
+#endif
 }
 
 // Initial setup
@@ -0,0 +1,135 @@
+/**
+ * #FujiNet Tests - Streaming JSON parser
+ *
+ * This set of tests feeds documents to FNJSONStreamParser in small chunks and
+ * compares the result with cJSON_Parse().
+ */
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <cJSON_Utils.h>
+#include "../lib/fnjson/fnjsonstream.h"
+#include "test_fnjsonstream.h"
+
+using namespace std;
+
+/**
+ * Parse text fed in chunks of the given size, pruned to the pointers if any
+ */
+static cJSON *stream_parse(const string &text, size_t chunk, const vector<string> &pointers = {})
+{
+    FNJSONStreamParser parser(pointers);
+
+    for (size_t pos = 0; pos < text.size(); pos += chunk)
+        parser.feed(text.data() + pos, min(chunk, text.size() - pos));
+
+    return parser.finish();
+}
+
+/**
+ * Unformatted text of item, empty for none
+ */
+static string print(const cJSON *item)
+{
+    if (item == nullptr)
+        return string();
+
+    char *text = cJSON_PrintUnformatted(item);
+    string s(text);
+    cJSON_free(text);
+    return s;
+}
+
+/**
+ * Stream parse text in 1 to 7 byte chunks and compare with cJSON_Parse()
+ */
+static void assert_same_as_cjson(const string &text)
+{
+    cJSON *expected = cJSON_Parse(text.c_str());
+
+    for (size_t chunk = 1; chunk <= 7; chunk++)
+    {
+        cJSON *actual = stream_parse(text, chunk);
+        TEST_ASSERT_EQUAL_STRING(print(expected).c_str(), print(actual).c_str());
+        TEST_ASSERT_EQUAL(expected == nullptr, actual == nullptr);
+        cJSON_Delete(actual);
+    }
+
+    cJSON_Delete(expected);
+}
+
+/**
+ * Tests entrypoint
+ */
+void tests_fnjsonstream()
+{
+    RUN_TEST(tests_fnjsonstream_escapes);
+    RUN_TEST(tests_fnjsonstream_nesting);
+    RUN_TEST(tests_fnjsonstream_truncated);
+    RUN_TEST(tests_fnjsonstream_queries);
+}
+
+/**
+ * Test string escapes, surrogate pairs and bad escapes
+ */
+void tests_fnjsonstream_escapes()
+{
+    assert_same_as_cjson("\"quote \\\" backslash \\\\ slash \\/\"");
+    assert_same_as_cjson("\"\\b\\f\\n\\r\\t\"");
+    assert_same_as_cjson("\"\\u0041\\u00e9\\u20ac\"");
+    assert_same_as_cjson("\"\\ud83d\\ude00 pair\"");
+    assert_same_as_cjson("\"\\ud83d lone high\"");
+    assert_same_as_cjson("\"\\ude00 lone low\"");
+    assert_same_as_cjson("\"\\x bad escape\"");
+    assert_same_as_cjson("{\"k\\u0065y\":\"v\\tal\"}");
+    assert_same_as_cjson("\xEF\xBB\xBF{\"bom\":true}");
+}
+
+/**
+ * Test nested containers, up to and past the nesting limit
+ */
+void tests_fnjsonstream_nesting()
+{
+    assert_same_as_cjson("[[1,[2,[3]]],{\"a\":[{\"b\":[]}]}]");
+
+    for (int depth : {CJSON_NESTING_LIMIT - 1, CJSON_NESTING_LIMIT, CJSON_NESTING_LIMIT + 1})
+        assert_same_as_cjson(string(depth, '[') + string(depth, ']'));
+}
+
+/**
+ * Test documents cut short are rejected
+ */
+void tests_fnjsonstream_truncated()
+{
+    const string text = "{\"a\":[1,2.5,\"three\",true,null],\"b\":{\"c\":\"\\u00e9\"}}";
+
+    for (size_t len = 0; len <= text.size(); len++)
+        assert_same_as_cjson(text.substr(0, len));
+}
+
+/**
+ * Test queries on the full and on a pruned tree
+ */
+void tests_fnjsonstream_queries()
+{
+    // the first of two duplicate keys is the one a query finds
+    const string text = "{\"items\":[{\"name\":\"one\"},{\"name\":\"two\"}],\"a\":5,\"A\":[1,2,3],\"x~/y\":{\"z\":0}}";
+    const char *pointers[] = {"/items/1/name", "/ITEMS/0/Name", "/items/2", "/a", "/a/2", "/x~0~1y/z", "/missing", ""};
+
+    cJSON *expected = cJSON_Parse(text.c_str());
+    cJSON *full = stream_parse(text, 3);
+
+    for (const char *pointer : pointers)
+    {
+        string want = print(cJSONUtils_GetPointer(expected, pointer));
+        TEST_ASSERT_EQUAL_STRING(want.c_str(), print(cJSONUtils_GetPointer(full, pointer)).c_str());
+
+        cJSON *pruned = stream_parse(text, 3, {pointer});
+        TEST_ASSERT_EQUAL_STRING(want.c_str(), print(cJSONUtils_GetPointer(pruned, pointer)).c_str());
+        cJSON_Delete(pruned);
+    }
+
+    cJSON_Delete(full);
+    cJSON_Delete(expected);
+}
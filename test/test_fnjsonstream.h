@@ -0,0 +1,48 @@
+/**
+ * #FujiNet Tests - Streaming JSON parser
+ *
+ * This set of tests feeds documents to FNJSONStreamParser in small chunks and
+ * compares the result with cJSON_Parse().
+ */
+
+#ifndef TEST_FNJSONSTREAM_H
+#define TEST_FNJSONSTREAM_H
+
+#define UNIT_TESTS
+
+#include <unity.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_fnjsonstream();
+
+    /**
+     * Test string escapes, surrogate pairs and bad escapes
+     */
+    void tests_fnjsonstream_escapes();
+
+    /**
+     * Test nested containers, up to and past the nesting limit
+     */
+    void tests_fnjsonstream_nesting();
+
+    /**
+     * Test documents cut short are rejected
+     */
+    void tests_fnjsonstream_truncated();
+
+    /**
+     * Test queries on the full and on a pruned tree
+     */
+    void tests_fnjsonstream_queries();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_FNJSONSTREAM_H */
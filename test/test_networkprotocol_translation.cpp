@@ -6,8 +6,12 @@
 
 #include <string.h>
 #include <string>
+#include <algorithm>
 #include "../lib/network-protocol/Protocol.h"
+#include "../lib/utils/string_utils.h"
+#include "../lib/utils/utils.h"
 #include "test_networkprotocol_translation.h"
+#include "test_networkprotocol_translation_ref.h"
 
 /**
  * Buffer sizes
@@ -20,13 +24,26 @@ using namespace std;
 /**
  * The Buffers
  */
-string *rx_buf;
-string *tx_buf;
+NetworkBuffer *rx_buf;
+NetworkBuffer *tx_buf;
 string *sp_buf;
 
 /**
- * Protocol object
+ * Protocol object, the base class write() does not translate so route it through
+ * translate_transmit_buffer() here.
  */
+class TranslationTestProtocol : public NetworkProtocol
+{
+public:
+    using NetworkProtocol::NetworkProtocol;
+
+    bool write(unsigned short len) override
+    {
+        translate_transmit_buffer();
+        return false;
+    }
+};
+
 static NetworkProtocol *protocol;
 
 /**
@@ -36,6 +53,36 @@ static const char *test_eol = "This is a test string.\x9BThis is a second line.\
 static const char *test_cr = "This is a test string.\x0DThis is a second line.\x0DThis is a third line.\x0D";
 static const char *test_lf = "This is a test string.\x0AThis is a second line.\x0AThis is a third line.\x0A";
 static const char *test_crlf = "This is a test string.\x0D\x0AThis is a second line.\x0D\x0AThis is a third line.\x0D\x0A";
+static const char *test_mixed = "\x0D\x0A\x0D\x0D\x0A\x0A\x9B\x07\x08\x09\x7E\x7F\xFDline\x0D\x0A";
+
+/**
+ * Translation modes exercised by the golden tests, 5 is not a defined mode
+ */
+static const uint8_t golden_modes[] = {0, 1, 2, 3, 4, 5};
+
+/**
+ * Every byte value, followed by the line ending fixtures
+ */
+static string golden_input()
+{
+    string s;
+
+    for (int i = 0; i < 256; i++)
+        s.push_back((char)i);
+
+    return s + test_mixed + test_crlf + test_eol;
+}
+
+/**
+ * Golden test set-up, empty buffers and a protocol that translates on write()
+ */
+static void golden_setup()
+{
+    rx_buf = new NetworkBuffer();
+    tx_buf = new NetworkBuffer();
+    sp_buf = new string();
+    protocol = new TranslationTestProtocol(rx_buf, tx_buf, sp_buf);
+}
 
 /**
  * Tests entrypoint
@@ -48,6 +95,9 @@ void tests_networkprotocol_translation()
     RUN_TEST(tests_networkprotocol_translation_tx_eol_to_cr);
     RUN_TEST(tests_networkprotocol_translation_tx_eol_to_lf);
     RUN_TEST(tests_networkprotocol_translation_tx_eol_to_crlf);
+    RUN_TEST(tests_networkprotocol_translation_rx_golden);
+    RUN_TEST(tests_networkprotocol_translation_tx_golden);
+    RUN_TEST(tests_networkprotocol_translation_rx_split);
 }
 
 /**
@@ -56,17 +106,16 @@ void tests_networkprotocol_translation()
 void tests_networkprotocol_translation_rx_cr_to_eol()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x01, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_cr);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->read(strlen(test_cr));
-    protocol->close();
 
     TEST_ASSERT_EQUAL_STRING(test_eol, rx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -75,17 +124,16 @@ void tests_networkprotocol_translation_rx_cr_to_eol()
 void tests_networkprotocol_translation_rx_lf_to_eol()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x02, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_lf);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->read(strlen(test_lf));
-    protocol->close();
 
     TEST_ASSERT_EQUAL_STRING(test_eol, rx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -94,17 +142,16 @@ void tests_networkprotocol_translation_rx_lf_to_eol()
 void tests_networkprotocol_translation_rx_crlf_to_eol()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x03, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_crlf);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->read(strlen(test_crlf));
-    protocol->close();
 
     TEST_ASSERT_EQUAL_STRING(test_eol, rx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -113,17 +160,16 @@ void tests_networkprotocol_translation_rx_crlf_to_eol()
 void tests_networkprotocol_translation_tx_eol_to_cr()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x01, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_eol);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->write(strlen(test_eol));
-    protocol->close();
 
     TEST_ASSERT_EQUAL_STRING(test_cr, tx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -132,17 +178,16 @@ void tests_networkprotocol_translation_tx_eol_to_cr()
 void tests_networkprotocol_translation_tx_eol_to_lf()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x02, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_eol);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->write(strlen(test_eol));
-    protocol->close();
 
     TEST_ASSERT_EQUAL_STRING(test_lf, tx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -151,17 +196,16 @@ void tests_networkprotocol_translation_tx_eol_to_lf()
 void tests_networkprotocol_translation_tx_eol_to_crlf()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x03, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_eol);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->write(strlen(test_eol));
-    protocol->close();
 
     TEST_ASSERT_EQUAL_STRING(test_crlf, tx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -171,11 +215,11 @@ void tests_networkprotocol_translation_tx_eol_to_crlf()
  */
 bool tests_networkprotocol_translation_setup(const char *c)
 {
-    rx_buf = nullptr;
-    tx_buf = nullptr;
-    sp_buf = nullptr;
+    rx_buf = new NetworkBuffer();
+    tx_buf = new NetworkBuffer();
+    sp_buf = new string();
 
-    protocol = new NetworkProtocol(rx_buf, tx_buf, sp_buf);
+    protocol = new TranslationTestProtocol(rx_buf, tx_buf, sp_buf);
 
     if (protocol == nullptr || rx_buf == nullptr || tx_buf == nullptr || sp_buf == nullptr)
         return false;
@@ -209,3 +253,74 @@ void tests_networkprotocol_translation_done()
     if (sp_buf != nullptr)
         delete sp_buf;
 }
+
+/**
+ * Test RX translation of every byte value against the reference, all modes
+ */
+void tests_networkprotocol_translation_rx_golden()
+{
+    string input = golden_input();
+
+    for (uint8_t mode : golden_modes)
+    {
+        golden_setup();
+        *rx_buf = input; // fixture contains NUL
+        protocol->set_open_params(0x0C, mode);
+        protocol->read(input.length());
+
+        string expected = input;
+        translation_ref_rx(expected, mode);
+        TEST_ASSERT_EQUAL_size_t(expected.length(), rx_buf->length());
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), rx_buf->data(), expected.length());
+        tests_networkprotocol_translation_done();
+    }
+}
+
+/**
+ * Test TX translation of every byte value against the reference, all modes
+ */
+void tests_networkprotocol_translation_tx_golden()
+{
+    string input = golden_input();
+
+    for (uint8_t mode : golden_modes)
+    {
+        golden_setup();
+        *tx_buf = input; // fixture contains NUL
+        protocol->set_open_params(0x0C, mode);
+        protocol->write(input.length());
+
+        string expected = input;
+        translation_ref_tx(expected, mode);
+        TEST_ASSERT_EQUAL_size_t(expected.length(), tx_buf->length());
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), tx_buf->data(), expected.length());
+        tests_networkprotocol_translation_done();
+    }
+}
+
+/**
+ * Test RX data arriving over several reads is translated once, with the same result
+ */
+void tests_networkprotocol_translation_rx_split()
+{
+    string input = golden_input();
+
+    for (uint8_t mode : golden_modes)
+    {
+        golden_setup();
+        protocol->set_open_params(0x0C, mode);
+
+        for (size_t pos = 0; pos < input.length(); pos += 7)
+        {
+            string chunk = input.substr(pos, 7);
+            rx_buf->append(chunk);
+            protocol->read(chunk.length());
+        }
+
+        string expected = input;
+        translation_ref_rx(expected, mode);
+        TEST_ASSERT_EQUAL_size_t(expected.length(), rx_buf->length());
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), rx_buf->data(), expected.length());
+        tests_networkprotocol_translation_done();
+    }
+}
@@ -51,6 +51,21 @@ extern "C"
      */
     void tests_networkprotocol_translation_tx_eol_to_crlf();
 
+    /**
+     * Test RX translation of every byte value against the reference, all modes
+     */
+    void tests_networkprotocol_translation_rx_golden();
+
+    /**
+     * Test TX translation of every byte value against the reference, all modes
+     */
+    void tests_networkprotocol_translation_tx_golden();
+
+    /**
+     * Test RX data arriving over several reads is translated once, with the same result
+     */
+    void tests_networkprotocol_translation_rx_split();
+
     /**
      * Test set-up
      * @param c The test fixture to stuff into the buffer.
@@ -0,0 +1,93 @@
+/**
+ * #FujiNet Tests - NetworkProtocol Translation reference
+ *
+ * The per-character replace passes NetworkProtocol used to translate with,
+ * kept as the reference for the translation tests and tools/translate_bench.
+ */
+
+#ifndef TEST_NETWORKPROTOCOL_TRANSLATION_REF_H
+#define TEST_NETWORKPROTOCOL_TRANSLATION_REF_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+
+#include "../lib/utils/string_utils.h"
+#include "../lib/utils/utils.h"
+
+#ifdef BUILD_APPLE
+#define TRANSLATION_REF_EOL '\x0D'
+#define TRANSLATION_REF_STR_EOL "\x0d"
+#else
+#define TRANSLATION_REF_EOL '\x9B'
+#define TRANSLATION_REF_STR_EOL "\x9b"
+#endif
+
+/**
+ * translate_receive_buffer() as it was
+ */
+static inline void translation_ref_rx(std::string &s, uint8_t mode)
+{
+    if (mode == 0)
+        return;
+
+#ifdef BUILD_ATARI
+    std::replace(s.begin(), s.end(), '\x07', '\xFD');
+    std::replace(s.begin(), s.end(), '\x08', '\x7E');
+    std::replace(s.begin(), s.end(), '\x09', '\x7F');
+#endif
+
+    switch (mode)
+    {
+    case 1:
+        std::replace(s.begin(), s.end(), '\x0D', TRANSLATION_REF_EOL);
+        break;
+    case 2:
+        std::replace(s.begin(), s.end(), '\x0A', TRANSLATION_REF_EOL);
+        break;
+    case 3:
+#ifndef BUILD_APPLE
+        std::replace(s.begin(), s.end(), '\x0D', TRANSLATION_REF_EOL);
+#endif
+        break;
+    case 4:
+        s = mstr::toUTF8(s);
+        break;
+    }
+
+    if (mode == 3)
+        s.erase(std::remove(s.begin(), s.end(), '\n'), s.end());
+}
+
+/**
+ * translate_transmit_buffer() as it was
+ */
+static inline void translation_ref_tx(std::string &s, uint8_t mode)
+{
+    if (mode == 0)
+        return;
+
+#ifdef BUILD_ATARI
+    util_replaceAll(s, "\xfd", "\x07");
+    util_replaceAll(s, "\x7e", "\x08");
+    util_replaceAll(s, "\x7f", "\x09");
+#endif
+
+    switch (mode)
+    {
+    case 1:
+        util_replaceAll(s, TRANSLATION_REF_STR_EOL, "\x0d");
+        break;
+    case 2:
+        util_replaceAll(s, TRANSLATION_REF_STR_EOL, "\x0a");
+        break;
+    case 3:
+        util_replaceAll(s, TRANSLATION_REF_STR_EOL, "\x0d\x0a");
+        break;
+    case 4:
+        s = mstr::toUTF8(s);
+        break;
+    }
+}
+
+#endif /* TEST_NETWORKPROTOCOL_TRANSLATION_REF_H */
@@ -0,0 +1,236 @@
+/**
+ * devrelay request pipelining benchmark
+ *
+ * Reads blocks through Requestor from a simulated SmartPort-over-SLIP device:
+ * every packet takes --latency ms each way, and the device answers one
+ * request at a time, taking --service ms for each. Compares one request at
+ * a time (Requestor::send_request) with Requestor::send_requests at several
+ * window sizes, and checks every block that comes back.
+ *
+ * Also checks that Connection::wait_for_request hands requests out in the
+ * order they arrived, across the 255 -> 0 wrap of request ids.
+ *
+ * Build with "cmake --build build --target devrelay_bench" and run:
+ *
+ *   devrelay_bench [--blocks N] [--latency MS] [--service MS]
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "commands/ReadBlock.h"
+#include "service/Connection.h"
+#include "service/Requestor.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Device at the far end of a link with a fixed delay each way
+class LoopConnection : public Connection
+{
+public:
+	LoopConnection(double latency_ms, double service_ms) : latency_(to_duration(latency_ms)), service_(to_duration(service_ms))
+	{
+		set_is_connected(true);
+		device_ = std::thread(&LoopConnection::device, this);
+		wire_ = std::thread(&LoopConnection::wire, this);
+	}
+
+	~LoopConnection() override { close_connection(); }
+
+	void send_data(const std::vector<uint8_t> &data) override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		to_device_.push_back({Clock::now() + latency_, data});
+		cv_.notify_all();
+	}
+
+	void create_read_channel() override {}
+
+	void close_connection() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!running_)
+				return;
+			running_ = false;
+			cv_.notify_all();
+		}
+		device_.join();
+		wire_.join();
+	}
+
+	// Hands a packet straight to the connection, as the reading thread would
+	void inject(std::vector<uint8_t> packet) { deliver(std::move(packet)); }
+
+private:
+	struct Packet
+	{
+		Clock::time_point due;
+		std::vector<uint8_t> data;
+	};
+
+	static Clock::duration to_duration(double ms) { return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms)); }
+
+	// Answers ReadBlock requests one after the other, block filled with its number
+	void device()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (running_)
+		{
+			if (to_device_.empty())
+			{
+				cv_.wait(lock);
+				continue;
+			}
+			Packet request = std::move(to_device_.front());
+			to_device_.pop_front();
+			lock.unlock();
+
+			std::this_thread::sleep_until(request.due);
+			std::this_thread::sleep_for(service_);
+			std::vector<uint8_t> response(2 + 512, request.data[3]);
+			response[0] = request.data[0];
+			response[1] = 0;
+
+			lock.lock();
+			to_host_.push_back({Clock::now() + latency_, std::move(response)});
+			cv_.notify_all();
+		}
+	}
+
+	void wire()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (running_)
+		{
+			if (to_host_.empty())
+			{
+				cv_.wait(lock);
+				continue;
+			}
+			Packet response = std::move(to_host_.front());
+			to_host_.pop_front();
+			lock.unlock();
+
+			std::this_thread::sleep_until(response.due);
+			deliver(std::move(response.data));
+			lock.lock();
+		}
+	}
+
+	Clock::duration latency_;
+	Clock::duration service_;
+	bool running_ = true;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<Packet> to_device_;
+	std::deque<Packet> to_host_;
+	std::thread device_;
+	std::thread wire_;
+};
+
+static bool check_block(const Response *response, uint8_t block)
+{
+	auto read_response = dynamic_cast<const ReadBlockResponse *>(response);
+	if (read_response == nullptr)
+		return false;
+	for (uint8_t b : read_response->get_block_data())
+		if (b != block)
+			return false;
+	return true;
+}
+
+static int check_request_order()
+{
+	LoopConnection connection(0, 0);
+	int failures = 0;
+	for (int id = 250; id < 262; id++)
+		connection.inject({(uint8_t)id, 0x01});
+	for (int id = 250; id < 262; id++)
+	{
+		auto request = connection.wait_for_request();
+		if (request.empty() || request[0] != (uint8_t)id)
+		{
+			printf("request %d out of order\n", id & 0xff);
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int main(int argc, char **argv)
+{
+	int blocks = 200;
+	double latency_ms = 2;
+	double service_ms = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--blocks") == 0 && i + 1 < argc)
+			blocks = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+			latency_ms = atof(argv[++i]);
+		else if (strcmp(argv[i], "--service") == 0 && i + 1 < argc)
+			service_ms = atof(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [--blocks N] [--latency MS] [--service MS]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	int failures = check_request_order();
+	printf("request order: %s\n", failures ? "FAILED" : "ok");
+
+	LoopConnection connection(latency_ms, service_ms);
+	printf("%d blocks, %.1f ms each way, %.1f ms per request on the device\n", blocks, latency_ms, service_ms);
+	printf("%-10s %10s %10s\n", "window", "ms", "blocks/s");
+
+	for (size_t window : {0, 1, 2, 4, 8})
+	{
+		std::vector<ReadBlockRequest> requests;
+		requests.reserve(blocks);
+		for (int i = 0; i < blocks; i++)
+		{
+			requests.emplace_back(Requestor::next_request_number(), 1);
+			requests.back().set_block_number_from_bytes((uint8_t)i, 0, 0);
+		}
+
+		auto t0 = Clock::now();
+		std::vector<std::unique_ptr<Response>> responses;
+		if (window == 0)
+		{
+			for (const auto &request : requests)
+				responses.push_back(Requestor::send_request(request, &connection));
+		}
+		else
+		{
+			std::vector<const Request *> pending;
+			for (const auto &request : requests)
+				pending.push_back(&request);
+			responses = Requestor::send_requests(pending, &connection, window);
+		}
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+		for (int i = 0; i < blocks; i++)
+		{
+			if (!check_block(responses[i].get(), (uint8_t)i))
+			{
+				printf("block %d wrong\n", i);
+				failures++;
+				break;
+			}
+		}
+		printf("%-10s %10.1f %10.1f\n", window == 0 ? "single" : std::to_string(window).c_str(), ms, blocks * 1000.0 / ms);
+	}
+
+	return failures ? 1 : 0;
+}
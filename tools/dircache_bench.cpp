@@ -0,0 +1,241 @@
+/**
+ * DirCache heap and time benchmark
+ *
+ * Fills the directory cache used by the SMB and FTP file systems with
+ * synthetic entries, filters and sorts them and reads them all back, the way
+ * a directory is listed for the host. The same is done with a copy of the
+ * cache as it was before the names were packed into one buffer (a full
+ * fsdir_entry per file, copied again by the filter) and the heap in use and
+ * the time taken are compared. The heap is taken once the filter has run,
+ * when both hold the most.
+ *
+ * Check: both give the same entries in the same order for every sort
+ * option, with and without a pattern.
+ *
+ * Build with "cmake --build build --target dircache_bench" and run:
+ *
+ *   dircache_bench [--entries N] [--pattern P]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+#include "compat_string.h"
+#include "fnDirCache.h"
+#include "utils.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+// Heap in use, as glibc counts it
+static size_t heap_in_use()
+{
+    return mallinfo2().uordblks;
+}
+
+// Reference: the cache as it was, one fsdir_entry per file
+class OldDirCache
+{
+    std::vector<fsdir_entry> _entries;
+    std::vector<fsdir_entry> _entries_filtered;
+    uint16_t _current = 0;
+
+    static bool name_ascend(const fsdir_entry &left, const fsdir_entry &right)
+    {
+        if (left.isDir == right.isDir)
+            return strcasecmp(left.filename, right.filename) < 0;
+        return left.isDir;
+    }
+
+    static bool name_descend(const fsdir_entry &left, const fsdir_entry &right)
+    {
+        if (left.isDir == right.isDir)
+            return strcasecmp(left.filename, right.filename) > 0;
+        return left.isDir;
+    }
+
+    static bool time_ascend(const fsdir_entry &left, const fsdir_entry &right)
+    {
+        if (left.isDir == right.isDir)
+            return left.modified_time > right.modified_time;
+        return left.isDir;
+    }
+
+    static bool time_descend(const fsdir_entry &left, const fsdir_entry &right)
+    {
+        if (left.isDir == right.isDir)
+            return left.modified_time < right.modified_time;
+        return left.isDir;
+    }
+
+public:
+    void clear()
+    {
+        _entries.clear();
+        _entries_filtered.clear();
+        _current = 0;
+    }
+
+    void add_entry(const char *name, bool isDir, uint32_t size, time_t modified_time)
+    {
+        _entries.push_back(fsdir_entry());
+        fsdir_entry &entry = _entries.back();
+        strlcpy(entry.filename, name, sizeof(entry.filename));
+        entry.isDir = isDir;
+        entry.size = size;
+        entry.modified_time = modified_time;
+    }
+
+    void apply_filter(const char *pattern, uint16_t diropts)
+    {
+        bool have_pattern = pattern != nullptr && pattern[0] != '\0';
+        bool filter_dirs = have_pattern && pattern[strlen(pattern) - 1] == '/';
+        fsdir_entry entry;
+        _entries_filtered.clear();
+        for (unsigned i = 0; i < _entries.size(); ++i)
+        {
+            entry = _entries[i];
+            if (have_pattern && (!entry.isDir || (entry.isDir && filter_dirs)) &&
+                util_wildcard_match(entry.filename, pattern) == false)
+                continue;
+            _entries_filtered.push_back(entry);
+        }
+        bool (*sortfn)(const fsdir_entry &, const fsdir_entry &);
+        if (diropts & DIR_OPTION_FILEDATE)
+            sortfn = (diropts & DIR_OPTION_DESCENDING) ? time_descend : time_ascend;
+        else
+            sortfn = (diropts & DIR_OPTION_DESCENDING) ? name_descend : name_ascend;
+        std::sort(_entries_filtered.begin(), _entries_filtered.end(), sortfn);
+        _current = 0;
+    }
+
+    fsdir_entry *read()
+    {
+        if (_current < _entries_filtered.size())
+            return &_entries_filtered[_current++];
+        return nullptr;
+    }
+};
+
+struct listed
+{
+    std::string name;
+    bool isDir;
+    uint32_t size;
+    time_t modified_time;
+
+    bool operator==(const listed &o) const
+    {
+        return name == o.name && isDir == o.isDir && size == o.size && modified_time == o.modified_time;
+    }
+};
+
+struct result
+{
+    std::vector<listed> entries;
+    size_t peak_heap;
+    double ms;
+};
+
+// Lists entries synthetic files through cache, as fnFsSMB does
+template <class Cache>
+static result list(int entries, const char *pattern, uint16_t diropts, bool keep)
+{
+    result r;
+    r.entries.reserve(keep ? entries : 0);
+    size_t base = heap_in_use();
+
+    auto t0 = BenchClock::now();
+    {
+        Cache cache;
+        char name[64];
+        for (int i = 0; i < entries; i++)
+        {
+            bool dir = i % 10 == 0;
+            snprintf(name, sizeof(name), dir ? "Folder %d" : "Program %d.atr", (i * 7919) % entries);
+            cache.add_entry(name, dir, dir ? 0 : 1000 + i, 1600000000 + (i * 104729) % 100000);
+        }
+        cache.apply_filter(pattern, diropts);
+        // everything is held once the filter has run
+        r.peak_heap = heap_in_use() - base;
+        fsdir_entry *e;
+        while ((e = cache.read()) != nullptr)
+            if (keep)
+                r.entries.push_back({e->filename, e->isDir, e->size, e->modified_time});
+        cache.clear();
+    }
+    r.ms = ms_since(t0);
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int entries = 10000;
+    const char *pattern = "*1*";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--entries") == 0 && i + 1 < argc)
+            entries = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc)
+            pattern = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--entries N] [--pattern P]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failures = 0;
+    const uint16_t options[] = {0, DIR_OPTION_DESCENDING, DIR_OPTION_FILEDATE, DIR_OPTION_FILEDATE | DIR_OPTION_DESCENDING};
+    for (const char *p : {"", "*1*", "F*/", "*.ATR"})
+    {
+        for (uint16_t opt : options)
+        {
+            // time sorting compares only the time, ties may come in any order
+            result now = list<DirCache>(2000, p, opt, true);
+            result old = list<OldDirCache>(2000, p, opt, true);
+            if (!(opt & DIR_OPTION_FILEDATE) ? now.entries != old.entries :
+                now.entries.size() != old.entries.size() ||
+                !std::equal(now.entries.begin(), now.entries.end(), old.entries.begin(),
+                            [](const listed &a, const listed &b) { return a.isDir == b.isDir && a.modified_time == b.modified_time; }))
+            {
+                printf("mismatch: pattern \"%s\", options 0x%02x\n", p, opt);
+                failures++;
+            }
+        }
+    }
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    printf("%d entries, pattern \"%s\", fill + filter + read\n", entries, pattern);
+    printf("%-8s %12s %10s\n", "", "peak heap KB", "ms");
+    for (int old = 1; old >= 0; old--)
+    {
+        result best = {};
+        for (int round = 0; round < 5; round++)
+        {
+            result r = old ? list<OldDirCache>(entries, pattern, 0, false) : list<DirCache>(entries, pattern, 0, false);
+            if (round == 0 || r.ms < best.ms)
+                best = r;
+        }
+        printf("%-8s %12.1f %10.2f\n", old ? "old" : "new", best.peak_heap / 1024.0, best.ms);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+DriveWire disk benchmark over the Becker port
+
+Connects to FujiNet-PC's Becker port the way an emulator running a CoCo
+would, and times the disk traffic of an OS-9 boot: LSN 0, the OS9Boot file
+named there, the kernel track, then a round of random reads and rewrites.
+Rewrites put back the data that was read, the disk image is not changed.
+
+Enable BOIP (Becker port) in FujiNet-PC, mount an OS-9 / NitrOS-9 disk in
+drive 0 and run:
+
+  python3 tools/dw_bench.py [--host localhost] [--port 65504] [--drive 0]
+"""
+
+import argparse, random, socket, struct, time
+
+OP_READEX = 0xD2
+OP_WRITE = 0x57
+OP_TERM = 0x54
+
+KERNEL_TRACK = 34
+SECTORS_PER_TRACK = 18
+
+
+class DriveWire:
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.transactions = 0
+
+    def recv(self, n):
+        data = b''
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError('FujiNet closed the connection')
+            data += chunk
+        return data
+
+    def read(self, drive, lsn):
+        self.sock.sendall(bytes([OP_READEX, drive]) + lsn.to_bytes(3, 'big'))
+        data = self.recv(256)
+        self.sock.sendall(struct.pack('>H', sum(data) & 0xFFFF))
+        status = self.recv(1)[0]
+        self.transactions += 1
+        if status != 0:
+            raise IOError(f'read of LSN {lsn} failed with status {status}')
+        return data
+
+    def write(self, drive, lsn, data):
+        self.sock.sendall(bytes([OP_WRITE, drive]) + lsn.to_bytes(3, 'big') + data
+                          + struct.pack('>H', sum(data) & 0xFFFF))
+        status = self.recv(1)[0]
+        self.transactions += 1
+        if status != 0:
+            raise IOError(f'write of LSN {lsn} failed with status {status}')
+
+    def term(self):
+        self.sock.sendall(bytes([OP_TERM]))
+
+
+def phase(name, dw, fn):
+    start_count = dw.transactions
+    start = time.perf_counter()
+    fn()
+    elapsed = time.perf_counter() - start
+    count = dw.transactions - start_count
+    rate = count / elapsed if elapsed > 0 else 0
+    print(f'{name:<10} {count:6d} sectors {elapsed * 1000:9.1f} ms {rate:9.1f} sectors/s')
+    return elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description='DriveWire disk benchmark over the Becker port')
+    parser.add_argument('--host', default='localhost')
+    parser.add_argument('--port', type=int, default=65504)
+    parser.add_argument('--drive', type=int, default=0)
+    parser.add_argument('--random', type=int, default=200, help='random reads and rewrites')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    dw = DriveWire(args.host, args.port)
+    drive = args.drive
+
+    lsn0 = dw.read(drive, 0)
+    total_sectors = int.from_bytes(lsn0[0:3], 'big')
+    boot_lsn = int.from_bytes(lsn0[0x15:0x18], 'big')
+    boot_size = int.from_bytes(lsn0[0x18:0x1A], 'big')
+    if total_sectors == 0:
+        raise SystemExit('LSN 0 does not look like an OS-9 disk')
+    print(f'disk: {total_sectors} sectors, OS9Boot at LSN {boot_lsn}, {boot_size} bytes')
+
+    kernel_lsn = KERNEL_TRACK * SECTORS_PER_TRACK
+    rng = random.Random(args.seed)
+    picks = [rng.randrange(total_sectors) for _ in range(args.random)]
+
+    def boot():
+        for lsn in range(boot_lsn, boot_lsn + (boot_size + 255) // 256):
+            dw.read(drive, lsn)
+        if kernel_lsn + SECTORS_PER_TRACK <= total_sectors:
+            for lsn in range(kernel_lsn, kernel_lsn + SECTORS_PER_TRACK):
+                dw.read(drive, lsn)
+
+    def random_reads():
+        for lsn in picks:
+            dw.read(drive, lsn)
+
+    def rewrites():
+        for lsn in picks:
+            dw.write(drive, lsn, dw.read(drive, lsn))
+        dw.term()
+
+    total = phase('boot', dw, boot)
+    total += phase('random', dw, random_reads)
+    total += phase('rewrite', dw, rewrites)
+    print(f'total      {total * 1000:25.1f} ms')
+
+
+if __name__ == '__main__':
+    main()
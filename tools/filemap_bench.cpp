@@ -0,0 +1,209 @@
+/**
+ * mmap file handler check and random sector benchmark
+ *
+ * Check: plain reads are left to stdio, only files opened for update are
+ * mapped. A write through one mapped handle is seen through a second one and
+ * through stdio, and writing past the end extends the file. Another program
+ * truncating or extending the image while it is mapped must be seen like with
+ * stdio (short reads past the new end), not crash with SIGBUS.
+ *
+ * Benchmark: random sector reads, and reads mixed with 10% write+flush, on an
+ * ATR sized and a ProDOS sized image, through FileHandlerLocal (stdio) and
+ * FileHandlerMap. Prints millions of operations per second.
+ *
+ * Build with "cmake --build build --target filemap_bench" and run:
+ *
+ *   filemap_bench [--dir D] [--ops N]
+ *
+ * The images are made in D (default /dev/shm, else /tmp) and removed after.
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "fnFileLocal.h"
+#include "fnFileMap.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("check: %s\n", what);
+        failures++;
+    }
+}
+
+static void make_file(const std::string &path, size_t size, uint8_t fill)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    std::vector<uint8_t> buf(size, fill);
+    fwrite(buf.data(), 1, size, f);
+    fclose(f);
+}
+
+static void check(const std::string &dir)
+{
+    std::string path = dir + "/filemap_check.img";
+    make_file(path, 4096, 0xAA);
+
+    FileHandler *ro = FileHandlerMap::open(path.c_str(), "rb");
+    expect(ro == nullptr, "plain read is mapped");
+    if (ro != nullptr)
+        ro->close();
+
+    FileHandler *a = FileHandlerMap::open(path.c_str(), "rb+");
+    FileHandler *b = FileHandlerMap::open(path.c_str(), "r+b");
+    expect(a != nullptr && b != nullptr, "file opened for update is not mapped");
+    if (a == nullptr || b == nullptr)
+        return;
+
+    uint8_t buf[256], got[256];
+    memset(buf, 0x55, sizeof(buf));
+    a->seek(1024, SEEK_SET);
+    a->write(buf, 1, sizeof(buf));
+    a->flush();
+    b->seek(1024, SEEK_SET);
+    expect(b->read(got, 1, sizeof(got)) == sizeof(got) && memcmp(buf, got, sizeof(buf)) == 0,
+           "write not seen through second handle");
+    FILE *f = fopen(path.c_str(), "rb");
+    fseek(f, 1024, SEEK_SET);
+    expect(fread(got, 1, sizeof(got), f) == sizeof(got) && memcmp(buf, got, sizeof(buf)) == 0,
+           "write not seen through stdio");
+    fclose(f);
+
+    // past the end
+    a->seek(8192, SEEK_SET);
+    expect(a->write(buf, 1, sizeof(buf)) == sizeof(buf), "write past the end failed");
+    b->seek(0, SEEK_END);
+    expect(b->tell() == 8192 + 256, "write past the end did not extend the file");
+
+    // another program cuts the image short
+    expect(truncate(path.c_str(), 2048) == 0, "truncate");
+    b->seek(1024, SEEK_SET);
+    expect(b->read(got, 1, sizeof(got)) == sizeof(got) && memcmp(buf, got, sizeof(buf)) == 0,
+           "read in front of the new end");
+    b->seek(4000, SEEK_SET);
+    expect(b->read(got, 1, sizeof(got)) == 0 && b->eof(), "read past the new end");
+    b->seek(2000, SEEK_SET);
+    expect(b->read(got, 1, sizeof(got)) == 48, "read across the new end");
+    a->seek(0, SEEK_END);
+    expect(a->tell() == 2048, "size after truncate");
+
+    // ... and to nothing, then writes it again
+    expect(truncate(path.c_str(), 0) == 0, "truncate to 0");
+    b->seek(0, SEEK_SET);
+    expect(b->read(got, 1, sizeof(got)) == 0, "read from an emptied file");
+    a->seek(0, SEEK_SET);
+    expect(a->write(buf, 1, sizeof(buf)) == sizeof(buf), "write to an emptied file");
+
+    // ... and extends it
+    f = fopen(path.c_str(), "ab");
+    memset(buf, 0x77, sizeof(buf));
+    fwrite(buf, 1, sizeof(buf), f);
+    fclose(f);
+    b->seek(256, SEEK_SET);
+    expect(b->read(got, 1, sizeof(got)) == sizeof(got) && memcmp(buf, got, sizeof(buf)) == 0,
+           "data appended by another program");
+
+    a->close();
+    b->close();
+    unlink(path.c_str());
+}
+
+static double bench(FileHandler *fh, size_t sectors, size_t sector_size, int write_pct, int ops)
+{
+    std::mt19937 rng(1);
+    std::vector<uint8_t> buf(sector_size, 0x42);
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < ops; i++)
+    {
+        size_t sector = rng() % sectors;
+        fh->seek(16 + sector * sector_size, SEEK_SET);
+        if ((int)(rng() % 100) < write_pct)
+        {
+            fh->write(buf.data(), 1, sector_size);
+            fh->flush();
+        }
+        else
+            fh->read(buf.data(), 1, sector_size);
+    }
+    return ops / ms_since(t0) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+    int ops = 200000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+            ops = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--dir D] [--ops N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    check(dir);
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    struct
+    {
+        const char *name;
+        size_t sectors;
+        size_t sector_size;
+        int write_pct;
+    } cases[] = {
+        {"ATR 90K, 128B sectors, random read", 720, 128, 0},
+        {"ATR 90K, 90% read / 10% write+flush", 720, 128, 10},
+        {"PO 32M, 512B blocks, random read", 65535, 512, 0},
+        {"PO 32M, 90% read / 10% write+flush", 65535, 512, 10},
+    };
+
+    std::string path = dir + "/filemap_bench.img";
+    printf("%d operations in %s, best of 3, M/s\n", ops, dir.c_str());
+    printf("%-40s %8s %8s\n", "", "stdio", "mmap");
+    for (auto &c : cases)
+    {
+        make_file(path, 16 + c.sectors * c.sector_size, 0);
+        double best[2] = {0, 0};
+        for (int round = 0; round < 3; round++)
+        {
+            FileHandler *local = new FileHandlerLocal(fopen(path.c_str(), "rb+"));
+            best[0] = std::max(best[0], bench(local, c.sectors, c.sector_size, c.write_pct, ops));
+            local->close();
+
+            FileHandler *map = FileHandlerMap::open(path.c_str(), "rb+");
+            best[1] = std::max(best[1], bench(map, c.sectors, c.sector_size, c.write_pct, ops));
+            map->close();
+        }
+        printf("%-40s %8.2f %8.2f\n", c.name, best[0], best[1]);
+    }
+    unlink(path.c_str());
+    return 0;
+}
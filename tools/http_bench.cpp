@@ -0,0 +1,451 @@
+/**
+ * HTTP client check and benchmark against a loopback server
+ *
+ * Runs a small HTTP/1.1 server on 127.0.0.1 in a thread, one thread per
+ * connection, and reads responses from it with mgHttpClient the way the
+ * HTTP protocol does: GET(), then read() while available() or until the
+ * transaction is done.
+ *
+ * Check: bodies sent with Content-Length, with chunked transfer coding in
+ * odd chunk sizes and until the server closes all arrive complete and in
+ * order. A chunk size of 8 hex digits is taken, one of more than 8 digits
+ * drops the connection after the data before it instead of overflowing.
+ *
+ * Keep-alive connections go back to the pool and are taken by the next
+ * client. Clients in several threads at once, sharing the one mongoose
+ * manager, all get their bodies right. With HTTP_POOL_MAX_OPEN_PER_HOST
+ * responses to one server left unread, the next request waits until one
+ * of them is closed and the server never sees more connections than that.
+ * mgHttpClient::shutdown() closes the pooled connections and a request
+ * after it still works.
+ *
+ * Benchmark: time to the status code and to the end of the body, and
+ * throughput, for a few body sizes and codings. Resident set size after
+ * the largest body. Small requests per second, each on a new client object,
+ * from one and from several threads.
+ *
+ * Build with "cmake --build build --target http_bench" and run:
+ *
+ *   http_bench [--mb N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "httpConnectionPool.h"
+#include "mgHttpClient.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+// Body byte at offset i, so the client can check what it gets without a copy
+static inline uint8_t pattern(size_t i)
+{
+    return (uint8_t)(i * 7 + (i >> 8));
+}
+
+/**
+ * HTTP server answering
+ *   /len/N     N bytes with Content-Length
+ *   /chunk/N   N bytes in chunks of 1 to 5000 bytes
+ *   /close/N   N bytes, ends by closing the connection
+ *   /raw/NAME  5 bytes in a chunk with an 8 digit size (8digits) or
+ *              followed by a 10 digit chunk size (long)
+ */
+class TestServer
+{
+public:
+    TestServer()
+    {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(_fd, (sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, (sockaddr *)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        listen(_fd, 16);
+        _thread = std::thread([this] { accept_loop(); });
+    }
+
+    ~TestServer()
+    {
+        _stop = true;
+        shutdown(_fd, SHUT_RDWR);
+        ::close(_fd);
+        _thread.join();
+    }
+
+    std::string url(const std::string &path) const
+    {
+        return "http://127.0.0.1:" + std::to_string(_port) + path;
+    }
+
+    int accepted() const { return _accepted; }
+    int open() const { return _open; }
+    int max_open() const { return _max_open; }
+    void reset_max_open() { _max_open = _open.load(); }
+
+private:
+    int _fd;
+    int _port;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+    std::atomic<int> _accepted{0};
+    std::atomic<int> _open{0};
+    std::atomic<int> _max_open{0};
+
+    void accept_loop()
+    {
+        while (!_stop)
+        {
+            int c = accept(_fd, nullptr, nullptr);
+            if (c < 0)
+                continue;
+            _accepted++;
+            int on = 1;
+            setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            int now = ++_open;
+            for (int max = _max_open; now > max && !_max_open.compare_exchange_weak(max, now);)
+                ;
+            std::thread([this, c] {
+                serve(c);
+                _open--;
+            }).detach();
+        }
+    }
+
+    static bool send_all(int c, const char *p, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = send(c, p, len, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool send_body(int c, size_t from, size_t len)
+    {
+        char buf[16384];
+        while (len > 0)
+        {
+            size_t n = len < sizeof(buf) ? len : sizeof(buf);
+            for (size_t i = 0; i < n; i++)
+                buf[i] = pattern(from + i);
+            if (!send_all(c, buf, n))
+                return false;
+            from += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static void serve(int c)
+    {
+        std::string req;
+        char buf[4096];
+        bool open = true;
+        while (open)
+        {
+            size_t end;
+            while ((end = req.find("\r\n\r\n")) == std::string::npos)
+            {
+                ssize_t n = recv(c, buf, sizeof(buf), 0);
+                if (n <= 0)
+                {
+                    ::close(c);
+                    return;
+                }
+                req.append(buf, n);
+            }
+            std::string path = req.substr(req.find(' ') + 1);
+            path = path.substr(0, path.find(' '));
+            req.erase(0, end + 4);
+            open = respond(c, path);
+        }
+        ::close(c);
+    }
+
+    // Returns false once the connection is to be closed
+    static bool respond(int c, const std::string &path)
+    {
+        size_t slash = path.rfind('/');
+        std::string kind = path.substr(0, slash);
+        std::string arg = path.substr(slash + 1);
+        size_t size = strtoull(arg.c_str(), nullptr, 10);
+
+        if (kind == "/len")
+        {
+            std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+            return send_all(c, head.data(), head.size()) && send_body(c, 0, size);
+        }
+        if (kind == "/close")
+        {
+            std::string head = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n";
+            send_all(c, head.data(), head.size()) && send_body(c, 0, size);
+            return false;
+        }
+        if (kind == "/chunk")
+        {
+            std::string head = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+            if (!send_all(c, head.data(), head.size()))
+                return false;
+            unsigned seed = 1;
+            for (size_t pos = 0; pos < size;)
+            {
+                seed = seed * 1103515245 + 12345;
+                size_t n = 1 + (seed >> 8) % 5000;
+                if (n > size - pos)
+                    n = size - pos;
+                char line[32];
+                snprintf(line, sizeof(line), "%zx;ext=1\r\n", n);
+                if (!send_all(c, line, strlen(line)) || !send_body(c, pos, n) || !send_all(c, "\r\n", 2))
+                    return false;
+                pos += n;
+            }
+            return send_all(c, "0\r\nX-Trailer: 1\r\n\r\n", 19);
+        }
+        if (kind == "/raw")
+        {
+            std::string head = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+            std::string data;
+            for (int i = 0; i < 5; i++)
+                data += (char)pattern(i);
+            std::string body;
+            if (arg == "8digits")
+                body = "00000005\r\n" + data + "\r\n0\r\n\r\n";
+            else
+                body = "5\r\n" + data + "\r\n1000000005\r\n";
+            send_all(c, head.data(), head.size()) && send_all(c, body.data(), body.size());
+            if (arg == "8digits")
+                return true;
+            // the client has to give up on its own, hold the connection open
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            return false;
+        }
+
+        const char *nf = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        return send_all(c, nf, strlen(nf));
+    }
+};
+
+struct fetch_result
+{
+    int status = 0;
+    size_t size = 0;
+    bool in_order = true;
+    double ttfb_ms = 0;
+    double total_ms = 0;
+};
+
+static fetch_result fetch(const std::string &url)
+{
+    fetch_result r;
+    std::vector<uint8_t> buf(4096);
+    mgHttpClient client;
+
+    auto t0 = BenchClock::now();
+    client.begin(url);
+    r.status = client.GET();
+    r.ttfb_ms = ms_since(t0);
+
+    while (true)
+    {
+        int n = client.read(buf.data(), buf.size());
+        for (int i = 0; i < n; i++)
+            if (buf[i] != pattern(r.size + i))
+                r.in_order = false;
+        r.size += n;
+        if (n == 0 && client.available() == 0 && client.is_transaction_done())
+            break;
+    }
+    r.total_ms = ms_since(t0);
+    client.close();
+    return r;
+}
+
+// Small requests on new client objects, returns requests per second
+static double fetch_many(TestServer &server, int threads, int count, int *bad)
+{
+    std::vector<std::thread> workers;
+    std::atomic<int> errors{0};
+    auto t0 = BenchClock::now();
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < count; i++)
+            {
+                size_t size = 1024 + (t * 131 + i * 17) % 3000;
+                fetch_result r = fetch(server.url((i & 1 ? "/chunk/" : "/len/") + std::to_string(size)));
+                if (r.status != 200 || r.size != size || !r.in_order)
+                    errors++;
+            }
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+    *bad = errors;
+    return threads * count / (ms_since(t0) / 1000.0);
+}
+
+static long rss_kb()
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == nullptr)
+        return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "VmRSS: %ld", &kb) == 1)
+            break;
+    fclose(f);
+    return kb;
+}
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("check: %s\n", what);
+        failures++;
+    }
+}
+
+static void check(TestServer &server)
+{
+    for (const char *kind : {"/len/", "/chunk/", "/close/"})
+    {
+        for (size_t size : {0, 1, 4999, HTTP_BODY_BUFFER_SIZE - 1, HTTP_BODY_BUFFER_SIZE * 5 + 17})
+        {
+            fetch_result r = fetch(server.url(kind + std::to_string(size)));
+            if (r.status != 200 || r.size != size || !r.in_order)
+            {
+                printf("check: %s%zu gave %d, %zu bytes%s\n", kind, size, r.status, r.size, r.in_order ? "" : ", out of order");
+                failures++;
+            }
+        }
+    }
+
+    fetch_result r = fetch(server.url("/raw/8digits"));
+    expect(r.status == 200 && r.size == 5 && r.in_order, "8 digit chunk size not taken");
+
+    auto t0 = BenchClock::now();
+    r = fetch(server.url("/raw/long"));
+    expect(r.status == 200 && r.size == 5 && r.in_order, "data before a 10 digit chunk size lost");
+    expect(ms_since(t0) < 400, "10 digit chunk size did not drop the connection");
+
+    // a finished keep-alive response leaves its connection for the next client
+    fetch(server.url("/len/10"));
+    int accepted = server.accepted();
+    for (int i = 0; i < 20; i++)
+        fetch(server.url("/chunk/100"));
+    expect(server.accepted() == accepted, "pooled connection not reused");
+
+    int bad;
+    fetch_many(server, 4, 100, &bad);
+    expect(bad == 0, "requests from several threads at once");
+
+    // responses left unread hold their connections
+    server.reset_max_open();
+    int before = server.open();
+    std::vector<mgHttpClient> held(HTTP_POOL_MAX_OPEN_PER_HOST);
+    for (auto &client : held)
+    {
+        client.begin(server.url("/len/" + std::to_string(HTTP_BODY_BUFFER_SIZE * 4)));
+        client.GET();
+    }
+    std::thread closer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        held[0].close();
+    });
+    t0 = BenchClock::now();
+    r = fetch(server.url("/len/100"));
+    double waited = ms_since(t0);
+    closer.join();
+    expect(r.status == 200 && r.size == 100, "request after the connection limit");
+    expect(waited >= 250, "request did not wait for a connection to come free");
+    expect(server.max_open() <= before + HTTP_POOL_MAX_OPEN_PER_HOST, "more connections open than allowed");
+    for (auto &client : held)
+        client.close();
+
+    // the pooled connection is closed, the next request opens a new one
+    fetch(server.url("/len/10"));
+    accepted = server.accepted();
+    mgHttpClient::shutdown();
+    r = fetch(server.url("/len/10"));
+    expect(r.status == 200 && r.size == 10 && server.accepted() == accepted + 1, "request after shutdown()");
+}
+
+int main(int argc, char **argv)
+{
+    size_t mb = 100;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+            mb = strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [--mb N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    TestServer server;
+
+    check(server);
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    printf("%-8s %10s %12s %12s %10s\n", "body", "size", "status ms", "total ms", "MB/s");
+    for (const char *kind : {"len", "chunk"})
+    {
+        for (size_t size : {(size_t)1024, (size_t)1 << 20, (size_t)10 << 20, mb << 20})
+        {
+            fetch_result r = fetch(server.url(std::string("/") + kind + "/" + std::to_string(size)));
+            printf("%-8s %10zu %12.2f %12.2f %10.1f\n", kind, r.size, r.ttfb_ms, r.total_ms,
+                   r.size / 1048576.0 / (r.total_ms / 1000.0));
+        }
+    }
+    printf("RSS after %zu MB bodies: %ld KB\n", mb, rss_kb());
+
+    for (int threads : {1, 4})
+    {
+        int bad;
+        double rate = fetch_many(server, threads, 1000 / threads, &bad);
+        printf("%d thread(s): %.0f requests/s, 1-4 KB bodies, new client each\n", threads, rate);
+    }
+    mgHttpClient::shutdown();
+    return 0;
+}
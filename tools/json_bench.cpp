@@ -0,0 +1,530 @@
+/**
+ * Streaming JSON parser check and benchmark
+ *
+ * Check: documents are fed to FNJSONStreamParser in small random chunks and
+ * the tree is compared with what cJSON_Parse() makes of the whole text. The
+ * one intended difference: a \u escape with bad hex digits is rejected,
+ * cJSON reads it as U+0000.
+ * Covered are string escapes (including surrogate pairs and invalid ones),
+ * deep nesting up to and past the cJSON limit, truncated documents, random
+ * documents and JSON pointer queries, both on the full tree and on a tree
+ * pruned to the queried pointer. FNJSON is also driven through a protocol
+ * to make sure a query set before parse() does not stop a later query on
+ * another path from being answered.
+ *
+ * Benchmark: a document with 5000 items is fed in 512-byte chunks. Peak
+ * heap and time are printed for the old way (collect the text, then
+ * cJSON_Parse()), for the stream parser, for the stream parser pruned
+ * to one pointer, and for FNJSON with the query set before parse() (pruned,
+ * text kept) and after it (text collected and parsed whole).
+ *
+ * Build with "cmake --build build --target json_bench" and run:
+ *
+ *   json_bench [--docs N] [--items N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cJSON.h>
+#include <cJSON_Utils.h>
+
+#include "fnjson.h"
+#include "fnjsonstream.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+// Heap in use by operator new and cJSON, as malloc sizes them
+static size_t heap_now = 0;
+static size_t heap_peak = 0;
+
+static void *counted_malloc(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (p != nullptr)
+    {
+        heap_now += malloc_usable_size(p);
+        if (heap_now > heap_peak)
+            heap_peak = heap_now;
+    }
+    return p;
+}
+
+static void counted_free(void *p)
+{
+    if (p == nullptr)
+        return;
+    heap_now -= malloc_usable_size(p);
+    free(p);
+}
+
+void *operator new(size_t size)
+{
+    void *p = counted_malloc(size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    counted_free(p);
+}
+
+static std::mt19937 rng(1);
+
+static int rand_int(int n)
+{
+    return std::uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+static std::string print(const cJSON *item)
+{
+    if (item == nullptr)
+        return "(none)";
+    char *text = cJSON_PrintUnformatted(item);
+    std::string s = text != nullptr ? text : "(unprintable)";
+    cJSON_free(text);
+    return s;
+}
+
+// Feeds text in random chunks of 1 to max_chunk bytes
+static cJSON *stream_parse(const std::string &text, size_t max_chunk, const std::vector<std::string> &pointers = {})
+{
+    FNJSONStreamParser parser(pointers);
+    for (size_t pos = 0; pos < text.size();)
+    {
+        size_t n = std::min(text.size() - pos, (size_t)rand_int(max_chunk) + 1);
+        parser.feed(text.data() + pos, n);
+        pos += n;
+    }
+    return parser.finish();
+}
+
+static int failures = 0;
+
+// Stream parser and cJSON_Parse() must agree on the document, and on each pointer
+static void compare(const char *what, const std::string &text, const std::vector<std::string> &pointers = {})
+{
+    cJSON *want = cJSON_Parse(text.c_str());
+    cJSON *got = stream_parse(text, 7);
+
+    std::string w = print(want), g = print(got);
+    if (w != g)
+    {
+        printf("%s: parsed \"%.60s\" as %.60s, cJSON gives %.60s\n", what, text.c_str(), g.c_str(), w.c_str());
+        failures++;
+    }
+
+    for (const std::string &pointer : pointers)
+    {
+        std::string wp = want ? print(cJSONUtils_GetPointer(want, pointer.c_str())) : "(none)";
+        std::string full = got ? print(cJSONUtils_GetPointer(got, pointer.c_str())) : "(none)";
+        cJSON *pruned = stream_parse(text, 7, {pointer});
+        std::string pp = pruned ? print(cJSONUtils_GetPointer(pruned, pointer.c_str())) : "(none)";
+        if (full != wp || pp != wp)
+        {
+            printf("%s: query %s gave %.40s (full) %.40s (pruned), cJSON gives %.40s\n", what, pointer.c_str(),
+                   full.c_str(), pp.c_str(), wp.c_str());
+            failures++;
+        }
+        cJSON_Delete(pruned);
+    }
+
+    cJSON_Delete(want);
+    cJSON_Delete(got);
+}
+
+static void check_escapes()
+{
+    const char *docs[] = {
+        "\"plain\"",
+        "\"quote \\\" backslash \\\\ slash \\/\"",
+        "\"\\b\\f\\n\\r\\t\"",
+        "\"\\u0041\\u00e9\\u20ac\"",
+        "\"\\ud83d\\ude00 pair\"",
+        "\"\\uD83D\\uDE00 upper case hex\"",
+        "\"\\ud83d lone high\"",
+        "\"\\ude00 lone low\"",
+        "\"\\ud83d\\u0041 broken pair\"",
+        "\"\\x bad escape\"",
+        "\"\\u0000 nul\"",
+        "{\"k\\u0065y\":1,\"tab\\tkey\":2}",
+        "\"unterminated",
+        "\xEF\xBB\xBF{\"bom\":true}",
+        "\xEF\xBB{\"half bom\":true}",
+    };
+    for (const char *d : docs)
+        compare("escapes", d);
+
+    // cJSON reads a \u with bad hex digits as U+0000, the stream parser rejects it
+    cJSON *bad = stream_parse("\"\\u12 short\"", 7);
+    if (bad != nullptr)
+    {
+        printf("escapes: \\u with bad hex digits accepted\n");
+        failures++;
+        cJSON_Delete(bad);
+    }
+}
+
+static void check_nesting()
+{
+    for (int depth : {1, 2, 50, 999, 1000, 1001, 5000})
+    {
+        std::string arrays = std::string(depth, '[') + "1" + std::string(depth, ']');
+        compare("nesting", arrays);
+
+        std::string objects;
+        for (int i = 0; i < depth; i++)
+            objects += "{\"a\":";
+        objects += "1" + std::string(depth, '}');
+        compare("nesting", objects, {"/a/a/a"});
+    }
+    compare("nesting", "[[1,[2,[3]]],{\"a\":[{\"b\":[]}]}]", {"/0/1/1/0", "/1/a/0/b", "/1/A", "/0/2"});
+    compare("nesting", "[[1,2]", {});
+    compare("nesting", "[1,2]]", {});
+    compare("nesting", "{\"a\":[1,2}", {});
+}
+
+// A random value, max_depth levels deep at most
+static cJSON *random_value(int max_depth)
+{
+    static const char *keys[] = {"a", "B", "name", "Name", "id", "x/y", "t~0", "", "caf\xc3\xa9", "k\"q", "0", "12"};
+    int kind = rand_int(max_depth > 0 ? 8 : 6);
+    switch (kind)
+    {
+    case 0:
+        return cJSON_CreateNull();
+    case 1:
+        return cJSON_CreateBool(rand_int(2));
+    case 2:
+        return cJSON_CreateNumber(rand_int(2000000) - 1000000);
+    case 3:
+        return cJSON_CreateNumber((rand_int(2000000) - 1000000) / 1024.0);
+    case 4:
+    case 5:
+    {
+        std::string s;
+        int len = rand_int(12);
+        for (int i = 0; i < len; i++)
+        {
+            int c = rand_int(6);
+            if (c == 0)
+                s += (char)(1 + rand_int(31)); // control, printed as \u00XX
+            else if (c == 1)
+                s += "\"\\/"[rand_int(3)];
+            else if (c == 2)
+                s += "\xe2\x82\xac"; // euro sign
+            else
+                s += (char)('a' + rand_int(26));
+        }
+        return cJSON_CreateString(s.c_str());
+    }
+    case 6:
+    {
+        cJSON *a = cJSON_CreateArray();
+        int n = rand_int(6);
+        for (int i = 0; i < n; i++)
+            cJSON_AddItemToArray(a, random_value(max_depth - 1));
+        return a;
+    }
+    default:
+    {
+        cJSON *o = cJSON_CreateObject();
+        int n = rand_int(6);
+        for (int i = 0; i < n; i++)
+            cJSON_AddItemToObject(o, keys[rand_int(sizeof(keys) / sizeof(keys[0]))], random_value(max_depth - 1));
+        return o;
+    }
+    }
+}
+
+static std::string escape_pointer_token(const std::string &key)
+{
+    std::string t;
+    for (char c : key)
+    {
+        if (c == '~')
+            t += "~0";
+        else if (c == '/')
+            t += "~1";
+        else
+            t += c;
+    }
+    return t;
+}
+
+// A pointer to a random place in the document, now and then one that leads nowhere
+static std::string random_pointer(const cJSON *item)
+{
+    std::string pointer;
+    while ((cJSON_IsArray(item) || cJSON_IsObject(item)) && item->child != nullptr && rand_int(4) != 0)
+    {
+        int n = cJSON_GetArraySize(item);
+        int i = rand_int(n + 1);
+        if (i == n)
+            return pointer + (cJSON_IsArray(item) ? "/" + std::to_string(n) : "/missing");
+        const cJSON *child = cJSON_GetArrayItem(item, i);
+        pointer += "/" + (cJSON_IsArray(item) ? std::to_string(i) : escape_pointer_token(child->string));
+        item = child;
+    }
+    return pointer.empty() ? "/" : pointer;
+}
+
+static void check_random(int docs)
+{
+    for (int d = 0; d < docs; d++)
+    {
+        cJSON *doc = random_value(6);
+        char *printed = rand_int(2) ? cJSON_Print(doc) : cJSON_PrintUnformatted(doc);
+        std::string text = printed;
+        cJSON_free(printed);
+
+        std::vector<std::string> pointers;
+        for (int i = 0; i < 3; i++)
+            pointers.push_back(random_pointer(doc));
+        cJSON_Delete(doc);
+
+        compare("random", text, pointers);
+
+        // truncated at a random place, and with trailing data
+        compare("truncated", text.substr(0, rand_int(text.size() + 1)));
+        compare("trailing", text + " , 1");
+    }
+}
+
+// Feeds a fixed document to FNJSON the way a network channel does
+class FeedProtocol : public NetworkProtocol
+{
+public:
+    FeedProtocol(NetworkBuffer *rx, NetworkBuffer *tx, std::string *sp, const std::string &doc)
+        : NetworkProtocol(rx, tx, sp), _doc(doc)
+    {
+    }
+
+    bool read(unsigned short len) override
+    {
+        receiveBuffer->append(_doc.data() + _pos, len);
+        _pos += len;
+        return false;
+    }
+
+    bool status(NetworkStatus *status) override
+    {
+        status->rxBytesWaiting = std::min<size_t>(_doc.size() - _pos, 512);
+        status->connected = _pos < _doc.size();
+        status->error = 0;
+        return false;
+    }
+
+private:
+    std::string _doc;
+    size_t _pos = 0;
+};
+
+static std::string read_query(FNJSON &json, const char *query)
+{
+    json.setReadQuery(query, 0);
+    std::string value(json.readValueLen(), '\0');
+    if (json.readValue((uint8_t *)&value[0], value.size()))
+        return "(none)";
+    return value;
+}
+
+static void check_fnjson()
+{
+    const std::string doc = "{\"weather\":{\"temp\":21,\"sky\":\"clear\"},\"items\":[{\"name\":\"one\"},{\"name\":\"two\"}]}";
+
+    struct
+    {
+        const char *query;
+        const char *value;
+    } queries[] = {
+        {"/weather/temp", "21\n"},
+        {"/weather/sky", "clear\n"},
+        {"/items/1/name", "two\n"},
+        {"/items/0/name", "one\n"},
+        {"/ITEMS/0/NAME", "one\n"},
+        {"/weather/temp", "21\n"},
+    };
+
+    // pruned to a query, whole because of an empty query, whole without one
+    for (const char *first : {"/weather/temp", "", (const char *)nullptr})
+    {
+        NetworkBuffer rx, tx;
+        std::string sp;
+        FeedProtocol protocol(&rx, &tx, &sp, doc);
+
+        FNJSON json;
+        json.setLineEnding("\n");
+        json.setProtocol(&protocol);
+        if (first != nullptr)
+            json.setReadQuery(first, 0);
+        if (!json.parse())
+        {
+            printf("fnjson: parse failed\n");
+            failures++;
+            return;
+        }
+
+        for (auto &q : queries)
+        {
+            std::string value = read_query(json, q.query);
+            if (value != q.value)
+            {
+                printf("fnjson: query %s after parse gave \"%s\"\n", q.query, value.c_str());
+                failures++;
+            }
+        }
+    }
+}
+
+// 5000 items, about 850 KB
+static std::string bench_document(int items)
+{
+    std::string doc = "{\"count\":" + std::to_string(items) + ",\"items\":[";
+    for (int i = 0; i < items; i++)
+    {
+        if (i)
+            doc += ",";
+        doc += "{\"id\":" + std::to_string(i) + ",\"name\":\"Item number " + std::to_string(i) +
+               "\",\"price\":" + std::to_string(i * 1.25) + ",\"tags\":[\"red\",\"green\",\"blue\"]," +
+               "\"description\":\"A \\\"quoted\\\" description of item " + std::to_string(i) +
+               " with \\u00e9scapes and some more text to make it longer than it needs to be.\"}";
+    }
+    return doc + "]}";
+}
+
+struct result
+{
+    size_t peak_heap;
+    double ms;
+    std::string value;
+};
+
+static result bench_run(const std::string &doc, int mode, const std::string &pointer)
+{
+    result r;
+    NetworkBuffer rx, tx;
+    std::string sp;
+    FeedProtocol protocol(&rx, &tx, &sp, doc);
+    FNJSON fnjson;
+    fnjson.setProtocol(&protocol);
+    size_t base = heap_now;
+    heap_peak = heap_now;
+    auto t0 = BenchClock::now();
+
+    cJSON *json;
+    if (mode == 0)
+    {
+        // the old way: collect the text, then parse
+        std::string buffer;
+        for (size_t pos = 0; pos < doc.size(); pos += 512)
+            buffer += doc.substr(pos, 512);
+        json = cJSON_Parse(buffer.c_str());
+    }
+    else if (mode >= 3)
+    {
+        // FNJSON as a channel uses it, with the query set before or after parse()
+        if (mode == 3)
+            fnjson.setReadQuery(pointer, 0);
+        fnjson.parse();
+        if (mode == 4)
+            fnjson.setReadQuery(pointer, 0);
+        r.value = print(fnjson.resolveQuery());
+        r.ms = ms_since(t0);
+        r.peak_heap = heap_peak - base;
+        return r;
+    }
+    else
+    {
+        FNJSONStreamParser parser(mode == 2 ? std::vector<std::string>{pointer} : std::vector<std::string>{});
+        for (size_t pos = 0; pos < doc.size(); pos += 512)
+            parser.feed(doc.data() + pos, std::min<size_t>(512, doc.size() - pos));
+        json = parser.finish();
+    }
+
+    r.value = print(cJSONUtils_GetPointer(json, pointer.c_str()));
+    cJSON_Delete(json);
+    r.ms = ms_since(t0);
+    r.peak_heap = heap_peak - base;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int docs = 2000;
+    int items = 5000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--docs") == 0 && i + 1 < argc)
+            docs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+            items = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--docs N] [--items N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    cJSON_Hooks hooks = {counted_malloc, counted_free};
+    cJSON_InitHooks(&hooks);
+
+    check_escapes();
+    check_nesting();
+    check_random(docs);
+    check_fnjson();
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    std::string doc = bench_document(items);
+    std::string pointer = "/items/" + std::to_string(items - 1) + "/name";
+    printf("%zu KB document, %d items, 512-byte chunks, query %s\n", doc.size() / 1024, items, pointer.c_str());
+    printf("%-22s %14s %8s\n", "", "peak heap KB", "ms");
+    const char *names[] = {"buffer + cJSON_Parse", "stream", "stream, pruned", "FNJSON, query first", "FNJSON, query after"};
+    std::string value;
+    for (int mode = 0; mode < 5; mode++)
+    {
+        result best = {};
+        for (int round = 0; round < 5; round++)
+        {
+            result r = bench_run(doc, mode, pointer);
+            if (round == 0 || r.ms < best.ms)
+                best = r;
+        }
+        if (mode == 0)
+            value = best.value;
+        else if (best.value != value)
+        {
+            printf("%s: query gave %s, cJSON gives %s\n", names[mode], best.value.c_str(), value.c_str());
+            return 1;
+        }
+        printf("%-22s %14.1f %8.2f\n", names[mode], best.peak_heap / 1024.0, best.ms);
+    }
+    return 0;
+}
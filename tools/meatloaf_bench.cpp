@@ -0,0 +1,445 @@
+/**
+ * Meatloaf disk image benchmark
+ *
+ * Lists the directory of each disk image and loads every file in it through
+ * the meatloaf media streams, the way a LOAD"$" followed by a LOAD of each
+ * file would. Reports the time taken and how many reads and seeks reached
+ * the container stream (the SD card, TNFS or HTTP stream on the device).
+ *
+ * Build with "cmake --build build --target meatloaf_bench" and run:
+ *
+ *   meatloaf_bench [--repeat N] [--http [--rtt MS] [--kbps N]] [images...]
+ *
+ * Images are picked by extension (.d64 .d41 .d71 .d80 .d81 .d82 .dnp).
+ * Without any, sample D64, D71, D80, D81 and D82 images are generated in
+ * memory, each filled with files of 1 to 40 blocks.
+ *
+ * --http also runs each image through an in-process stand-in for a web
+ * server, as if it was opened from an http:// URL:
+ *   reopen  a new Range request on every seek, as MeatHttpClient::seek() does
+ *   cache   HttpBlockCache, as HttpIStream uses once it is seeked
+ *   copy    one download of the whole image, for servers without Range,
+ *           shared by the streams on it like HttpLocalCopy
+ * and counts the requests and bytes sent. The time estimate adds the round
+ * trip (default 30 ms) per request and the transfer time (default 500 KB/s).
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "disk/d64.h"
+#include "disk/d71.h"
+#include "disk/d80.h"
+#include "disk/d81.h"
+#include "disk/d82.h"
+#include "disk/dnp.h"
+#include "network/http_cache.h"
+
+// Image held in memory, counting the calls that would go to storage
+class BenchMStream : public MStream
+{
+public:
+    std::shared_ptr<std::vector<uint8_t>> data;
+    uint32_t reads = 0;
+    uint32_t seeks = 0;
+
+    BenchMStream(std::shared_ptr<std::vector<uint8_t>> d) : data(d) { _size = data->size(); }
+
+    // Traffic to the server, none for local images
+    virtual uint32_t requests() { return 0; }
+    virtual uint64_t sent() { return 0; }
+
+    bool isOpen() override { return true; }
+    bool open() override { return true; }
+    void close() override {}
+
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; }
+    uint32_t read(uint8_t *buf, uint32_t size) override
+    {
+        reads++;
+        if (_position >= _size)
+            return 0;
+        size = std::min(size, _size - _position);
+        memcpy(buf, data->data() + _position, size);
+        _position += size;
+        return size;
+    }
+    bool seek(uint32_t pos) override
+    {
+        seeks++;
+        _position = pos;
+        return pos <= _size;
+    }
+};
+
+struct Image
+{
+    std::string name;
+    std::string ext;
+    std::shared_ptr<std::vector<uint8_t>> data;
+};
+
+// Every seek to a new offset is a new request from there to the end
+class ReopenMStream : public BenchMStream
+{
+    uint32_t _requests = 1; // the GET made on open
+    uint64_t _sent = 0;
+
+public:
+    using BenchMStream::BenchMStream;
+
+    uint32_t requests() override { return _requests; }
+    uint64_t sent() override { return _sent; }
+
+    uint32_t read(uint8_t *buf, uint32_t size) override
+    {
+        uint32_t n = BenchMStream::read(buf, size);
+        _sent += n;
+        return n;
+    }
+    bool seek(uint32_t pos) override
+    {
+        if (pos != _position)
+            _requests++;
+        return BenchMStream::seek(pos);
+    }
+};
+
+// Web server stand-in answering Range requests
+class RangeServer : public HttpBlockSource
+{
+    std::shared_ptr<std::vector<uint8_t>> _data;
+    uint32_t _pos = 0;
+    uint32_t _end = 0;
+
+public:
+    uint32_t requests = 0;
+    uint64_t sent = 0;
+
+    RangeServer(std::shared_ptr<std::vector<uint8_t>> d) : _data(d) {}
+
+    uint32_t streamPosition() override { return _pos < _end ? _pos : UINT32_MAX; }
+    bool requestRange(uint32_t start, uint32_t end) override
+    {
+        requests++;
+        _pos = start;
+        _end = std::min<uint32_t>(end, _data->size());
+        return true;
+    }
+    uint32_t readStream(uint8_t *buf, uint32_t size) override
+    {
+        size = std::min(size, _end - _pos);
+        memcpy(buf, _data->data() + _pos, size);
+        _pos += size;
+        sent += size;
+        return size;
+    }
+};
+
+// Reads through HttpBlockCache, like HttpIStream after a seek
+class CachedMStream : public BenchMStream
+{
+    RangeServer _server;
+    std::shared_ptr<HttpBlockCache> _cache;
+
+public:
+    CachedMStream(std::shared_ptr<std::vector<uint8_t>> d, const std::string &url)
+        : BenchMStream(d), _server(d), _cache(HttpBlockCache::obtain(url, d->size()))
+    {
+        _server.requestRange(0, _size); // the GET made on open
+    }
+
+    uint32_t requests() override { return _server.requests; }
+    uint64_t sent() override { return _server.sent; }
+
+    uint32_t read(uint8_t *buf, uint32_t size) override
+    {
+        reads++;
+        uint32_t n = _cache->read(&_server, _position, buf, size);
+        _position += n;
+        return n;
+    }
+};
+
+// One download shared by the streams on the image, then local reads
+class CopyMStream : public BenchMStream
+{
+    static std::map<std::string, std::weak_ptr<bool>> copies;
+    std::shared_ptr<bool> _copy;
+    bool _downloaded = false;
+
+public:
+    CopyMStream(std::shared_ptr<std::vector<uint8_t>> d, const std::string &url) : BenchMStream(d)
+    {
+        _copy = copies[url].lock();
+        if (!_copy)
+        {
+            _copy = std::make_shared<bool>(true);
+            copies[url] = _copy;
+            _downloaded = true;
+        }
+    }
+
+    uint32_t requests() override { return 1; } // the GET made on open
+    uint64_t sent() override { return _downloaded ? _size : 0; }
+};
+std::map<std::string, std::weak_ptr<bool>> CopyMStream::copies;
+
+static std::shared_ptr<BenchMStream> open_container(const std::string &transport, const Image &img)
+{
+    auto &data = img.data;
+    if (transport == "reopen")
+        return std::make_shared<ReopenMStream>(data);
+    if (transport == "cache")
+        return std::make_shared<CachedMStream>(data, img.name);
+    if (transport == "copy")
+        return std::make_shared<CopyMStream>(data, img.name);
+    return std::make_shared<BenchMStream>(data);
+}
+
+// Opens the meatloaf stream for an image by its extension
+static D64MStream *open_image(const std::string &ext, std::shared_ptr<MStream> is)
+{
+    if (ext == "d71")
+        return new D71MStream(is);
+    if (ext == "d80")
+        return new D80MStream(is);
+    if (ext == "d81")
+        return new D81MStream(is);
+    if (ext == "d82")
+        return new D82MStream(is);
+    if (ext == "dnp")
+        return new DNPMStream(is);
+    return new D64MStream(is);
+}
+
+// Builds an image holding as many files as fit, using the format's own geometry
+static Image make_image(const std::string &ext)
+{
+    Image img = {"sample." + ext, ext, std::make_shared<std::vector<uint8_t>>()};
+
+    std::unique_ptr<D64MStream> geo(open_image(ext, std::make_shared<BenchMStream>(img.data)));
+    auto &p = geo->partitions[0];
+    uint8_t tracks = p.block_allocation_map.back().end_track;
+    img.data->assign(geo->trackOffset(tracks + 1) * 256, 0);
+    uint8_t *d = img.data->data();
+
+    auto at = [&](uint8_t t, uint8_t s) { return d + (geo->trackOffset(t) + s) * 256; };
+
+    uint8_t *hdr = at(p.header_track, p.header_sector) + p.header_offset;
+    memset(hdr, 0xA0, 27);
+    memcpy(hdr, "MEATLOAF BENCH", 14);
+    memcpy(hdr + 18, "ML 2A", 5);
+
+    // Sectors available for files, skipping the directory track
+    std::vector<std::pair<uint8_t, uint8_t>> free_blocks;
+    for (uint8_t t = 1; t <= tracks; t++)
+        if (t != p.directory_track)
+            for (uint16_t s = 0; s < geo->getSectorCount(t); s++)
+                free_blocks.push_back({t, (uint8_t)s});
+
+    // Directory sectors, after the header and BAM sectors
+    std::vector<uint8_t> dir_sectors;
+    for (uint16_t s = p.directory_sector; s < geo->getSectorCount(p.directory_track) && dir_sectors.size() < 18; s++)
+        dir_sectors.push_back(s);
+
+    size_t next = 0;
+    int file = 0;
+    for (size_t ds = 0; ds < dir_sectors.size(); ds++)
+    {
+        uint8_t *sec = at(p.directory_track, dir_sectors[ds]);
+        bool last = (ds + 1 == dir_sectors.size());
+        sec[0] = last ? 0 : p.directory_track;
+        sec[1] = last ? 0xFF : dir_sectors[ds + 1];
+
+        for (int e = 0; e < 8; e++)
+        {
+            uint16_t blocks = 1 + (file * 7) % 40;
+            if (next + blocks > free_blocks.size())
+                break;
+
+            uint8_t *ent = sec + (e * 32);
+            ent[2] = 0x82; // PRG, closed
+            ent[3] = free_blocks[next].first;
+            ent[4] = free_blocks[next].second;
+            memset(ent + 5, 0xA0, 16);
+            char name[17];
+            int n = snprintf(name, sizeof(name), "FILE%03d", file);
+            memcpy(ent + 5, name, n);
+            ent[30] = blocks & 0xFF;
+            ent[31] = blocks >> 8;
+
+            for (uint16_t b = 0; b < blocks; b++, next++)
+            {
+                uint8_t *blk = at(free_blocks[next].first, free_blocks[next].second);
+                for (int i = 2; i < 256; i++)
+                    blk[i] = (uint8_t)(file + b + i);
+                if (b + 1 < blocks)
+                {
+                    blk[0] = free_blocks[next + 1].first;
+                    blk[1] = free_blocks[next + 1].second;
+                }
+                else
+                {
+                    blk[0] = 0;
+                    blk[1] = 255; // last block is full
+                }
+            }
+            file++;
+        }
+    }
+
+    return img;
+}
+
+struct Result
+{
+    uint32_t files = 0;
+    uint64_t bytes = 0;
+    uint32_t reads = 0;
+    uint32_t seeks = 0;
+    uint32_t requests = 0;
+    uint64_t sent = 0;
+    double ms = 0;
+
+    void add(BenchMStream &s)
+    {
+        reads += s.reads;
+        seeks += s.seeks;
+        requests += s.requests();
+        sent += s.sent();
+    }
+};
+
+static Result run(const Image &img, const std::string &transport)
+{
+    Result r;
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Directory listing
+    auto is = open_container(transport, img);
+    std::unique_ptr<D64MStream> image(open_image(img.ext, is));
+    std::vector<std::string> names;
+
+    image->seekHeader();
+    image->blocksFree();
+    while (image->seekNextImageEntry())
+    {
+        if ((image->entry.file_type & 0b00000111) == 0x00)
+            continue;
+
+        std::string filename = image->entry.filename;
+        filename = filename.substr(0, filename.find_first_of(0xA0));
+        names.push_back(mstr::toUTF8(filename));
+    }
+    r.add(*is);
+
+    // Load every file, each with its own stream like a LOAD would
+    uint8_t buf[256];
+    for (auto &name : names)
+    {
+        auto fis = open_container(transport, img);
+        std::unique_ptr<D64MStream> file(open_image(img.ext, fis));
+        if (!file->seekPath(name))
+        {
+            fprintf(stderr, "%s: can't open \"%s\"\n", img.name.c_str(), name.c_str());
+            continue;
+        }
+        while (uint32_t n = file->read(buf, sizeof(buf)))
+            r.bytes += n;
+        r.files++;
+        r.add(*fis);
+    }
+
+    r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 20;
+    bool http = false;
+    double rtt = 30;
+    double kbps = 500;
+    std::vector<Image> images;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+            continue;
+        }
+        if (arg == "--http")
+        {
+            http = true;
+            continue;
+        }
+        if (arg == "--rtt" && i + 1 < argc)
+        {
+            rtt = atof(argv[++i]);
+            continue;
+        }
+        if (arg == "--kbps" && i + 1 < argc)
+        {
+            kbps = atof(argv[++i]);
+            continue;
+        }
+
+        std::ifstream f(arg, std::ios::binary);
+        if (!f)
+        {
+            fprintf(stderr, "can't read %s\n", arg.c_str());
+            return 1;
+        }
+        std::string ext = arg.substr(arg.find_last_of('.') + 1);
+        mstr::toLower(ext);
+        if (ext == "d41")
+            ext = "d64";
+        auto data = std::make_shared<std::vector<uint8_t>>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        images.push_back({arg, ext, data});
+    }
+
+    if (images.empty())
+        for (auto ext : {"d64", "d71", "d80", "d81", "d82"})
+            images.push_back(make_image(ext));
+
+    std::vector<std::string> transports = {"local"};
+    if (http)
+        transports.insert(transports.end(), {"reopen", "cache", "copy"});
+
+    printf("%-24s %-7s %6s %10s %8s %8s %10s", "image", "via", "files", "bytes", "reads", "seeks", "ms/pass");
+    if (http)
+        printf(" %8s %10s %10s", "requests", "sent KB", "est. ms");
+    printf("\n");
+
+    for (auto &img : images)
+    {
+        for (auto &transport : transports)
+        {
+            Result r = run(img, transport);
+            double ms = r.ms;
+            for (int i = 1; i < repeat; i++)
+                ms += run(img, transport).ms;
+            ms /= repeat;
+
+            printf("%-24s %-7s %6u %10llu %8u %8u %10.3f", img.name.c_str(), transport.c_str(), r.files,
+                   (unsigned long long)r.bytes, r.reads, r.seeks, ms);
+            if (http)
+                printf(" %8u %10.1f %10.0f", r.requests, r.sent / 1024.0,
+                       ms + (r.requests * rtt) + (r.sent / 1024.0 / kbps * 1000));
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
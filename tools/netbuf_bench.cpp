@@ -0,0 +1,210 @@
+/**
+ * NetworkBuffer check and allocation benchmark
+ *
+ * Check: reads through prepare()/commit() keep exactly the committed bytes,
+ * consume() and a later append keep the bytes in order, and the translation
+ * mark survives consume(), str() and assignment, so no byte is translated
+ * twice.
+ *
+ * Benchmark: moves data through a receive buffer the way a protocol read
+ * and a bus read do (the socket read into the buffer, then the bus takes
+ * the bytes and consumes them), once with NetworkBuffer and once with the
+ * std::string code it replaced (a scratch vector per read, insert, then
+ * erase() and shrink_to_fit()). Prints heap allocations and MB/s for
+ * several read sizes.
+ *
+ * Build with "cmake --build build --target netbuf_bench" and run:
+ *
+ *   netbuf_bench [--mb N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "networkBuffer.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+// Heap allocations, counted through the global operator new
+static unsigned long allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("check: %s\n", what);
+        failures++;
+    }
+}
+
+static bool holds(NetworkBuffer &b, const char *s)
+{
+    return b.size() == strlen(s) && memcmp(b.data(), s, b.size()) == 0;
+}
+
+static void check()
+{
+    NetworkBuffer b;
+
+    // a read that stores fewer bytes than reserved
+    memcpy(b.prepare(8), "hello", 5);
+    b.commit(5);
+    expect(holds(b, "hello"), "commit() keeps only the stored bytes");
+
+    // a failed read drops what was reserved
+    b.prepare(16);
+    b.clear();
+    expect(b.empty(), "clear() after prepare() leaves the buffer empty");
+
+    // consume, then append until the consumed space is reclaimed
+    b.append("abcdef", 6);
+    b.consume(4);
+    for (int i = 0; i < 100; i++)
+        b.push_back('0' + i % 10);
+    expect(b.size() == 102 && memcmp(b.data(), "ef0123", 6) == 0, "append after consume() keeps the order");
+    b.clear();
+
+    // translated bytes stay translated
+    b.append("one\r", 4);
+    b.mark();
+    b.append("two", 3);
+    expect(b.unmarked_size() == 3 && memcmp(b.unmarked(), "two", 3) == 0, "mark() covers only earlier bytes");
+    b.consume(2);
+    expect(b.unmarked_size() == 3, "consume() moves the mark along");
+    b.str();
+    expect(b.unmarked_size() == 3 && memcmp(b.unmarked(), "two", 3) == 0, "str() keeps the mark");
+    b.str()[0] = 'E'; // in place, as the PETSCII helpers do
+    expect(b.unmarked_size() == 3 && memcmp(b.unmarked(), "two", 3) == 0, "edit through str() keeps the mark");
+    b.str().erase(1);
+    expect(b.unmarked_size() == 0 && b.size() == 1, "mark past the end after an edit through str()");
+    b = std::string("fresh");
+    expect(b.unmarked_size() == 5 && holds(b, "fresh"), "assigned content is not translated yet");
+    b.mark();
+    expect(b.unmarked_size() == 0, "mark() after assignment");
+    b.clear();
+
+    // the receive read with a partial bus read in between
+    memcpy(b.prepare(6), "abc\nde", 6);
+    b.commit(6);
+    b.mark();
+    b.consume(2);
+    memcpy(b.prepare(3), "xyz", 3);
+    b.commit(3);
+    expect(holds(b, "c\ndexyz") && b.unmarked_size() == 3, "second read after a partial consume()");
+}
+
+struct result
+{
+    unsigned long allocations;
+    double ms;
+};
+
+// One socket read of len bytes straight into the buffer, then the bus takes it in frames
+static result run_new(size_t total, size_t len, size_t frame)
+{
+    NetworkBuffer rx;
+    std::vector<char> bus(frame);
+    unsigned long start = allocations;
+    auto t0 = BenchClock::now();
+    for (size_t moved = 0; moved < total; moved += len)
+    {
+        char *p = rx.prepare(len);
+        memset(p, (int)moved, len);
+        rx.commit(len);
+        while (!rx.empty())
+        {
+            size_t n = std::min(frame, rx.size());
+            memcpy(bus.data(), rx.data(), n);
+            rx.consume(n);
+        }
+    }
+    return {allocations - start, ms_since(t0)};
+}
+
+// Reference: the std::string path as it was
+static result run_old(size_t total, size_t len, size_t frame)
+{
+    std::string rx;
+    std::vector<char> bus(frame);
+    unsigned long start = allocations;
+    auto t0 = BenchClock::now();
+    for (size_t moved = 0; moved < total; moved += len)
+    {
+        std::vector<uint8_t> newData = std::vector<uint8_t>(len);
+        memset(newData.data(), (int)moved, len);
+        rx.insert(rx.end(), newData.begin(), newData.end());
+        while (!rx.empty())
+        {
+            size_t n = std::min(frame, rx.size());
+            memcpy(bus.data(), rx.data(), n);
+            rx.erase(0, n);
+            rx.shrink_to_fit();
+        }
+    }
+    return {allocations - start, ms_since(t0)};
+}
+
+int main(int argc, char **argv)
+{
+    int mb = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+            mb = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--mb N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    check();
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    size_t total = (size_t)mb * 1024 * 1024;
+    printf("%d MB, bus takes 128-byte frames\n", mb);
+    printf("%-6s %12s %10s %12s %10s\n", "read", "old allocs", "old MB/s", "new allocs", "new MB/s");
+    for (size_t len : {127, 256, 512, 4096})
+    {
+        result o = run_old(total, len, 128);
+        result n = run_new(total, len, 128);
+        printf("%-6zu %12lu %10.1f %12lu %10.1f\n", len, o.allocations, mb / (o.ms / 1000), n.allocations, mb / (n.ms / 1000));
+    }
+    return 0;
+}
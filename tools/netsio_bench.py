@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+NetSIO sector read benchmark
+
+Stands in for the NetSIO hub and the emulated Atari behind it: FujiNet-PC
+connects to this script as it would to Altirra's hub, and the script issues
+SIO sector reads to D1: the way the emulator would, answering pings, alive
+and credit requests along the way. It reports sectors per second and how
+many datagrams FujiNet-PC needed per sector.
+
+Enable NetSIO in FujiNet-PC with this machine as host (port 9997 unless
+changed), mount a disk image in D1: and run:
+
+  python3 tools/netsio_bench.py [--port 9997] [--sectors 720] [--hsio 8]
+
+--hsio sets the peer speed to the given HSIO index, FujiNet-PC switches to
+it after the first command frames fail at standard speed. A session recorded
+as lines of "device command aux1 aux2" (hex) can be replayed with --session.
+"""
+
+import argparse, socket, time
+
+DATA_BYTE = 0x01
+DATA_BLOCK = 0x02
+COMMAND_OFF = 0x10
+COMMAND_ON = 0x11
+COMMAND_OFF_SYNC = 0x18
+SPEED_CHANGE = 0x80
+SYNC_RESPONSE = 0x81
+DEVICE_DISCONNECT = 0xC0
+DEVICE_CONNECT = 0xC1
+PING_REQUEST = 0xC2
+PING_RESPONSE = 0xC3
+ALIVE_REQUEST = 0xC4
+ALIVE_RESPONSE = 0xC5
+CREDIT_STATUS = 0xC6
+CREDIT_UPDATE = 0xC7
+
+EMPTY_SYNC = 0x00
+
+CREDIT = 3
+PAL_FREQUENCY = 1773447
+
+
+def sio_checksum(data):
+    ck = 0
+    for b in data:
+        ck += b
+        ck = (ck >> 8) + (ck & 0xFF)
+    return ck
+
+
+def hsio_baud(index):
+    if index < 0:
+        return 19200
+    return PAL_FREQUENCY // (2 * (index + 7))
+
+
+class Hub:
+    def __init__(self, port):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind(('', port))
+        self.peer = None
+        self.sync_num = 0
+        self.datagrams = 0
+        self.rx = bytearray()
+        self.sync = None
+
+    def send(self, *msg):
+        self.sock.sendto(bytes(msg), self.peer)
+
+    def wait_connect(self):
+        print('Waiting for FujiNet-PC ...')
+        while True:
+            msg, addr = self.sock.recvfrom(1024)
+            if msg[0] == PING_REQUEST:
+                self.sock.sendto(bytes([PING_RESPONSE]), addr)
+            elif msg[0] == DEVICE_CONNECT:
+                self.peer = addr
+                print(f'Connected {addr[0]}:{addr[1]}')
+                self.send(CREDIT_UPDATE, CREDIT)
+                return
+
+    def receive(self, timeout):
+        """Handles one datagram from FujiNet-PC, False on timeout"""
+        self.sock.settimeout(timeout)
+        try:
+            msg, addr = self.sock.recvfrom(1024)
+        except socket.timeout:
+            return False
+        if addr != self.peer:
+            if msg[0] == PING_REQUEST:
+                self.sock.sendto(bytes([PING_RESPONSE]), addr)
+            return True
+        cmd = msg[0]
+        if cmd == DATA_BYTE:
+            self.datagrams += 1
+            self.rx += msg[1:2]
+        elif cmd == DATA_BLOCK:
+            self.datagrams += 1
+            self.rx += msg[1:]
+        elif cmd == SYNC_RESPONSE:
+            self.datagrams += 1
+            self.sync = msg
+        elif cmd == CREDIT_STATUS:
+            self.send(CREDIT_UPDATE, CREDIT)
+        elif cmd == PING_REQUEST:
+            self.send(PING_RESPONSE)
+        elif cmd == ALIVE_REQUEST:
+            self.send(ALIVE_RESPONSE)
+        elif cmd == DEVICE_DISCONNECT:
+            raise ConnectionError('FujiNet-PC disconnected')
+        return True
+
+    def read_bytes(self, n, timeout=1.0):
+        deadline = time.monotonic() + timeout
+        while len(self.rx) < n:
+            left = deadline - time.monotonic()
+            if left <= 0 or not self.receive(left):
+                break
+        data, self.rx = bytes(self.rx[:n]), self.rx[n:]
+        return data
+
+    def command(self, frame, length, timeout=1.0):
+        """Sends a command frame, returns the data frame read or None"""
+        self.rx.clear()
+        self.sync = None
+        self.sync_num = (self.sync_num + 1) & 0xFF
+        self.send(COMMAND_ON)
+        self.send(DATA_BLOCK, *frame, sio_checksum(frame), 0)  # last byte is a sequence number
+        self.send(COMMAND_OFF_SYNC, self.sync_num)
+
+        # ACK comes in the sync response
+        deadline = time.monotonic() + timeout
+        while self.sync is None or self.sync[1] != self.sync_num:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self.receive(left)
+        if self.sync[2] == EMPTY_SYNC or self.sync[3] != ord('A'):
+            return None
+
+        reply = self.read_bytes(1 + length + 1, timeout)
+        if len(reply) < length + 2 or reply[0] != ord('C'):
+            return None
+        data = reply[1:-1]
+        if sio_checksum(data) != reply[-1]:
+            return None
+        return data
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[1])
+    ap.add_argument('--port', type=int, default=9997)
+    ap.add_argument('--sectors', type=int, default=720, help='sectors read from D1:')
+    ap.add_argument('--size', type=int, default=128, help='sector size')
+    ap.add_argument('--hsio', type=int, default=-1, help='HSIO index, standard speed if not given')
+    ap.add_argument('--session', help='replay command frames from this file')
+    args = ap.parse_args()
+
+    if args.session:
+        with open(args.session) as f:
+            frames = [bytes(int(x, 16) for x in line.split()[:4]) for line in f if line.strip()]
+    else:
+        frames = [bytes([0x31, 0x52, s & 0xFF, s >> 8]) for s in range(1, args.sectors + 1)]
+
+    hub = Hub(args.port)
+    hub.wait_connect()
+    baud = hsio_baud(args.hsio)
+    hub.send(SPEED_CHANGE, *baud.to_bytes(4, 'little'))
+
+    retries = 0
+    start = time.monotonic()
+    for frame in frames:
+        length = args.size if frame[1] == 0x52 and frame[2] | (frame[3] << 8) > 3 else 128
+        for attempt in range(10):
+            if hub.command(frame, length) is not None:
+                break
+            retries += 1
+        else:
+            raise IOError(f'command {frame.hex()} failed')
+    elapsed = time.monotonic() - start
+
+    print(f'{len(frames)} commands at {baud} baud in {elapsed:.2f} s: '
+          f'{len(frames) / elapsed:.1f} sectors/s, '
+          f'{hub.datagrams / len(frames):.2f} datagrams/sector, {retries} retries')
+
+
+if __name__ == '__main__':
+    main()
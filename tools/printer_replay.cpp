@@ -0,0 +1,646 @@
+/**
+ * Printer emulator replay for FujiNet-PC
+ *
+ * Streams print jobs through each printer emulator in 40 byte frames, the way
+ * the SIO printer device hands them over, and reports throughput, heap
+ * allocations, output size and a hash of the output. The hashes can be
+ * checked against a golden file to catch output changes.
+ *
+ * Build with "cmake --build build --target printer_replay" and run it from the
+ * dist directory, the printer fonts are read from data/f/.
+ *
+ *   printer_replay [--golden FILE | --update FILE] [--repeat N] [job files...]
+ *
+ * PDF and PNG output is also taken apart when the host zlib is there: the
+ * PDF cross reference stream must point at every object, objects in the
+ * object stream must be where it says, and every compressed stream must
+ * inflate. PNG chunks must have good CRCs and the image data must inflate to
+ * the size in the header. "png-stored" is the PNG printer as it writes without
+ * memory for compression, its image must be the same as the compressed one.
+ *
+ * The hashes of the built-in jobs are kept in printer_replay_<TARGET>.golden
+ * next to this file, the output differs between build targets (e.g. the end
+ * of line character). "cmake --build build --target printer_replay_check"
+ * runs them and fails if any output changed. After an intended change,
+ * regenerate the file with --update and look at the new output first.
+ *
+ * Job files hold captured printer data, files ending in .scr are screen dumps
+ * for the PNG printer. Without any, the built-in jobs are run: a BASIC
+ * listing for the text printers and a screen dump for PNG.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef REPLAY_CHECK_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../include/atascii.h"
+#include "fnFsSD.h"
+#include "fsFlash.h"
+
+#include "atari_820.h"
+#include "atari_822.h"
+#include "atari_825.h"
+#include "atari_1020.h"
+#include "atari_1025.h"
+#include "atari_1027.h"
+#include "atari_1029.h"
+#include "atari_xdm121.h"
+#include "atari_xmm801.h"
+#include "coleco_printer.h"
+#include "commodoremps803.h"
+#include "epson_80.h"
+#include "epson_tps.h"
+#include "file_printer.h"
+#include "html_printer.h"
+#include "okimate_10.h"
+#include "png_printer.h"
+
+#define REPLAY_FRAME 40
+#define REPLAY_DIR "printer_replay.tmp"
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+/**
+ * Heap use while a job runs. glibc's malloc can be wrapped, which also sees
+ * C allocations (e.g. the deflate window), elsewhere only new is counted.
+ */
+static bool count_allocs = false;
+static unsigned long alloc_count = 0;
+static unsigned long long alloc_bytes = 0;
+
+#ifdef __GLIBC__
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    void *malloc(size_t size)
+    {
+        if (count_allocs)
+        {
+            alloc_count++;
+            alloc_bytes += size;
+        }
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t n, size_t size)
+    {
+        if (count_allocs)
+        {
+            alloc_count++;
+            alloc_bytes += n * size;
+        }
+        return __libc_calloc(n, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        if (count_allocs)
+        {
+            alloc_count++;
+            alloc_bytes += size;
+        }
+        return __libc_realloc(ptr, size);
+    }
+}
+#else
+void *operator new(size_t size)
+{
+    if (count_allocs)
+    {
+        alloc_count++;
+        alloc_bytes += size;
+    }
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+#endif
+
+// The PNG printer when the deflate window can't be allocated
+class pngPrinterStored : public pngPrinter
+{
+protected:
+    void post_new_file() override
+    {
+        pngPrinter::post_new_file();
+        idat.clear();
+        deflater.begin_stored(&idat);
+    }
+};
+
+struct replay_emulator
+{
+    const char *name;
+    printer_emu *(*create)();
+    bool graphics; // takes screen dumps rather than text
+};
+
+static const replay_emulator emulators[] = {
+    {"file-raw", []() -> printer_emu * { return new filePrinter(RAW); }, false},
+    {"file-trim", []() -> printer_emu * { return new filePrinter(TRIM); }, false},
+    {"file-ascii", []() -> printer_emu * { return new filePrinter(ASCII); }, false},
+    {"atari820", []() -> printer_emu * { return new atari820; }, false},
+    {"atari822", []() -> printer_emu * { return new atari822; }, false},
+    {"atari825", []() -> printer_emu * { return new atari825; }, false},
+    {"atari1020", []() -> printer_emu * { return new atari1020; }, false},
+    {"atari1025", []() -> printer_emu * { return new atari1025; }, false},
+    {"atari1027", []() -> printer_emu * { return new atari1027; }, false},
+    {"atari1029", []() -> printer_emu * { return new atari1029; }, false},
+    {"xdm121", []() -> printer_emu * { return new xdm121; }, false},
+    {"xmm801", []() -> printer_emu * { return new xmm801; }, false},
+    {"epson80", []() -> printer_emu * { return new epson80; }, false},
+    {"epson-tps", []() -> printer_emu * { return new epsonTPS; }, false},
+    {"okimate10", []() -> printer_emu * { return new okimate10; }, false},
+    {"mps803", []() -> printer_emu * { return new commodoremps803; }, false},
+    {"coleco", []() -> printer_emu * { return new colecoprinter; }, false},
+    {"html", []() -> printer_emu * { return new htmlPrinter(HTML); }, false},
+    {"html-atascii", []() -> printer_emu * { return new htmlPrinter(HTML_ATASCII); }, false},
+    {"png", []() -> printer_emu * { return new pngPrinter; }, true},
+    {"png-stored", []() -> printer_emu * { return new pngPrinterStored; }, true},
+};
+
+struct replay_job
+{
+    std::string name;
+    std::string data;
+    bool graphics;
+};
+
+// A BASIC listing with some long lines and characters PDF needs escaped
+static replay_job job_listing()
+{
+    replay_job job = {"listing", "", false};
+    char line[160];
+
+    for (int n = 1; n <= 500; n++)
+    {
+        int len = snprintf(line, sizeof(line), "%d PRINT \"LINE %d\";X(%d)*%d:GOSUB %d", n * 10, n, n % 17, n % 9, 1000 + (n % 50) * 10);
+        if (n % 7 == 3)
+            len += snprintf(line + len, sizeof(line) - len, ":REM (PARENS) \\ AND ENOUGH TEXT TO WRAP PAST FORTY COLUMNS");
+        job.data.append(line, len);
+        job.data += (char)ATASCII_EOL;
+    }
+    return job;
+}
+
+// Two screens for the PNG printer: a repeat count followed by 320 pixels per line
+static replay_job job_screen()
+{
+    replay_job job = {"screen", "", true};
+
+    for (int y = 0; y < 2 * PNG_SCREEN_HEIGHT; y += 2)
+    {
+        job.data += (char)2;
+        for (int x = 0; x < PNG_WIDTH; x++)
+        {
+            int dx = x / 2 - 80, dy = y / 2 - 48;
+            uint8_t c = (dx * dx + dy * dy * 3 < 1600) ? 0x28 : ((x / 40 + y / 24) % 2 ? 0xC6 : 0x00);
+            if ((x / 8 + y) % 64 == 0)
+                c = 0x0E | (uint8_t)(y & 0xF0);
+            job.data += (char)c;
+        }
+    }
+    return job;
+}
+
+static bool read_job(const char *path, replay_job &job)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr)
+        return false;
+
+    const char *base = strrchr(path, '/');
+    job.name = base ? base + 1 : path;
+    // screen dumps go to the PNG printer
+    job.graphics = job.name.size() > 4 && job.name.compare(job.name.size() - 4, 4, ".scr") == 0;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        job.data.append(buf, n);
+    fclose(f);
+    return true;
+}
+
+// FNV-1a, good enough to notice changed output
+static uint64_t hash_output(const std::string &data)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : data)
+        h = (h ^ c) * 0x100000001b3ULL;
+    return h;
+}
+
+static std::string read_output(FILE *f)
+{
+    std::string data;
+    char buf[4096];
+    size_t n;
+    while (f != nullptr && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.append(buf, n);
+    return data;
+}
+
+#ifdef REPLAY_CHECK_ZLIB
+static bool inflate_stream(const std::string &in, std::string &out)
+{
+    z_stream zs = {};
+    if (inflateInit(&zs) != Z_OK)
+        return false;
+    zs.next_in = (Bytef *)in.data();
+    zs.avail_in = in.size();
+    char buf[4096];
+    int ret;
+    do
+    {
+        zs.next_out = (Bytef *)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END && zs.avail_in == 0;
+}
+
+/**
+ * Object obj at offset in pdf: its dictionary and, if it has one, its stream,
+ * inflated if it is compressed. Returns an error or an empty string.
+ */
+static std::string pdf_object(const std::string &pdf, size_t offset, int obj, std::string &dict, std::string &stream)
+{
+    std::string head = std::to_string(obj) + " 0 obj\n";
+    if (offset >= pdf.size() || pdf.compare(offset, head.size(), head) != 0)
+        return "object " + std::to_string(obj) + " not at its offset";
+    size_t end = pdf.find("endobj", offset);
+    size_t data = pdf.find(">>\nstream\n", offset);
+    if (end == std::string::npos)
+        return "object " + std::to_string(obj) + " has no endobj";
+    if (data == std::string::npos || data > end)
+    {
+        dict = pdf.substr(offset + head.size(), end - offset - head.size());
+        stream.clear();
+        return "";
+    }
+    dict = pdf.substr(offset + head.size(), data + 2 - offset - head.size());
+    data += 10;
+
+    size_t l = dict.rfind("/Length ");
+    size_t len = l == std::string::npos ? 0 : strtoul(dict.c_str() + l + 8, nullptr, 10);
+    if (l == std::string::npos || data + len > pdf.size() || pdf.compare(data + len, 10, "\nendstream") != 0)
+        return "stream of object " + std::to_string(obj) + " has the wrong /Length";
+    stream = pdf.substr(data, len);
+    if (dict.find("/FlateDecode") != std::string::npos)
+    {
+        std::string raw;
+        if (!inflate_stream(stream, raw))
+            return "stream of object " + std::to_string(obj) + " does not inflate";
+        stream.swap(raw);
+    }
+    return "";
+}
+
+static uint32_t pdf_field(const std::string &table, size_t pos, int width)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < width; i++)
+        v = (v << 8) | (uint8_t)table[pos + i];
+    return v;
+}
+
+static uint32_t png_field(const std::string &png, size_t pos)
+{
+    return ((uint32_t)(uint8_t)png[pos] << 24) | ((uint8_t)png[pos + 1] << 16) | ((uint8_t)png[pos + 2] << 8) |
+           (uint8_t)png[pos + 3];
+}
+
+// Walks the chunks and inflates the image data into image, returns an error or an empty string
+static std::string check_png(const std::string &png, std::string &image)
+{
+    std::string idat;
+    uint32_t width = 0, height = 0;
+    size_t pos = 8;
+    bool end = false;
+    while (!end)
+    {
+        if (pos + 12 > png.size())
+            return "no IEND chunk";
+        uint32_t len = png_field(png, pos);
+        if (pos + 12 + len > png.size())
+            return "chunk runs past the end";
+        std::string type = png.substr(pos + 4, 4);
+        if (crc32(0, (const Bytef *)png.data() + pos + 4, len + 4) != png_field(png, pos + 8 + len))
+            return type + " chunk has a bad CRC";
+        if (type == "IHDR")
+        {
+            width = png_field(png, pos + 8);
+            height = png_field(png, pos + 12);
+        }
+        else if (type == "IDAT")
+            idat.append(png, pos + 8, len);
+        end = type == "IEND";
+        pos += 12 + len;
+    }
+    if (pos != png.size())
+        return "data after IEND";
+    if (!inflate_stream(idat, image))
+        return "image data does not inflate";
+    if (image.size() != (size_t)height * (width + 1))
+        return "image data does not match the IHDR size";
+    return "";
+}
+
+// Follows the cross reference stream to every object, returns an error or an empty string
+static std::string check_pdf(const std::string &pdf)
+{
+    size_t p = pdf.rfind("startxref\n");
+    if (p == std::string::npos)
+        return "no startxref";
+    size_t xref = strtoul(pdf.c_str() + p + 10, nullptr, 10);
+    int xref_obj = atoi(pdf.c_str() + (xref < pdf.size() ? xref : 0));
+
+    std::string dict, table;
+    std::string err = pdf_object(pdf, xref, xref_obj, dict, table);
+    if (!err.empty())
+        return "xref: " + err;
+    if (dict.find("/Type /XRef") == std::string::npos || dict.find("/W [1 4 2]") == std::string::npos)
+        return "startxref does not point at an xref stream";
+    size_t s = dict.find("/Size ");
+    size_t size = s == std::string::npos ? 0 : strtoul(dict.c_str() + s + 6, nullptr, 10);
+    if (size == 0 || table.size() != size * 7)
+        return "xref stream does not hold /Size entries";
+    if (table[0] != 0)
+        return "object 0 is not free";
+
+    std::map<int, std::vector<int>> in_stream; // object stream -> objects by index
+    for (size_t obj = 1; obj < size; obj++)
+    {
+        uint8_t type = table[obj * 7];
+        uint32_t field2 = pdf_field(table, obj * 7 + 1, 4);
+        uint32_t field3 = pdf_field(table, obj * 7 + 5, 2);
+        std::string stream;
+        if (type == 1)
+            err = pdf_object(pdf, field2, obj, dict, stream);
+        else if (type == 2)
+        {
+            if (field2 >= size || table[field2 * 7] != 1)
+                err = "object " + std::to_string(obj) + " in a stream that is not in the file";
+            std::vector<int> &objs = in_stream[field2];
+            if (objs.size() <= field3)
+                objs.resize(field3 + 1, -1);
+            objs[field3] = obj;
+        }
+        else
+            err = "object " + std::to_string(obj) + " is missing";
+        if (!err.empty())
+            return err;
+    }
+
+    // the object streams must hold the objects the xref puts there, in that order
+    for (const auto &os : in_stream)
+    {
+        std::string stream;
+        pdf_object(pdf, pdf_field(table, os.first * 7 + 1, 4), os.first, dict, stream);
+        size_t n = dict.find("/N "), first = dict.find("/First ");
+        if (dict.find("/Type /ObjStm") == std::string::npos || n == std::string::npos || first == std::string::npos ||
+            strtoul(dict.c_str() + n + 3, nullptr, 10) != os.second.size())
+            return "object stream " + std::to_string(os.first) + " does not match the xref";
+        const char *index = stream.c_str();
+        for (size_t i = 0; i < os.second.size(); i++)
+        {
+            char *next;
+            long obj = strtol(index, &next, 10);
+            strtol(next, &next, 10);
+            if (next == index || obj != os.second[i])
+                return "object stream " + std::to_string(os.first) + " index does not match the xref";
+            index = next;
+        }
+    }
+    return "";
+}
+#endif
+
+struct replay_result
+{
+    size_t out_size;
+    uint64_t hash;
+    std::string bad_output;  // what is wrong with PDF or PNG output
+    uint64_t image_hash = 0; // of the inflated PNG image data
+    double ms;
+    unsigned long allocs;
+    unsigned long long alloc_bytes;
+};
+
+static replay_result replay(const replay_emulator &emu, const replay_job &job, FileSystem *fs)
+{
+    replay_result r;
+    printer_emu *p = emu.create();
+    p->initPrinter(fs);
+
+    alloc_count = 0;
+    alloc_bytes = 0;
+    count_allocs = true;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t pos = 0; pos < job.data.size(); pos += REPLAY_FRAME)
+    {
+        size_t n = job.data.size() - pos < REPLAY_FRAME ? job.data.size() - pos : REPLAY_FRAME;
+        memcpy(p->provideBuffer(), job.data.data() + pos, n);
+        p->process(n, 'N', 0);
+    }
+    FILE *out = p->closeOutputAndProvideReadHandle();
+
+    r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    count_allocs = false;
+    r.allocs = alloc_count;
+    r.alloc_bytes = alloc_bytes;
+
+    std::string data = read_output(out);
+    r.out_size = data.size();
+    r.hash = hash_output(data);
+#ifdef REPLAY_CHECK_ZLIB
+    if (data.compare(0, 5, "%PDF-") == 0)
+        r.bad_output = check_pdf(data);
+    else if (data.compare(0, 4, "\x89PNG") == 0)
+    {
+        std::string image;
+        r.bad_output = check_png(data, image);
+        r.image_hash = hash_output(image);
+    }
+#endif
+    if (out != nullptr)
+        fclose(out);
+    delete p;
+    return r;
+}
+
+static std::map<std::string, std::string> read_golden(const char *path)
+{
+    std::map<std::string, std::string> golden;
+    FILE *f = fopen(path, "r");
+    char key[128], hash[32];
+
+    if (f == nullptr)
+        return golden;
+    while (fscanf(f, "%127s %31s", key, hash) == 2)
+        golden[key] = hash;
+    fclose(f);
+    return golden;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: printer_replay [--golden FILE | --update FILE] [--repeat N] [job files...]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *golden_path = nullptr;
+    bool update = false;
+    int repeat = 1;
+    std::vector<replay_job> jobs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--golden") == 0 || strcmp(argv[i], "--update") == 0) && i + 1 < argc)
+        {
+            update = argv[i][2] == 'u';
+            golden_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+            if (repeat < 1)
+                repeat = 1;
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+            return 2;
+        }
+        else
+        {
+            replay_job job;
+            if (!read_job(argv[i], job))
+            {
+                fprintf(stderr, "can't read %s\n", argv[i]);
+                return 2;
+            }
+            jobs.push_back(job);
+        }
+    }
+    if (jobs.empty())
+    {
+        jobs.push_back(job_listing());
+        jobs.push_back(job_screen());
+    }
+
+    // printer output goes to a scratch directory, fonts come from data/
+    std::error_code ec;
+    std::filesystem::create_directory(REPLAY_DIR, ec);
+    FileSystemSDFAT replayFS;
+    if (!replayFS.start(REPLAY_DIR) || !fsFlash.start())
+    {
+        fprintf(stderr, "can't set up file systems\n");
+        return 2;
+    }
+
+    std::map<std::string, std::string> golden;
+    if (golden_path != nullptr && !update)
+        golden = read_golden(golden_path);
+    FILE *golden_out = update ? fopen(golden_path, "w") : nullptr;
+
+    // the emulators' debug messages go to stdout, keep them out of the timing
+    fflush(stdout);
+    int console = dup(STDOUT_FILENO);
+    int null_fd = open(NULL_DEVICE, O_WRONLY);
+
+    int failed = 0;
+    std::map<std::string, uint64_t> images; // job -> image of the first PNG emulator
+    printf("%-13s %-10s %9s %9s %10s %8s %10s  %s\n", "emulator", "job", "in", "out", "KB/s", "allocs", "alloc KB", "hash");
+    for (const replay_job &job : jobs)
+    {
+        for (const replay_emulator &emu : emulators)
+        {
+            if (emu.graphics != job.graphics)
+                continue;
+
+            replay_result best = {};
+            for (int run = 0; run < repeat; run++)
+            {
+                fflush(stdout);
+                dup2(null_fd, STDOUT_FILENO);
+                replay_result r = replay(emu, job, &replayFS);
+                fflush(stdout);
+                dup2(console, STDOUT_FILENO);
+                if (run == 0 || r.ms < best.ms)
+                    best = r;
+            }
+
+            char hash[32];
+            snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)best.hash);
+            std::string key = std::string(emu.name) + "/" + job.name;
+
+            const char *verdict = "";
+            if (!golden.empty())
+            {
+                auto g = golden.find(key);
+                if (g == golden.end())
+                    verdict = "  (new)";
+                else if (g->second != hash)
+                {
+                    verdict = "  CHANGED";
+                    failed++;
+                }
+            }
+            if (golden_out != nullptr)
+                fprintf(golden_out, "%s %s\n", key.c_str(), hash);
+            if (best.image_hash != 0 && !images.emplace(job.name, best.image_hash).second &&
+                images[job.name] != best.image_hash && best.bad_output.empty())
+                best.bad_output = "image differs from the first PNG emulator's";
+            if (!best.bad_output.empty())
+            {
+                verdict = "  BAD OUTPUT";
+                failed++;
+            }
+
+            printf("%-13s %-10s %9zu %9zu %10.0f %8lu %10.1f  %s%s\n", emu.name, job.name.c_str(),
+                   job.data.size(), best.out_size, job.data.size() / 1024.0 / (best.ms / 1000.0),
+                   best.allocs, best.alloc_bytes / 1024.0, hash, verdict);
+            if (!best.bad_output.empty())
+                printf("    %s\n", best.bad_output.c_str());
+        }
+    }
+
+    close(null_fd);
+    close(console);
+    if (golden_out != nullptr)
+        fclose(golden_out);
+    std::filesystem::remove_all(REPLAY_DIR, ec);
+
+    if (failed > 0)
+        printf("%d output(s) differ from %s\n", failed, golden_path);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * SAM streaming renderer and phrase cache check and benchmark
+ *
+ * Check: phrases are said through SamCache and the waveforms compared with
+ * the length and FNV-1a hash of what the renderer made before it was made
+ * reentrant (taken from the old code, SAMMain() with GetBuffer()). The
+ * pieces must be no longer than SAM_CHUNK and the old SAMMain() interface
+ * must still give the same waveform. The same phrases said from several
+ * threads at once must come out the same, and the cache must give back the
+ * same bytes and drop the least recently used phrase when full.
+ *
+ * Benchmark: time until the first sample is ready with SAMMain(), with the
+ * streaming renderer and from the cache, for a short and a long phrase.
+ *
+ * Build with "cmake --build build --target sam_bench" and run:
+ *
+ *   sam_bench [--rounds N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "compat_string.h"
+#include "reciter.h"
+#include "sam.h"
+#include "samcache.h"
+
+extern char input[256];
+int debug = 0;
+
+struct phrase_case
+{
+    bool phonetic;
+    const char *text;
+    sam_voice voice;
+    int samples;
+    uint64_t hash;
+};
+
+#define SAM_DEFAULT_VOICE {72, 64, 128, 128, 0}
+
+// Reference: output of the renderer as it was
+static const phrase_case cases[] = {
+    {true, "WAH7NQ", SAM_DEFAULT_VOICE, 7931, 0xa3957f46ea10c696ULL},
+    {true, "TUW7", SAM_DEFAULT_VOICE, 6774, 0x9ff7dcb26f3fa04eULL},
+    {true, "THRIYY7Q", SAM_DEFAULT_VOICE, 9005, 0xd6e0f71ae37d2e8bULL},
+    {true, "FOH7R", SAM_DEFAULT_VOICE, 7601, 0x70f00cc3c172f895ULL},
+    {true, "F7AYVQ", SAM_DEFAULT_VOICE, 10107, 0x389801215af45740ULL},
+    {true, "SIH7IHKSQ", SAM_DEFAULT_VOICE, 12088, 0x8cba06f0e632d4f6ULL},
+    {true, "SEHV7EHNQ", SAM_DEFAULT_VOICE, 12621, 0x3db16da711dd4e17ULL},
+    {true, "AEY74Q", SAM_DEFAULT_VOICE, 5598, 0x7d1f752da4f0bd6cULL},
+    {true, "DIHSK7Q ", SAM_DEFAULT_VOICE, 9310, 0x01a545bfa3901b68ULL},
+    {false, "HELLO WORLD", SAM_DEFAULT_VOICE, 18887, 0x016ac951d420226dULL},
+    {false, "I AM SAM. WHO ARE YOU?", SAM_DEFAULT_VOICE, 43361, 0xf6a465d68ed32ddeULL},
+    {false, "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG. HOW MUCH WOOD WOULD A WOODCHUCK CHUCK, IF A WOODCHUCK COULD CHUCK WOOD?",
+     SAM_DEFAULT_VOICE, 152556, 0x8155a566bdf2d65cULL},
+    {true, "/HEH3LOW2, /HAW AH YUX2 TUXDEY. AY /HOH3P YUX AH FIYLIHNX OW4 KEY.", SAM_DEFAULT_VOICE, 86445, 0x1b5b7efaa57f8777ULL},
+    {false, "FUJINET IS READY", {92, 80, 190, 110, 0}, 34581, 0x00da831e4cb053baULL},
+    {false, "STUFFY GUY", {82, 72, 110, 105, 0}, 23444, 0x0d03c0469287c43fULL},
+    {false, "LITTLE ROBOT", {92, 60, 190, 190, 0}, 26651, 0x6083cb8e0717ea3aULL},
+    {false, "EXTRA TERRESTRIAL", {100, 64, 150, 200, 0}, 40739, 0xe8146e75c7bb7ffbULL},
+    {false, "DAISY DAISY GIVE ME YOUR ANSWER DO", {72, 60, 128, 128, 1}, 54778, 0x77ed68441dddc001ULL},
+    {true, "SAH5KSEHSFUHL", {40, 40, 80, 80, 0}, 15156, 0xb89c6ef051153459ULL},
+    {false, "MOUNTING DISK ONE", {160, 100, 128, 128, 0}, 58256, 0xaa5b1bae0fc4c4d3ULL},
+};
+static const int case_count = sizeof(cases) / sizeof(cases[0]);
+
+using Clock = std::chrono::steady_clock;
+
+static double us_since(Clock::time_point t)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - t).count();
+}
+
+static uint64_t fnv1a(const uint8_t *data, size_t size)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Text the way sam() passes it on, with a space after each word
+static std::string sam_text(const phrase_case &c)
+{
+    return std::string(c.text) + " ";
+}
+
+// Says a phrase, returns the waveform and the largest piece
+static std::vector<uint8_t> say(SamCache &cache, const phrase_case &c, size_t *largest = nullptr)
+{
+    std::vector<uint8_t> wave;
+    size_t max_piece = 0;
+    cache.say(sam_text(c).c_str(), c.phonetic, c.voice, [&](const uint8_t *pcm, size_t len) {
+        wave.insert(wave.end(), pcm, pcm + len);
+        if (len > max_piece)
+            max_piece = len;
+    });
+    if (largest)
+        *largest = max_piece;
+    return wave;
+}
+
+static bool matches(const phrase_case &c, const std::vector<uint8_t> &wave)
+{
+    return (int)wave.size() == c.samples && fnv1a(wave.data(), wave.size()) == c.hash;
+}
+
+// The old interface: global settings, SAMMain() and GetBuffer(). Sing mode can't be turned off again.
+static int sam_main(const phrase_case &c)
+{
+    SetSpeed(c.voice.speed);
+    SetPitch(c.voice.pitch);
+    SetMouth(c.voice.mouth);
+    SetThroat(c.voice.throat);
+
+    memset(input, 0, sizeof(input));
+    strlcat(input, sam_text(c).c_str(), 255);
+    if (!c.phonetic)
+    {
+        strlcat(input, "[", sizeof(input) - strlen(input));
+        if (!TextToPhonemes((unsigned char *)input))
+            return 0;
+    }
+    else
+        strlcat(input, "\x9b", sizeof(input) - strlen(input));
+    return SAMMain();
+}
+
+static int check_render()
+{
+    int failures = 0;
+    SamCache cache(0); // nothing kept, every phrase is rendered
+    for (int i = 0; i < case_count; i++)
+    {
+        const phrase_case &c = cases[i];
+        size_t largest;
+        std::vector<uint8_t> wave = say(cache, c, &largest);
+        if (!matches(c, wave) || largest > SAM_CHUNK)
+        {
+            printf("render mismatch: \"%s\" gave %zu samples, %zu largest piece\n", c.text, wave.size(), largest);
+            failures++;
+        }
+
+        if (c.voice.singmode)
+            continue;
+        if (!sam_main(c) || GetBufferLength() / 50 != c.samples ||
+            fnv1a((const uint8_t *)GetBuffer(), c.samples) != c.hash)
+        {
+            printf("SAMMain mismatch: \"%s\"\n", c.text);
+            failures++;
+        }
+        FreeBuffer();
+    }
+    if (cache.phrase_count() != 0)
+    {
+        printf("empty cache kept %zu phrases\n", cache.phrase_count());
+        failures++;
+    }
+    return failures;
+}
+
+static int check_threads(int threads)
+{
+    std::vector<int> failures(threads);
+    std::vector<std::thread> workers;
+    SamCache cache(0);
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < case_count; i++)
+            {
+                const phrase_case &c = cases[(i * 7 + t * 3) % case_count];
+                if (!matches(c, say(cache, c)))
+                    failures[t]++;
+            }
+        });
+    }
+    int total = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].join();
+        total += failures[t];
+    }
+    if (total)
+        printf("threads: %d mismatches\n", total);
+    return total;
+}
+
+static int check_cache()
+{
+    int failures = 0;
+    auto fail = [&](const char *what) {
+        printf("cache: %s\n", what);
+        failures++;
+    };
+
+    // room for a and b, but not for c as well
+    const phrase_case &a = cases[0], &b = cases[1], &c = cases[2];
+    SamCache cache(a.samples + b.samples + c.samples / 2);
+
+    say(cache, a);
+    say(cache, b);
+    if (cache.phrase_count() != 2 || cache.byte_count() != (size_t)(a.samples + b.samples))
+        fail("first two phrases not kept");
+
+    unsigned long hits = cache.hit_count();
+    if (!matches(a, say(cache, a)) || cache.hit_count() != hits + 1)
+        fail("repeated phrase not played from the cache");
+
+    // a is used more recently than b, so b goes to make room for c
+    say(cache, c);
+    if (cache.phrase_count() != 2 || cache.byte_count() != (size_t)(a.samples + c.samples))
+        fail("wrong phrases dropped");
+    hits = cache.hit_count();
+    if (!matches(a, say(cache, a)) || cache.hit_count() != hits + 1)
+        fail("recently used phrase dropped");
+    if (!matches(b, say(cache, b)) || cache.hit_count() != hits + 1)
+        fail("least recently used phrase kept");
+
+    // same text in lower case is the same phrase, in another voice it is not
+    phrase_case lower = b;
+    lower.text = "tuw7";
+    hits = cache.hit_count();
+    if (!matches(b, say(cache, lower)) || cache.hit_count() != hits + 1)
+        fail("lower case phrase not found");
+    phrase_case other = b;
+    other.voice.pitch = 65;
+    if (matches(b, say(cache, other)) || cache.hit_count() != hits + 1)
+        fail("phrase found in another voice");
+
+    cache.clear();
+    if (cache.phrase_count() != 0 || cache.byte_count() != 0)
+        fail("clear() left phrases");
+    return failures;
+}
+
+// Microseconds until the first sample can be played, mean over rounds
+static void bench(const phrase_case &c, int rounds)
+{
+    double whole = 0, stream = 0, cached = 0;
+    SamCache cache;
+    for (int r = 0; r < rounds; r++)
+    {
+        auto t0 = Clock::now();
+        sam_main(c);
+        whole += us_since(t0);
+        FreeBuffer();
+
+        cache.clear();
+        for (double *total : {&stream, &cached})
+        {
+            double first = -1;
+            t0 = Clock::now();
+            cache.say(sam_text(c).c_str(), c.phonetic, c.voice, [&](const uint8_t *, size_t) {
+                if (first < 0)
+                    first = us_since(t0);
+            });
+            *total += first;
+        }
+    }
+    printf("%-8d %12.1f %12.1f %12.1f   \"%.24s\"\n", c.samples, whole / rounds, stream / rounds, cached / rounds, c.text);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 20;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--rounds N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failures = check_render();
+    failures += check_threads(4);
+    failures += check_cache();
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    printf("%-8s %12s %12s %12s\n", "samples", "SAMMain us", "stream us", "cached us");
+    bench(cases[9], rounds);
+    bench(cases[11], rounds);
+    return 0;
+}
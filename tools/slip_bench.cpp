@@ -0,0 +1,457 @@
+/**
+ * SLIP framing fuzz check and benchmark
+ *
+ * Fuzz: random frames, weighted towards SLIP_END and SLIP_ESC bytes, are
+ * encoded with SLIP::encode() and SLIP::encode_segments() and compared with
+ * the push_back encoder they replaced (kept below as reference). The frames
+ * are then sent through SLIP::Decoder as one stream cut into reads of random
+ * size, and must all come back in order. Random noise and damaged frames must
+ * not crash the decoder, and a frame after a damaged one must still arrive.
+ *
+ * Sockets (not on Windows): threads send frames on one TCPConnection over
+ * loopback with a small send buffer, while a signal keeps interrupting the
+ * sends. The receiver must decode every frame whole and in order per thread.
+ *
+ * Benchmark: encodes and decodes a stream of 512-byte blocks with the old
+ * vector code and with the new buffer code, and prints MB/s.
+ *
+ * Build with "cmake --build build --target slip_bench" and run:
+ *
+ *   slip_bench [--rounds N] [--mb N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "SLIP.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "Listener.h"
+#include "TCPConnection.h"
+
+// Only the read channel reports to the listener, the check doesn't start one
+Listener &GetCommandListener(void)
+{
+	abort();
+}
+
+void Listener::connection_closed(Connection *connection)
+{
+}
+#endif
+
+// Reference: SLIP::encode() as it was
+static std::vector<uint8_t> ref_encode(const std::vector<uint8_t> &data)
+{
+	std::vector<uint8_t> encoded_data;
+	encoded_data.push_back(SLIP_END);
+	for (uint8_t byte : data)
+	{
+		if (byte == SLIP_END || byte == SLIP_ESC)
+		{
+			encoded_data.push_back(SLIP_ESC);
+			encoded_data.push_back(byte == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC);
+		}
+		else
+		{
+			encoded_data.push_back(byte);
+		}
+	}
+	encoded_data.push_back(SLIP_END);
+	return encoded_data;
+}
+
+// Reference: SLIP::decode() as it was, one frame
+static std::vector<uint8_t> ref_decode(const std::vector<uint8_t> &data)
+{
+	std::vector<uint8_t> decoded_data;
+	size_t i = 1;
+	while (i < data.size() && data[i] != SLIP_END)
+	{
+		if (data[i] == SLIP_ESC)
+		{
+			i++;
+			if (data[i] == SLIP_ESC_END)
+				decoded_data.push_back(SLIP_END);
+			else if (data[i] == SLIP_ESC_ESC)
+				decoded_data.push_back(SLIP_ESC);
+			else
+				return std::vector<uint8_t>();
+		}
+		else
+		{
+			decoded_data.push_back(data[i]);
+		}
+		i++;
+	}
+	return decoded_data;
+}
+
+// Reference: SLIP::split_into_packets() as it was
+static std::vector<std::vector<uint8_t>> ref_split_into_packets(const uint8_t *data, size_t bytes_read)
+{
+	std::vector<std::vector<uint8_t>> decoded_packets;
+	bool parsing = false;
+	const uint8_t *packet_start = nullptr;
+	for (size_t i = 0; i < bytes_read; i++)
+	{
+		if (data[i] != SLIP_END)
+			continue;
+		if (!parsing)
+		{
+			parsing = true;
+			packet_start = data + i;
+		}
+		else
+		{
+			std::vector<uint8_t> slip_packet_data(packet_start, data + i + 1);
+			decoded_packets.push_back(ref_decode(slip_packet_data));
+			parsing = false;
+		}
+	}
+	return decoded_packets;
+}
+
+static std::vector<uint8_t> random_frame(std::mt19937 &rng, size_t max_size)
+{
+	std::vector<uint8_t> frame(1 + rng() % max_size);
+	int special = rng() % 4; // 0: none, 1: few, 2: many, 3: only specials
+	for (auto &b : frame)
+	{
+		b = (uint8_t)rng();
+		if (special == 3 || (special == 1 && rng() % 64 == 0) || (special == 2 && rng() % 3 == 0))
+			b = rng() & 1 ? SLIP_END : SLIP_ESC;
+		else if (b == SLIP_END || b == SLIP_ESC)
+			b = special == 0 ? 0 : b;
+	}
+	return frame;
+}
+
+static int check_encode(std::mt19937 &rng, int rounds)
+{
+	int failures = 0;
+	std::vector<uint8_t> out;
+	SLIP::Segment segments[64];
+	for (int round = 0; round < rounds; round++)
+	{
+		auto frame = random_frame(rng, 2048);
+		auto ref = ref_encode(frame);
+
+		out.assign(SLIP::max_encoded_size(frame.size()), 0);
+		size_t n = SLIP::encode(frame.data(), frame.size(), out.data());
+		if (n != ref.size() || memcmp(out.data(), ref.data(), n) != 0 || SLIP::encode(frame) != ref)
+		{
+			printf("encode mismatch, %zu bytes, round %d\n", frame.size(), round);
+			failures++;
+			continue;
+		}
+
+		size_t count = SLIP::encode_segments(frame.data(), frame.size(), segments, 64);
+		if (count == 0)
+			continue; // too many escapes for 64 segments
+		std::vector<uint8_t> gathered;
+		for (size_t i = 0; i < count; i++)
+			gathered.insert(gathered.end(), segments[i].data, segments[i].data + segments[i].size);
+		if (gathered != ref)
+		{
+			printf("encode_segments mismatch, %zu bytes, round %d\n", frame.size(), round);
+			failures++;
+		}
+	}
+
+	// segments must report 0 rather than overflow
+	std::vector<uint8_t> escapes(100, SLIP_ESC);
+	if (SLIP::encode_segments(escapes.data(), escapes.size(), segments, 64) != 0)
+	{
+		printf("encode_segments overflowed\n");
+		failures++;
+	}
+	return failures;
+}
+
+static int check_decode(std::mt19937 &rng, int rounds)
+{
+	int failures = 0;
+	for (int round = 0; round < rounds; round++)
+	{
+		// stream of frames, sometimes with noise in front and bad frames between
+		std::vector<std::vector<uint8_t>> frames;
+		std::vector<uint8_t> stream;
+		if (round % 2)
+			stream = {0x01, SLIP_ESC, 0x02};
+		int count = 1 + rng() % 16;
+		for (int i = 0; i < count; i++)
+		{
+			if (rng() % 8 == 0)
+			{
+				// bad escape, must be dropped without taking the next frame with it
+				static const uint8_t bad[] = {SLIP_END, 0x10, SLIP_ESC, 0x11, 0x12, SLIP_END};
+				stream.insert(stream.end(), bad, bad + sizeof(bad));
+			}
+			frames.push_back(random_frame(rng, 1500));
+			auto encoded = ref_encode(frames.back());
+			stream.insert(stream.end(), encoded.begin(), encoded.end());
+		}
+
+		std::vector<std::vector<uint8_t>> decoded;
+		SLIP::Decoder decoder;
+		size_t pos = 0;
+		while (pos < stream.size())
+		{
+			size_t read = std::min<size_t>(stream.size() - pos, 1 + rng() % 300);
+			decoder.feed(stream.data() + pos, read, [&](const uint8_t *frame, size_t size) {
+				decoded.emplace_back(frame, frame + size);
+			});
+			pos += read;
+		}
+		if (decoded != frames)
+		{
+			printf("decode mismatch, %d frames, got %zu, round %d\n", count, decoded.size(), round);
+			failures++;
+		}
+	}
+
+	// noise: anything goes except crashing or an oversized frame
+	SLIP::Decoder decoder(256);
+	std::vector<uint8_t> noise(4096);
+	for (int round = 0; round < rounds; round++)
+	{
+		for (auto &b : noise)
+			b = rng() % 4 == 0 ? (rng() & 1 ? SLIP_END : SLIP_ESC) : (uint8_t)rng();
+		decoder.feed(noise.data(), 1 + rng() % noise.size(), [&](const uint8_t *frame, size_t size) {
+			if (size == 0 || size > 256)
+			{
+				printf("noise gave a %zu byte frame\n", size);
+				failures++;
+			}
+		});
+	}
+	return failures;
+}
+
+#ifndef _WIN32
+static void on_signal(int)
+{
+}
+
+static int check_tcp_send(std::mt19937 &rng, int frames_per_thread)
+{
+	const int threads = 4;
+	int failures = 0;
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	int sender = socket(AF_INET, SOCK_STREAM, 0);
+	int small = 4096;
+	setsockopt(sender, SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+	// no delayed ACK stalls with the small buffers
+	int one = 1;
+	setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+		getsockname(listener, (sockaddr *)&addr, &len) != 0 || connect(sender, (sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		printf("tcp: can't connect on loopback\n");
+		return 1;
+	}
+	int receiver = accept(listener, nullptr, nullptr);
+	close(listener);
+
+	// interrupted sends return short or fail with EINTR
+	struct sigaction sa = {};
+	sa.sa_handler = on_signal;
+	sigaction(SIGUSR1, &sa, nullptr);
+
+	// frame = thread, sequence number (2 bytes), random data
+	std::vector<std::vector<std::vector<uint8_t>>> frames(threads);
+	for (auto &list : frames)
+		for (int i = 0; i < frames_per_thread; i++)
+			list.push_back(random_frame(rng, 3000));
+	for (int t = 0; t < threads; t++)
+		for (int i = 0; i < frames_per_thread; i++)
+		{
+			auto &f = frames[t][i];
+			f.resize(std::max<size_t>(f.size(), 3));
+			f[0] = (uint8_t)t;
+			f[1] = (uint8_t)(i >> 8);
+			f[2] = (uint8_t)i;
+		}
+
+	auto connection = std::make_shared<TCPConnection>(sender);
+	std::vector<std::thread> senders;
+	std::vector<pthread_t> handles;
+	std::atomic<int> running{threads};
+	for (int t = 0; t < threads; t++)
+	{
+		senders.emplace_back([&, t] {
+			for (auto &f : frames[t])
+				connection->send_data(f);
+			running--;
+		});
+		handles.push_back(senders.back().native_handle());
+	}
+	std::thread interrupter([&] {
+		while (running > 0)
+		{
+			for (pthread_t h : handles)
+				pthread_kill(h, SIGUSR1);
+			usleep(200);
+		}
+		// a frame cut short would leave the receiver waiting for the rest
+		shutdown(sender, SHUT_WR);
+	});
+
+	std::vector<int> next(threads, 0);
+	int received = 0, bad = 0;
+	SLIP::Decoder decoder;
+	std::vector<uint8_t> buf(4096);
+	while (received + bad < threads * frames_per_thread)
+	{
+		ssize_t n = recv(receiver, buf.data(), 1 + rng() % buf.size(), 0);
+		if (n <= 0)
+			break;
+		decoder.feed(buf.data(), n, [&](const uint8_t *frame, size_t size) {
+			int t = size >= 3 ? frame[0] : threads;
+			if (t < threads && next[t] < frames_per_thread && frames[t][next[t]] == std::vector<uint8_t>(frame, frame + size))
+			{
+				next[t]++;
+				received++;
+			}
+			else
+				bad++;
+		});
+	}
+
+	interrupter.join();
+	for (auto &th : senders)
+		th.join();
+	close(receiver);
+	connection->close_connection();
+
+	if (received != threads * frames_per_thread)
+	{
+		printf("tcp: %d of %d frames came through whole and in order, %d damaged\n", received,
+			   threads * frames_per_thread, bad);
+		failures++;
+	}
+	return failures;
+}
+#endif
+
+template <typename F>
+static double mb_per_s(size_t bytes, F f)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	f();
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	return bytes / s / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	int rounds = 20000;
+	int mb = 64;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+			rounds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+			mb = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [--rounds N] [--mb N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::mt19937 rng(6502);
+	int failures = check_encode(rng, rounds);
+	failures += check_decode(rng, rounds / 10);
+#ifndef _WIN32
+	failures += check_tcp_send(rng, rounds / 100);
+#endif
+	printf("check: %s\n", failures ? "FAILED" : "ok");
+	if (failures)
+		return 1;
+
+	// 512-byte blocks of random data, about 1 in 128 bytes needs escaping
+	std::vector<uint8_t> block(512);
+	for (auto &b : block)
+		b = (uint8_t)rng();
+	const size_t blocks = (size_t)mb * 1000000 / block.size();
+	const size_t bytes = blocks * block.size();
+	volatile size_t sink = 0;
+
+	double ref_enc = mb_per_s(bytes, [&] {
+		for (size_t i = 0; i < blocks; i++)
+		{
+			block[0] = (uint8_t)i;
+			sink = sink + ref_encode(block).size();
+		}
+	});
+	std::vector<uint8_t> out(SLIP::max_encoded_size(block.size()));
+	double enc = mb_per_s(bytes, [&] {
+		for (size_t i = 0; i < blocks; i++)
+		{
+			block[0] = (uint8_t)i;
+			sink = sink + SLIP::encode(block.data(), block.size(), out.data());
+		}
+	});
+	SLIP::Segment segments[16];
+	double seg = mb_per_s(bytes, [&] {
+		for (size_t i = 0; i < blocks; i++)
+		{
+			block[0] = (uint8_t)i;
+			sink = sink + SLIP::encode_segments(block.data(), block.size(), segments, 16);
+		}
+	});
+
+	// decode from 4 KB reads of a stream of encoded blocks
+	std::vector<uint8_t> stream;
+	for (size_t i = 0; i < 64; i++)
+	{
+		block[0] = (uint8_t)i;
+		auto encoded = ref_encode(block);
+		stream.insert(stream.end(), encoded.begin(), encoded.end());
+	}
+	const size_t passes = blocks / 64;
+	double ref_dec = mb_per_s(passes * 64 * block.size(), [&] {
+		for (size_t pass = 0; pass < passes; pass++)
+			for (size_t pos = 0; pos < stream.size(); pos += 4096)
+				for (auto &packet : ref_split_into_packets(stream.data() + pos, std::min<size_t>(4096, stream.size() - pos)))
+					sink = sink + packet.size();
+	});
+	SLIP::Decoder decoder;
+	double dec = mb_per_s(passes * 64 * block.size(), [&] {
+		for (size_t pass = 0; pass < passes; pass++)
+			for (size_t pos = 0; pos < stream.size(); pos += 4096)
+				decoder.feed(stream.data() + pos, std::min<size_t>(4096, stream.size() - pos), [&](const uint8_t *frame, size_t size) { sink = sink + size + frame[1]; });
+	});
+
+	printf("%-16s %12s %12s %8s\n", "512 B blocks", "vector MB/s", "buffer MB/s", "speedup");
+	printf("%-16s %12.1f %12.1f %7.1fx\n", "encode", ref_enc, enc, enc / ref_enc);
+	printf("%-16s %12.1f %12.1f %7.1fx\n", "encode_segments", ref_enc, seg, seg / ref_enc);
+	printf("%-16s %12.1f %12.1f %7.1fx\n", "decode", ref_dec, dec, dec / ref_dec);
+	return 0;
+}
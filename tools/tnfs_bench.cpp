@@ -0,0 +1,742 @@
+/**
+ * TNFS client check and benchmark against a loopback server
+ *
+ * Runs a small TNFS server over UDP on 127.0.0.1 in a thread, serving files
+ * from memory and holding every reply back for a simulated round trip time,
+ * and talks to it with the TNFS client library the way FujiNet does.
+ *
+ * Check: files read with the pipelined cache fill match what the server
+ * holds. A server that answers every pipelined read out of order gets the
+ * mount dropped to stop-and-wait after TNFS_READ_WINDOW_MAX_FAILURES
+ * windows, one that does so only now and then keeps its read window.
+ * Written data reads back before it reaches the server, also across a gap
+ * left by writing past the end of the file, and survives the server losing
+ * the file handle.
+ *
+ * Directory listings are read from the server once and then kept: opening
+ * the directory again takes no requests until the listing expires or is
+ * dropped by a change made through the same mount, and then shows the
+ * change, also one that left the directory's modification time alone.
+ *
+ * Benchmark: sequential read throughput with stop-and-wait and with
+ * pipelined cache fills, at a few round trip times. Requests and time for
+ * listing a directory again with and without kept listings.
+ *
+ * Build with "cmake --build build --target tnfs_bench" and run:
+ *
+ *   tnfs_bench [--size KB]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tnfslib.h"
+#include "fnFileTNFS.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+/**
+ * TNFS server holding its files in memory
+ */
+class TestServer
+{
+public:
+    struct entry
+    {
+        bool dir = false;
+        std::vector<uint8_t> data;
+        uint32_t m_time = 1;
+    };
+
+    TestServer()
+    {
+        _fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(_fd, (sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, (sockaddr *)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        _files["/"].dir = true;
+        _thread = std::thread(&TestServer::run, this);
+    }
+
+    ~TestServer()
+    {
+        _stop = true;
+        _thread.join();
+        close(_fd);
+    }
+
+    uint16_t port() { return _port; }
+
+    // Latency added to every reply
+    void set_rtt_ms(int ms) { _rtt_ms = ms; }
+
+    // Swap the replies to two pipelined READs in each of the next count windows
+    void misorder_reads(int count) { _misorder = count; }
+
+    void put(const std::string &path, const std::vector<uint8_t> &data, uint32_t m_time = 1)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        entry &e = _files[path];
+        e.data = data;
+        e.m_time = m_time;
+    }
+
+    std::vector<uint8_t> get(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _files[path].data;
+    }
+
+    // Forget all open files, as a restarted server would
+    void forget_handles()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _open.clear();
+        _next_handle = 1;
+    }
+
+    unsigned long requests(uint8_t command)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _requests[command];
+    }
+
+private:
+    struct reply
+    {
+        BenchClock::time_point due;
+        sockaddr_in to;
+        std::vector<uint8_t> data;
+        uint8_t command;
+    };
+
+    struct open_file
+    {
+        std::string path;
+        uint32_t pos = 0;
+    };
+
+    struct open_dir
+    {
+        std::vector<std::pair<std::string, entry>> entries;
+        uint16_t pos = 0;
+    };
+
+    int _fd;
+    uint16_t _port;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+    std::atomic<int> _rtt_ms{0};
+    std::atomic<int> _misorder{0};
+
+    std::mutex _mutex; // guards the below
+    std::map<std::string, entry> _files;
+    std::map<uint8_t, open_file> _open;
+    std::map<uint8_t, open_dir> _dirs;
+    std::map<uint8_t, unsigned long> _requests;
+    uint8_t _next_handle = 1;
+
+    std::deque<reply> _replies;
+
+    static void put16(std::vector<uint8_t> &out, uint32_t v)
+    {
+        out.push_back(v & 0xFF);
+        out.push_back(v >> 8 & 0xFF);
+    }
+
+    static void put32(std::vector<uint8_t> &out, uint32_t v)
+    {
+        put16(out, v & 0xFFFF);
+        put16(out, v >> 16);
+    }
+
+    void run()
+    {
+        while (!_stop)
+        {
+            int timeout = 1;
+            if (!_replies.empty())
+            {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(_replies.front().due - BenchClock::now()).count();
+                timeout = std::max<int>(0, std::min<int>(1, wait));
+            }
+            pollfd pfd = {_fd, POLLIN, 0};
+            if (poll(&pfd, 1, timeout) > 0)
+            {
+                uint8_t buf[TNFS_HEADER_SIZE + TNFS_PAYLOAD_SIZE];
+                sockaddr_in from;
+                socklen_t fromlen = sizeof(from);
+                ssize_t len = recvfrom(_fd, buf, sizeof(buf), 0, (sockaddr *)&from, &fromlen);
+                if (len >= TNFS_HEADER_SIZE)
+                {
+                    reply r;
+                    r.due = BenchClock::now() + std::chrono::milliseconds(_rtt_ms);
+                    r.to = from;
+                    r.command = buf[3];
+                    r.data.assign(buf, buf + TNFS_HEADER_SIZE);
+                    handle(buf + TNFS_HEADER_SIZE, len - TNFS_HEADER_SIZE, r.data);
+                    queue(std::move(r));
+                }
+            }
+            while (!_replies.empty() && _replies.front().due <= BenchClock::now())
+            {
+                reply &r = _replies.front();
+                sendto(_fd, r.data.data(), r.data.size(), 0, (sockaddr *)&r.to, sizeof(r.to));
+                _replies.pop_front();
+            }
+        }
+    }
+
+    void queue(reply &&r)
+    {
+        if (r.command == TNFS_CMD_READ && _misorder > 0)
+        {
+            // a READ reply overtakes the one before it
+            if (!_replies.empty() && _replies.back().command == TNFS_CMD_READ &&
+                (uint8_t)(_replies.back().data[2] + 1) == r.data[2])
+            {
+                _misorder--;
+                r.due = _replies.back().due;
+                _replies.insert(_replies.end() - 1, std::move(r));
+                return;
+            }
+            // give the next READ of a window time to arrive
+            r.due = std::max(r.due, BenchClock::now() + std::chrono::milliseconds(5));
+        }
+        _replies.push_back(std::move(r));
+    }
+
+    void handle(const uint8_t *req, size_t len, std::vector<uint8_t> &out)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint8_t command = out[3];
+        _requests[command]++;
+
+        switch (command)
+        {
+        case TNFS_CMD_MOUNT:
+            out[0] = 0x34;
+            out[1] = 0x12;
+            out.push_back(TNFS_RESULT_SUCCESS);
+            put16(out, 0x0102);
+            put16(out, 100);
+            break;
+
+        case TNFS_CMD_UNMOUNT:
+            out.push_back(TNFS_RESULT_SUCCESS);
+            break;
+
+        case TNFS_CMD_STAT:
+        {
+            auto f = _files.find(std::string((const char *)req, strnlen((const char *)req, len)));
+            if (f == _files.end())
+            {
+                out.push_back(TNFS_RESULT_FILE_NOT_FOUND);
+                break;
+            }
+            out.push_back(TNFS_RESULT_SUCCESS);
+            put16(out, f->second.dir ? S_IFDIR | 0755 : S_IFREG | 0644);
+            put16(out, 0);
+            put16(out, 0);
+            put32(out, f->second.data.size());
+            put32(out, f->second.m_time);
+            put32(out, f->second.m_time);
+            put32(out, f->second.m_time);
+            break;
+        }
+
+        case TNFS_CMD_OPEN:
+        {
+            uint16_t mode = req[0] | req[1] << 8;
+            std::string path((const char *)req + 4, strnlen((const char *)req + 4, len - 4));
+            auto f = _files.find(path);
+            if (f == _files.end())
+            {
+                if (!(mode & TNFS_OPENMODE_WRITE_CREATE))
+                {
+                    out.push_back(TNFS_RESULT_FILE_NOT_FOUND);
+                    break;
+                }
+                f = _files.emplace(path, entry()).first;
+            }
+            if (mode & TNFS_OPENMODE_WRITE_TRUNCATE)
+                f->second.data.clear();
+            uint8_t handle = _next_handle++;
+            _open[handle].path = path;
+            out.push_back(TNFS_RESULT_SUCCESS);
+            out.push_back(handle);
+            break;
+        }
+
+        case TNFS_CMD_CLOSE:
+            out.push_back(_open.erase(req[0]) ? TNFS_RESULT_SUCCESS : TNFS_RESULT_BAD_FILENUM);
+            break;
+
+        case TNFS_CMD_READ:
+        {
+            auto o = _open.find(req[0]);
+            if (o == _open.end())
+            {
+                out.push_back(TNFS_RESULT_BAD_FILENUM);
+                break;
+            }
+            const std::vector<uint8_t> &data = _files[o->second.path].data;
+            uint16_t want = req[1] | req[2] << 8;
+            if (o->second.pos >= data.size())
+            {
+                out.push_back(TNFS_RESULT_END_OF_FILE);
+                break;
+            }
+            uint16_t n = std::min<size_t>(want, data.size() - o->second.pos);
+            out.push_back(TNFS_RESULT_SUCCESS);
+            put16(out, n);
+            out.insert(out.end(), data.begin() + o->second.pos, data.begin() + o->second.pos + n);
+            o->second.pos += n;
+            break;
+        }
+
+        case TNFS_CMD_WRITE:
+        {
+            auto o = _open.find(req[0]);
+            if (o == _open.end())
+            {
+                out.push_back(TNFS_RESULT_BAD_FILENUM);
+                break;
+            }
+            std::vector<uint8_t> &data = _files[o->second.path].data;
+            uint16_t n = req[1] | req[2] << 8;
+            if (data.size() < o->second.pos + n)
+                data.resize(o->second.pos + n);
+            memcpy(data.data() + o->second.pos, req + 3, n);
+            o->second.pos += n;
+            out.push_back(TNFS_RESULT_SUCCESS);
+            put16(out, n);
+            break;
+        }
+
+        case TNFS_CMD_LSEEK:
+        {
+            auto o = _open.find(req[0]);
+            if (o == _open.end() || req[1] != SEEK_SET)
+            {
+                out.push_back(o == _open.end() ? TNFS_RESULT_BAD_FILENUM : TNFS_RESULT_INVALID_ARGUMENT);
+                break;
+            }
+            o->second.pos = req[2] | req[3] << 8 | req[4] << 16 | (uint32_t)req[5] << 24;
+            out.push_back(TNFS_RESULT_SUCCESS);
+            put32(out, o->second.pos);
+            break;
+        }
+
+        case TNFS_CMD_OPENDIRX:
+        {
+            // pattern and options are ignored, entries come in name order
+            const char *pattern = (const char *)req + 4;
+            const char *path = pattern + strlen(pattern) + 1;
+            std::string prefix = path;
+            if (prefix.back() != '/')
+                prefix += '/';
+            uint8_t handle = _next_handle++;
+            open_dir &d = _dirs[handle];
+            for (auto &f : _files)
+                if (f.first.size() > prefix.size() && f.first.compare(0, prefix.size(), prefix) == 0 &&
+                    f.first.find('/', prefix.size()) == std::string::npos)
+                    d.entries.emplace_back(f.first.substr(prefix.size()), f.second);
+            out.push_back(TNFS_RESULT_SUCCESS);
+            out.push_back(handle);
+            put16(out, d.entries.size());
+            break;
+        }
+
+        case TNFS_CMD_READDIRX:
+        {
+            auto d = _dirs.find(req[0]);
+            if (d == _dirs.end())
+            {
+                out.push_back(TNFS_RESULT_BAD_FILENUM);
+                break;
+            }
+            open_dir &dir = d->second;
+            if (dir.pos >= dir.entries.size())
+            {
+                out.push_back(TNFS_RESULT_END_OF_FILE);
+                break;
+            }
+            out.push_back(TNFS_RESULT_SUCCESS);
+            size_t count_at = out.size();
+            out.push_back(0);
+            out.push_back(0);
+            put16(out, dir.pos);
+            uint8_t count = 0;
+            while (count < req[1] && dir.pos < dir.entries.size() &&
+                   out.size() + 14 + dir.entries[dir.pos].first.size() <= TNFS_HEADER_SIZE + TNFS_PAYLOAD_SIZE)
+            {
+                const auto &e = dir.entries[dir.pos++];
+                out.push_back(e.second.dir ? TNFS_READDIRX_DIR : 0);
+                put32(out, e.second.data.size());
+                put32(out, e.second.m_time);
+                put32(out, e.second.m_time);
+                out.insert(out.end(), e.first.begin(), e.first.end());
+                out.push_back(0);
+                count++;
+            }
+            out[count_at] = count;
+            out[count_at + 1] = dir.pos >= dir.entries.size() ? TNFS_READDIRX_STATUS_EOF : 0;
+            break;
+        }
+
+        case TNFS_CMD_CLOSEDIR:
+            out.push_back(_dirs.erase(req[0]) ? TNFS_RESULT_SUCCESS : TNFS_RESULT_BAD_FILENUM);
+            break;
+
+        default:
+            out.push_back(TNFS_RESULT_FUNCTION_UNIMPLEMENTED);
+            break;
+        }
+    }
+};
+
+static std::vector<uint8_t> test_data(size_t size, unsigned seed)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+    return data;
+}
+
+static bool mount(tnfsMountInfo &mi, TestServer &server)
+{
+    mi.host_ip = inet_addr("127.0.0.1");
+    mi.port = server.port();
+    mi.protocol = TNFS_PROTOCOL_UDP;
+    mi.timeout_ms = 200;
+    return tnfs_mount(&mi) == TNFS_RESULT_SUCCESS;
+}
+
+// Reads a whole file in pieces of chunk bytes, the way a disk image is read
+static std::vector<uint8_t> read_file(tnfsMountInfo &mi, const char *path, uint16_t chunk)
+{
+    std::vector<uint8_t> data;
+    int16_t handle;
+    if (tnfs_open(&mi, path, TNFS_OPENMODE_READ, 0, &handle) != TNFS_RESULT_SUCCESS)
+        return data;
+    std::vector<uint8_t> buf(chunk);
+    uint16_t got;
+    int result;
+    do
+    {
+        result = tnfs_read(&mi, handle, buf.data(), chunk, &got);
+        data.insert(data.end(), buf.begin(), buf.begin() + got);
+    } while (result == TNFS_RESULT_SUCCESS && got > 0);
+    tnfs_close(&mi, handle);
+    return data;
+}
+
+static int check_reads(TestServer &server, size_t size)
+{
+    int failures = 0;
+    auto fail = [&](const char *what) {
+        printf("read: %s\n", what);
+        failures++;
+    };
+
+    std::vector<uint8_t> data = test_data(size, 1);
+    server.put("/image.atr", data);
+    server.put("/odd.bin", test_data(TNFS_FILE_CACHE_BLOCK_SIZE * 5 + 77, 2));
+
+    tnfsMountInfo mi;
+    if (!mount(mi, server))
+    {
+        fail("mount failed");
+        return failures;
+    }
+
+    if (read_file(mi, "/image.atr", 128) != data)
+        fail("pipelined read differs");
+    if (read_file(mi, "/odd.bin", 300) != server.get("/odd.bin"))
+        fail("file ending inside a block differs");
+
+    // every pipelined read misordered: falls back to stop-and-wait but still reads right
+    server.misorder_reads(1000);
+    if (read_file(mi, "/image.atr", 128) != data)
+        fail("read from misordering server differs");
+    if (mi.read_window != 1)
+        fail("misordering server kept the read window");
+    server.misorder_reads(0);
+    tnfs_umount(&mi);
+
+    // a misordered window now and then is forgiven
+    tnfsMountInfo mi2;
+    mount(mi2, server);
+    for (int round = 0; round < TNFS_READ_WINDOW_MAX_FAILURES * 2; round++)
+    {
+        server.misorder_reads(1);
+        if (read_file(mi2, "/image.atr", 256) != data)
+            fail("read with one misordered window differs");
+    }
+    if (mi2.read_window != TNFS_READ_WINDOW)
+        fail("occasional misordering dropped the read window");
+    tnfs_umount(&mi2);
+    return failures;
+}
+
+static int check_writes(TestServer &server)
+{
+    int failures = 0;
+    auto fail = [&](const char *what) {
+        printf("write: %s\n", what);
+        failures++;
+    };
+
+    tnfsMountInfo mi;
+    if (!mount(mi, server))
+    {
+        fail("mount failed");
+        return failures;
+    }
+
+    // writing past the end leaves a zero-filled gap, also in the block read up to the old end
+    std::vector<uint8_t> expect = test_data(700, 4);
+    server.put("/grow.bin", expect);
+    int16_t handle;
+    tnfs_open(&mi, "/grow.bin", TNFS_OPENMODE_READWRITE, 0, &handle);
+    std::vector<uint8_t> buf(TNFS_MAX_READWRITE_PAYLOAD);
+    uint16_t got;
+    while (tnfs_read(&mi, handle, buf.data(), 128, &got) == TNFS_RESULT_SUCCESS)
+        ;
+    std::vector<uint8_t> tail = test_data(100, 5);
+    tnfs_lseek(&mi, handle, 2000, SEEK_SET);
+    tnfs_write(&mi, handle, tail.data(), tail.size(), &got);
+    expect.resize(2000);
+    expect.insert(expect.end(), tail.begin(), tail.end());
+
+    std::vector<uint8_t> back;
+    tnfs_lseek(&mi, handle, 0, SEEK_SET);
+    int result;
+    do
+    {
+        result = tnfs_read(&mi, handle, buf.data(), 300, &got);
+        back.insert(back.end(), buf.begin(), buf.begin() + got);
+    } while (result == TNFS_RESULT_SUCCESS);
+    if (back != expect)
+        fail("file grown by a write past the end reads back wrong");
+    tnfs_close(&mi, handle);
+    if (server.get("/grow.bin") != expect)
+        fail("file grown by a write past the end differs on the server");
+
+    // the server forgets the handle while written data is still cached
+    expect = test_data(TNFS_FILE_CACHE_BLOCK_SIZE * 20, 6);
+    server.put("/disk.img", expect);
+    tnfs_open(&mi, "/disk.img", TNFS_OPENMODE_READWRITE, 0, &handle);
+    FileHandlerTNFS *fh = new FileHandlerTNFS(&mi, handle);
+    std::vector<uint8_t> sectors = test_data(TNFS_FILE_CACHE_BLOCK_SIZE * 2, 7);
+    fh->seek(1000, SEEK_SET);
+    if (fh->write(sectors.data(), 1, sectors.size()) != sectors.size())
+        fail("write to the cache failed");
+    memcpy(expect.data() + 1000, sectors.data(), sectors.size());
+
+    server.forget_handles();
+    fh->seek(TNFS_FILE_CACHE_BLOCK_SIZE * 10, SEEK_SET);
+    if (fh->read(buf.data(), 1, 256) != 256 ||
+        memcmp(buf.data(), expect.data() + TNFS_FILE_CACHE_BLOCK_SIZE * 10, 256) != 0)
+        fail("read after the server lost the handle failed");
+    if (server.get("/disk.img") != expect)
+        fail("written data lost when the handle was reopened");
+    fh->close();
+    tnfs_umount(&mi);
+    return failures;
+}
+
+// Name and size of every entry
+static std::map<std::string, uint32_t> list_dir(tnfsMountInfo &mi, const char *path)
+{
+    std::map<std::string, uint32_t> entries;
+    if (tnfs_opendirx(&mi, path) != TNFS_RESULT_SUCCESS)
+        return entries;
+    tnfsStat st;
+    char name[TNFS_MAX_FILELEN];
+    while (tnfs_readdirx(&mi, &st, name, sizeof(name)) == TNFS_RESULT_SUCCESS)
+        entries[name] = st.filesize;
+    tnfs_closedir(&mi);
+    return entries;
+}
+
+static unsigned long dir_requests(TestServer &server)
+{
+    return server.requests(TNFS_CMD_OPENDIRX) + server.requests(TNFS_CMD_READDIRX) +
+           server.requests(TNFS_CMD_CLOSEDIR) + server.requests(TNFS_CMD_STAT);
+}
+
+static void make_dir(TestServer &server, const char *path, int files)
+{
+    for (int i = 0; i < files; i++)
+    {
+        char name[TNFS_MAX_FILELEN];
+        snprintf(name, sizeof(name), "%s/GAME%04d.ATR", path, i);
+        server.put(name, std::vector<uint8_t>(100 + i));
+    }
+}
+
+static int check_dirs(TestServer &server)
+{
+    int failures = 0;
+    auto fail = [&](const char *what) {
+        printf("dir: %s\n", what);
+        failures++;
+    };
+
+    make_dir(server, "/games", 300);
+    tnfsMountInfo mi;
+    if (!mount(mi, server))
+    {
+        fail("mount failed");
+        return failures;
+    }
+
+    unsigned long stats = server.requests(TNFS_CMD_STAT);
+    std::map<std::string, uint32_t> first = list_dir(mi, "/games");
+    if (first.size() != 300 || first["GAME0007.ATR"] != 107)
+        fail("listing differs from the server");
+    if (server.requests(TNFS_CMD_STAT) != stats)
+        fail("listing a directory took a STAT");
+
+    unsigned long before = dir_requests(server);
+    if (list_dir(mi, "/games") != first || dir_requests(server) != before)
+        fail("kept listing not used");
+
+    // a file changing size leaves the directory alone, the kept listing expires
+    server.put("/games/GAME0007.ATR", std::vector<uint8_t>(5000));
+    mi.find_dirlisting("/games", nullptr, 0, 0, 0)->fetched_ms -= TNFS_DIRLISTING_TTL_MS;
+    if (list_dir(mi, "/games")["GAME0007.ATR"] != 5000)
+        fail("expired listing still used");
+
+    // a file written through this mount drops the kept listing
+    int16_t handle;
+    uint16_t got;
+    tnfs_open(&mi, "/games/NEW.ATR", TNFS_OPENMODE_WRITE | TNFS_OPENMODE_WRITE_CREATE, 0644, &handle);
+    tnfs_write(&mi, handle, (uint8_t *)"data", 4, &got);
+    tnfs_close(&mi, handle);
+    if (list_dir(mi, "/games")["NEW.ATR"] != 4)
+        fail("listing not dropped after writing a file");
+
+    tnfs_umount(&mi);
+    return failures;
+}
+
+static void bench_dirs(TestServer &server, int rtt_ms, int rounds)
+{
+    server.set_rtt_ms(rtt_ms);
+    make_dir(server, "/bench", 300);
+
+    double ms[2];
+    unsigned long requests[2];
+    for (int kept = 0; kept < 2; kept++)
+    {
+        tnfsMountInfo mi;
+        mount(mi, server);
+        unsigned long before = dir_requests(server);
+        auto t0 = BenchClock::now();
+        for (int r = 0; r < rounds; r++)
+        {
+            list_dir(mi, "/bench");
+            if (!kept)
+                mi.invalidate_dirlistings();
+        }
+        ms[kept] = ms_since(t0) / rounds;
+        requests[kept] = dir_requests(server) - before;
+        tnfs_umount(&mi);
+    }
+    printf("%-6d %10.1f %10.1f %10lu %10lu\n", rtt_ms, ms[0], ms[1], requests[0], requests[1]);
+}
+
+static void bench(TestServer &server, size_t size, int rtt_ms)
+{
+    server.set_rtt_ms(rtt_ms);
+    server.put("/bench.atr", test_data(size, 3));
+
+    double ms[2];
+    unsigned long reads[2];
+    for (int pipelined = 0; pipelined < 2; pipelined++)
+    {
+        tnfsMountInfo mi;
+        mount(mi, server);
+        mi.read_window = pipelined ? TNFS_READ_WINDOW : 1;
+        unsigned long before = server.requests(TNFS_CMD_READ);
+        auto t0 = BenchClock::now();
+        read_file(mi, "/bench.atr", 128);
+        ms[pipelined] = ms_since(t0);
+        reads[pipelined] = server.requests(TNFS_CMD_READ) - before;
+        tnfs_umount(&mi);
+    }
+    printf("%-6d %10.1f %10.1f %10lu %10lu\n", rtt_ms, size / 1024.0 / (ms[0] / 1000), size / 1024.0 / (ms[1] / 1000),
+           reads[0], reads[1]);
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = 92160; // single density 720 sector image
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            size = atoi(argv[++i]) * 1024;
+        else
+        {
+            fprintf(stderr, "usage: %s [--size KB]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    TestServer server;
+
+    int failures = check_reads(server, size);
+    failures += check_writes(server);
+    failures += check_dirs(server);
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    printf("%-6s %10s %10s %10s %10s\n", "rtt ms", "s&w KB/s", "pipe KB/s", "s&w READs", "pipe READs");
+    for (int rtt : {0, 2, 10})
+        bench(server, size, rtt);
+
+    printf("\n300 entry directory listed 10 times\n");
+    printf("%-6s %10s %10s %10s %10s\n", "rtt ms", "read ms", "kept ms", "read reqs", "kept reqs");
+    for (int rtt : {0, 2, 10})
+        bench_dirs(server, rtt, 10);
+    return 0;
+}
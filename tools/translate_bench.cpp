@@ -0,0 +1,194 @@
+/**
+ * Network line ending translation check and benchmark
+ *
+ * Check: every byte value and the line ending fixtures are translated by
+ * NetworkProtocol in each mode, for receive and transmit, and compared with
+ * the per-character replace passes it replaced (kept as reference in
+ * test/test_networkprotocol_translation_ref.h, shared with the unit tests).
+ * Receive data is also fed in several reads, which must give the same
+ * result.
+ *
+ * Benchmark: translates 64 KB of text with CR/LF line endings in CR/LF mode,
+ * once with the old passes and once with NetworkProtocol, and prints the
+ * microseconds per buffer for receive and transmit.
+ *
+ * Build with "cmake --build build --target translate_bench" and run:
+ *
+ *   translate_bench [--rounds N] [--kb N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Protocol.h"
+#include "string_utils.h"
+#include "utils.h"
+
+#include "test_networkprotocol_translation_ref.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double us_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::micro>(BenchClock::now() - t).count();
+}
+
+// The translation calls are protected, reach them from a subclass
+class BenchProtocol : public NetworkProtocol
+{
+public:
+    using NetworkProtocol::NetworkProtocol;
+    using NetworkProtocol::translate_receive_buffer;
+    using NetworkProtocol::translate_transmit_buffer;
+};
+
+struct protocol_bench
+{
+    NetworkBuffer rx, tx;
+    std::string sp;
+    BenchProtocol protocol{&rx, &tx, &sp};
+
+    explicit protocol_bench(uint8_t mode) { protocol.set_open_params(0x0C, mode); }
+};
+
+static bool same(NetworkBuffer &b, const std::string &s)
+{
+    return b.size() == s.size() && memcmp(b.data(), s.data(), s.size()) == 0;
+}
+
+static std::string check_input()
+{
+    std::string s;
+    for (int i = 0; i < 256; i++)
+        s.push_back((char)i);
+    s += "\x0D\x0A\x0D\x0D\x0A\x0A\x9B\x07\x08\x09\x7E\x7F\xFDline\x0D\x0A";
+    s += "This is a test string.\x0D\x0AThis is a second line.\x9BThis is a third line.\x9B";
+    return s;
+}
+
+static int check()
+{
+    int failures = 0;
+    std::string input = check_input();
+
+    for (uint8_t mode = 0; mode <= 5; mode++)
+    {
+        std::string want_rx = input, want_tx = input;
+        translation_ref_rx(want_rx, mode);
+        translation_ref_tx(want_tx, mode);
+
+        protocol_bench b(mode);
+        b.rx.append(input);
+        b.protocol.translate_receive_buffer();
+        if (!same(b.rx, want_rx))
+        {
+            printf("rx mismatch in mode %u\n", mode);
+            failures++;
+        }
+
+        b.tx.append(input);
+        b.protocol.translate_transmit_buffer();
+        if (!same(b.tx, want_tx))
+        {
+            printf("tx mismatch in mode %u\n", mode);
+            failures++;
+        }
+
+        // a CR/LF pair can be split between reads
+        protocol_bench split(mode);
+        for (size_t pos = 0; pos < input.size(); pos += 7)
+        {
+            split.rx.append(input.substr(pos, 7));
+            split.protocol.translate_receive_buffer();
+        }
+        if (!same(split.rx, want_rx))
+        {
+            printf("split rx mismatch in mode %u\n", mode);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static std::string text(size_t size)
+{
+    static const char *line = "10 PRINT \"HELLO FROM THE FUJINET\";:GOTO 10";
+    std::string s;
+    while (s.size() < size)
+    {
+        s += line;
+        s += "\x0D\x0A";
+    }
+    s.resize(size);
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 200;
+    int kb = 64;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--kb") == 0 && i + 1 < argc)
+            kb = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--rounds N] [--kb N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failures = check();
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    std::string rx_text = text((size_t)kb * 1024);
+    std::string tx_text = rx_text;
+    translation_ref_rx(tx_text, 3); // host side data with EOLs
+
+    double old_rx = 0, old_tx = 0, new_rx = 0, new_tx = 0;
+    protocol_bench b(3);
+    for (int r = 0; r < rounds; r++)
+    {
+        std::string s = rx_text;
+        auto t0 = BenchClock::now();
+        translation_ref_rx(s, 3);
+        old_rx += us_since(t0);
+
+        s = tx_text;
+        t0 = BenchClock::now();
+        translation_ref_tx(s, 3);
+        old_tx += us_since(t0);
+
+        b.rx.clear();
+        b.rx.append(rx_text);
+        t0 = BenchClock::now();
+        b.protocol.translate_receive_buffer();
+        new_rx += us_since(t0);
+
+        b.tx.clear();
+        b.tx.append(tx_text);
+        t0 = BenchClock::now();
+        b.protocol.translate_transmit_buffer();
+        new_tx += us_since(t0);
+    }
+
+    printf("%d KB in CR/LF mode, us per buffer\n", kb);
+    printf("%-4s %10s %10s\n", "", "old", "new");
+    printf("%-4s %10.1f %10.1f\n", "rx", old_rx / rounds, new_rx / rounds);
+    printf("%-4s %10.1f %10.1f\n", "tx", old_tx / rounds, new_tx / rounds);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * UARTManager::poll() latency and idle CPU benchmark
+ *
+ * Runs UARTManager on the slave side of a pty pair, the way the SIO and
+ * DriveWire service loops use it: check for input, then poll(1). A writer
+ * thread sends single bytes into the master side at random intervals, and the
+ * time from write to the loop seeing the byte is measured. The same loop with
+ * the old fixed 500 us sleep in place of poll() is timed as reference, and
+ * both are run idle for a second to compare CPU time.
+ *
+ * Also checks that unread data is reported by poll() only once, and that
+ * wake() from another thread ends a poll() early.
+ *
+ * Build with "cmake --build build --target uart_poll_bench" and run:
+ *
+ *   uart_poll_bench [--bytes N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "fnUART.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double us_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::micro>(BenchClock::now() - t).count();
+}
+
+static double cpu_ms()
+{
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3 + ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+}
+
+// The old poll(): sleep and report nothing
+static bool sleep_poll(UARTManager &, int)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+    return false;
+}
+
+static bool uart_poll(UARTManager &uart, int ms)
+{
+    return uart.poll(ms);
+}
+
+// Service loop: look for input, otherwise poll. Returns latencies in us.
+static std::vector<double> measure(UARTManager &uart, int master, int bytes, bool (*poll)(UARTManager &, int))
+{
+    std::vector<BenchClock::time_point> sent(bytes);
+    std::vector<double> latency;
+    std::thread writer([&] {
+        std::mt19937 rng(1977);
+        for (int i = 0; i < bytes; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(2000 + rng() % 3000));
+            uint8_t b = (uint8_t)i;
+            sent[i] = BenchClock::now();
+            if (write(master, &b, 1) != 1)
+                perror("write");
+        }
+    });
+
+    auto deadline = BenchClock::now() + std::chrono::milliseconds(bytes * 10 + 1000);
+    while ((int)latency.size() < bytes && BenchClock::now() < deadline)
+    {
+        if (uart.available() > 0)
+        {
+            uint8_t b;
+            if (uart.readBytes(&b, 1) == 1)
+                latency.push_back(us_since(sent[latency.size()]));
+            continue;
+        }
+        poll(uart, 1);
+    }
+    writer.join();
+    return latency;
+}
+
+static void report(const char *name, std::vector<double> latency)
+{
+    if (latency.empty())
+        return;
+    std::sort(latency.begin(), latency.end());
+    double sum = 0;
+    for (double l : latency)
+        sum += l;
+    printf("%-12s %10.1f %10.1f %10.1f\n", name, sum / latency.size(), latency[latency.size() / 2], latency[latency.size() * 99 / 100]);
+}
+
+// Idle loop for a second, returns CPU ms used
+static double idle(UARTManager &uart, bool (*poll)(UARTManager &, int), long &loops)
+{
+    double c0 = cpu_ms();
+    auto t0 = BenchClock::now();
+    loops = 0;
+    while (BenchClock::now() - t0 < std::chrono::seconds(1))
+    {
+        if (uart.available() == 0)
+            poll(uart, 1);
+        loops++;
+    }
+    return cpu_ms() - c0;
+}
+
+static int check(UARTManager &uart, int master)
+{
+    int failures = 0;
+
+    // three bytes arrive, poll() reports them once even though they are not read
+    uint8_t bytes[3] = {1, 2, 3};
+    if (write(master, bytes, 3) != 3)
+        perror("write");
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    bool first = uart.poll(10);
+    bool second = uart.poll(10);
+    if (!first || second)
+    {
+        printf("unread data: poll() gave %d then %d\n", first, second);
+        failures++;
+    }
+    uart.flush_input();
+
+    // wake() from another thread ends the wait early
+    std::thread waker([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uart.wake();
+    });
+    auto t0 = BenchClock::now();
+    bool woken = uart.poll(1000);
+    double waited = us_since(t0);
+    waker.join();
+    if (!woken || waited > 500000)
+    {
+        printf("wake: poll() gave %d after %.0f us\n", woken, waited);
+        failures++;
+    }
+
+    // and the poll after it times out
+    if (uart.poll(10))
+    {
+        printf("wake reported twice\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    int bytes = 500;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc)
+            bytes = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--bytes N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        perror("pty");
+        return 2;
+    }
+
+    UARTManager uart;
+    uart.set_port(ptsname(master));
+    uart.begin(19200);
+    if (!uart.initialized())
+    {
+        fprintf(stderr, "can't open %s\n", ptsname(master));
+        return 2;
+    }
+
+    int failures = check(uart, master);
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+
+    printf("%d bytes, 2-5 ms apart\n", bytes);
+    printf("%-12s %10s %10s %10s\n", "latency us", "mean", "median", "p99");
+    std::vector<double> old_latency = measure(uart, master, bytes, sleep_poll);
+    std::vector<double> new_latency = measure(uart, master, bytes, uart_poll);
+    if ((int)old_latency.size() != bytes || (int)new_latency.size() != bytes)
+    {
+        printf("bytes lost: %zu and %zu of %d\n", old_latency.size(), new_latency.size(), bytes);
+        failures++;
+    }
+    report("sleep 500us", old_latency);
+    report("poll(1)", new_latency);
+
+    long old_loops, new_loops;
+    double old_cpu = idle(uart, sleep_poll, old_loops);
+    double new_cpu = idle(uart, uart_poll, new_loops);
+    printf("%-12s %10s %10s\n", "idle 1 s", "cpu ms", "loops");
+    printf("%-12s %10.1f %10ld\n", "sleep 500us", old_cpu, old_loops);
+    printf("%-12s %10.1f %10ld\n", "poll(1)", new_cpu, new_loops);
+
+    const uart_poll_stats &stats = uart.get_poll_stats();
+    printf("poll stats: %u polls, %u data, %u line, %u wake, %u timeout, wake latency max %u us\n",
+           stats.polls, stats.data, stats.line, stats.events, stats.timeouts, stats.latency_us_max);
+
+    uart.end();
+    close(master);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * WebDAV directory listing parser check and benchmark
+ *
+ * Check: a PROPFIND response is fed to WebDAV in pieces the way the HTTP
+ * protocol does, and the entries that come out match the generated
+ * listing: the collection itself is skipped, directories are flagged,
+ * and names and sizes are right also when a piece ends in the middle of
+ * them.
+ *
+ * Benchmark: time to parse listings of a few sizes, in 1 KB pieces, and
+ * entries per second.
+ *
+ * Build with "cmake --build build --target webdav_bench" and run:
+ *
+ *   webdav_bench [--entries N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "WebDAV.h"
+
+// globals the firmware expects from main.cpp
+#include "device.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+static std::string entry_name(int i)
+{
+    return "file " + std::to_string(i) + (i % 7 == 0 ? " with a longer name.atr" : ".xex");
+}
+
+static uint32_t entry_size(int i)
+{
+    return (uint32_t)i * 2654435761u % 100000000;
+}
+
+static bool entry_dir(int i)
+{
+    return i % 10 == 3;
+}
+
+// Multistatus response for a collection with entries members, as Apache mod_dav sends it
+static std::string propfind_response(int entries)
+{
+    std::string xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                      "<D:multistatus xmlns:D=\"DAV:\">\n"
+                      "<D:response><D:href>/dir/</D:href><D:propstat><D:prop>"
+                      "<D:displayname>dir</D:displayname><D:resourcetype><D:collection/></D:resourcetype>"
+                      "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>\n";
+    for (int i = 0; i < entries; i++)
+    {
+        std::string name = entry_name(i);
+        xml += "<D:response><D:href>/dir/" + name + "</D:href><D:propstat><D:prop>";
+        xml += "<D:displayname>" + name + "</D:displayname>";
+        if (entry_dir(i))
+            xml += "<D:resourcetype><D:collection/></D:resourcetype>";
+        else
+            xml += "<D:resourcetype/><D:getcontentlength>" + std::to_string(entry_size(i)) + "</D:getcontentlength>";
+        xml += "<D:getlastmodified>Sat, 17 Oct 2026 10:00:00 GMT</D:getlastmodified>";
+        xml += "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>\n";
+    }
+    xml += "</D:multistatus>\n";
+    return xml;
+}
+
+/**
+ * Parses xml in pieces of piece bytes, taking entries as soon as they are
+ * ready like NetworkProtocolHTTP::fetch_dir_entries(). Returns the number of
+ * entries, failures counts wrong ones.
+ */
+static int parse_listing(const std::string &xml, size_t piece, int *failures)
+{
+    WebDAV dav;
+    dav.begin_parser();
+    size_t pos = 0;
+    int count = 0;
+    WebDAV::DAVEntry e;
+    while (true)
+    {
+        if (dav.next_entry(e))
+        {
+            if (failures != nullptr)
+            {
+                bool dir = entry_dir(count);
+                if (e.filename != entry_name(count) || e.isDir != dir || (!dir && e.fileSize != entry_size(count)))
+                {
+                    if (*failures < 5)
+                        printf("check: entry %d is \"%s\" %s %u\n", count, e.filename.c_str(), e.isDir ? "dir" : "file", e.fileSize);
+                    (*failures)++;
+                }
+            }
+            count++;
+            continue;
+        }
+        if (pos >= xml.size())
+            break;
+        size_t n = xml.size() - pos < piece ? xml.size() - pos : piece;
+        if (dav.parse(xml.data() + pos, n, pos + n == xml.size()))
+        {
+            if (failures != nullptr)
+                (*failures)++;
+            break;
+        }
+        pos += n;
+    }
+    dav.end_parser(true);
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    int max_entries = 10000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--entries") == 0 && i + 1 < argc)
+            max_entries = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--entries N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failures = 0;
+    std::string xml = propfind_response(500);
+    for (size_t piece : {1, 7, 64, 1024, 1 << 20})
+    {
+        int count = parse_listing(xml, piece, &failures);
+        if (count != 500)
+        {
+            printf("check: %d entries in %zu byte pieces\n", count, piece);
+            failures++;
+        }
+    }
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    printf("%-8s %10s %10s %14s\n", "entries", "KB", "ms", "entries/s");
+    for (int entries : {100, 1000, max_entries})
+    {
+        xml = propfind_response(entries);
+        double best = 0;
+        for (int round = 0; round < 5; round++)
+        {
+            auto t0 = BenchClock::now();
+            parse_listing(xml, 1024, nullptr);
+            double ms = ms_since(t0);
+            if (round == 0 || ms < best)
+                best = ms;
+        }
+        printf("%-8d %10zu %10.2f %14.0f\n", entries, xml.size() / 1024, best, entries / (best / 1000.0));
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * zlibStream round trip check and benchmark against the host zlib
+ *
+ * Check: data of several kinds and sizes (empty, incompressible, long runs,
+ * PDF page operators, PNG scanlines, random mixes) is compressed with the
+ * printer emulators' zlibStream, written in pieces of 1 byte up to all at
+ * once and with short and long match chains, and inflated again with the
+ * host zlib. The stream must end where zlib says it ends and give back the
+ * same bytes, the Adler-32 is checked by zlib on the way. The stored block
+ * streams the PNG printer falls back to without memory for the window are
+ * checked the same way, with writes larger than one stored block.
+ *
+ * Benchmark: compression speed and size for PDF operators and PNG scanlines,
+ * zlibStream and its stored blocks against zlib's compress2() at levels 1
+ * and 6.
+ *
+ * Build with "cmake --build build --target zlib_bench" and run:
+ *
+ *   zlib_bench [--mb N] [--fuzz N]
+ *
+ * Exits with 1 if any check fails.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "zlib_stream.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ms_since(BenchClock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - t).count();
+}
+
+// Text drawing operators like the PDF printers write for a page
+static std::string pdf_operators(size_t size, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s;
+    char line[160];
+    for (int y = 0; s.size() < size; y++)
+    {
+        int n = snprintf(line, sizeof(line), "BT /F1 12 Tf 1 0 0 1 %d.%02d %d.%02d Tm (LINE %u PRINT X\\(%u\\)) Tj ET\n",
+                         18 + (int)(rng() % 3), (int)(rng() % 100), 780 - (y % 66) * 12, (int)(rng() % 100), y, (unsigned)(rng() % 1000));
+        s.append(line, n);
+    }
+    s.resize(size);
+    return s;
+}
+
+// Filtered scanlines of a 320 pixel RGB image with large flat areas
+static std::string png_scanlines(size_t size)
+{
+    std::string s;
+    for (int y = 0; s.size() < size; y++)
+    {
+        s += (char)(y % 3 == 0 ? 2 : 1); // up, sub
+        for (int x = 0; x < 320; x++)
+        {
+            int dx = x - 160, dy = (y % 200) - 96;
+            uint8_t c = (dx * dx + dy * dy * 3 < 4000) ? 0x80 : (x / 40 + y / 24) % 2 ? 0x40 : 0;
+            s += (char)c;
+            s += (char)(c >> 1);
+            s += (char)(c ^ (uint8_t)y);
+        }
+    }
+    s.resize(size);
+    return s;
+}
+
+static std::string random_bytes(size_t size, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s(size, '\0');
+    for (auto &c : s)
+        c = (char)rng();
+    return s;
+}
+
+// Pieces of the other kinds glued together, with runs and repeats far apart
+static std::string random_mix(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s;
+    int pieces = 1 + rng() % 12;
+    for (int i = 0; i < pieces; i++)
+    {
+        size_t n = rng() % (rng() % 4 == 0 ? 20000 : 600);
+        switch (rng() % 5)
+        {
+        case 0:
+            s += random_bytes(n, rng());
+            break;
+        case 1:
+            s += std::string(n, (char)rng());
+            break;
+        case 2:
+            s += pdf_operators(n, rng());
+            break;
+        case 3:
+            s += png_scanlines(n);
+            break;
+        case 4:
+            if (!s.empty())
+            {
+                size_t from = rng() % s.size();
+                s += s.substr(from, n);
+            }
+            break;
+        }
+    }
+    return s;
+}
+
+// max_chain 0 writes stored blocks
+static std::string deflate_stream(const std::string &src, size_t piece, int max_chain)
+{
+    std::string out;
+    zlibStream z;
+    if (max_chain == 0)
+        z.begin_stored(&out);
+    else if (!z.begin(&out, max_chain))
+        return out;
+    for (size_t pos = 0; pos < src.size(); pos += piece)
+        z.write(src.data() + pos, std::min(piece, src.size() - pos));
+    z.end();
+    return out;
+}
+
+// Inflate with the host zlib, returns false unless the stream is complete and nothing follows it
+static bool inflate_stream(const std::string &in, std::string &out)
+{
+    z_stream zs = {};
+    if (inflateInit(&zs) != Z_OK)
+        return false;
+    zs.next_in = (Bytef *)in.data();
+    zs.avail_in = in.size();
+    out.clear();
+    char buf[16384];
+    int ret;
+    do
+    {
+        zs.next_out = (Bytef *)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    bool ok = ret == Z_STREAM_END && zs.avail_in == 0;
+    inflateEnd(&zs);
+    return ok;
+}
+
+static int failures = 0;
+
+static void round_trip(const char *what, const std::string &src, size_t piece, int max_chain)
+{
+    std::string packed = deflate_stream(src, piece, max_chain);
+    std::string back;
+    if (!inflate_stream(packed, back) || back != src)
+    {
+        if (failures < 10)
+            printf("check: %s, %zu bytes in %zu byte pieces, %s %d does not inflate back\n",
+                   what, src.size(), piece, max_chain ? "chain" : "stored", max_chain);
+        failures++;
+    }
+}
+
+static void check(int fuzz)
+{
+    struct
+    {
+        const char *name;
+        std::string data;
+    } inputs[] = {
+        {"empty", ""},
+        {"one byte", "A"},
+        {"short text", "%PDF-1.5\n"},
+        {"random", random_bytes(100000, 1)},
+        {"zeros", std::string(300000, '\0')},
+        {"pdf", pdf_operators(200000, 2)},
+        {"png", png_scanlines(200000)},
+    };
+    for (auto &in : inputs)
+        for (size_t piece : {(size_t)1, (size_t)7, (size_t)1000, (size_t)ZLIB_WINDOW_SIZE, in.data.size() + 1})
+            for (int chain : {0, 1, ZLIB_MAX_CHAIN, 256})
+                round_trip(in.name, in.data, piece, chain);
+
+    // sizes around the window and the sliding of it
+    for (size_t size : {(size_t)ZLIB_WINDOW_SIZE - 1, (size_t)ZLIB_WINDOW_SIZE, (size_t)2 * ZLIB_WINDOW_SIZE - 1,
+                        (size_t)2 * ZLIB_WINDOW_SIZE, (size_t)2 * ZLIB_WINDOW_SIZE + 1, (size_t)3 * ZLIB_WINDOW_SIZE + 257})
+    {
+        round_trip("window edge pdf", pdf_operators(size, 3), 333, ZLIB_MAX_CHAIN);
+        round_trip("window edge run", std::string(size, 'x'), 333, ZLIB_MAX_CHAIN);
+    }
+
+    std::mt19937 rng(7);
+    for (int i = 0; i < fuzz; i++)
+        round_trip("mix", random_mix(rng()), 1 + rng() % 5000, rng() % 64);
+
+    // stored blocks hold at most 65535 bytes
+    for (size_t size : {(size_t)65534, (size_t)65535, (size_t)65536, (size_t)3 * 65535 + 1})
+        round_trip("stored block edge", random_bytes(size, 8), size, 0);
+
+    // the one shot helper is what the PDF printers use
+    std::string src = pdf_operators(50000, 4), packed, back;
+    if (!zlibStream::compress(src, packed) || !inflate_stream(packed, back) || back != src)
+    {
+        printf("check: zlibStream::compress() does not inflate back\n");
+        failures++;
+    }
+}
+
+static void bench(const char *name, const std::string &src, size_t piece)
+{
+    for (int chain : {ZLIB_MAX_CHAIN, 0})
+    {
+        auto t0 = BenchClock::now();
+        std::string packed = deflate_stream(src, piece, chain);
+        double ms = ms_since(t0);
+        printf("%-5s %-14s %9.1f %9zu %8.1f%%\n", name, chain ? "zlibStream" : "stored", src.size() / 1048576.0 / (ms / 1000.0),
+               packed.size(), 100.0 * packed.size() / src.size());
+    }
+
+    for (int level : {1, 6})
+    {
+        std::vector<Bytef> out(compressBound(src.size()));
+        uLongf len = out.size();
+        auto t0 = BenchClock::now();
+        compress2(out.data(), &len, (const Bytef *)src.data(), src.size(), level);
+        double ms = ms_since(t0);
+        char label[32];
+        snprintf(label, sizeof(label), "zlib level %d", level);
+        printf("%-5s %-14s %9.1f %9lu %8.1f%%\n", name, label, src.size() / 1048576.0 / (ms / 1000.0),
+               (unsigned long)len, 100.0 * len / src.size());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t mb = 4;
+    int fuzz = 300;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+            mb = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc)
+            fuzz = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--mb N] [--fuzz N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    check(fuzz);
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    if (failures)
+        return 1;
+
+    printf("%-5s %-14s %9s %9s %9s\n", "data", "", "MB/s", "bytes", "size");
+    // PDF operators come in small writes, scanlines a line at a time
+    bench("pdf", pdf_operators(mb << 20, 5), 40);
+    bench("png", png_scanlines(mb << 20), 321);
+    return 0;
+}